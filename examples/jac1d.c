@@ -43,10 +43,12 @@ int main(int argc, char* argv[])
     int ksize = 0;
     int maxiter = 0;
     int repart = 0; // enforce repartitioning after <repart> iterations
+    double tolerance = -1.0; // if >= 0, repartition incrementally
 
     if (argc > 1) ksize = atoi(argv[1]);
     if (argc > 2) maxiter = atoi(argv[2]);
     if (argc > 3) repart = atoi(argv[3]);
+    if (argc > 4) tolerance = atof(argv[4]);
 
     if (ksize == 0) ksize = 10000; // 10 mio entries
     if (maxiter == 0) maxiter = 50;
@@ -84,6 +86,15 @@ int main(int argc, char* argv[])
     prWrite = laik_new_block_partitioner1();
     prRead = laik_new_cornerhalo_partitioner(1);
 
+    // for repartitioning: changing task weights (see getTW)
+    static int userData;
+    // incremental repartitioning only moving borders if a task is loaded
+    // more than (1 + tolerance) times its share
+    Laik_Partitioner* prRebalance = 0;
+    if (tolerance >= 0.0)
+        prRebalance = laik_new_rebalance_partitioner(0, getTW, &userData,
+                                                     tolerance);
+
     Laik_Data *dWrite, *dRead; // set to data1/2, depending on iteration
     Laik_Partitioning *pWrite, *pRead;
     int iter = laik_phase(inst);
@@ -242,15 +253,24 @@ int main(int argc, char* argv[])
 
         // optionally, change partitioning slightly as test
         if ((repart > 0) && (iter > 0) && ((iter % repart) == 0)) {
-            static int userData;
             userData = iter / repart;
-            laik_set_task_weight(prWrite, getTW, (void*) &userData);
+            if (!prRebalance)
+                laik_set_task_weight(prWrite, getTW, (void*) &userData);
 
             // calculate new partitionings, switch to them, free old
             // only need to preserve data written into dWrite
             Laik_Partitioning *pWriteNew, *pReadNew;
-            pWriteNew = laik_new_partitioning(prWrite, world, space, 0);
+            if (prRebalance)
+                pWriteNew = laik_new_partitioning(prRebalance, world, space, pWrite);
+            else
+                pWriteNew = laik_new_partitioning(prWrite, world, space, 0);
             pReadNew  = laik_new_partitioning(prRead, world, space, pWriteNew);
+
+            uint64_t sendBytes, recvBytes;
+            laik_data_migration_bytes(dWrite, pWriteNew, &sendBytes, &recvBytes);
+            laik_log(2, "Repartitioning: sending %llu bytes, receiving %llu bytes",
+                     (unsigned long long) sendBytes,
+                     (unsigned long long) recvBytes);
             laik_switchto_partitioning(dWrite, pWriteNew,
                                        LAIK_DF_Preserve, LAIK_RO_None);
             laik_switchto_partitioning(dRead, pReadNew,
@@ -66,6 +66,20 @@ void setBoundary(int size, Laik_Partitioning *pWrite, Laik_Data* dWrite)
     }
 }
 
+// do jacobi update for cells in [y1;y2[ x [x1;x2[, indexing as with baseW
+void update(double* baseR, uint64_t ystrideR, double* baseW, uint64_t ystrideW,
+            int64_t y1, int64_t y2, int64_t x1, int64_t x2)
+{
+    for(int64_t y = y1; y < y2; y++) {
+        for(int64_t x = x1; x < x2; x++) {
+            baseW[y * ystrideW + x] = 0.25 * ( baseR[ (y-1) * ystrideR + x    ] +
+                                               baseR[  y    * ystrideR + x - 1] +
+                                               baseR[  y    * ystrideR + x + 1] +
+                                               baseR[ (y+1) * ystrideR + x    ] );
+        }
+    }
+}
+
 // to deliberately change block partitioning (if arg 3 provided)
 double getTW(int rank, const void* userData)
 {
@@ -85,18 +99,21 @@ int main(int argc, char* argv[])
     bool use_cornerhalo = true; // use halo partitioner including corners?
     bool do_profiling = false;
     bool do_sum = false;
+    bool do_overlap = false; // split-phase switch for halo exchange?
 
     int arg = 1;
     while ((argc > arg) && (argv[arg][0] == '-')) {
         if (argv[arg][1] == 'n') use_cornerhalo = false;
         if (argv[arg][1] == 'p') do_profiling = true;
         if (argv[arg][1] == 's') do_sum = true;
+        if (argv[arg][1] == 'o') do_overlap = true;
         if (argv[arg][1] == 'h') {
             printf("Usage: %s [options] <side width> <maxiter> <repart>\n\n"
                    "Options:\n"
                    " -n : use partitioner which does not include corners\n"
                    " -p : write profiling data to 'jac2d_profiling.txt'\n"
                    " -s : print value sum at end (warning: sum done at master)\n"
+                   " -o : overlap halo exchange with update of inner cells\n"
                    " -h : print this help text and exit\n",
                    argv[0]);
             exit(1);
@@ -183,6 +200,12 @@ int main(int argc, char* argv[])
     int last_iter = 0;
     int res_iters = 0; // iterations done with residuum calculation
 
+    // for statistics on overlapping (with -o and LAIK_LOG=2):
+    // time for switch in iterations without overlap (residuum calculation),
+    // and time spent for begin/end of split-phase switches
+    double ts, tSync = 0.0, tBegin = 0.0, tEnd = 0.0;
+    int syncSwitches = 0, splitSwitches = 0;
+
     int iter = 0;
     for(; iter < maxiter; iter++) {
         laik_set_iteration(inst, iter + 1);
@@ -191,7 +214,19 @@ int main(int argc, char* argv[])
         if (dRead == data1) { dRead = data2; dWrite = data1; }
         else                { dRead = data1; dWrite = data2; }
 
-        laik_switchto_partitioning(dRead,  pRead,  LAIK_DF_Preserve, LAIK_RO_None);
+        // with overlap, residuum iterations still use a normal switch
+        Laik_SwitchHandle* sh = 0;
+        ts = laik_wtime();
+        if (do_overlap && ((iter % 10) != 0)) {
+            sh = laik_switchto_begin(dRead, pRead, LAIK_DF_Preserve, LAIK_RO_None);
+            tBegin += laik_wtime() - ts;
+            splitSwitches++;
+        }
+        else {
+            laik_switchto_partitioning(dRead, pRead, LAIK_DF_Preserve, LAIK_RO_None);
+            tSync += laik_wtime() - ts;
+            syncSwitches++;
+        }
         laik_switchto_partitioning(dWrite, pWrite, LAIK_DF_None, LAIK_RO_None);
         laik_get_map_2d(dRead,  0, (void**) &baseR, &ysizeR, &ystrideR, &xsizeR);
         laik_get_map_2d(dWrite, 0, (void**) &baseW, &ysizeW, &ystrideW, &xsizeW);
@@ -265,6 +300,20 @@ int main(int argc, char* argv[])
 
             if (res < .001) break;
         }
+        else if (sh) {
+            // inner cells do not need halo values: update during exchange
+            update(baseR, ystrideR, baseW, ystrideW, y1 + 1, y2 - 1, x1 + 1, x2 - 1);
+
+            ts = laik_wtime();
+            laik_switchto_end(sh);
+            tEnd += laik_wtime() - ts;
+
+            // border rows and columns
+            update(baseR, ystrideR, baseW, ystrideW, y1, y1 + 1, x1, x2);
+            update(baseR, ystrideR, baseW, ystrideW, y2 - 1, y2, x1, x2);
+            update(baseR, ystrideR, baseW, ystrideW, y1 + 1, y2 - 1, x1, x1 + 1);
+            update(baseR, ystrideR, baseW, ystrideW, y1 + 1, y2 - 1, x2 - 1, x2);
+        }
         else {
             double newValue;
             for(int64_t y = y1; y < y2; y++) {
@@ -294,6 +343,18 @@ int main(int argc, char* argv[])
                  gUpdates * (7 * res_iters + 4 * (diter - res_iters)) / dt,
                  // per update 32 bytes read + 8 byte written
                  gUpdates * diter * 40 / dt);
+
+        if ((syncSwitches > 0) && (splitSwitches > 0)) {
+            // communication time hidden by overlap: time of normal switch
+            // minus time not overlapped in split-phase switch
+            double avgSync = tSync / syncSwitches;
+            double avgSplit = (tBegin + tEnd) / splitSwitches;
+            laik_log(2, "Halo switch (ms): sync %.3f, split %.3f "
+                     "(begin %.3f, wait %.3f), hidden %.3f",
+                     1000.0 * avgSync, 1000.0 * avgSplit,
+                     1000.0 * tBegin / splitSwitches, 1000.0 * tEnd / splitSwitches,
+                     1000.0 * (avgSync - avgSplit));
+        }
     }
 
     if (do_sum) {
@@ -106,6 +106,11 @@ void help(char* err)
            " -s <iter>       iterations after which to shrink by removing task 0\n"
            " -t <task>       on shrinking, remove task with ID <task> (default 0)\n"
            " -i              use incremental partitioner on shrinking\n"
+           " -w              give row weights as array (prefix sums kept)\n"
+           " -W              give row weights as distributed container\n"
+           " -l <factor>     simulate slow tasks: odd tasks compute <factor> times\n"
+           " -b <threshold>  balance load if slowest task needs more than\n"
+           "                 (1 + <threshold>) times average compute time\n"
            " -v              make LAIK verbose (same as LAIK_LOG=1)\n");
     exit(1);
 }
@@ -119,6 +124,11 @@ int main(int argc, char* argv[])
     int maxiter = 0, size = 0, nextshrink = -1, shrink = -1, removeTask = 0;
     bool useReduction = false;
     bool useIncremental = false;
+    // 0: weight callback, 1: weight array, 2: distributed weight container
+    int weightMode = 0;
+    // automatic load balancing if >= 0, with artificial slowdown
+    double lbThreshold = -1.0;
+    int slowFactor = 1;
 
     // timing: t1 raw computation, t2: everything without init
     double t1 = 0.0, t2 = 0.0, tt1, tt2, tt;
@@ -135,6 +145,10 @@ int main(int argc, char* argv[])
                 useIncremental = true;
             else if (argv[arg][1] == 'v')
                 laik_set_loglevel(1);
+            else if (argv[arg][1] == 'w')
+                weightMode = 1;
+            else if (argv[arg][1] == 'W')
+                weightMode = 2;
             else if (argv[arg][1] == 's') {
                 arg++;
                 if (arg < argc)
@@ -142,6 +156,20 @@ int main(int argc, char* argv[])
                 else
                     help("-s: no parameter");
             }
+            else if (argv[arg][1] == 'l') {
+                arg++;
+                if (arg < argc)
+                    slowFactor = atoi(argv[arg]);
+                else
+                    help("-l needs a slowdown factor");
+            }
+            else if (argv[arg][1] == 'b') {
+                arg++;
+                if (arg < argc)
+                    lbThreshold = atof(argv[arg]);
+                else
+                    help("-b needs a threshold");
+            }
             else if (argv[arg][1] == 't') {
                 arg++;
                 if (arg < argc)
@@ -169,6 +197,12 @@ int main(int argc, char* argv[])
 
     if (maxiter == 0) maxiter = 10;
     if (size == 0) size = 10000;
+    // weights in container are only available to processes of its group
+    if ((weightMode == 2) && (shrink >= 0))
+        help("-W can not be combined with shrinking");
+    if ((lbThreshold >= 0.0) && (shrink >= 0))
+        help("-b can not be combined with shrinking");
+    if (slowFactor < 1) slowFactor = 1;
 
     laik_enable_profiling(inst);
 
@@ -201,6 +235,35 @@ int main(int argc, char* argv[])
     // block partitioning according to number of non-zero elems in matrix rows
     Laik_Partitioner* pr = laik_new_block_partitioner(0, 1, getEW, 0, m);
     laik_set_index_weight(pr, getEW, m);
+    double* weights = 0;
+    if (weightMode == 1) {
+        // same weights, but given as array
+        weights = malloc(size * sizeof(double));
+        for(int r = 0; r < size; r++)
+            weights[r] = (double) (m->row[r + 1] - m->row[r]);
+        laik_set_index_weight_array(pr, weights, size);
+    }
+    else if (weightMode == 2) {
+        // same weights, but each process only provides weights of own rows
+        Laik_Data* wD = laik_new_data(s, laik_Double);
+        laik_data_set_name(wD, "weights");
+        Laik_Partitioning* pW;
+        pW = laik_switchto_new_partitioning(wD, world, laik_new_block_partitioner1(),
+                                            LAIK_DF_None, LAIK_RO_None);
+        double* w;
+        int64_t from, to;
+        for(int rangeNo = 0; laik_my_range_1d(pW, rangeNo, &from, &to); rangeNo++) {
+            laik_get_map_1d(wD, rangeNo, (void**) &w, 0);
+            for(int64_t r = from; r < to; r++)
+                w[r - from] = (double) (m->row[r + 1] - m->row[r]);
+        }
+        laik_set_index_weight_data(pr, wD);
+    }
+    // check for imbalance every iteration, repartition at most every 2nd
+    Laik_LoadBalancer* lb = 0;
+    if (lbThreshold >= 0.0)
+        lb = laik_new_load_balancer(pr, lbThreshold, 2);
+
     Laik_Partitioning* p = laik_new_partitioning(pr, world, s, 0);
     // nothing to preserve between iterations (assume at least one iter)
     laik_switchto_partitioning(resD, p, LAIK_DF_None, LAIK_RO_None);
@@ -239,6 +302,8 @@ int main(int argc, char* argv[])
         // do a partial sum of result during traversal
         sum = 0.0;
         tt1 = wtime();
+        if (lb) laik_lb_start(lb);
+        int reps = (laik_myid(world) & 1) ? slowFactor : 1;
 
         // loop over all local ranges
         for(int rangeNo = 0; ; rangeNo++) {
@@ -247,19 +312,22 @@ int main(int argc, char* argv[])
             // my partition range of result vector (local indexing, from 0)
             laik_get_map_1d(resD, rangeNo, (void**) &res, &rcount);
 
+            for(int rep = 0; rep < reps; rep++) {
 #ifdef _OPENMP
 #pragma omp parallel for schedule(dynamic,50)
 #endif
-            for(int64_t r = fromRow; r < toRow; r++) {
-                res[r - fromRow] = 0.0;
-                for(int o = m->row[r]; o < m->row[r+1]; o++)
-                    res[r - fromRow] += m->val[o] * inp[m->col[o]];
+                for(int64_t r = fromRow; r < toRow; r++) {
+                    res[r - fromRow] = 0.0;
+                    for(int o = m->row[r]; o < m->row[r+1]; o++)
+                        res[r - fromRow] += m->val[o] * inp[m->col[o]];
+                }
             }
 
             for(i = 0; i < rcount; i++)
                 sum += res[i];
         }
         t1 += wtime() - tt1;
+        if (lb) laik_lb_stop(lb);
 
         // compute global sum with LAIK, broadcast result to all
         // only done by tasks which still take part in SPMV
@@ -354,6 +422,17 @@ int main(int argc, char* argv[])
         laik_switchto_partitioning(inpD, pAll, LAIK_DF_Preserve, LAIK_RO_Sum);
 
         if (laik_myid(world) == -1) break;
+
+        // automatic load balancing: new partitioning for result vector
+        // (written in next iteration, nothing to preserve)
+        if (lb && (iter + 1 < maxiter)) {
+            Laik_Partitioning* p2 = laik_lb_balance(lb, p);
+            if (p2) {
+                laik_switchto_partitioning(resD, p2, LAIK_DF_None, LAIK_RO_None);
+                laik_free_partitioning(p);
+                p = p2;
+            }
+        }
     }
     
     laik_iter_reset(inst);
@@ -379,6 +458,8 @@ int main(int argc, char* argv[])
     laik_log(2, "Timing: Laik total: %.3fs, backend: %.3fs\n",
              laik_get_total_time(), laik_get_backend_time());
 
+    if (lb) laik_free_load_balancer(lb);
     laik_finalize(inst);
+    free(weights);
     return 0;
 }
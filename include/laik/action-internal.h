@@ -38,15 +38,23 @@
 // funactions are defined. They may be useful by backends for optimizing
 // a sequence.
 
-// all actions must start with this 4-byte header
+// all actions must start with this 6-byte header
 struct _Laik_Action {
     unsigned char type;
-    unsigned char len;
-    unsigned char round;   // actions are order by rounds
     unsigned char tid  :7; // ID of transition context for this action
     unsigned char mark :1; // boolean flag used in some transformations
+    unsigned short len;
+    unsigned short round;  // actions are order by rounds
 };
 
+// maximal number of transition contexts (limited by <tid>) and rounds
+#define ASEQ_CONTEXTS_MAX 128
+#define ASEQ_ROUNDS_MAX   65536
+
+// IDs of buffer reservations start here, lower IDs refer to allocated
+// buffers (see laik_aseq_addBufReserve)
+#define ASEQ_RESERVEID_BASE 1000000
+
 // for iterating action sequences
 #define nextAction(a) ((Laik_Action*) (((char*)a) + a->len))
 
@@ -210,22 +218,34 @@ struct _Laik_ActionSeq {
     // the backend gets called for clean-up when the sequence is destroyed
     Laik_Backend* backend;
 
-    // actions can refer to different transition contexts
-#define ASEQ_CONTEXTS_MAX 1
-    void* context[ASEQ_CONTEXTS_MAX];
-    int contextCount;
-
-    // each call to laik_aseq_allocBuffer() allocates another buffer
-#define ASEQ_BUFFER_MAX 5
-    char* buf[ASEQ_BUFFER_MAX];
-    size_t bufSize[ASEQ_BUFFER_MAX];
-    int bufferCount;
+    // set by backend prepare if all processes of the group must execute
+    // the sequence (collective operations), even without own communication
+    bool collective;
+
+    // set if the sequence gets executed multiple times (cached switch or
+    // sequence held by the application): one-time setup is worth it
+    bool reused;
+
+    // actions can refer to different transition contexts (growable).
+    // All transitions must be in the same process group, such that
+    // messages to the same peer can be combined across containers
+    void** context;
+    int contextCount, contextAlloc;
+    // context ID given to actions appended by the add functions, set by
+    // transformations to the one of the action currently transformed
+    int currentTID;
+
+    // each call to laik_aseq_allocBuffer() adds another buffer (growable).
+    // all buffers are parts of one arena starting at buf[0], which gets
+    // reallocated on each call
+    char** buf;
+    size_t* bufSize;
+    int bufferCount, bufferAlloc;
     unsigned int bufReserveCount; // current number of BufReserve actions
 
-    // for copy actions
-#define ASEQ_COPYENTRY_MAX 5
-    Laik_CopyEntry* ce[ASEQ_COPYENTRY_MAX];
-    int ceCount;
+    // for copy actions (growable)
+    Laik_CopyEntry** ce;
+    int ceCount, ceAlloc;
     int ceRanges;
 
     // action sequence to trigger on execution
@@ -488,6 +508,9 @@ bool laik_aseq_sort_rounds(Laik_ActionSeq* as);
 // transform MapPackAndSend/MapRecvAndUnpack into simple Send/Recv actions
 bool laik_aseq_flattenPacking(Laik_ActionSeq* as);
 
+// send/recv directly from/to mappings for ranges stored contiguously
+bool laik_aseq_avoidPacking(Laik_ActionSeq* as);
+
 // transformation for split reduce actions into basic multiple actions
 bool laik_aseq_splitReduce(Laik_ActionSeq* as);
 
@@ -507,6 +530,9 @@ int laik_aseq_calc_stats(Laik_ActionSeq* as);
 void laik_exec_pack(Laik_BackendAction* a, Laik_Mapping* map);
 // exec action LAIK_AT_UnpackFromBuf
 void laik_exec_unpack(Laik_BackendAction* a, Laik_Mapping* map);
+// exec actions LAIK_AT_CopyToBuf/CopyFromBuf, using the thread pool
+void laik_threads_copyEntries(Laik_CopyEntry* ce, unsigned int count,
+                              char* buf, bool toBuf);
 
 
 #endif // LAIK_ACTION_INTERNAL_H
@@ -58,6 +58,13 @@ struct _Laik_Backend {
   // execute a action sequence
   void (*exec)(Laik_ActionSeq*);
 
+  // split-phase execution of an action sequence, can be NULL.
+  // exec_begin starts execution without blocking (e.g. by posting
+  // asynchronous requests) and returns the number of actions done.
+  // exec_end executes the remaining actions, waiting for completion.
+  unsigned int (*exec_begin)(Laik_ActionSeq*);
+  void (*exec_end)(Laik_ActionSeq*, unsigned int done);
+
   // update backend specific data for group if needed
   void (*updateGroup)(Laik_Group*);
 
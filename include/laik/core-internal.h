@@ -101,7 +101,10 @@ struct _Laik_Instance {
 
     // External Control Related
     Laik_RepartitionControl* repart_ctrl;
-    
+
+    // only store own ranges of partitionings, see laik_set_owner_ranges()
+    bool ownerRanges;
+
 };
 
 // allocate space for a new LAIK instance.
@@ -117,6 +120,7 @@ void laik_addSpaceForInstance(Laik_Instance* inst, Laik_Space* s);
 void laik_removeSpaceFromInstance(Laik_Instance* inst, Laik_Space* s);
 
 void laik_addDataForInstance(Laik_Instance* inst, Laik_Data* d);
+void laik_removeDataFromInstance(Laik_Instance* inst, Laik_Data* d);
 
 // synchronize location strings via KVS among processes in current world
 void laik_sync_location(Laik_Instance *instance);
@@ -157,6 +161,7 @@ struct _Laik_KVS_Entry {
     char* key;
     char* value;
     unsigned int vlen;
+    unsigned int vcap; // space at <value>, for in-place updates
     bool updated;
 
     void* data; // custom user data attached to this entry
@@ -173,6 +178,9 @@ struct _Laik_KVS_Changes {
     Laik_KVS_Entry* entry;
 };
 
+// chunk of memory for keys/values of a KV store (see kvs.c)
+typedef struct _Laik_KVS_Chunk Laik_KVS_Chunk;
+
 struct _Laik_KVStore {
     Laik_Instance* inst;
     const char* name;
@@ -180,9 +188,16 @@ struct _Laik_KVStore {
     // KV array
     Laik_KVS_Entry* entry;
     unsigned int size, used;
-    // new entries are unsorted, call laik_kvs_sort to enable binary search
+    // new entries are appended unsorted, sorted by laik_kvs_sort
     unsigned int sorted_upto;
 
+    // open-addressing hash index for key lookup: entry index + 1 (0: empty)
+    unsigned int* hash;
+    unsigned int hashSize; // power of 2, at least 2x <used>
+
+    // arena for keys and values: only freed with the store
+    Laik_KVS_Chunk* arena;
+
     laik_kvs_created_func created_func;
     laik_kvs_changed_func changed_func;
     laik_kvs_removed_func removed_func;
@@ -208,5 +223,37 @@ void laik_kvs_changes_sort(Laik_KVS_Changes* c);
 void laik_kvs_changes_merge(Laik_KVS_Changes* dst,
                             Laik_KVS_Changes* src1, Laik_KVS_Changes* src2);
 void laik_kvs_changes_apply(Laik_KVS_Changes* c, Laik_KVStore* kvs);
+void laik_kvs_changes_apply_other(Laik_KVS_Changes* c, Laik_KVS_Changes* own,
+                                  Laik_KVStore* kvs);
+
+//--------------------------------------------------------
+// Thread pool for local actions (see thread.c)
+//
+
+// called for chunk [from;to[ of elements
+typedef void (*laik_chunk_func_t)(void* ctx, uint64_t from, uint64_t to);
+// called for sub-range of a range, <off> is index of first sub-range
+// element in lexicographical traversal order of the full range
+typedef void (*laik_range_func_t)(void* ctx, Laik_Range* sub, uint64_t off);
+
+// start/stop worker threads as requested by LAIK_THREADS
+void laik_threads_init(void);
+void laik_threads_finalize(void);
+int laik_threads_count(void);
+
+// run <f> on chunks of [0;count[, each at least <minChunk> elements large
+void laik_threads_run(uint64_t count, uint64_t minChunk,
+                      laik_chunk_func_t f, void* ctx);
+// run <f> on sub-ranges of <range>, split along highest dimension
+void laik_threads_run_range(Laik_Range* range, int elemsize,
+                            laik_range_func_t f, void* ctx);
+
+// parallel variants of element-wise operations
+void laik_threads_memcpy(void* to, const void* from, uint64_t bytes);
+void laik_threads_init_elems(Laik_Type* t, void* base, uint64_t count,
+                             Laik_ReductionOperation op);
+void laik_threads_reduce(Laik_Type* t, void* out,
+                         const void* in1, const void* in2,
+                         uint64_t count, Laik_ReductionOperation op);
 
 #endif // LAIK_CORE_INTERNAL_H
@@ -57,13 +57,18 @@ struct _Laik_SwitchStat
     int mallocCount, freeCount;
     uint64_t mallocedBytes, freedBytes, initedBytes, copiedBytes;
     uint64_t currAllocedBytes, maxAllocedBytes;
+    // mapping allocations served from memory pool (LAIK_MP_UsePool)
+    int poolHitCount;
+    uint64_t poolHitBytes;
     int transitionCount;
     unsigned int msgSendCount, msgRecvCount, msgReduceCount;
     unsigned int msgAsyncSendCount, msgAsyncRecvCount;
     uint64_t elemSendCount, elemRecvCount, elemReduceCount;
     uint64_t byteSendCount, byteRecvCount, byteReduceCount;
     uint64_t initOpCount, reduceOpCount, byteBufCopyCount;
-
+    // switch cache: reuse of transitions and prepared action sequences
+    int transCacheHits, transCacheMisses;
+    int aseqCacheHits, aseqCacheMisses;
 };
 
 Laik_SwitchStat* laik_newSwitchStat(void);
@@ -72,6 +77,17 @@ void laik_switchstat_addASeq(Laik_SwitchStat* target, Laik_ActionSeq* as);
 void laik_switchstat_malloc(Laik_SwitchStat* ss, uint64_t bytes);
 void laik_switchstat_free(Laik_SwitchStat* ss, uint64_t bytes);
 
+// default malloc/free functions used by allocators
+void* laik_def_malloc(Laik_Data* d, size_t size);
+void laik_def_free(Laik_Data* d, void* ptr);
+
+// memory pool for allocators with policy LAIK_MP_UsePool (see mempool.c)
+void* laik_mempool_alloc(Laik_Allocator* a, Laik_Data* d,
+                         uint64_t* size, Laik_SwitchStat* ss);
+void laik_mempool_free(Laik_Allocator* a, Laik_Data* d,
+                       void* ptr, uint64_t size);
+void laik_mempool_release(Laik_Allocator* a);
+
 // information for a reservation
 typedef struct _Laik_ReservationEntry {
     Laik_Partitioning* p;
@@ -91,6 +107,36 @@ struct _Laik_Reservation {
     Laik_MappingList* mList; // mappings for reservations
 };
 
+// cached transition for switching between two partitionings, with
+// action sequence prepared for given mapping lists (only if the lists
+// belong to reservations, as otherwise they are not reused)
+typedef struct _Laik_SwitchCacheEntry {
+    Laik_Partitioning *fromP, *toP;
+    Laik_Group *fromGroup, *toGroup; // groups of partitionings when cached
+    Laik_DataFlow flow;
+    Laik_ReductionOperation redOp;
+
+    Laik_Transition* t;
+    Laik_ActionSeq* as; // may be 0 if no prepared sequence is cached
+    Laik_MappingList *fromList, *toList; // mapping lists <as> is prepared for
+} Laik_SwitchCacheEntry;
+
+// maximal number of switch cache entries per container
+#define SWITCHCACHE_MAX 8
+
+// state of a transition in execution, used for split-phase switches
+struct _Laik_SwitchHandle {
+    Laik_Data* data;
+    Laik_Transition* t;
+    Laik_ActionSeq* as;
+    Laik_MappingList *fromList, *toList;
+    bool split;          // executed in two phases?
+    bool freeASeq;       // action sequence created just for this switch?
+    bool freeTransition; // transition not stored in switch cache?
+    bool done;           // switch finished?
+    unsigned int actionsDone; // actions executed by backend in begin phase
+};
+
 // a data container
 struct _Laik_Data {
     char* name;
@@ -124,6 +170,13 @@ struct _Laik_Data {
 
     // statistics
     Laik_SwitchStat* stat;
+
+    // split-phase switch in progress, 0 if none
+    Laik_SwitchHandle* activeSwitch;
+
+    // cache for repeated switches between same partitionings
+    int switchCacheCount, switchCacheNext;
+    Laik_SwitchCacheEntry switchCache[SWITCHCACHE_MAX];
 };
 
 
@@ -169,4 +222,13 @@ Laik_MappingList* laik_mappinglist_new(Laik_Data* d, int n, Laik_Layout* l);
 // ensure that the mapping is backed by memory (called by backends)
 void laik_allocateMap(Laik_Mapping* m, Laik_SwitchStat *ss);
 
+// drop cached transitions/action sequences referring to partitioning <p>
+// in all containers of the instance (all entries if <p> is 0)
+void laik_data_invalidate_switchcache(Laik_Instance* inst, Laik_Partitioning* p);
+
+// collective: element-wise reduction of <n> values of type <t> in <buf>
+// over all processes of group <g>, using a temporary container <name>
+void laik_allreduce(Laik_Group* g, Laik_Type* t, int n, void* buf,
+                    Laik_ReductionOperation op, const char* name);
+
 #endif // LAIK_DATA_INTERNAL_H
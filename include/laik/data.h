@@ -129,13 +129,32 @@ void laik_data_use_reservation(Laik_Data* d, Laik_Reservation* r);
 // execute a previously calculated transition on a data container
 void laik_exec_transition(Laik_Data* d, Laik_Transition* t);
 
+// calculate transitions for <n> containers <d[i]> from their active
+// partitionings to <toP[i]>, storing them in <t[i]>. Calculations are
+// done in parallel if worker threads are enabled (see LAIK_THREADS)
+void laik_calc_transitions(int n, Laik_Data** d, Laik_Partitioning** toP,
+                           Laik_DataFlow flow, Laik_ReductionOperation redOp,
+                           Laik_Transition** t);
+
 // record steps for a transition on a container into an action sequence,
 // optionally provide allocations from reservations which are known
 Laik_ActionSeq* laik_calc_actions(Laik_Data* d, Laik_Transition* t,
                                   Laik_Reservation* fromRes,
                                   Laik_Reservation* toRes);
 
-// execute a previously calculated transition on a data container
+// record steps for transitions <t[i]> on <n> containers <d[i]> into one
+// action sequence. Executing it does all transitions, with messages to the
+// same process combined across containers of same type (e.g. one message
+// per neighbor for a halo exchange of multiple fields). All transitions
+// must be in the same process group. Reservations are optional: <fromRes>
+// and <toRes> can be 0, as well as their entries
+Laik_ActionSeq* laik_calc_actions_multi(int n, Laik_Data** d,
+                                        Laik_Transition** t,
+                                        Laik_Reservation** fromRes,
+                                        Laik_Reservation** toRes);
+
+// execute a previously calculated action sequence, doing the transitions
+// of all containers recorded in it
 void laik_exec_actions(Laik_ActionSeq* as);
 
 // switch to new partitioning (new flow is derived from previous flow)
@@ -143,9 +162,35 @@ void laik_switchto_partitioning(Laik_Data* d,
                                 Laik_Partitioning* toP,
                                 Laik_DataFlow flow, Laik_ReductionOperation redOp);
 
+// switch <n> containers <d[i]> to new partitionings <toP[i]>, doing the
+// communication of all transitions in one exchange, with messages combined
+// as for laik_calc_actions_multi(). Containers whose switch is not within
+// the process group of the first one are switched separately
+void laik_switchto_partitionings(int n, Laik_Data** d,
+                                 Laik_Partitioning** toP, Laik_DataFlow flow,
+                                 Laik_ReductionOperation redOp);
+
+// split-phase switch to new partitioning: laik_switchto_begin() starts
+// the switch and returns a handle, laik_switchto_end() waits for completion.
+// In-between, own ranges of the new partitioning which are not received
+// from other processes already are valid and can be accessed, allowing to
+// overlap communication (e.g. halo exchange) with computation.
+// Only one split-phase switch can be active per container.
+typedef struct _Laik_SwitchHandle Laik_SwitchHandle;
+Laik_SwitchHandle* laik_switchto_begin(Laik_Data* d,
+                                       Laik_Partitioning* toP,
+                                       Laik_DataFlow flow,
+                                       Laik_ReductionOperation redOp);
+void laik_switchto_end(Laik_SwitchHandle* h);
+
 // switch to use another data flow, keep access phase/partitioning
 void laik_switchto_flow(Laik_Data* d, Laik_DataFlow flow, Laik_ReductionOperation redOp);
 
+// get bytes this process would send/receive when switching <d> to <toP>
+// while preserving data, e.g. to decide whether a repartitioning is worth it
+void laik_data_migration_bytes(Laik_Data* d, Laik_Partitioning* toP,
+                               uint64_t* sendBytes, uint64_t* recvBytes);
+
 // get range number <n> in own partition of data container <d>
 // returns 0 if partitioning is not set or range number <n> is invalid
 Laik_TaskRange* laik_data_range(Laik_Data* d, int n);
@@ -167,6 +212,12 @@ Laik_Partitioning* laik_switchto_new_partitioning(Laik_Data*, Laik_Group* g,
 
 void laik_fill_double(Laik_Data* data, double v);
 
+// collective: use index-wise weights stored in 1d container <d> of doubles
+// for BLOCK partitioner <p>, distributed via its active partitioning (ranges
+// must not overlap). Weights are not replicated: block borders are calculated
+// collectively here among the processes of the container's group
+void laik_set_index_weight_data(Laik_Partitioner* p, Laik_Data* d);
+
 
 
 //----------------------------------
@@ -359,6 +410,18 @@ void laik_init_layout(Laik_Layout* l, int dims, int map_count, uint64_t count,
 // (slow) generic copy just using offset function from layout interface
 void laik_layout_copy_gen(Laik_Range* range,
                           Laik_Mapping* from, Laik_Mapping* to);
+// (slow) generic pack/unpack just using offset function
+unsigned int laik_layout_pack_gen(Laik_Mapping* m, Laik_Range* range,
+                                  Laik_Index* idx, char* buf, unsigned int size);
+unsigned int laik_layout_unpack_gen(Laik_Mapping* m, Laik_Range* range,
+                                    Laik_Index* idx, char* buf, unsigned int size);
+
+// copy <count> blocks of <len> consecutive elements of size <elemsize>,
+// with strides between block starts given in elements.
+// To be used by layout implementations for pack/unpack/copy
+void laik_copy_blocks(char* to, uint64_t toStride,
+                      const char* from, uint64_t fromStride,
+                      uint64_t len, uint64_t count, unsigned int elemsize);
 
 
 // lexicographical layout covering one 1d, 2d, 3d range
@@ -371,6 +434,12 @@ Laik_Layout* laik_new_layout_lex(int n, Laik_Range* ranges);
 // return stride for dimension <d> in lex layout mapping <n>
 uint64_t laik_layout_lex_stride(Laik_Layout* l, int n, int d);
 
+// is <l> a lexicographical layout?
+bool laik_layout_is_lex(Laik_Layout* l);
+
+// is range <r> stored contiguously in lex layout mapping <n>?
+bool laik_layout_lex_isContiguous(Laik_Layout* l, int n, Laik_Range* r);
+
 
 //----------------------------------
 // Allocator interface
@@ -388,6 +457,9 @@ typedef enum _Laik_MemoryPolicy {
     LAIK_MP_UsePool,        // no allocate if possible via spare pool resource
 } Laik_MemoryPolicy;
 
+// pool of memory resources kept for reuse (for LAIK_MP_UsePool)
+typedef struct _Laik_MemPool Laik_MemPool;
+
 // allocator interface
 typedef void* (*Laik_malloc_t)(Laik_Data*, size_t);
 typedef void  (*Laik_free_t)(Laik_Data*, void*);
@@ -408,6 +480,9 @@ struct _Laik_Allocator {
     // transfered by the communication backend and should be made consistent
     // (used with LAIK_MP_NotifyOnChange)
     void (*unmap)(Laik_Data* d, void* ptr, size_t length);
+
+    // memory of freed mappings kept for reuse (used with LAIK_MP_UsePool)
+    Laik_MemPool* pool;
 };
 
 Laik_Allocator* laik_new_allocator(Laik_malloc_t, Laik_free_t, Laik_realloc_t);
@@ -415,6 +490,10 @@ void laik_set_allocator(Laik_Data* d, Laik_Allocator* alloc);
 Laik_Allocator* laik_get_allocator(Laik_Data* d);
 // returns an allocator with default policy LAIK_MP_NewAllocOnRepartition
 Laik_Allocator* laik_new_allocator_def();
+// returns an allocator with policy LAIK_MP_UsePool: memory of freed mappings
+// is kept for reuse by later mappings of all containers using the allocator.
+// With <hugepages>, large allocations are backed by huge pages if possible
+Laik_Allocator* laik_new_allocator_pool(bool hugepages);
 
 // predefined allocator
 extern Laik_Allocator *laik_allocator_def;
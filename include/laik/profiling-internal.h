@@ -36,4 +36,20 @@ struct _Laik_Profiling_Controller
     void* profile_file;
 };
 
+// load balancer, see laik_new_load_balancer()
+struct _Laik_LoadBalancer
+{
+    Laik_Partitioner* pr;
+    double threshold;
+    int interval;
+
+    int size;       // number of tasks the arrays below are for
+    double* weight; // task weights set in partitioner
+    double* time;   // compute times of all tasks (reduction buffer)
+
+    double start;   // start of running measurement, 0 if not running
+    double myTime;  // own compute time since last balancing check
+    int calls;      // balancing checks since last repartitioning
+};
+
 #endif // LAIK_PROFILING_INTERNAL
@@ -19,7 +19,8 @@
 #ifndef LAIK_PROFILING_H
 #define LAIK_PROFILING_H
 
-#include "core.h" // for Laik_Instance
+#include "core.h"  // for Laik_Instance
+#include "space.h" // for Laik_Partitioner, Laik_Partitioning
 
 //
 // application controlled profiling
@@ -57,5 +58,29 @@ void laik_close_profiling_file(Laik_Instance* i);
 // print arbitrary text to file in output-to-file mode
 void laik_profile_printf(const char* msg, ...);
 
+//
+// automatic load balancing using measured compute times
+//
+
+// opaque
+typedef struct _Laik_LoadBalancer Laik_LoadBalancer;
+
+// create load balancer setting task weights of block partitioner <pr>
+// (replacing weights set before). Repartitioning is done if the slowest
+// task needs more than (1 + <threshold>) times the average compute time,
+// at most every <interval> calls to laik_lb_balance()
+Laik_LoadBalancer* laik_new_load_balancer(Laik_Partitioner* pr,
+                                          double threshold, int interval);
+// free load balancer, resetting task weights of its partitioner
+void laik_free_load_balancer(Laik_LoadBalancer* lb);
+// start compute time measurement of this process
+void laik_lb_start(Laik_LoadBalancer* lb);
+// stop compute time measurement, adding to time since last balancing check
+void laik_lb_stop(Laik_LoadBalancer* lb);
+// collective over group of <p> (created with the partitioner of <lb>):
+// collect compute times measured since last call. Returns a new
+// partitioning if repartitioning is needed, 0 otherwise
+Laik_Partitioning* laik_lb_balance(Laik_LoadBalancer* lb, Laik_Partitioning* p);
+
 
 #endif // LAIK_PROFILING_H
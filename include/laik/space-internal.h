@@ -51,6 +51,10 @@ struct _Laik_Partitioner {
     laik_run_partitioner_t run;
     Laik_PartitionerFlag flags;
     void* data; // partitioner specific data
+
+    // partitionings which may need to run this partitioner again, as only
+    // own ranges are stored (owner-only mode, see laik_partitioner_changed)
+    Laik_Partitioning* firstRerun;
 };
 
 // context during a partitioner run, to filter and forward ranges
@@ -77,9 +81,11 @@ typedef struct _Laik_TaskRange_Gen {
     int mapNo;
 } Laik_TaskRange_Gen;
 
-// for single-index ranges in 1d
+// for single-index ranges in 1d: consecutive indexes appended for same
+// task are merged on the fly into a run of <len> indexes starting at <idx>
 typedef struct _Laik_TaskRange_Single1d {
     int task;
+    unsigned int len; // fits into padding, does not increase size
     int64_t idx;
 } Laik_TaskRange_Single1d;
 
@@ -90,11 +96,14 @@ struct _Laik_TaskRange {
 };
 
 
+// spatial index over ranges of a frozen range list (see rangelist.c)
+typedef struct _Laik_RangeIndex Laik_RangeIndex;
+
 // an ordered sequence of ranges assigned to task ids
 // ordered by task id, then mapping id, then index ordering
 struct _Laik_RangeList {
     Laik_Space* space;
-    unsigned int tid_count; // size of <off> array
+    unsigned int tid_count; // number of task ids
 
     unsigned int capacity;   // ranges allocated
     unsigned int count;      // ranges used
@@ -102,15 +111,28 @@ struct _Laik_RangeList {
     Laik_TaskRange_Gen* trange; // range array
     Laik_TaskRange_Single1d* tss1d; // specific array used during collection
 
-    // calculated on freezing
-    unsigned int* off;       // offsets into ranges, ordered by task id
+    // calculated on freezing: offsets into ranges, ordered by task id.
+    // Only stored for tasks [off_first; off_first + off_count[, ie. from
+    // first to last task with ranges. Use laik_rangelist_tidoff()
+    unsigned int* off;
+    unsigned int off_first, off_count;
 
     // for fast access to ranges within mappings from a task with given id
     int map_tid;  // typically used for "own" task id
     unsigned int map_count; // number of mappings needed for ranges of <maptask>
     unsigned int* map_off;  // offsets into own ranges for same mapping
+
+    // built on first intersection query, 0 before
+    Laik_RangeIndex* index;
 };
 
+// call <f> with the offset of each range in frozen <list> which may
+// intersect <range>, in no specific order. Uses a spatial index for
+// sub-linear lookup, ranges not reported definitely do not intersect
+typedef void (*laik_rangelist_hit_t)(void* ctx, unsigned int o);
+void laik_rangelist_query(Laik_RangeList* list, const Laik_Range* range,
+                          laik_rangelist_hit_t f, void* ctx);
+
 
 // if a range filter is installed for a new created partitioning, for
 // each range added by the partitioner, the filter is called to check
@@ -155,8 +177,10 @@ typedef struct _RangeList_Entry {
     RangeInfo info;
     int filter_tid; // for AI_SINGLETASK
     Laik_Partitioning* other; // for AI_INTERSECT
+    int otherId; // id of <other>, as its memory may be reused after free
 
     Laik_RangeList* ranges;
+    uint64_t bytes; // memory used for entry and range list
     struct _RangeList_Entry* next;
 } RangeList_Entry;
 
@@ -174,11 +198,26 @@ struct _Laik_Partitioning {
 
     // base partitioning, used with partitioner or chained partitionings
     Laik_Partitioning* other;
+
+    // for list of partitionings which may run <partitioner> again
+    Laik_Partitioning* nextRerun;
 };
 
 void laik_free_partitioning(Laik_Partitioning* p);
 void laik_updateMapOffsets(Laik_RangeList* list, int tid);
 
+// make sure ranges required for transition calculation are stored
+void laik_partitioning_prepare_transition(Laik_Partitioning* fromP,
+                                          Laik_Partitioning* toP,
+                                          Laik_ReductionOperation redOp);
+
+// migrate range lists to new group (see laik_partitioning_migrate)
+void laik_partitioning_migrate_ranges(Laik_Partitioning* p, Laik_Group* newg);
+
+// parameters of partitioner <pr> are about to change: store all ranges of
+// partitionings which otherwise would need to run <pr> again later
+void laik_partitioner_changed(Laik_Partitioner* pr);
+
 
 
 //
@@ -176,8 +176,14 @@ void laik_range_init_3d(Laik_Range* range, Laik_Space* space,
 bool laik_range_isEmpty(Laik_Range*);
 
 // get the intersection of two ranges; return 0 if intersection is empty
+// (the returned range is overwritten by the next call)
 Laik_Range* laik_range_intersect(const Laik_Range* r1, const Laik_Range* r2);
 
+// same as laik_range_intersect, but storing result into <res> (reentrant);
+// return false if intersection is empty
+bool laik_range_intersection(const Laik_Range* r1, const Laik_Range* r2,
+                             Laik_Range* res);
+
 // expand range <dst> such that it contains <src>
 void laik_range_expand(Laik_Range* dst, Laik_Range* src);
 
@@ -267,12 +273,16 @@ bool laik_rangelist_coversSpace(Laik_RangeList* list);
 // get number of ranges
 int laik_rangelist_rangecount(Laik_RangeList* list);
 int laik_rangelist_tidrangecount(Laik_RangeList* list, int tid);
+// get offset of first range of task <tid> (ranges are sorted by task)
+unsigned int laik_rangelist_tidoff(Laik_RangeList* list, int tid);
 int laik_rangelist_tidmapcount(Laik_RangeList* list, int tid);
 unsigned int laik_rangelist_tidmaprangecount(Laik_RangeList* list, int tid, int mapNo);
 // get a given task range from a range list
 Laik_TaskRange* laik_rangelist_taskrange(Laik_RangeList* list, int n);
 Laik_TaskRange* laik_rangelist_tidrange(Laik_RangeList* list, int tid, int n);
 Laik_TaskRange* laik_rangelist_tidmaprange(Laik_RangeList* list, int tid, int mapNo, int n);
+// bytes of memory used by a frozen range list
+uint64_t laik_rangelist_memory(Laik_RangeList* list);
 
 
 /**
@@ -316,7 +326,12 @@ typedef enum _Laik_PartitionerFlag {
 
     // use an internal data representation optimized for single index ranges.
     // this is useful for fine-grained partitioning, requiring indirections
-    LAIK_PF_SingleIndex = 16
+    LAIK_PF_SingleIndex = 16,
+
+    // the partitioner cannot be run again later with same result, e.g.
+    // when depending on weights changed afterwards. All ranges then are
+    // stored even if only own ranges should be stored (owner-only mode)
+    LAIK_PF_NoRerun = 32
 
 } Laik_PartitionerFlag;
 
@@ -403,6 +418,16 @@ Laik_Partitioning* laik_new_partitioning(Laik_Partitioner* pr,
                                          Laik_Group* g, Laik_Space* space,
                                          Laik_Partitioning* otherP);
 
+// only store own ranges in partitionings created afterwards. Ranges of
+// other processes needed for transitions are calculated on demand, keeping
+// only ranges intersecting own ones (default: env LAIK_OWNER_RANGES)
+void laik_set_owner_ranges(Laik_Instance* inst, bool enable);
+
+// bytes used for storing ranges of partitioning <p> in this process
+uint64_t laik_partitioning_memory(Laik_Partitioning* p);
+// bytes used for ranges of all partitionings in this process (current/peak)
+void laik_get_partitioning_memory(uint64_t* current, uint64_t* peak);
+
 // new partitioning taking ranges from another, migrating to new group
 Laik_Partitioning* laik_new_migrated_partitioning(Laik_Partitioning* other,
                                                   Laik_Group* newg);
@@ -520,16 +545,50 @@ Laik_Partitioner* laik_new_block_partitioner_tw1(Laik_GetTaskWeight_t f,
 void laik_set_index_weight(Laik_Partitioner* p, Laik_GetIdxWeight_t f,
                            const void* userData);
 
+// set index-wise weights as array <w> with <count> entries, replicated in
+// every task. Prefix sums over the weights are calculated once and kept
+// (the array must not change), so re-running the partitioner with new task
+// weights only needs binary searches for the block borders
+void laik_set_index_weight_array(Laik_Partitioner* p,
+                                 const double* w, int64_t count);
+
+// collective: recalculate block borders for weights given as container
+// (see laik_set_index_weight_data),
+// required after changing task weights or cycle count (no-op without)
+void laik_update_block_partitioner(Laik_Partitioner* p);
+
 // set task-wise weight getter, used when calculating BLOCK partitioning.
 // as getter is called in every LAIK task, weights have to be known globally
 // (useful if relative performance per task is known)
 void laik_set_task_weight(Laik_Partitioner* pr, Laik_GetTaskWeight_t f,
                           const void* userData);
 
+// set task-wise weights as array <w> with an entry for each task, replicated
+// in every task (alternative to a getter, keeping its user data for index
+// weights). The array is read on every run, it can change between runs
+void laik_set_task_weight_array(Laik_Partitioner* pr, const double* w,
+                                int count);
+
 // for block partitionings, we can specify how often we go around in cycles
 // to distribute chunks to tasks. Default is 1.
 void laik_set_cycle_count(Laik_Partitioner* p, int cycles);
 
+// space-filling curve partitioner for 1d/2d/3d spaces: the space is split
+// into cubic blocks of side <blocksize> (0: automatic, at least 64 blocks
+// per task) ordered along a Morton or Hilbert curve. Tasks get contiguous
+// curve segments, balanced according to index and task weights (optional).
+// Ranges of a task are merged into few rectangles, with rectangles close
+// to each other using the same tag (i.e. mapping)
+typedef enum _Laik_SFCType {
+    LAIK_SFC_Morton = 0, // Z-order curve
+    LAIK_SFC_Hilbert
+} Laik_SFCType;
+
+Laik_Partitioner* laik_new_sfc_partitioner(Laik_SFCType type, int64_t blocksize,
+                                           Laik_GetIdxWeight_t ifunc,
+                                           Laik_GetTaskWeight_t tfunc,
+                                           const void* userData);
+
 // Reassign: incremental partitioner
 // redistribute indexes from tasks to be removed
 // this partitioner can make use of application-specified index weights
@@ -538,6 +597,16 @@ laik_new_reassign_partitioner(Laik_Group* newg,
                               Laik_GetIdxWeight_t getIdxW,
                               const void* userData);
 
+// Rebalance: incremental partitioner for 1d spaces
+// move borders of base partitioning (one range per task) to get weight
+// sums of tasks within (1 + <tolerance>) times their share, with as few
+// indexes as possible changing owner. Without overloaded tasks, borders
+// are kept unchanged. Index/task weight functions may be null (all 1)
+Laik_Partitioner*
+laik_new_rebalance_partitioner(Laik_GetIdxWeight_t getIdxW,
+                               Laik_GetTaskWeight_t getTaskW,
+                               const void* userData, double tolerance);
+
 
 // get local index from global one. return false if not local
 bool laik_index_global2local(Laik_Partitioning*,
@@ -41,21 +41,23 @@ Laik_ActionSeq* laik_aseq_new(Laik_Instance *inst)
 
     as->inst = inst;
     as->backend = 0;
+    as->collective = false;
+    as->reused = false;
 
-    for(int i = 0; i < ASEQ_CONTEXTS_MAX; i++)
-        as->context[i] = 0;
+    as->context = 0;
     as->contextCount = 0;
+    as->contextAlloc = 0;
+    as->currentTID = 0;
 
-    for(int i = 0; i < ASEQ_BUFFER_MAX; i++) {
-        as->buf[i] = 0;
-        as->bufSize[i] = 0;
-    }
+    as->buf = 0;
+    as->bufSize = 0;
     as->bufferCount = 0;
+    as->bufferAlloc = 0;
     as->bufReserveCount = 0;
 
-    for(int i = 0; i < ASEQ_COPYENTRY_MAX; i++)
-        as->ce[i] = 0;
+    as->ce = 0;
     as->ceCount = 0;
+    as->ceAlloc = 0;
     as->ceRanges = 0;
 
     as->actionCount = 0;
@@ -91,23 +93,26 @@ void laik_aseq_free(Laik_ActionSeq* as)
         (as->backend->cleanup)(as);
     }
 
-    Laik_TransitionContext* tc = as->context[0];
-
     for(int i = 0; i < as->bufferCount; i++) {
-        if (as->bufSize[i] == 0) continue;
-
         laik_log(1, "    free buffer %d: %zu bytes\n", i, as->bufSize[i]);
-        free(as->buf[i]);
 
-        // update allocation statistics
+        // update allocation statistics (accounted to first container)
+        Laik_TransitionContext* tc = as->context[0];
         laik_switchstat_free(tc->data->stat, as->bufSize[i]);
     }
+    // all buffers are in one arena starting at buf[0]
+    if (as->bufferCount > 0)
+        free(as->buf[0]);
+    free(as->buf);
+    free(as->bufSize);
 
     for(int i = 0; i < as->contextCount; i++)
         free(as->context[i]);
+    free(as->context);
 
     for(int i = 0; i < as->ceCount; i++)
         free(as->ce[i]);
+    free(as->ce);
 
     free(as->action);
     free(as->newAction);
@@ -126,11 +131,27 @@ int laik_aseq_bufsize(Laik_ActionSeq* as)
     return total;
 }
 
+// make sure that <table> with <count> entries of size <esize>, allocated
+// for <*alloc> entries, has space for one more entry (returns new table)
+static
+void* growTable(void* table, int count, int* alloc, size_t esize)
+{
+    if (count < *alloc) return table;
+
+    *alloc = (*alloc == 0) ? 4 : 2 * *alloc;
+    table = realloc(table, (size_t) *alloc * esize);
+    if (!table) {
+        laik_panic("Out of memory allocating table for Laik_ActionSeq");
+        exit(1); // not actually needed, laik_panic never returns
+    }
+    return table;
+}
+
 // append an invalid action of given size
 Laik_Action* laik_aseq_addAction(Laik_ActionSeq* as, unsigned int size,
                                  Laik_ActionType type, int round, int tid)
 {
-    assert(round < 255);
+    assert((round >= 0) && (round < ASEQ_ROUNDS_MAX));
 
     if (as->newBytesUsed + size > as->newBytesAlloc) {
         // enlarge buffer by more than <size>
@@ -146,12 +167,11 @@ Laik_Action* laik_aseq_addAction(Laik_ActionSeq* as, unsigned int size,
     as->newActionCount++;
 
     assert(type < 256);
-    assert(size < 256);
-    assert(round < 256);
-    assert(tid < 128);
+    assert(size < 65536);
+    assert(tid < ASEQ_CONTEXTS_MAX);
     a->type  = (unsigned char) type;
-    a->len   = (unsigned char) size;
-    a->round = (unsigned char) round;
+    a->len   = (unsigned short) size;
+    a->round = (unsigned short) round;
     a->tid   = (unsigned char) tid;
     a->mark  = 0;
 
@@ -168,6 +188,7 @@ void laik_aseq_discardNewActions(Laik_ActionSeq* as)
     as->newBytesUsed = 0;
     as->newActionCount = 0;
     as->newRoundCount = 0;
+    as->currentTID = 0;
 }
 
 // finish building an action sequence, activate the new built sequence
@@ -203,7 +224,7 @@ Laik_BackendAction* laik_aseq_addBAction(Laik_ActionSeq* as, int round)
     Laik_BackendAction* ba;
     ba = (Laik_BackendAction*) laik_aseq_addAction(as,
                                                    sizeof(Laik_BackendAction),
-                                                   LAIK_AT_Invalid, round, 0);
+                                                   LAIK_AT_Invalid, round, as->currentTID);
     return ba;
 }
 
@@ -214,6 +235,11 @@ int laik_aseq_addTContext(Laik_ActionSeq* as,
 {
     // the transition must be valid
     assert(transition != 0);
+    // all transitions of a sequence must be in the same process group
+    if (as->contextCount > 0) {
+        Laik_TransitionContext* tc0 = as->context[0];
+        assert(tc0->transition->group == transition->group);
+    }
 
     Laik_TransitionContext* tc = malloc(sizeof(Laik_TransitionContext));
     tc->data = data;
@@ -224,10 +250,10 @@ int laik_aseq_addTContext(Laik_ActionSeq* as,
     tc->prepToList = 0;
 
     assert(as->contextCount < ASEQ_CONTEXTS_MAX);
+    as->context = growTable(as->context, as->contextCount,
+                            &(as->contextAlloc), sizeof(void*));
     int contextID = as->contextCount;
     as->contextCount++;
-
-    assert(as->context[contextID] == 0);
     as->context[contextID] = tc;
 
     laik_log(1, "action seq '%s': added context for trans '%s' on data '%s'",
@@ -253,28 +279,30 @@ void laik_aseq_addTExec(Laik_ActionSeq* as, int tid)
 
 
 // append action to reserve buffer space
-// if <bufID> is negative, a new ID is generated (always > 100)
+// if <bufID> is negative, a new ID is generated (always >= ASEQ_RESERVEID_BASE)
 // returns bufID.
 //
-// bufID < 100 are reserved for buffers already allocated (buf[bufID]).
-// in a final pass, all buffer reservations must be collected, the buffer
-// allocated (with ID 0), and the references to this buffer replaced
-// by references into buffer 0. These actions can be removed afterwards.
+// bufID < ASEQ_RESERVEID_BASE are reserved for buffers already allocated
+// (buf[bufID]). in a final pass, all buffer reservations must be collected,
+// the buffer allocated (with next free ID), and the references to this buffer
+// replaced by references into the new buffer. These actions can be removed
+// afterwards.
 int laik_aseq_addBufReserve(Laik_ActionSeq* as, unsigned int size, int bufID)
 {
     if (bufID < 0) {
         // generate new buf ID
-        // only return IDs > 100. ID <100 are reserved for actual buffers
-        bufID = (int)(as->bufReserveCount + 100);
+        // lower IDs are reserved for actual buffers
+        bufID = (int)(as->bufReserveCount + ASEQ_RESERVEID_BASE);
         as->bufReserveCount++;
     }
     else
-        assert(bufID <= (int)(as->bufReserveCount + 99));
+        assert(bufID < (int)(as->bufReserveCount + ASEQ_RESERVEID_BASE));
 
     // BufReserve in round 0: allocation is done before exec
     Laik_A_BufReserve* a;
     a = (Laik_A_BufReserve*) laik_aseq_addAction(as, sizeof(*a),
-                                                 LAIK_AT_BufReserve, 0, 0);
+                                                 LAIK_AT_BufReserve, 0,
+                                                 as->currentTID);
     a->size = size;
     a->bufID = bufID;
     a->offset = 0;
@@ -289,7 +317,7 @@ void laik_aseq_addRBufSend(Laik_ActionSeq* as, int round,
 {
     Laik_A_RBufSend* a;
     a = (Laik_A_RBufSend*) laik_aseq_addAction(as, sizeof(*a),
-                                               LAIK_AT_RBufSend, round, 0);
+                                               LAIK_AT_RBufSend, round, as->currentTID);
     a->bufID = bufID;
     a->offset = byteOffset;
     a->count = count;
@@ -303,7 +331,7 @@ void laik_aseq_addRBufRecv(Laik_ActionSeq* as, int round,
 {
     Laik_A_RBufRecv* a;
     a = (Laik_A_RBufRecv*) laik_aseq_addAction(as, sizeof(*a),
-                                               LAIK_AT_RBufRecv, round, 0);
+                                               LAIK_AT_RBufRecv, round, as->currentTID);
     a->bufID = bufID;
     a->offset = byteOffset;
     a->count = count;
@@ -394,7 +422,7 @@ void laik_aseq_addBufSend(Laik_ActionSeq* as, int round,
 {
     Laik_A_BufSend* a;
     a = (Laik_A_BufSend*) laik_aseq_addAction(as, sizeof(*a),
-                                              LAIK_AT_BufSend, round, 0);
+                                              LAIK_AT_BufSend, round, as->currentTID);
     a->buf = fromBuf;
     a->count = count;
     a->to_rank = to;
@@ -420,7 +448,7 @@ void laik_aseq_addBufRecv(Laik_ActionSeq* as, int round,
 {
     Laik_A_BufRecv* a;
     a = (Laik_A_BufRecv*) laik_aseq_addAction(as, sizeof(*a),
-                                              LAIK_AT_BufRecv, round, 0);
+                                              LAIK_AT_BufRecv, round, as->currentTID);
     a->buf = toBuf;
     a->count = count;
     a->from_rank = from;
@@ -479,7 +507,7 @@ void laik_aseq_addMapPackAndSend(Laik_ActionSeq* as, int round,
     Laik_A_MapPackAndSend* a;
     a = (Laik_A_MapPackAndSend*) laik_aseq_addAction(as, sizeof(*a),
                                                      LAIK_AT_MapPackAndSend,
-                                                     round, 0);
+                                                     round, as->currentTID);
     uint64_t count = laik_range_size(range);
     assert(count > 0);
 
@@ -575,7 +603,7 @@ void laik_aseq_addMapRecvAndUnpack(Laik_ActionSeq* as, int round,
     Laik_A_MapRecvAndUnpack* a;
     a = (Laik_A_MapRecvAndUnpack*) laik_aseq_addAction(as, sizeof(*a),
                                                        LAIK_AT_MapRecvAndUnpack,
-                                                       round, 0);
+                                                       round, as->currentTID);
     uint64_t count = laik_range_size(range);
     assert(count > 0);
 
@@ -791,7 +819,7 @@ bool laik_action_isRecv(Laik_Action* a)
 void laik_aseq_addReds(Laik_ActionSeq* as, int round,
                        Laik_Data* data, Laik_Transition* t)
 {
-    Laik_TransitionContext* tc = as->context[0];
+    Laik_TransitionContext* tc = as->context[as->currentTID];
     assert(tc->data == data);
     assert(tc->transition == t);
     assert(t->group->myid >= 0);
@@ -810,7 +838,7 @@ void laik_aseq_addReds(Laik_ActionSeq* as, int round,
 void laik_aseq_addRecvs(Laik_ActionSeq* as, int round,
                         Laik_Data* data, Laik_Transition* t)
 {
-    Laik_TransitionContext* tc = as->context[0];
+    Laik_TransitionContext* tc = as->context[as->currentTID];
     assert(tc->data == data);
     assert(tc->transition == t);
     assert(t->group->myid >= 0);
@@ -827,7 +855,7 @@ void laik_aseq_addRecvs(Laik_ActionSeq* as, int round,
 void laik_aseq_addSends(Laik_ActionSeq* as, int round,
                         Laik_Data* data, Laik_Transition* t)
 {
-    Laik_TransitionContext* tc = as->context[0];
+    Laik_TransitionContext* tc = as->context[as->currentTID];
     assert(tc->data == data);
     assert(tc->transition == t);
     assert(t->group->myid >= 0);
@@ -839,22 +867,90 @@ void laik_aseq_addSends(Laik_ActionSeq* as, int round,
     }
 }
 
+// buffers in the arena of an action sequence start at cache line boundaries
+#define ASEQ_BUFFER_ALIGN 64
+
+// move the arena with all buffers allocated for <as> to <arena> with
+// <oldSize> bytes used: update buffer start addresses and pointers
+// into the old arena used by actions. Only called before any backend
+// specific actions are added to a sequence
+static
+void relocateBuffers(Laik_ActionSeq* as, char* arena, size_t oldSize)
+{
+    char* old = as->buf[0];
+    for(int i = 0; i < as->bufferCount; i++)
+        as->buf[i] = arena + (as->buf[i] - old);
+
+    Laik_Action* a = as->action;
+    for(unsigned int i = 0; i < as->actionCount; i++, a = nextAction(a)) {
+        assert(a->type < LAIK_AT_Backend);
+
+        char** p[2] = { 0, 0 };
+        switch(a->type) {
+        case LAIK_AT_BufSend:
+            p[0] = &( ((Laik_A_BufSend*) a)->buf );
+            break;
+        case LAIK_AT_BufRecv:
+            p[0] = &( ((Laik_A_BufRecv*) a)->buf );
+            break;
+        case LAIK_AT_BufInit:
+        case LAIK_AT_BufCopy:
+        case LAIK_AT_RBufCopy:
+        case LAIK_AT_RBufLocalReduce:
+        case LAIK_AT_PackToBuf:
+        case LAIK_AT_MapPackToBuf:
+        case LAIK_AT_UnpackFromBuf:
+        case LAIK_AT_MapUnpackFromBuf:
+        case LAIK_AT_Reduce:
+        case LAIK_AT_GroupReduce:
+        case LAIK_AT_CopyFromBuf:
+        case LAIK_AT_CopyToBuf:
+            // actions using buffer pointers of Laik_BackendAction
+            p[0] = &( ((Laik_BackendAction*) a)->fromBuf );
+            p[1] = &( ((Laik_BackendAction*) a)->toBuf );
+            break;
+        default:
+            break;
+        }
+        for(int j = 0; j < 2; j++) {
+            if (!p[j] || (*p[j] < old) || (*p[j] >= old + oldSize)) continue;
+            *p[j] = arena + (*p[j] - old);
+        }
+
+        // copy entries of combined actions may point into buffers, too
+        switch(a->type) {
+        case LAIK_AT_CopyFromBuf:
+        case LAIK_AT_CopyToBuf:
+        case LAIK_AT_CopyFromRBuf:
+        case LAIK_AT_CopyToRBuf: {
+            Laik_BackendAction* ba = (Laik_BackendAction*) a;
+            for(unsigned int j = 0; j < ba->count; j++) {
+                char* ptr = ba->ce[j].ptr;
+                if ((ptr < old) || (ptr >= old + oldSize)) continue;
+                ba->ce[j].ptr = arena + (ptr - old);
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+}
+
 // collect buffer reservation actions and update actions referencing them
 // works in-place; BufReserve actions are marked as NOP but not removed
-// can be called ASEQ_BUFFER_MAX times, allocating a new buffer on each call
+// can be called multiple times, adding a new buffer on each call. All
+// buffers are kept in one arena, which gets reallocated when a buffer is
+// added. This must be done before buffers are used, ie. during preparation
 bool laik_aseq_allocBuffer(Laik_ActionSeq* as)
 {
     unsigned int rCount = 0, rActions = 0;
-    assert(as->bufferCount < ASEQ_BUFFER_MAX);
-    assert(as->buf[as->bufferCount] == 0); // nothing allocated yet
-
-    Laik_TransitionContext* tc = as->context[0];
-    unsigned int elemsize = tc->data->elemsize;
+    assert(as->bufferCount < ASEQ_RESERVEID_BASE);
 
     Laik_A_BufReserve** resAction;
     resAction = malloc(as->bufReserveCount * sizeof(Laik_A_BufReserve*));
     for(unsigned int i = 0; i < as->bufReserveCount; i++)
-        resAction[i] = 0; // reservation not seen yet for ID (i-100)
+        resAction[i] = 0; // reservation not seen yet for ID (i+base)
 
     unsigned int bufSize = 0;
     Laik_Action* a = as->action;
@@ -865,12 +961,11 @@ bool laik_aseq_allocBuffer(Laik_ActionSeq* as)
         case LAIK_AT_BufReserve: {
             Laik_A_BufReserve* aa = (Laik_A_BufReserve*) a;
             // reservation already processed and allocated
-            if (aa->bufID < ASEQ_BUFFER_MAX) break;
+            if (aa->bufID < ASEQ_RESERVEID_BASE) break;
 
             aa->offset = bufSize;
-            assert(aa->bufID >= 100);
-            assert(aa->bufID < (int)(100 + as->bufReserveCount));
-            resAction[aa->bufID - 100] = aa;
+            assert(aa->bufID < (int)(ASEQ_RESERVEID_BASE + as->bufReserveCount));
+            resAction[aa->bufID - ASEQ_RESERVEID_BASE] = aa;
             aa->bufID = as->bufferCount; // mark as processed
             bufSize += aa->size;
             rCount++;
@@ -922,13 +1017,14 @@ bool laik_aseq_allocBuffer(Laik_ActionSeq* as)
             }
 
             // action with allocated reservation
-            if (*pBufID < ASEQ_BUFFER_MAX) break;
+            if (*pBufID < ASEQ_RESERVEID_BASE) break;
 
-            assert(*pBufID >= 100);
-            assert(*pBufID < (int)(100 + as->bufReserveCount));
-            Laik_A_BufReserve* ra = resAction[*pBufID - 100];
+            assert(*pBufID < (int)(ASEQ_RESERVEID_BASE + as->bufReserveCount));
+            Laik_A_BufReserve* ra = resAction[*pBufID - ASEQ_RESERVEID_BASE];
             assert(ra != 0);
             assert(count > 0);
+            Laik_TransitionContext* tc = as->context[a->tid];
+            unsigned int elemsize = tc->data->elemsize;
             assert(*pOffset + (uint64_t)(count * elemsize) <= (uint64_t) ra->size);
 
             *pOffset += ra->offset;
@@ -948,16 +1044,35 @@ bool laik_aseq_allocBuffer(Laik_ActionSeq* as)
         return false;
     }
 
-    char* buf = malloc(bufSize);
-    assert(buf != 0);
+    // new buffer gets appended to the arena of all buffers of this sequence
+    size_t oldSize = 0, bufStart = 0;
+    if (as->bufferCount > 0) {
+        int last = as->bufferCount - 1;
+        oldSize = (size_t) (as->buf[last] - as->buf[0]) + as->bufSize[last];
+        bufStart = (oldSize + ASEQ_BUFFER_ALIGN - 1) & ~((size_t) ASEQ_BUFFER_ALIGN - 1);
+    }
+    char* arena = malloc(bufStart + bufSize);
+    if (!arena) {
+        laik_panic("Out of memory allocating buffers for Laik_ActionSeq");
+        exit(1); // not actually needed, laik_panic never returns
+    }
+    if (as->bufferCount > 0) {
+        // buffers are not in use yet, no need to copy contents
+        char* old = as->buf[0];
+        relocateBuffers(as, arena, oldSize);
+        free(old);
+    }
+    char* buf = arena + bufStart;
 
-    // update allocation statistics
+    // update allocation statistics (accounted to first container)
+    Laik_TransitionContext* tc = as->context[0];
     laik_switchstat_malloc(tc->data->stat, bufSize);
 
     // substitute RBuf actions, now that buffer allocation is known
     a = as->action;
     for(unsigned int i = 0; i < as->actionCount; i++, a = nextAction(a)) {
         Laik_BackendAction* ba = (Laik_BackendAction*) a;
+        as->currentTID = a->tid;
         switch(a->type) {
         case LAIK_AT_BufReserve:
             // BufReserve actions processed, can be removed
@@ -1027,6 +1142,13 @@ bool laik_aseq_allocBuffer(Laik_ActionSeq* as)
     }
     assert(as->bytesUsed == (size_t) (((char*)a) - ((char*)as->action)));
 
+    as->buf = growTable(as->buf, as->bufferCount, &(as->bufferAlloc), sizeof(char*));
+    // same number of entries for sizes
+    as->bufSize = realloc(as->bufSize, as->bufferAlloc * sizeof(size_t));
+    if (!as->bufSize) {
+        laik_panic("Out of memory allocating table for Laik_ActionSeq");
+        exit(1); // not actually needed, laik_panic never returns
+    }
     as->bufSize[as->bufferCount] = bufSize;
     as->buf[as->bufferCount] = buf;
 
@@ -1037,7 +1159,7 @@ bool laik_aseq_allocBuffer(Laik_ActionSeq* as)
         for(unsigned int i = 0; i < as->bufReserveCount; i++) {
             if (resAction[i] == 0) continue;
             laik_log_append("\n    RBuf %d (len %d) ==> off %d at %p",
-                            i + 100, resAction[i]->size,
+                            i + ASEQ_RESERVEID_BASE, resAction[i]->size,
                             resAction[i]->offset,
                             (void*) (buf + resAction[i]->offset));
         }
@@ -1048,7 +1170,7 @@ bool laik_aseq_allocBuffer(Laik_ActionSeq* as)
     free(resAction);
     laik_aseq_activateNewActions(as);
 
-    // start again with bufID 100 for next reservations
+    // start again with bufID ASEQ_RESERVEID_BASE for next reservations
     as->bufReserveCount = 0;
     as->bufferCount++;
 
@@ -1092,52 +1214,117 @@ void laik_aseq_copySeq(Laik_ActionSeq* as)
 
 // helpers for action combining
 
-// check that <a> is a BufSend action with same round and peer rank as <bsa>
-static bool isSameBufSend(Laik_A_BufSend* bsa, Laik_Action* a)
-{
-    assert(bsa->h.type == LAIK_AT_BufSend);
-    if (a->type != LAIK_AT_BufSend) return false;
-    if (a->round != bsa->h.round) return false;
-    if ( ((Laik_A_BufSend*)a)->to_rank != bsa->to_rank) return false;
-    return true;
+// for sorting actions to combine: entry with action index and
+// element type of the container the action belongs to
+typedef struct {
+    Laik_Action* a;
+    unsigned int idx;
+    int typeID;
+} CombineEntry;
+
+static bool isCombinable(Laik_Action* a)
+{
+    return (a->type == LAIK_AT_BufSend) || (a->type == LAIK_AT_BufRecv) ||
+           (a->type == LAIK_AT_GroupReduce) || (a->type == LAIK_AT_Reduce);
+}
+
+// order of actions to combine: actions can be combined if equal, ie.
+// - all: same round and element type (actions of different containers
+//   in a sequence recording multiple transitions can be combined)
+// - BufSend/BufRecv: same peer rank
+// - GroupReduce: same transition (group IDs are specific to a transition),
+//   input/output group and reduction
+// - Reduce: same root and reduction
+static int combineKeyCmp(const CombineEntry* e1, const CombineEntry* e2)
+{
+    Laik_Action* a1 = e1->a;
+    Laik_Action* a2 = e2->a;
+    if (a1->type != a2->type) return (a1->type < a2->type) ? -1 : 1;
+    if (a1->round != a2->round) return (a1->round < a2->round) ? -1 : 1;
+    if (e1->typeID != e2->typeID) return (e1->typeID < e2->typeID) ? -1 : 1;
+
+    int k1[4] = {0, 0, 0, 0}, k2[4] = {0, 0, 0, 0};
+    switch(a1->type) {
+    case LAIK_AT_BufSend:
+        k1[0] = ((Laik_A_BufSend*)a1)->to_rank;
+        k2[0] = ((Laik_A_BufSend*)a2)->to_rank;
+        break;
+    case LAIK_AT_BufRecv:
+        k1[0] = ((Laik_A_BufRecv*)a1)->from_rank;
+        k2[0] = ((Laik_A_BufRecv*)a2)->from_rank;
+        break;
+    case LAIK_AT_GroupReduce: {
+        Laik_BackendAction* ba1 = (Laik_BackendAction*) a1;
+        Laik_BackendAction* ba2 = (Laik_BackendAction*) a2;
+        k1[0] = a1->tid;          k2[0] = a2->tid;
+        k1[1] = ba1->inputGroup;  k2[1] = ba2->inputGroup;
+        k1[2] = ba1->outputGroup; k2[2] = ba2->outputGroup;
+        k1[3] = (int) ba1->redOp; k2[3] = (int) ba2->redOp;
+        break;
+    }
+    case LAIK_AT_Reduce: {
+        Laik_BackendAction* ba1 = (Laik_BackendAction*) a1;
+        Laik_BackendAction* ba2 = (Laik_BackendAction*) a2;
+        k1[0] = ba1->rank;        k2[0] = ba2->rank;
+        k1[1] = (int) ba1->redOp; k2[1] = (int) ba2->redOp;
+        break;
+    }
+    default: assert(0);
+    }
+    for(int i = 0; i < 4; i++)
+        if (k1[i] != k2[i]) return (k1[i] < k2[i]) ? -1 : 1;
+    return 0;
 }
 
-// check that <a> is a BufRecv action with same round and peer rank as <bra>
-static bool isSameBufRecv(Laik_A_BufRecv* bra, Laik_Action* a)
+// for qsort: keep original order of actions to combine
+static int combineEntryCmp(const void* p1, const void* p2)
 {
-    assert(bra->h.type == LAIK_AT_BufRecv);
-    if (a->type != LAIK_AT_BufRecv) return false;
-    if (a->round != bra->h.round) return false;
-    if ( ((Laik_A_BufRecv*)a)->from_rank != bra->from_rank) return false;
-    return true;
+    const CombineEntry* e1 = (const CombineEntry*) p1;
+    const CombineEntry* e2 = (const CombineEntry*) p2;
+    int res = combineKeyCmp(e1, e2);
+    if (res != 0) return res;
+    return (e1->idx < e2->idx) ? -1 : 1;
 }
 
-static bool isSameGroupReduce(Laik_BackendAction* ba, Laik_Action* a)
+// find groups of actions to combine by sorting, in O(n log n).
+// Returns array with actions of <as> by index. For each group, the first
+// action (in sequence order) is unmarked and chained with the other group
+// actions via <next> (index, <actionCount> at end), which are marked.
+// Single actions and ones not to combine are unmarked with no successor
+static Laik_Action** findCombineGroups(Laik_ActionSeq* as, unsigned int* next)
 {
-    assert(ba->h.type == LAIK_AT_GroupReduce);
-    if (a->type != LAIK_AT_GroupReduce) return false;
-    if (a->round != ba->h.round) return false;
-
-    Laik_BackendAction* ba2 = (Laik_BackendAction*) a;
-    if (ba2->inputGroup != ba->inputGroup) return false;
-    if (ba2->outputGroup != ba->outputGroup) return false;
-    if (ba2->redOp != ba->redOp) return false;
-    return true;
-}
+    unsigned int n = as->actionCount;
+    Laik_Action** act = malloc(n * sizeof(Laik_Action*));
+    CombineEntry* e = malloc(n * sizeof(CombineEntry));
+    if (!act || !e) {
+        laik_panic("Out of memory allocating memory for combining actions");
+        exit(1); // not actually needed, laik_panic never returns
+    }
 
-static bool isSameReduce(Laik_BackendAction* ba, Laik_Action* a)
-{
-    assert(ba->h.type == LAIK_AT_Reduce);
-    if (a->type != LAIK_AT_Reduce) return false;
-    if (a->round != ba->h.round) return false;
+    unsigned int m = 0;
+    Laik_Action* a = as->action;
+    for(unsigned int i = 0; i < n; i++, a = nextAction(a)) {
+        act[i] = a;
+        a->mark = 0;
+        next[i] = n;
+        if (!isCombinable(a)) continue;
+        Laik_TransitionContext* tc = as->context[a->tid];
+        e[m].a = a;
+        e[m].idx = i;
+        e[m].typeID = tc->data->type->id;
+        m++;
+    }
+    qsort(e, m, sizeof(CombineEntry), combineEntryCmp);
 
-    Laik_BackendAction* ba2 = (Laik_BackendAction*) a;
-    if (ba2->rank != ba->rank) return false;
-    if (ba2->redOp != ba->redOp) return false;
-    return true;
+    for(unsigned int k = 1; k < m; k++) {
+        if (combineKeyCmp(&(e[k-1]), &(e[k])) != 0) continue;
+        next[e[k-1].idx] = e[k].idx;
+        e[k].a->mark = 1;
+    }
+    free(e);
+    return act;
 }
 
-
 /* Merge send/recv/groupReduce/reduce actions from "oldAS" into "as".
  *
  * We merge actions with same communication partners, marking actions
@@ -1157,53 +1344,55 @@ static bool isSameReduce(Laik_BackendAction* ba, Laik_Action* a)
  * This merge transformation is easy to see in LAIK_LOG=1 output of the
  * "the markov2 -f ..." test.
  *
+ * Actions to combine are found by sorting (see findCombineGroups), to
+ * keep this fast for sequences with lots of actions.
+ *
  * TODO: Instead of doing merging in one big step for all action types,
  * we could do it for each seperately, and also generate individual buffer
  * reservation actions.
- *
- * TODO: Instead of nested loops to find actions to combine, do sorting
- * before: (1) by round, (2) by action type, ...
  */
 bool laik_aseq_combineActions(Laik_ActionSeq* as)
 {
     // must not have new actions, we want to start a new build
     assert(as->newActionCount == 0);
 
-    Laik_TransitionContext* tc = as->context[0];
-    Laik_Data* d = tc->data;
-    unsigned int elemsize = d->elemsize;
-    // used for combining GroupReduce actions
-    int myid = tc->transition->group->myid;
+    // used for combining GroupReduce actions (same group for all contexts)
+    Laik_TransitionContext* tc0 = as->context[0];
+    int myid = tc0->transition->group->myid;
 
-    // unmark all actions first
-    // all actions will be marked on combining, to not process them twice
-    Laik_Action* a = as->action;
-    for(unsigned int i = 0; i < as->actionCount; i++, a = nextAction(a))
-        a->mark = 0;
+    // group actions to combine: only first ones of groups are unmarked
+    unsigned int n = as->actionCount;
+    unsigned int* next = malloc(n * sizeof(unsigned int));
+    if (!next) {
+        laik_panic("Out of memory allocating memory for combining actions");
+        exit(1); // not actually needed, laik_panic never returns
+    }
+    Laik_Action** act = findCombineGroups(as, next);
 
-    // first pass: how much buffer space / copy range elements is needed?
+    // first pass: how much buffer space (bytes) / copy range elements is needed?
     unsigned int bufSize = 0, copyRanges = 0;
-    a = as->action;
-    for(unsigned int i = 0; i < as->actionCount; i++, a = nextAction(a)) {
-        // skip already combined actions
+    Laik_Action* a;
+    for(unsigned int i = 0; i < n; i++) {
+        a = act[i];
+        // skip actions combined into other ones
         if (a->mark == 1) continue;
 
+        // actions combined with <a> are for containers with same element type
+        Laik_TransitionContext* tc = as->context[a->tid];
+        unsigned int elemsize = tc->data->elemsize;
+
         switch(a->type) {
         case LAIK_AT_BufSend: {
             // combine all BufSend actions in same round with same target rank
-            Laik_A_BufSend* bsa = (Laik_A_BufSend*) a;
             unsigned int countSum = 0;
             unsigned int actionCount = 0;
-            Laik_Action* a2 = a;
-            for(unsigned int j = i; j < as->actionCount; j++, a2 = nextAction(a2)) {
-                if (!isSameBufSend(bsa, a2)) continue;
-
-                a2->mark = 1;
+            for(unsigned int j = i; j < n; j = next[j]) {
+                Laik_Action* a2 = act[j];
                 countSum += ((Laik_A_BufSend*)a2)->count;
                 actionCount++;
             }
             if (actionCount > 1) {
-                bufSize += countSum;
+                bufSize += countSum * elemsize;
                 copyRanges += actionCount;
             }
             break;
@@ -1211,19 +1400,15 @@ bool laik_aseq_combineActions(Laik_ActionSeq* as)
 
         case LAIK_AT_BufRecv: {
             // combine all BufRecv actions in same round with same source rank
-            Laik_A_BufRecv* bra = (Laik_A_BufRecv*) a;
             unsigned int countSum = 0;
             unsigned int actionCount = 0;
-            Laik_Action* a2 = a;
-            for(unsigned int j = i; j < as->actionCount; j++, a2 = nextAction(a2)) {
-                if (!isSameBufRecv(bra, a2)) continue;
-
-                a2->mark = 1;
+            for(unsigned int j = i; j < n; j = next[j]) {
+                Laik_Action* a2 = act[j];
                 countSum += ((Laik_A_BufRecv*)a2)->count;
                 actionCount++;
             }
             if (actionCount > 1) {
-                bufSize += countSum;
+                bufSize += countSum * elemsize;
                 copyRanges += actionCount;
             }
             break;
@@ -1235,16 +1420,13 @@ bool laik_aseq_combineActions(Laik_ActionSeq* as)
             Laik_BackendAction* ba = (Laik_BackendAction*) a;
             unsigned int countSum = 0;
             unsigned int actionCount = 0;
-            Laik_Action* a2 = a;
-            for(unsigned int j = i; j < as->actionCount; j++, a2 = nextAction(a2)) {
-                if (!isSameGroupReduce(ba, a2)) continue;
-
-                a2->mark = 1;
+            for(unsigned int j = i; j < n; j = next[j]) {
+                Laik_Action* a2 = act[j];
                 countSum += ((Laik_BackendAction*)a2)->count;
                 actionCount++;
             }
             if (actionCount > 1) {
-                bufSize += countSum;
+                bufSize += countSum * elemsize;
                 if (laik_trans_isInGroup(tc->transition, ba->inputGroup, myid))
                     copyRanges += actionCount;
                 if (laik_trans_isInGroup(tc->transition, ba->outputGroup, myid))
@@ -1258,16 +1440,13 @@ bool laik_aseq_combineActions(Laik_ActionSeq* as)
             Laik_BackendAction* ba = (Laik_BackendAction*) a;
             unsigned int countSum = 0;
             unsigned int actionCount = 0;
-            Laik_Action* a2 = a;
-            for(unsigned int j = i; j < as->actionCount; j++, a2 = nextAction(a2)) {
-                if (!isSameReduce(ba, a2)) continue;
-
-                a2->mark = 1;
+            for(unsigned int j = i; j < n; j = next[j]) {
+                Laik_Action* a2 = act[j];
                 countSum += ((Laik_BackendAction*)a2)->count;
                 actionCount++;
             }
             if (actionCount > 1) {
-                bufSize += countSum;
+                bufSize += countSum * elemsize;
                 // always providing input, copy input ranges
                 copyRanges += actionCount;
                 // if I want result, we can reuse the input ranges
@@ -1286,47 +1465,46 @@ bool laik_aseq_combineActions(Laik_ActionSeq* as)
     if (bufSize == 0) {
         assert(copyRanges == 0);
         assert(as->newActionCount == 0);
+        free(act);
+        free(next);
         return false;
     }
 
     assert(copyRanges > 0);
     Laik_CopyEntry* ce = malloc(copyRanges * sizeof(Laik_CopyEntry));
 
-    assert(as->ceCount < ASEQ_COPYENTRY_MAX);
-    assert(as->ce[as->ceCount] == 0);
+    as->ce = growTable(as->ce, as->ceCount, &(as->ceAlloc),
+                       sizeof(Laik_CopyEntry*));
     as->ce[as->ceCount] = ce;
     as->ceCount++;
     as->ceRanges += copyRanges;
 
-    int bufID = laik_aseq_addBufReserve(as, bufSize * elemsize, -1);
+    int bufID = laik_aseq_addBufReserve(as, bufSize, -1);
 
-    laik_log(1, "Reservation for combined actions: length %d x %d, ranges %d",
-             bufSize, elemsize, copyRanges);
-
-    // unmark all actions: restart for finding same type of actions
-    a = as->action;
-    for(unsigned int i = 0; i < as->actionCount; i++, a = nextAction(a))
-        a->mark = 0;
+    laik_log(1, "Reservation for combined actions: %d bytes, ranges %d",
+             bufSize, copyRanges);
 
     // second pass: add merged actions
     unsigned int bufOff = 0;
     unsigned int rangeOff = 0;
 
-    a = as->action;
-    for(unsigned int i = 0; i < as->actionCount; i++, a = nextAction(a)) {
-        // skip already processed actions
+    for(unsigned int i = 0; i < n; i++) {
+        a = act[i];
+        // skip actions combined into other ones
         if (a->mark == 1) continue;
 
+        // combined actions get the transition context of the first one
+        Laik_TransitionContext* tc = as->context[a->tid];
+        unsigned int elemsize = tc->data->elemsize;
+        as->currentTID = a->tid;
+
         switch(a->type) {
         case LAIK_AT_BufSend: {
             Laik_A_BufSend* bsa = (Laik_A_BufSend*) a;
             unsigned int countSum = 0;
             unsigned int actionCount = 0;
-            Laik_Action* a2 = a;
-            for(unsigned int j = i; j < as->actionCount; j++, a2 = nextAction(a2)) {
-                if (!isSameBufSend(bsa, a2)) continue;
-
-                a2->mark = 1;
+            for(unsigned int j = i; j < n; j = next[j]) {
+                Laik_Action* a2 = act[j];
                 countSum += ((Laik_A_BufSend*)a2)->count;
                 actionCount++;
             }
@@ -1338,19 +1516,17 @@ bool laik_aseq_combineActions(Laik_ActionSeq* as)
                                         bufID, 0,
                                         actionCount);
                 laik_aseq_addRBufSend(as, 3 * a->round + 1,
-                                      bufID, bufOff * elemsize,
+                                      bufID, bufOff,
                                       countSum, bsa->to_rank);
                 unsigned int oldRangeOff = rangeOff;
-                Laik_Action* a2 = a;
-                for(unsigned int k = i; k < as->actionCount; k++, a2 = nextAction(a2)) {
-                    if (!isSameBufSend(bsa, a2)) continue;
-
+                for(unsigned int k = i; k < n; k = next[k]) {
+                    Laik_Action* a2 = act[k];
                     Laik_A_BufSend* bsa2 = (Laik_A_BufSend*) a2;
                     assert(rangeOff < copyRanges);
                     ce[rangeOff].ptr = bsa2->buf;
                     ce[rangeOff].bytes = bsa2->count * elemsize;
-                    ce[rangeOff].offset = bufOff * elemsize;
-                    bufOff += bsa2->count;
+                    ce[rangeOff].offset = bufOff;
+                    bufOff += bsa2->count * elemsize;
                     rangeOff++;
                 }
                 assert(oldRangeOff + actionCount == rangeOff);
@@ -1365,33 +1541,28 @@ bool laik_aseq_combineActions(Laik_ActionSeq* as)
             Laik_A_BufRecv* bra = (Laik_A_BufRecv*) a;
             unsigned int countSum = 0;
             unsigned int actionCount = 0;
-            Laik_Action* a2 = a;
-            for(unsigned int j = i; j < as->actionCount; j++, a2 = nextAction(a2)) {
-                if (!isSameBufRecv(bra, a2)) continue;
-
-                a2->mark = 1;
+            for(unsigned int j = i; j < n; j = next[j]) {
+                Laik_Action* a2 = act[j];
                 countSum += ((Laik_A_BufRecv*)a2)->count;
                 actionCount++;
             }
             if (actionCount > 1) {
                 laik_aseq_addRBufRecv(as, 3 * a->round + 1,
-                                      bufID, bufOff * elemsize,
+                                      bufID, bufOff,
                                       countSum, bra->from_rank);
                 laik_aseq_addCopyFromRBuf(as, 3 * a->round + 2,
                                           ce + rangeOff,
                                           bufID, 0,
                                           actionCount);
                 unsigned int oldRangeOff = rangeOff;
-                Laik_Action* a2 = a;
-                for(unsigned int k = i; k < as->actionCount; k++, a2 = nextAction(a2)) {
-                    if (!isSameBufRecv(bra, a2)) continue;
-
+                for(unsigned int k = i; k < n; k = next[k]) {
+                    Laik_Action* a2 = act[k];
                     Laik_A_BufRecv* bra2 = (Laik_A_BufRecv*) a2;
                     assert(rangeOff < copyRanges);
                     ce[rangeOff].ptr = bra2->buf;
                     ce[rangeOff].bytes = bra2->count * elemsize;
-                    ce[rangeOff].offset = bufOff * elemsize;
-                    bufOff += bra2->count;
+                    ce[rangeOff].offset = bufOff;
+                    bufOff += bra2->count * elemsize;
                     rangeOff++;
                 }
                 assert(oldRangeOff + actionCount == rangeOff);
@@ -1406,11 +1577,8 @@ bool laik_aseq_combineActions(Laik_ActionSeq* as)
             Laik_BackendAction* ba = (Laik_BackendAction*) a;
             unsigned int countSum = 0;
             unsigned int actionCount = 0;
-            Laik_Action* a2 = a;
-            for(unsigned int j = i; j < as->actionCount; j++, a2 = nextAction(a2)) {
-                if (!isSameGroupReduce(ba, a2)) continue;
-
-                a2->mark = 1;
+            for(unsigned int j = i; j < n; j = next[j]) {
+                Laik_Action* a2 = act[j];
                 countSum += ((Laik_BackendAction*)a2)->count;
                 actionCount++;
             }
@@ -1426,26 +1594,24 @@ bool laik_aseq_combineActions(Laik_ActionSeq* as)
                                             actionCount);
                     // ranges for input pieces
                     unsigned int oldRangeOff = rangeOff;
-                    Laik_Action* a2 = a;
-                    for(unsigned int k = i; k < as->actionCount; k++, a2 = nextAction(a2)) {
-                        if (!isSameGroupReduce(ba, a2)) continue;
-
+                    for(unsigned int k = i; k < n; k = next[k]) {
+                        Laik_Action* a2 = act[k];
                         Laik_BackendAction* ba2 = (Laik_BackendAction*) a2;
                         assert(rangeOff < copyRanges);
                         ce[rangeOff].ptr = ba2->fromBuf;
                         ce[rangeOff].bytes = ba2->count * elemsize;
-                        ce[rangeOff].offset = bufOff * elemsize;
-                        bufOff += ba2->count;
+                        ce[rangeOff].offset = bufOff;
+                        bufOff += ba2->count * elemsize;
                         rangeOff++;
                     }
                     assert(oldRangeOff + actionCount == rangeOff);
-                    assert(startBufOff + countSum == bufOff);
+                    assert(startBufOff + countSum * elemsize == bufOff);
                 }
 
                 // use temporary buffer for both input and output
                 laik_aseq_addRBufGroupReduce(as, 3 * a->round + 1,
                                              ba->inputGroup, ba->outputGroup,
-                                             bufID, startBufOff * elemsize,
+                                             bufID, startBufOff,
                                              countSum, ba->redOp);
 
                 // if I want output: copy pieces from temporary buffer
@@ -1456,22 +1622,20 @@ bool laik_aseq_combineActions(Laik_ActionSeq* as)
                                               actionCount);
                     bufOff = startBufOff;
                     unsigned int oldRangeOff = rangeOff;
-                    Laik_Action* a2 = a;
-                    for(unsigned int k = i; k < as->actionCount; k++, a2 = nextAction(a2)) {
-                        if (!isSameGroupReduce(ba, a2)) continue;
-
+                    for(unsigned int k = i; k < n; k = next[k]) {
+                        Laik_Action* a2 = act[k];
                         Laik_BackendAction* ba2 = (Laik_BackendAction*) a2;
                         assert(rangeOff < copyRanges);
                         ce[rangeOff].ptr = ba2->toBuf;
                         ce[rangeOff].bytes = ba2->count * elemsize;
-                        ce[rangeOff].offset = bufOff * elemsize;
-                        bufOff += ba2->count;
+                        ce[rangeOff].offset = bufOff;
+                        bufOff += ba2->count * elemsize;
                         rangeOff++;
                     }
                     assert(oldRangeOff + actionCount == rangeOff);
-                    assert(startBufOff + countSum == bufOff);
+                    assert(startBufOff + countSum * elemsize == bufOff);
                 }
-                bufOff = startBufOff + countSum;
+                bufOff = startBufOff + countSum * elemsize;
             }
             else
                 laik_aseq_addGroupReduce(as, 3 * a->round + 1,
@@ -1485,11 +1649,8 @@ bool laik_aseq_combineActions(Laik_ActionSeq* as)
             Laik_BackendAction* ba = (Laik_BackendAction*) a;
             unsigned int countSum = 0;
             unsigned int actionCount = 0;
-            Laik_Action* a2 = a;
-            for(unsigned int j = i; j < as->actionCount; j++, a2 = nextAction(a2)) {
-                if (!isSameReduce(ba, a2)) continue;
-
-                a2->mark = 1;
+            for(unsigned int j = i; j < n; j = next[j]) {
+                Laik_Action* a2 = act[j];
                 countSum += ((Laik_BackendAction*)a2)->count;
                 actionCount++;
             }
@@ -1504,24 +1665,22 @@ bool laik_aseq_combineActions(Laik_ActionSeq* as)
                                         actionCount);
                 // ranges for input pieces
                 unsigned int oldRangeOff = rangeOff;
-                Laik_Action* a2 = a;
-                for(unsigned int k = i; k < as->actionCount; k++, a2 = nextAction(a2)) {
-                    if (!isSameReduce(ba, a2)) continue;
-
+                for(unsigned int k = i; k < n; k = next[k]) {
+                    Laik_Action* a2 = act[k];
                     Laik_BackendAction* ba2 = (Laik_BackendAction*) a2;
                     assert(rangeOff < copyRanges);
                     ce[rangeOff].ptr = ba2->fromBuf;
                     ce[rangeOff].bytes = ba2->count * elemsize;
-                    ce[rangeOff].offset = bufOff * elemsize;
-                    bufOff += ba2->count;
+                    ce[rangeOff].offset = bufOff;
+                    bufOff += ba2->count * elemsize;
                     rangeOff++;
                 }
                 assert(oldRangeOff + actionCount == rangeOff);
-                assert(startBufOff + countSum == bufOff);
+                assert(startBufOff + countSum * elemsize == bufOff);
 
                 // use temporary buffer for both input and output
                 laik_aseq_addRBufReduce(as, 3 * a->round + 1,
-                                           bufID, startBufOff * elemsize,
+                                           bufID, startBufOff,
                                            countSum, ba->rank, ba->redOp);
 
                 // if I want result, copy output ranges
@@ -1534,22 +1693,20 @@ bool laik_aseq_combineActions(Laik_ActionSeq* as)
                                               actionCount);
                     bufOff = startBufOff;
                     unsigned int oldRangeOff = rangeOff;
-                    Laik_Action* a2 = a;
-                    for(unsigned int k = i; k < as->actionCount; k++, a2 = nextAction(a2)) {
-                        if (!isSameReduce(ba, a2)) continue;
-
+                    for(unsigned int k = i; k < n; k = next[k]) {
+                        Laik_Action* a2 = act[k];
                         Laik_BackendAction* ba2 = (Laik_BackendAction*) a2;
                         assert(rangeOff < copyRanges);
                         ce[rangeOff].ptr = ba2->toBuf;
                         ce[rangeOff].bytes = ba2->count * elemsize;
-                        ce[rangeOff].offset = bufOff * elemsize;
-                        bufOff += ba2->count;
+                        ce[rangeOff].offset = bufOff;
+                        bufOff += ba2->count * elemsize;
                         rangeOff++;
                     }
                     assert(oldRangeOff + actionCount == rangeOff);
-                    assert(startBufOff + countSum == bufOff);
+                    assert(startBufOff + countSum * elemsize == bufOff);
                 }
-                bufOff = startBufOff + countSum;
+                bufOff = startBufOff + countSum * elemsize;
             }
             else
                 laik_aseq_addReduce(as, 3 * a->round + 1,
@@ -1566,6 +1723,8 @@ bool laik_aseq_combineActions(Laik_ActionSeq* as)
     }
     assert(rangeOff == copyRanges);
     assert(bufSize == bufOff);
+    free(act);
+    free(next);
 
     laik_aseq_activateNewActions(as);
 
@@ -1622,6 +1781,15 @@ int getActionPeer(Laik_Action* a)
 // used by compare functions, set directly before sort
 static int myid4cmp;
 
+// compare positions of actions in a sequence, to keep original order
+// (byte addresses: action sizes are no multiple of the header size)
+static
+int cmpActionPos(Laik_Action* a1, Laik_Action* a2)
+{
+    if (a1 == a2) return 0;
+    return ((char*) a1 < (char*) a2) ? -1 : 1;
+}
+
 static
 int cmp2phase(const void* aptr1, const void* aptr2)
 {
@@ -1658,12 +1826,12 @@ int cmp2phase(const void* aptr1, const void* aptr2)
 
         // with same peers, use original order
         // we can compare pointers to actions (as they are not sorted directly!)
-        return (int) (a1 - a2);
+        return cmpActionPos(a1, a2);
     }
 
     // both are neither send/recv actions: keep same order
     // we can compare pointers to actions (as they are not sorted directly!)
-    return (int) (a1 - a2);
+    return cmpActionPos(a1, a2);
 }
 
 /* sort actions into 2 phases to avoid deadlocks
@@ -1761,7 +1929,7 @@ int cmp_rankdigits(const void* aptr1, const void* aptr2)
     }
     // otherwise, keep original order
     // we can compare pointers to actions (as they are not sorted directly!)
-    return (int) (a1 - a2);
+    return cmpActionPos(a1, a2);
 }
 
 /* sort actions using binary digits of rank numbers, to avoid deadlocks
@@ -1822,7 +1990,7 @@ int cmp_rounds(const void* aptr1, const void* aptr2)
 
     // otherwise, keep original order
     // we can compare pointers to actions (as they are not sorted directly!)
-    return (int) (a1 - a2);
+    return cmpActionPos(a1, a2);
 }
 
 // sort actions according to their rounds, and compress rounds
@@ -1883,13 +2051,15 @@ bool laik_aseq_flattenPacking(Laik_ActionSeq* as)
     // must not have new actions, we want to start a new build
     assert(as->newActionCount == 0);
 
-    Laik_TransitionContext* tc = as->context[0];
-    unsigned int elemsize = tc->data->elemsize;
-    int myid = tc->transition->group->myid;
+    Laik_TransitionContext* tc0 = as->context[0];
+    int myid = tc0->transition->group->myid;
 
     Laik_Action* a = as->action;
     for(unsigned int i = 0; i < as->actionCount; i++, a = nextAction(a)) {
         Laik_BackendAction* ba = (Laik_BackendAction*) a;
+        Laik_TransitionContext* tc = as->context[a->tid];
+        unsigned int elemsize = tc->data->elemsize;
+        as->currentTID = a->tid;
         bool handled = false;
 
         switch(a->type) {
@@ -2058,136 +2228,271 @@ bool laik_aseq_flattenPacking(Laik_ActionSeq* as)
     return changed;
 }
 
+/* Avoid packing/unpacking for ranges stored contiguously in mappings:
+ * a PackToBuf action into a buffer only used for a BufSend of the same
+ * size is removed, with the send done directly from the mapping.
+ * Similar for BufRecv followed by UnpackFromBuf.
+ *
+ * This is done on buffer-allocated sequences, after combining actions,
+ * as then the number and order of messages are fixed. Whether a range is
+ * contiguous depends on the local layout, which may be different for
+ * sender and receiver.
+ *
+ * return true if action sequence changed
+ */
+bool laik_aseq_avoidPacking(Laik_ActionSeq* as)
+{
+    // must not have new actions, we want to start a new build
+    assert(as->newActionCount == 0);
+
+    // removed pack/unpack actions get marked
+    Laik_Action* a = as->action;
+    for(unsigned int i = 0; i < as->actionCount; i++, a = nextAction(a))
+        a->mark = 0;
+
+    bool changed = false;
+    a = as->action;
+    for(unsigned int i = 0; i < as->actionCount; i++, a = nextAction(a)) {
+        if ((a->type != LAIK_AT_PackToBuf) && (a->type != LAIK_AT_UnpackFromBuf))
+            continue;
+
+        Laik_BackendAction* ba = (Laik_BackendAction*) a;
+        Laik_Mapping* m = ba->map;
+        if ((m == 0) || (m->base == 0)) continue;
+        if (!laik_layout_lex_isContiguous(m->layout, m->layoutSection, ba->range))
+            continue;
+
+        bool isPack = (a->type == LAIK_AT_PackToBuf);
+        char* buf = isPack ? ba->toBuf : ba->fromBuf;
+
+        // find the send/recv action using the buffer
+        Laik_Action* a2 = as->action;
+        for(unsigned int i2 = 0; i2 < as->actionCount; i2++, a2 = nextAction(a2)) {
+            char** pBuf;
+            if (isPack && (a2->type == LAIK_AT_BufSend) &&
+                (((Laik_A_BufSend*) a2)->count == ba->count))
+                pBuf = &(((Laik_A_BufSend*) a2)->buf);
+            else if (!isPack && (a2->type == LAIK_AT_BufRecv) &&
+                     (((Laik_A_BufRecv*) a2)->count == ba->count))
+                pBuf = &(((Laik_A_BufRecv*) a2)->buf);
+            else
+                continue;
+            if (*pBuf != buf) continue;
+
+            int64_t off = laik_offset(m->layout, m->layoutSection, &(ba->range->from));
+            *pBuf = m->start + off * m->data->elemsize;
+            a->mark = 1;
+            changed = true;
+            break;
+        }
+    }
+    if (!changed) return false;
+
+    a = as->action;
+    for(unsigned int i = 0; i < as->actionCount; i++, a = nextAction(a))
+        if (a->mark == 0)
+            laik_aseq_add(a, as, -1);
+
+    laik_aseq_activateNewActions(as);
+    return true;
+}
+
 // helpers for splitReduce transformation
 
-// add actions for 3-step manual reduction for a group-reduce action
-// spread rounds by 3
-// round 0: send to reduce task, round 1: reduction, round 2: send back
+// maximal number of inputs reduced by one task in a manual reduction,
+// with more inputs, reduction is done hierarchically
+#define REDUCE_FANIN 32
+
+// add actions for receiving inputs from the <count> tasks <from> and reducing
+// them into toBuf of group-reduce action <ba>: receive in round <round>,
+// reduce in round <round>+1. If <own> is not 0, it is used as first input
 static
-void laik_aseq_addReduce3Rounds(Laik_ActionSeq* as,
-                                Laik_TransitionContext* tc, Laik_BackendAction* ba)
+void addCollectAndReduce(Laik_ActionSeq* as, Laik_TransitionContext* tc,
+                         Laik_BackendAction* ba, int round,
+                         int count, int* from, char* own)
 {
-    assert(ba->h.type == LAIK_AT_GroupReduce);
-    Laik_Transition* t = tc->transition;
     Laik_Data* data = tc->data;
+    unsigned int byteCount = ba->count * data->elemsize;
 
-    // do the manual reduction on smallest rank of output group
-    int reduceTask = laik_trans_taskInGroup(t, ba->outputGroup, 0);
-    int myid = t->group->myid;
+    // buffer for all partial input values
+    int bufID = -1;
+    if (count > 0)
+        bufID = laik_aseq_addBufReserve(as, count * byteCount, -1);
 
-    if (myid != reduceTask) {
-        // not the reduce task: eventually send input and recv result
+    for(int i = 0; i < count; i++)
+        laik_aseq_addRBufRecv(as, round,
+                              bufID, i * byteCount, ba->count, from[i]);
 
-        if (laik_trans_isInGroup(t, ba->inputGroup, myid)) {
-            // send action in round 0
-            laik_aseq_addBufSend(as, 3 * ba->h.round,
-                                 ba->fromBuf, ba->count, reduceTask);
-        }
+    if ((count == 0) && (own == 0)) {
+        // no input: add init action for neutral element of reduction
+        laik_aseq_addBufInit(as, round + 1,
+                             data->type, ba->redOp, ba->toBuf, ba->count);
+        return;
+    }
 
-        if (laik_trans_isInGroup(t, ba->outputGroup, myid)) {
-            // recv action only in round 2
-            laik_aseq_addBufRecv(as, 3 * ba->h.round + 2,
-                                 ba->toBuf, ba->count, reduceTask);
+    // move first input to a->toBuf, and then reduce on that.
+    // we use toBuf to calculate our results, but there may be own input,
+    // which would be overwritten if not starting with it
+    int first = 0;
+    if (own) {
+        if (own != ba->toBuf) {
+            // if my input is not already at a->toBuf, copy it
+            laik_aseq_addBufCopy(as, round + 1, own, ba->toBuf, ba->count);
         }
-
-        return;
+    }
+    else {
+        // copy first input to a->toBuf
+        laik_aseq_addRBufCopy(as, round + 1, bufID, 0, ba->toBuf, ba->count);
+        first = 1;
     }
 
-    // we are the reduce task
+    // do reduction with other inputs
+    for(int i = first; i < count; i++)
+        laik_aseq_addRBufLocalReduce(as, round + 1,
+                                     data->type, ba->redOp,
+                                     bufID, i * byteCount,
+                                     ba->toBuf, ba->count);
+}
+
+// add actions for manual reduction of a group-reduce action on a reduce
+// task (smallest rank of output group), using rounds <round> + 0 .. 2L:
+// - round 2k: send partial results on level k (k = 0 .. L-1)
+// - round 2k+1: reduction on level k
+// - round 2L: send result from reduce task to all tasks in output group
+// The reduce task collects up to REDUCE_FANIN inputs on the last level.
+// With more inputs, reduction is done hierarchically: on each level before,
+// the inputs of up to REDUCE_FANIN tasks are reduced by one of them, using
+// the output buffer for its partial result. For that, this task must be
+// in the output group; if there is none, inputs are just passed on.
+// Returns number of levels L. If <as> is 0, no actions are added
+static
+int laik_aseq_addReduceTree(Laik_ActionSeq* as, Laik_TransitionContext* tc,
+                            Laik_BackendAction* ba, int round)
+{
+    assert(ba->h.type == LAIK_AT_GroupReduce);
+    Laik_Transition* t = tc->transition;
+    int myid = t->group->myid;
 
+    int reduceTask = laik_trans_taskInGroup(t, ba->outputGroup, 0);
     int inCount = laik_trans_groupCount(t, ba->inputGroup);
-    unsigned int byteCount = ba->count * data->elemsize;
-
-    bool inputFromMe = laik_trans_isInGroup(t, ba->inputGroup, myid);
+    bool reduceTaskInput = laik_trans_isInGroup(t, ba->inputGroup, reduceTask);
     assert(inCount >= 0);
-    unsigned int inCountWithoutMe = (unsigned int) inCount;
-    if (inputFromMe) {
-        assert(inCountWithoutMe > 0);
-        inCountWithoutMe--;
-    }
 
-    // buffer for all partial input values
-    unsigned int bufSize = inCountWithoutMe * byteCount;
-    int bufID = -1;
-    if (bufSize > 0)
-        bufID = laik_aseq_addBufReserve(as, bufSize, -1);
-
-    // collect values from tasks in input group
-    unsigned int bufOff[32], off = 0;
-    assert(inCount <= 32); // TODO: support more than 32 partitial inputs
-
-    // always put this task in front: we use toBuf to calculate
-    // our results, but there may be input from us, which would
-    // be overwritten if not starting with our input
-    int ii = 0;
-    if (inputFromMe) {
-        ii++; // slot 0 reserved for this task (use a->fromBuf)
-        bufOff[0] = 0;
+    // tasks with partial results still to reduce (without reduce task),
+    // and whether the partial result already is in their output buffer
+    int* task = malloc((inCount + 1) * sizeof(int));
+    bool* inToBuf = malloc((inCount + 1) * sizeof(bool));
+    if (!task || !inToBuf) {
+        laik_panic("Out of memory in laik_aseq_addReduceTree");
+        exit(1); // not actually needed, laik_panic never returns
     }
+    int count = 0;
     for(int i = 0; i < inCount; i++) {
         int inTask = laik_trans_taskInGroup(t, ba->inputGroup, i);
-        if (inTask == myid) continue;
-
-        laik_aseq_addRBufRecv(as, 3 * ba->h.round,
-                              bufID, off, ba->count, inTask);
-        bufOff[ii++] = off;
-        off += byteCount;
+        if (inTask == reduceTask) continue;
+        task[count] = inTask;
+        inToBuf[count] = false;
+        count++;
     }
-    assert(ii == inCount);
-    assert(off == bufSize);
 
-    if (inCount == 0) {
-        // no input: add init action for neutral element of reduction
-        laik_aseq_addBufInit(as, 3 * ba->h.round + 1,
-                             data->type, ba->redOp, ba->toBuf, ba->count);
-    }
-    else {
-        // move first input to a->toBuf, and then reduce on that
-        if (inputFromMe) {
-            if (ba->fromBuf != ba->toBuf) {
-                // if my input is not already at a->toBuf, copy it
-                laik_aseq_addBufCopy(as, 3 * ba->h.round + 1,
-                                     ba->fromBuf, ba ->toBuf, ba->count);
+    int level = 0;
+    while(count + (reduceTaskInput ? 1 : 0) > REDUCE_FANIN) {
+        int newCount = 0;
+        for(int start = 0; start < count; start += REDUCE_FANIN) {
+            int end = start + REDUCE_FANIN;
+            if (end > count) end = count;
+
+            int leader = -1;
+            for(int i = start; i < end; i++) {
+                if (laik_trans_isInGroup(t, ba->outputGroup, task[i])) {
+                    leader = i;
+                    break;
+                }
+            }
+            if ((leader < 0) || (end - start == 1)) {
+                // no reduction on this level: pass on partial results
+                for(int i = start; i < end; i++) {
+                    task[newCount] = task[i];
+                    inToBuf[newCount] = inToBuf[i];
+                    newCount++;
+                }
+                continue;
             }
-        }
-        else {
-            // copy first input to a->toBuf
-            laik_aseq_addRBufCopy(as,  3 * ba->h.round + 1,
-                                  bufID, bufOff[0], ba->toBuf, ba->count);
-        }
 
-        // do reduction with other inputs
-        for(int t = 1; t < inCount; t++)
-            laik_aseq_addRBufLocalReduce(as, 3 * ba->h.round + 1,
-                                         data->type, ba->redOp,
-                                         bufID, bufOff[t],
-                                         ba->toBuf, ba->count);
+            if (as && (task[leader] == myid)) {
+                int from[REDUCE_FANIN], fromCount = 0;
+                for(int i = start; i < end; i++)
+                    if (i != leader) from[fromCount++] = task[i];
+                addCollectAndReduce(as, tc, ba, round + 2 * level,
+                                    fromCount, from,
+                                    inToBuf[leader] ? ba->toBuf : ba->fromBuf);
+            }
+            else if (as) {
+                for(int i = start; i < end; i++) {
+                    if (task[i] != myid) continue;
+                    laik_aseq_addBufSend(as, round + 2 * level,
+                                         inToBuf[i] ? ba->toBuf : ba->fromBuf,
+                                         ba->count, task[leader]);
+                }
+            }
+            task[newCount] = task[leader];
+            inToBuf[newCount] = true;
+            newCount++;
+        }
+        bool reduced = (newCount < count);
+        count = newCount;
+        if (!reduced) break;
+        level++;
     }
 
-    // send result to tasks in output group
-    int outCount = laik_trans_groupCount(t, ba->outputGroup);
-    for(int i = 0; i< outCount; i++) {
-        int outTask = laik_trans_taskInGroup(t, ba->outputGroup, i);
-        if (outTask == myid) {
-            // that's myself: nothing to do
-            continue;
+    if (as && (myid == reduceTask)) {
+        addCollectAndReduce(as, tc, ba, round + 2 * level, count, task,
+                            reduceTaskInput ? ba->fromBuf : 0);
+
+        // send result to tasks in output group
+        int outCount = laik_trans_groupCount(t, ba->outputGroup);
+        for(int i = 0; i< outCount; i++) {
+            int outTask = laik_trans_taskInGroup(t, ba->outputGroup, i);
+            if (outTask == myid) {
+                // that's myself: nothing to do
+                continue;
+            }
+
+            laik_aseq_addBufSend(as, round + 2 * level + 2,
+                                 ba->toBuf, ba->count, outTask);
+        }
+    }
+    else if (as) {
+        // not the reduce task: eventually send input and recv result
+        for(int i = 0; i < count; i++) {
+            if (task[i] != myid) continue;
+            laik_aseq_addBufSend(as, round + 2 * level,
+                                 inToBuf[i] ? ba->toBuf : ba->fromBuf,
+                                 ba->count, reduceTask);
         }
 
-        laik_aseq_addBufSend(as,  3 * ba->h.round + 2,
-                             ba->toBuf, ba->count, outTask);
+        if (laik_trans_isInGroup(t, ba->outputGroup, myid)) {
+            // recv action only in last round
+            laik_aseq_addBufRecv(as, round + 2 * level + 2,
+                                 ba->toBuf, ba->count, reduceTask);
+        }
     }
+
+    free(task);
+    free(inToBuf);
+    return level + 1;
 }
 
 // add actions for 2-step manual reduction for a group-reduce action
-// intermixed with 3-step reduction, thus need to spread rounds by 3
+// intermixed with reduction via laik_aseq_addReduceTree(), starting
+// at round <round>
 // round 0: send/recv, round 1: reduction
 static
-void laik_aseq_addReduce2Rounds(Laik_ActionSeq* as,
-                                Laik_TransitionContext* tc, Laik_BackendAction* ba)
+void laik_aseq_addReduce2Rounds(Laik_ActionSeq* as, Laik_TransitionContext* tc,
+                                Laik_BackendAction* ba, int round)
 {
     assert(ba->h.type == LAIK_AT_GroupReduce);
     Laik_Transition* t = tc->transition;
-    Laik_Data* data = tc->data;
 
     // everybody sends his input to all others, everybody does reduction
     int myid = t->group->myid;
@@ -2203,125 +2508,86 @@ void laik_aseq_addReduce2Rounds(Laik_ActionSeq* as,
                 continue;
             }
 
-            laik_aseq_addBufSend(as,  3 * ba->h.round,
-                                 ba->fromBuf, ba->count, outTask);
+            laik_aseq_addBufSend(as, round, ba->fromBuf, ba->count, outTask);
         }
     }
 
     if (!laik_trans_isInGroup(t, ba->outputGroup, myid)) return;
 
     // I am interested in result, process inputs from others
-
     int inCount = laik_trans_groupCount(t, ba->inputGroup);
-    unsigned int byteCount = ba->count * data->elemsize;
-
-    // buffer for all partial input values
     assert(inCount >= 0);
-    unsigned int inCountWithoutMe = (unsigned int) inCount;
-    if (inputFromMe) {
-        assert(inCountWithoutMe > 0);
-        inCountWithoutMe--;
-    }
-    unsigned int bufSize = inCountWithoutMe * byteCount;
-
-    int bufID = -1;
-    if (bufSize > 0)
-        bufID = laik_aseq_addBufReserve(as, bufSize, -1);
-
-    // collect values from tasks in input group
-    unsigned int bufOff[32], off = 0;
-    assert(inCount <= 32); // TODO: support more than 32 partitial inputs
-
-    // always put this task in front: we use toBuf to calculate
-    // our results, but there may be input from us, which would
-    // be overwritten if not starting with our input
-    int ii = 0;
-    if (inputFromMe) {
-        ii++; // slot 0 reserved for this task (use a->fromBuf)
-        bufOff[0] = 0;
+    int* from = malloc((inCount + 1) * sizeof(int));
+    if (!from) {
+        laik_panic("Out of memory in laik_aseq_addReduce2Rounds");
+        exit(1); // not actually needed, laik_panic never returns
     }
+    int fromCount = 0;
     for(int i = 0; i < inCount; i++) {
         int inTask = laik_trans_taskInGroup(t, ba->inputGroup, i);
         if (inTask == myid) continue;
-
-        laik_aseq_addRBufRecv(as, 3 * ba->h.round,
-                              bufID, off, ba->count, inTask);
-        bufOff[ii++] = off;
-        off += byteCount;
+        from[fromCount++] = inTask;
     }
-    assert(ii == inCount);
-    assert(off == bufSize);
 
-    if (inCount == 0) {
-        // no input: add init action for neutral element of reduction
-        laik_aseq_addBufInit(as, 3 * ba->h.round + 1,
-                             data->type, ba->redOp, ba->toBuf, ba->count);
-    }
-    else {
-        // move first input to a->toBuf, and then reduce on that
-        if (inputFromMe) {
-            if (ba->fromBuf != ba->toBuf) {
-                // if my input is not already at a->toBuf, copy it
-                laik_aseq_addBufCopy(as, 3 * ba->h.round +1,
-                                     ba->fromBuf, ba ->toBuf, ba->count);
-            }
-        }
-        else {
-            // copy first input to a->toBuf
-            laik_aseq_addRBufCopy(as, 3 * ba->h.round + 1,
-                                  bufID, bufOff[0], ba->toBuf, ba->count);
-        }
+    addCollectAndReduce(as, tc, ba, round, fromCount, from,
+                        inputFromMe ? ba->fromBuf : 0);
+    free(from);
+}
 
-        // do reduction with other inputs
-        for(int t = 1; t < inCount; t++)
-            laik_aseq_addRBufLocalReduce(as, 3 * ba->h.round +1,
-                                         data->type, ba->redOp,
-                                         bufID, bufOff[t],
-                                         ba->toBuf, ba->count);
-    }
+// use reduction via reduce task if too many messages for 2-step reduction
+static
+bool useReduceTree(Laik_Transition* t, Laik_BackendAction* ba)
+{
+    int inCount, outCount;
+    inCount = laik_trans_groupCount(t, ba->inputGroup);
+    outCount = laik_trans_groupCount(t, ba->inputGroup);
+    return (inCount * outCount > 4 * (inCount + outCount));
 }
 
 // transformation for split reduce actions into basic multiple actions.
-// action round numbers are spreaded by *3+1, allowing space for 3-step
+// action round numbers are spreaded by *(2L+1)+1, allowing space for
+// reductions with L levels (L = 1 without hierarchical reduction)
 // return true if sequence changed
 bool laik_aseq_splitReduce(Laik_ActionSeq* as)
 {
     bool reduceFound = false;
+    int levels = 1;
 
     // must not have new actions, we want to start a new build
     assert(as->newActionCount == 0);
 
-    Laik_TransitionContext* tc = as->context[0];
-
     Laik_Action* a = as->action;
     for(unsigned int i = 0; i < as->actionCount; i++, a = nextAction(a)) {
-        if (a->type == LAIK_AT_GroupReduce) {
-            reduceFound = true;
-            break;
+        if (a->type != LAIK_AT_GroupReduce) continue;
+
+        reduceFound = true;
+        Laik_TransitionContext* tc = as->context[a->tid];
+        Laik_BackendAction* ba = (Laik_BackendAction*) a;
+        if (useReduceTree(tc->transition, ba)) {
+            int l = laik_aseq_addReduceTree(0, tc, ba, 0);
+            if (l > levels) levels = l;
         }
     }
     if (!reduceFound)
         return false;
 
+    int spread = 2 * levels + 1;
     a = as->action;
     for(unsigned int i = 0; i < as->actionCount; i++, a = nextAction(a)) {
+        Laik_TransitionContext* tc = as->context[a->tid];
         Laik_BackendAction* ba = (Laik_BackendAction*) a;
+        as->currentTID = a->tid;
 
         switch(a->type) {
-        case LAIK_AT_GroupReduce: {
-            int inCount, outCount;
-            inCount = laik_trans_groupCount(tc->transition, ba->inputGroup);
-            outCount = laik_trans_groupCount(tc->transition, ba->inputGroup);
-            // use simple 3-step reduction if too many messages for 2-step
-            if (inCount * outCount > 4 * (inCount + outCount))
-                laik_aseq_addReduce3Rounds(as, tc, ba);
+        case LAIK_AT_GroupReduce:
+            if (useReduceTree(tc->transition, ba))
+                laik_aseq_addReduceTree(as, tc, ba, spread * a->round);
             else
-                laik_aseq_addReduce2Rounds(as, tc, ba);
+                laik_aseq_addReduce2Rounds(as, tc, ba, spread * a->round);
             break;
-        }
 
         default:
-            laik_aseq_add(a, as, 3 * a->round + 1);
+            laik_aseq_add(a, as, spread * a->round + 1);
             break;
         }
     }
@@ -2337,12 +2603,12 @@ bool laik_aseq_replaceWithAllReduce(Laik_ActionSeq* as)
     bool changed = false;
     assert(as->newActionCount == 0);
 
-    Laik_TransitionContext* tc = as->context[0];
-    Laik_Transition* t = tc->transition;
-
     Laik_Action* a = as->action;
     for(unsigned int i = 0; i < as->actionCount; i++, a = nextAction(a)) {
+        Laik_TransitionContext* tc = as->context[a->tid];
+        Laik_Transition* t = tc->transition;
         Laik_BackendAction* ba = (Laik_BackendAction*) a;
+        as->currentTID = a->tid;
 
         switch(a->type) {
         // TODO: LAIK_AT_MapGroupReduce
@@ -2386,7 +2652,6 @@ bool laik_aseq_splitTransitionExecs(Laik_ActionSeq* as)
     // must not have new actions, we want to start a new build
     assert(as->newActionCount == 0);
 
-    Laik_TransitionContext* tc = as->context[0];
     bool found = false;
     Laik_Action* a = as->action;
     for(unsigned int i = 0; i < as->actionCount; i++, a = nextAction(a)) {
@@ -2401,12 +2666,14 @@ bool laik_aseq_splitTransitionExecs(Laik_ActionSeq* as)
     a = as->action;
     for(unsigned int i = 0; i < as->actionCount; i++, a = nextAction(a)) {
         switch(a->type) {
-        case LAIK_AT_TExec:
-            assert(a->tid == 0);
+        case LAIK_AT_TExec: {
+            Laik_TransitionContext* tc = as->context[a->tid];
+            as->currentTID = a->tid;
             laik_aseq_addReds(as, a->round, tc->data, tc->transition);
             laik_aseq_addSends(as, a->round, tc->data, tc->transition);
             laik_aseq_addRecvs(as, a->round, tc->data, tc->transition);
             break;
+        }
 
         default:
             laik_aseq_add(a, as, -1);
@@ -2445,14 +2712,12 @@ int laik_aseq_calc_stats(Laik_ActionSeq* as)
     as->reduceOpCount = 0;
     as->byteBufCopyCount = 0;
 
-    // TODO: we only allow 1 transition at the moment
-    Laik_TransitionContext* tc = as->context[0];
-    int current_tid = 0;
-    as->transitionCount = 1;
+    // one execution does all transitions recorded in the sequence
+    as->transitionCount = as->contextCount;
 
     Laik_Action* a = as->action;
     for(unsigned int i = 0; i < as->actionCount; i++, a = nextAction(a)) {
-        assert(a->tid == current_tid); // TODO: only assumes actions from one transition
+        Laik_TransitionContext* tc = as->context[a->tid];
 
         switch(a->type) {
         case LAIK_AT_TExec:
@@ -2569,25 +2834,43 @@ int laik_aseq_calc_stats(Laik_ActionSeq* as)
 // Default Exec implementations for actions not specific to a backend.
 // Backends can to use them or implement their own versions
 
+// pack/unpack of a sub-range, called via thread pool
+struct packCtx {
+    Laik_Mapping* map;
+    char* buf;
+    bool pack;
+};
+
+static
+void packSubRange(void* ctx, Laik_Range* sub, uint64_t off)
+{
+    struct packCtx* c = (struct packCtx*) ctx;
+    Laik_Mapping* map = c->map;
+    int elemsize = map->data->elemsize;
+    uint64_t count = laik_range_size(sub);
+    Laik_Index idx = sub->from;
+    char* buf = c->buf + off * elemsize;
+    unsigned int n;
+    if (c->pack)
+        n = (map->layout->pack)(map, sub, &idx, buf, count * elemsize);
+    else
+        n = (map->layout->unpack)(map, sub, &idx, buf, count * elemsize);
+    assert(n == count);
+    assert(laik_index_isEqual(sub->space->dims, &idx, &(sub->to)));
+}
+
 // LAIK_AT_PackToBuf
 void laik_exec_pack(Laik_BackendAction* a, Laik_Mapping* map)
 {
-    Laik_Index idx = a->range->from;
-    int dims = a->range->space->dims;
-    unsigned int byteCount = a->count * map->data->elemsize;
-    unsigned int packed = (map->layout->pack)(map, a->range, &idx, a->toBuf, byteCount);
-    assert(packed == a->count);
-    assert(laik_index_isEqual(dims, &idx, &(a->range->to)));
+    assert(laik_range_size(a->range) == a->count);
+    struct packCtx c = { map, a->toBuf, true };
+    laik_threads_run_range(a->range, map->data->elemsize, packSubRange, &c);
 }
 
 // LAIK_AT_UnpackFromBuf
 void laik_exec_unpack(Laik_BackendAction* a, Laik_Mapping* map)
 {
-    Laik_Index idx = a->range->from;
-    int dims = a->range->space->dims;
-    unsigned int byteCount = a->count * map->data->elemsize;
-    unsigned int unpacked = (map->layout->unpack)(map, a->range, &idx,
-                                                  a->fromBuf, byteCount);
-    assert(unpacked == a->count);
-    assert(laik_index_isEqual(dims, &idx, &(a->range->to)));
+    assert(laik_range_size(a->range) == a->count);
+    struct packCtx c = { map, a->fromBuf, false };
+    laik_threads_run_range(a->range, map->data->elemsize, packSubRange, &c);
 }
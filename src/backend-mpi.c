@@ -38,6 +38,8 @@ static void laik_mpi_finalize(Laik_Instance*);
 static void laik_mpi_prepare(Laik_ActionSeq*);
 static void laik_mpi_cleanup(Laik_ActionSeq*);
 static void laik_mpi_exec(Laik_ActionSeq* as);
+static unsigned int laik_mpi_exec_begin(Laik_ActionSeq* as);
+static void laik_mpi_exec_end(Laik_ActionSeq* as, unsigned int done);
 static void laik_mpi_updateGroup(Laik_Group*);
 static bool laik_mpi_log_action(Laik_Action* a);
 static void laik_mpi_sync(Laik_KVStore* kvs);
@@ -49,6 +51,8 @@ static Laik_Backend laik_backend_mpi = {
     .prepare     = laik_mpi_prepare,
     .cleanup     = laik_mpi_cleanup,
     .exec        = laik_mpi_exec,
+    .exec_begin  = laik_mpi_exec_begin,
+    .exec_end    = laik_mpi_exec_end,
     .updateGroup = laik_mpi_updateGroup,
     .log_action  = laik_mpi_log_action,
     .sync        = laik_mpi_sync
@@ -61,8 +65,19 @@ typedef struct {
     bool didInit;
 } MPIData;
 
+// distributed graph communicator for neighborhood exchanges
 typedef struct {
     MPI_Comm comm;
+    int indegree, outdegree;
+    int* ranks; // sources followed by destinations, both ascending
+} MPINeighborComm;
+
+typedef struct {
+    MPI_Comm comm;
+    // graph communicators created for this group. As they are created
+    // collectively, the index of a communicator is the same in all processes
+    MPINeighborComm* nbComm;
+    int nbCommCount;
 } MPIGroupData;
 
 //----------------------------------------------------------------
@@ -75,8 +90,33 @@ static int mpi_reduce = 1;
 // LAIK_MPI_ASYNC: convert send/recv to isend/irecv? Default: Yes
 static int mpi_async = 1;
 
+// LAIK_MPI_DATATYPES: use derived datatypes for strided ranges instead
+// of packing into buffers? Only used with async send/recv. Default: Yes
+static int mpi_datatypes = 1;
+
+// LAIK_MPI_PERSISTENT: create persistent requests for isend/irecv when
+// preparing an action sequence, started with MPI_Startall on each exec?
+// Only used with async send/recv, and for sequences executed multiple times
+// (cached switches or sequences held by the application). Default: Yes
+static int mpi_persistent = 1;
+
+// LAIK_MPI_NEIGHBOR: execute action sequences only consisting of send/recv
+// and packing actions as one neighborhood collective (MPI-3) on a graph
+// communicator? Needs agreement of all processes in the group on each
+// prepare. Default: No
+static int mpi_neighbor = 0;
+
+// LAIK_MPI_KVSTREE: synchronize KV stores via tree reduction + broadcast
+// instead of collecting all changes at T0? Default: Yes
+static int mpi_kvstree = 1;
+
 
 //----------------------------------------------------------------
+// tag used for all point-to-point messages. Must be the same for direct
+// execution and persistent requests created at prepare time, as messages
+// of both may have to match
+#define MSGTAG 1
+
 // buffer space for messages if packing/unpacking from/to not-1d layout
 // is necessary
 #define PACKBUFSIZE (10*1024*1024)
@@ -91,34 +131,47 @@ static char packbuf[PACKBUFSIZE];
 #define LAIK_AT_MpiIrecv (LAIK_AT_Backend + 1)
 #define LAIK_AT_MpiIsend (LAIK_AT_Backend + 2)
 #define LAIK_AT_MpiWait  (LAIK_AT_Backend + 3)
+#define LAIK_AT_MpiStartAll (LAIK_AT_Backend + 4)
+#define LAIK_AT_MpiWaitAll  (LAIK_AT_Backend + 5)
+#define LAIK_AT_MpiNeighbor (LAIK_AT_Backend + 6)
 
 // action structs must be packed
 #pragma pack(push,1)
 
 // ReqBuf action: provide base address for MPI_Request array
-// referenced in following IRecv/Wait actions via req_it operands
+// referenced in following IRecv/Wait actions via req_it operands.
+// Also holds derived datatypes created for this sequence (freed on cleanup).
+// If <persistent> is set, requests are persistent ones created on prepare:
+// IRecv/ISend actions only describe them, they get started by StartAll
 typedef struct {
     Laik_Action h;
     unsigned int count;
     MPI_Request* req;
+    unsigned int typeCount;
+    MPI_Datatype* type;
+    unsigned char persistent;
 } Laik_A_MpiReq;
 
 // IRecv action
+// if <type> is not MPI_DATATYPE_NULL, receive one element of this type
+// (<count> still is number of container elements)
 typedef struct {
     Laik_Action h;
     unsigned int count;
     int from_rank;
     int req_id;
     char* buf;
+    MPI_Datatype type;
 } Laik_A_MpiIrecv;
 
-// ISend action
+// ISend action, <type> as for IRecv
 typedef struct {
     Laik_Action h;
     unsigned int count;
     int to_rank;
     int req_id;
     char* buf;
+    MPI_Datatype type;
 } Laik_A_MpiIsend;
 
 #pragma pack(pop)
@@ -129,9 +182,13 @@ void laik_mpi_addMpiReq(Laik_ActionSeq* as, int round,
 {
     Laik_A_MpiReq* a;
     a = (Laik_A_MpiReq*) laik_aseq_addAction(as, sizeof(*a),
-                                             LAIK_AT_MpiReq, round, 0);
+                                             LAIK_AT_MpiReq, round,
+                                             as->currentTID);
     a->count = count;
     a->req = buf;
+    a->typeCount = 0;
+    a->type = 0;
+    a->persistent = 0;
 }
 
 static
@@ -140,11 +197,13 @@ void laik_mpi_addMpiIrecv(Laik_ActionSeq* as, int round,
 {
     Laik_A_MpiIrecv* a;
     a = (Laik_A_MpiIrecv*) laik_aseq_addAction(as, sizeof(*a),
-                                               LAIK_AT_MpiIrecv, round, 0);
+                                               LAIK_AT_MpiIrecv, round,
+                                               as->currentTID);
     a->buf = toBuf;
     a->count = count;
     a->from_rank = from;
     a->req_id = req_id;
+    a->type = MPI_DATATYPE_NULL;
 }
 
 static
@@ -153,11 +212,13 @@ void laik_mpi_addMpiIsend(Laik_ActionSeq* as, int round,
 {
     Laik_A_MpiIsend* a;
     a = (Laik_A_MpiIsend*) laik_aseq_addAction(as, sizeof(*a),
-                                               LAIK_AT_MpiIsend, round, 0);
+                                               LAIK_AT_MpiIsend, round,
+                                               as->currentTID);
     a->buf = fromBuf;
     a->count = count;
     a->to_rank = to;
     a->req_id = req_id;
+    a->type = MPI_DATATYPE_NULL;
 }
 
 // Wait action
@@ -166,15 +227,48 @@ typedef struct {
     int req_id;
 } Laik_A_MpiWait;
 
+// StartAll/WaitAll action: start/wait for persistent requests
+// with IDs [req_id; req_id+count[
+typedef struct {
+    Laik_Action h;
+    int req_id;
+    int count;
+} Laik_A_MpiReqRange;
+
+// Neighbor action: exchange with MPI_Neighbor_alltoallw on graph communicator
+// <comm> (index into group data). Arrays have entries for <sendCount>
+// destinations followed by <recvCount> sources, with absolute addresses
+// of buffers. Arrays are freed on cleanup
+typedef struct {
+    Laik_Action h;
+    int comm;
+    int sendCount, recvCount;
+    int* count;
+    MPI_Aint* addr;
+    MPI_Datatype* type;
+} Laik_A_MpiNeighbor;
+
 static
 void laik_mpi_addMpiWait(Laik_ActionSeq* as, int round, int req_id)
 {
     Laik_A_MpiWait* a;
     a = (Laik_A_MpiWait*) laik_aseq_addAction(as, sizeof(*a),
-                                              LAIK_AT_MpiWait, round, 0);
+                                              LAIK_AT_MpiWait, round,
+                                              as->currentTID);
     a->req_id = req_id;
 }
 
+static
+void laik_mpi_addMpiReqRange(Laik_ActionSeq* as, Laik_ActionType type,
+                             int round, int req_id, int count)
+{
+    Laik_A_MpiReqRange* a;
+    a = (Laik_A_MpiReqRange*) laik_aseq_addAction(as, sizeof(*a), type, round,
+                                                  as->currentTID);
+    a->req_id = req_id;
+    a->count = count;
+}
+
 static
 bool laik_mpi_log_action(Laik_Action* a)
 {
@@ -182,20 +276,26 @@ bool laik_mpi_log_action(Laik_Action* a)
     case LAIK_AT_MpiReq: {
         Laik_A_MpiReq* aa = (Laik_A_MpiReq*) a;
         laik_log_append("MPI-Req: count %d, req %p", aa->count, aa->req);
+        if (aa->typeCount > 0)
+            laik_log_append(", %d datatypes", aa->typeCount);
+        if (aa->persistent)
+            laik_log_append(", persistent");
         break;
     }
 
     case LAIK_AT_MpiIsend: {
         Laik_A_MpiIsend* aa = (Laik_A_MpiIsend*) a;
-        laik_log_append("MPI-ISend: from %p ==> T%d, count %d, reqid %d",
-                        aa->buf, aa->to_rank, aa->count, aa->req_id);
+        laik_log_append("MPI-ISend: from %p ==> T%d, count %d, reqid %d%s",
+                        aa->buf, aa->to_rank, aa->count, aa->req_id,
+                        (aa->type != MPI_DATATYPE_NULL) ? " (datatype)" : "");
         break;
     }
 
     case LAIK_AT_MpiIrecv: {
         Laik_A_MpiIrecv* aa = (Laik_A_MpiIrecv*) a;
-        laik_log_append("MPI-IRecv: T%d ==> to %p, count %d, reqid %d",
-                        aa->from_rank, aa->buf, aa->count, aa->req_id);
+        laik_log_append("MPI-IRecv: T%d ==> to %p, count %d, reqid %d%s",
+                        aa->from_rank, aa->buf, aa->count, aa->req_id,
+                        (aa->type != MPI_DATATYPE_NULL) ? " (datatype)" : "");
         break;
     }
 
@@ -205,6 +305,27 @@ bool laik_mpi_log_action(Laik_Action* a)
         break;
     }
 
+    case LAIK_AT_MpiStartAll: {
+        Laik_A_MpiReqRange* aa = (Laik_A_MpiReqRange*) a;
+        laik_log_append("MPI-StartAll: reqid %d - %d",
+                        aa->req_id, aa->req_id + aa->count - 1);
+        break;
+    }
+
+    case LAIK_AT_MpiWaitAll: {
+        Laik_A_MpiReqRange* aa = (Laik_A_MpiReqRange*) a;
+        laik_log_append("MPI-WaitAll: reqid %d - %d",
+                        aa->req_id, aa->req_id + aa->count - 1);
+        break;
+    }
+
+    case LAIK_AT_MpiNeighbor: {
+        Laik_A_MpiNeighbor* aa = (Laik_A_MpiNeighbor*) a;
+        laik_log_append("MPI-Neighbor: graph comm %d, %d sends, %d recvs",
+                        aa->comm, aa->sendCount, aa->recvCount);
+        break;
+    }
+
     default:
         return false;
     }
@@ -233,6 +354,9 @@ bool laik_mpi_asyncSendRecv(Laik_ActionSeq* as)
     // add 2 new rounds: 0 and maxround+2
     // - round 0 gets MpiReq and all MpiIrecv actions
     // - round maxround+2 gets Waits from MpiISend actions
+    // Waits for receives are added after all other actions, such that
+    // within a round, all ISends are triggered before waiting
+    // (enables overlap with split-phase execution)
 
     MPI_Request* buf = malloc(count * sizeof(MPI_Request));
     laik_mpi_addMpiReq(as, 0, count, buf);
@@ -240,6 +364,7 @@ bool laik_mpi_asyncSendRecv(Laik_ActionSeq* as)
     int req_id = 0;
     a = as->action;
     for(unsigned int i = 0; i < as->actionCount; i++, a = nextAction(a)) {
+        as->currentTID = a->tid;
         switch(a->type) {
         case LAIK_AT_BufSend: {
             Laik_A_BufSend* aa = (Laik_A_BufSend*) a;
@@ -254,7 +379,6 @@ bool laik_mpi_asyncSendRecv(Laik_ActionSeq* as)
             Laik_A_BufRecv* aa = (Laik_A_BufRecv*) a;
             laik_mpi_addMpiIrecv(as, 0,
                                  aa->buf, aa->count, aa->from_rank, req_id);
-            laik_mpi_addMpiWait(as, a->round + 1, req_id);
             req_id++;
             break;
         }
@@ -267,6 +391,19 @@ bool laik_mpi_asyncSendRecv(Laik_ActionSeq* as)
     }
     assert(count == (unsigned) req_id);
 
+    // waits for receives, same request IDs as above
+    req_id = 0;
+    a = as->action;
+    for(unsigned int i = 0; i < as->actionCount; i++, a = nextAction(a)) {
+        if (a->type == LAIK_AT_BufSend)
+            req_id++;
+        else if (a->type == LAIK_AT_BufRecv) {
+            as->currentTID = a->tid;
+            laik_mpi_addMpiWait(as, a->round + 1, req_id);
+            req_id++;
+        }
+    }
+
     laik_aseq_activateNewActions(as);
     return true;
 }
@@ -329,6 +466,8 @@ Laik_Instance* laik_init_mpi(int* argc, char*** argv)
 
     // now finish initilization of <gd>/<d>, as MPI_Init is run
     gd->comm = ownworld;
+    gd->nbComm = 0;
+    gd->nbCommCount = 0;
     d->comm = ownworld;
 
     int size, rank;
@@ -372,6 +511,22 @@ Laik_Instance* laik_init_mpi(int* argc, char*** argv)
     str = getenv("LAIK_MPI_ASYNC");
     if (str) mpi_async = atoi(str);
 
+    // use derived datatypes?
+    str = getenv("LAIK_MPI_DATATYPES");
+    if (str) mpi_datatypes = atoi(str);
+
+    // use persistent requests?
+    str = getenv("LAIK_MPI_PERSISTENT");
+    if (str) mpi_persistent = atoi(str);
+
+    // neighborhood collectives?
+    str = getenv("LAIK_MPI_NEIGHBOR");
+    if (str) mpi_neighbor = atoi(str);
+
+    // KVS sync via tree?
+    str = getenv("LAIK_MPI_KVSTREE");
+    if (str) mpi_kvstree = atoi(str);
+
     mpi_instance = inst;
     return inst;
 }
@@ -427,6 +582,8 @@ void laik_mpi_updateGroup(Laik_Group* g)
         exit(1); // not actually needed, laik_panic never returns
     }
     g->backend_data = gd;
+    gd->nbComm = 0;
+    gd->nbCommCount = 0;
 
     laik_log(1, "MPI Comm_split: old myid %d => new myid %d",
              g->parent->myid, g->fromParent[g->parent->myid]);
@@ -677,14 +834,39 @@ void laik_mpi_exec_groupReduce(Laik_TransitionContext* tc,
     }
 }
 
+// actions which never block, as they only work locally or start
+// asynchronous MPI operations. Executed in begin phase of split-phase exec
 static
-void laik_mpi_exec(Laik_ActionSeq* as)
+bool isNonBlockingAction(Laik_Action* a)
 {
-    if (as->actionCount == 0) {
-        laik_log(1, "MPI backend exec: nothing to do\n");
-        return;
+    switch(a->type) {
+    case LAIK_AT_BufReserve:
+    case LAIK_AT_Nop:
+    case LAIK_AT_MpiReq:
+    case LAIK_AT_MpiIsend:
+    case LAIK_AT_MpiIrecv:
+    case LAIK_AT_MpiStartAll:
+    case LAIK_AT_CopyFromBuf:
+    case LAIK_AT_CopyToBuf:
+    case LAIK_AT_PackToBuf:
+    case LAIK_AT_MapPackToBuf:
+    case LAIK_AT_UnpackFromBuf:
+    case LAIK_AT_MapUnpackFromBuf:
+    case LAIK_AT_RBufLocalReduce:
+    case LAIK_AT_RBufCopy:
+    case LAIK_AT_BufCopy:
+    case LAIK_AT_BufInit:
+        return true;
+    default:
+        break;
     }
+    return false;
+}
 
+// do minimal transformations (sorting send/recv) if not prepared
+static
+void laik_mpi_prepare_on_exec(Laik_ActionSeq* as)
+{
     if (as->backend == 0) {
         // no preparation: do minimal transformations, sorting send/recv
         laik_log(1, "MPI backend exec: prepare before exec\n");
@@ -701,35 +883,58 @@ void laik_mpi_exec(Laik_ActionSeq* as)
         int not_handled = laik_aseq_calc_stats(as);
         assert(not_handled == 0); // there should be no MPI-specific actions
     }
+}
 
-    if (laik_log_begin(1)) {
-        laik_log_append("MPI backend exec:\n");
-        laik_log_ActionSeq(as, false);
-        laik_log_flush(0);
-    }
-
-    // TODO: use transition context given by each action
+// execute actions of sequence starting at action <start>.
+// with <nonblocking> set, stop at first action which may block.
+// returns number of actions done
+static
+unsigned int laik_mpi_exec_actions(Laik_ActionSeq* as,
+                                   unsigned int start, bool nonblocking)
+{
+    // common for all MPI calls: tag, comm (same group for all contexts)
+    int tag = MSGTAG;
     Laik_TransitionContext* tc = as->context[0];
-    Laik_MappingList* fromList = tc->fromList;
-    Laik_MappingList* toList = tc->toList;
-    int elemsize = tc->data->elemsize;
-
-    // common for all MPI calls: tag, comm, datatype
-    int tag = 1;
     MPIGroupData* gd = mpiGroupData(tc->transition->group);
     assert(gd);
     MPI_Comm comm = gd->comm;
-    MPI_Datatype dataType = getMPIDataType(tc->data);
     MPI_Status st;
     int err, count;
 
+    // mappings and datatype from transition context of current action
+    tc = 0;
+    Laik_MappingList *fromList = 0, *toList = 0;
+    int elemsize = 0;
+    MPI_Datatype dataType = MPI_DATATYPE_NULL;
+
     // MPI_Request array: not set yet
     int req_count = 0;
     MPI_Request* req = 0;
+    bool persistent = false;
 
     Laik_Action* a = as->action;
     for(unsigned int i = 0; i < as->actionCount; i++, a = nextAction(a)) {
         Laik_BackendAction* ba = (Laik_BackendAction*) a;
+        if (as->context[a->tid] != tc) {
+            tc = as->context[a->tid];
+            fromList = tc->fromList;
+            toList = tc->toList;
+            elemsize = tc->data->elemsize;
+            dataType = getMPIDataType(tc->data);
+        }
+
+        if (i < start) {
+            // already done, but MPI_Request array needed in later actions
+            if (a->type == LAIK_AT_MpiReq) {
+                req_count = ((Laik_A_MpiReq*) a)->count;
+                req = ((Laik_A_MpiReq*) a)->req;
+                persistent = ((Laik_A_MpiReq*) a)->persistent;
+            }
+            continue;
+        }
+        if (nonblocking && !isNonBlockingAction(a))
+            return i;
+
         if (laik_log_begin(1)) {
             laik_log_Action(a, as);
             laik_log_flush(0);
@@ -748,6 +953,7 @@ void laik_mpi_exec(Laik_ActionSeq* as)
             assert(aa->count > 0);
             req_count = aa->count;
             req = aa->req;
+            persistent = aa->persistent;
             break;
         }
 
@@ -755,8 +961,13 @@ void laik_mpi_exec(Laik_ActionSeq* as)
             // MPI-specific action: call MPI_Isend
             Laik_A_MpiIsend* aa = (Laik_A_MpiIsend*) a;
             assert(aa->req_id < req_count);
-            err = MPI_Isend(aa->buf, aa->count,
-                            dataType, aa->to_rank, tag, comm, req + aa->req_id);
+            if (persistent) break; // started by StartAll
+            if (aa->type != MPI_DATATYPE_NULL)
+                err = MPI_Isend(aa->buf, 1,
+                                aa->type, aa->to_rank, tag, comm, req + aa->req_id);
+            else
+                err = MPI_Isend(aa->buf, aa->count,
+                                dataType, aa->to_rank, tag, comm, req + aa->req_id);
             if (err != MPI_SUCCESS) laik_mpi_panic(err);
             break;
         }
@@ -765,8 +976,13 @@ void laik_mpi_exec(Laik_ActionSeq* as)
             // MPI-specific action: exec MPI_IRecv
             Laik_A_MpiIrecv* aa = (Laik_A_MpiIrecv*) a;
             assert(aa->req_id < req_count);
-            err = MPI_Irecv(aa->buf, aa->count,
-                            dataType, aa->from_rank, tag, comm, req + aa->req_id);
+            if (persistent) break; // started by StartAll
+            if (aa->type != MPI_DATATYPE_NULL)
+                err = MPI_Irecv(aa->buf, 1,
+                                aa->type, aa->from_rank, tag, comm, req + aa->req_id);
+            else
+                err = MPI_Irecv(aa->buf, aa->count,
+                                dataType, aa->from_rank, tag, comm, req + aa->req_id);
             if (err != MPI_SUCCESS) laik_mpi_panic(err);
             break;
         }
@@ -780,6 +996,36 @@ void laik_mpi_exec(Laik_ActionSeq* as)
             break;
         }
 
+        case LAIK_AT_MpiStartAll: {
+            // MPI-specific action: start range of persistent requests
+            Laik_A_MpiReqRange* aa = (Laik_A_MpiReqRange*) a;
+            assert(persistent && (aa->req_id + aa->count <= req_count));
+            err = MPI_Startall(aa->count, req + aa->req_id);
+            if (err != MPI_SUCCESS) laik_mpi_panic(err);
+            break;
+        }
+
+        case LAIK_AT_MpiWaitAll: {
+            // MPI-specific action: wait for range of requests
+            Laik_A_MpiReqRange* aa = (Laik_A_MpiReqRange*) a;
+            assert(aa->req_id + aa->count <= req_count);
+            err = MPI_Waitall(aa->count, req + aa->req_id, MPI_STATUSES_IGNORE);
+            if (err != MPI_SUCCESS) laik_mpi_panic(err);
+            break;
+        }
+
+        case LAIK_AT_MpiNeighbor: {
+            // MPI-specific action: neighborhood collective, addresses absolute
+            Laik_A_MpiNeighbor* aa = (Laik_A_MpiNeighbor*) a;
+            assert(aa->comm < gd->nbCommCount);
+            int n = aa->sendCount;
+            err = MPI_Neighbor_alltoallw(MPI_BOTTOM, aa->count, aa->addr, aa->type,
+                                         MPI_BOTTOM, aa->count + n, aa->addr + n,
+                                         aa->type + n, gd->nbComm[aa->comm].comm);
+            if (err != MPI_SUCCESS) laik_mpi_panic(err);
+            break;
+        }
+
         case LAIK_AT_MapSend: {
             assert(ba->fromMapNo < fromList->count);
             Laik_Mapping* fromMap = &(fromList->map[ba->fromMapNo]);
@@ -792,7 +1038,7 @@ void laik_mpi_exec(Laik_ActionSeq* as)
 
         case LAIK_AT_RBufSend: {
             Laik_A_RBufSend* aa = (Laik_A_RBufSend*) a;
-            assert(aa->bufID < ASEQ_BUFFER_MAX);
+            assert(aa->bufID < as->bufferCount);
             err = MPI_Send(as->buf[aa->bufID] + aa->offset, aa->count,
                            dataType, aa->to_rank, tag, comm);
             if (err != MPI_SUCCESS) laik_mpi_panic(err);
@@ -824,7 +1070,7 @@ void laik_mpi_exec(Laik_ActionSeq* as)
 
         case LAIK_AT_RBufRecv: {
             Laik_A_RBufRecv* aa = (Laik_A_RBufRecv*) a;
-            assert(aa->bufID < ASEQ_BUFFER_MAX);
+            assert(aa->bufID < as->bufferCount);
             err = MPI_Recv(as->buf[aa->bufID] + aa->offset, aa->count,
                            dataType, aa->from_rank, tag, comm, &st);
             if (err != MPI_SUCCESS) laik_mpi_panic(err);
@@ -850,17 +1096,11 @@ void laik_mpi_exec(Laik_ActionSeq* as)
         }
 
         case LAIK_AT_CopyFromBuf:
-            for(unsigned int i = 0; i < ba->count; i++)
-                memcpy(ba->ce[i].ptr,
-                       ba->fromBuf + ba->ce[i].offset,
-                       ba->ce[i].bytes);
+            laik_threads_copyEntries(ba->ce, ba->count, ba->fromBuf, false);
             break;
 
         case LAIK_AT_CopyToBuf:
-            for(unsigned int i = 0; i < ba->count; i++)
-                memcpy(ba->toBuf + ba->ce[i].offset,
-                       ba->ce[i].ptr,
-                       ba->ce[i].bytes);
+            laik_threads_copyEntries(ba->ce, ba->count, ba->toBuf, true);
             break;
 
         case LAIK_AT_PackToBuf:
@@ -929,24 +1169,26 @@ void laik_mpi_exec(Laik_ActionSeq* as)
             break;
 
         case LAIK_AT_RBufLocalReduce:
-            assert(ba->bufID < ASEQ_BUFFER_MAX);
+            assert(ba->bufID < as->bufferCount);
             assert(ba->dtype->reduce != 0);
-            (ba->dtype->reduce)(ba->toBuf, ba->toBuf, as->buf[ba->bufID] + ba->offset,
-                               ba->count, ba->redOp);
+            laik_threads_reduce(ba->dtype, ba->toBuf, ba->toBuf,
+                                as->buf[ba->bufID] + ba->offset,
+                                ba->count, ba->redOp);
             break;
 
         case LAIK_AT_RBufCopy:
-            assert(ba->bufID < ASEQ_BUFFER_MAX);
-            memcpy(ba->toBuf, as->buf[ba->bufID] + ba->offset, ba->count * elemsize);
+            assert(ba->bufID < as->bufferCount);
+            laik_threads_memcpy(ba->toBuf, as->buf[ba->bufID] + ba->offset,
+                                ba->count * elemsize);
             break;
 
         case LAIK_AT_BufCopy:
-            memcpy(ba->toBuf, ba->fromBuf, ba->count * elemsize);
+            laik_threads_memcpy(ba->toBuf, ba->fromBuf, ba->count * elemsize);
             break;
 
         case LAIK_AT_BufInit:
             assert(ba->dtype->init != 0);
-            (ba->dtype->init)(ba->toBuf, ba->count, ba->redOp);
+            laik_threads_init_elems(ba->dtype, ba->toBuf, ba->count, ba->redOp);
             break;
 
         default:
@@ -956,6 +1198,60 @@ void laik_mpi_exec(Laik_ActionSeq* as)
         }
     }
     assert( ((char*)as->action) + as->bytesUsed == ((char*)a) );
+
+    return as->actionCount;
+}
+
+static
+void laik_mpi_exec(Laik_ActionSeq* as)
+{
+    if (as->actionCount == 0) {
+        laik_log(1, "MPI backend exec: nothing to do\n");
+        return;
+    }
+
+    laik_mpi_prepare_on_exec(as);
+
+    if (laik_log_begin(1)) {
+        laik_log_append("MPI backend exec:\n");
+        laik_log_ActionSeq(as, false);
+        laik_log_flush(0);
+    }
+
+    laik_mpi_exec_actions(as, 0, false);
+}
+
+// split-phase exec: start with actions until first blocking one
+static
+unsigned int laik_mpi_exec_begin(Laik_ActionSeq* as)
+{
+    if (as->actionCount == 0) {
+        laik_log(1, "MPI backend exec begin: nothing to do\n");
+        return 0;
+    }
+
+    laik_mpi_prepare_on_exec(as);
+
+    if (laik_log_begin(1)) {
+        laik_log_append("MPI backend exec begin:\n");
+        laik_log_ActionSeq(as, false);
+        laik_log_flush(0);
+    }
+
+    unsigned int done = laik_mpi_exec_actions(as, 0, true);
+    laik_log(1, "MPI backend exec begin: %d of %d actions done",
+             done, as->actionCount);
+    return done;
+}
+
+// split-phase exec: execute remaining actions
+static
+void laik_mpi_exec_end(Laik_ActionSeq* as, unsigned int done)
+{
+    if (done == as->actionCount) return;
+
+    laik_log(1, "MPI backend exec end: from action %d", done);
+    laik_mpi_exec_actions(as, done, false);
 }
 
 
@@ -964,11 +1260,9 @@ static
 void laik_mpi_aseq_calc_stats(Laik_ActionSeq* as)
 {
     unsigned int count;
-    Laik_TransitionContext* tc = as->context[0];
-    int current_tid = 0;
     Laik_Action* a = as->action;
     for(unsigned int i = 0; i < as->actionCount; i++, a = nextAction(a)) {
-        assert(a->tid == current_tid); // TODO: only assumes actions from one transition
+        Laik_TransitionContext* tc = as->context[a->tid];
         switch(a->type) {
         case LAIK_AT_MpiIsend:
             count = ((Laik_A_MpiIsend*)a)->count;
@@ -982,12 +1276,554 @@ void laik_mpi_aseq_calc_stats(Laik_ActionSeq* as)
             as->elemRecvCount += count;
             as->byteRecvCount += count * tc->data->elemsize;
             break;
+        case LAIK_AT_MpiNeighbor: {
+            Laik_A_MpiNeighbor* aa = (Laik_A_MpiNeighbor*) a;
+            for(int j = 0; j < aa->sendCount + aa->recvCount; j++) {
+                int size;
+                MPI_Type_size(aa->type[j], &size);
+                if (j < aa->sendCount) {
+                    as->msgSendCount++;
+                    as->elemSendCount += aa->count[j];
+                    as->byteSendCount += (uint64_t) aa->count[j] * size;
+                }
+                else {
+                    as->msgRecvCount++;
+                    as->elemRecvCount += aa->count[j];
+                    as->byteRecvCount += (uint64_t) aa->count[j] * size;
+                }
+            }
+            break;
+        }
         default: break;
         }
     }
 }
 
 
+// key for derived datatypes created within an action sequence
+typedef struct {
+    int64_t count[3];
+    uint64_t stride[3];
+} MpiTypeKey;
+
+// return derived datatype for range <r> in mapping <m> (lex layout).
+// Types are shared among actions, using key array <key> parallel to <types>
+static
+MPI_Datatype getRangeDatatype(Laik_Mapping* m, Laik_Range* r,
+                              unsigned int* typeCount,
+                              MPI_Datatype** types, MpiTypeKey** keys)
+{
+    int dims = r->space->dims;
+    MpiTypeKey k;
+    for(int d = 0; d < 3; d++) {
+        k.count[d] = (d < dims) ? r->to.i[d] - r->from.i[d] : 1;
+        k.stride[d] = (d < dims) ?
+            laik_layout_lex_stride(m->layout, m->layoutSection, d) : 0;
+    }
+    for(unsigned int i = 0; i < *typeCount; i++)
+        if (memcmp(&k, &((*keys)[i]), sizeof(MpiTypeKey)) == 0)
+            return (*types)[i];
+
+    MPI_Datatype elemType = getMPIDataType(m->data);
+    MPI_Datatype t, t2;
+    int err;
+    // rows: blocks of count[0] consecutive elements
+    err = MPI_Type_vector((int) k.count[1], (int) k.count[0], (int) k.stride[1],
+                          elemType, &t);
+    if (err != MPI_SUCCESS) laik_mpi_panic(err);
+    if (dims > 2) {
+        MPI_Aint planeStride = (MPI_Aint) (k.stride[2] * m->data->elemsize);
+        err = MPI_Type_create_hvector((int) k.count[2], 1, planeStride, t, &t2);
+        if (err != MPI_SUCCESS) laik_mpi_panic(err);
+        MPI_Type_free(&t);
+        t = t2;
+    }
+    err = MPI_Type_commit(&t);
+    if (err != MPI_SUCCESS) laik_mpi_panic(err);
+
+    *types = realloc(*types, (*typeCount + 1) * sizeof(MPI_Datatype));
+    *keys = realloc(*keys, (*typeCount + 1) * sizeof(MpiTypeKey));
+    assert((*types != 0) && (*keys != 0));
+    (*types)[*typeCount] = t;
+    (*keys)[*typeCount] = k;
+    (*typeCount)++;
+    return t;
+}
+
+// transformation: for ranges not stored contiguously in a mapping, replace
+// packing into/unpacking from a buffer used in an ISend/IRecv by a
+// derived datatype describing the range in the mapping.
+// Must be run after laik_mpi_asyncSendRecv
+static
+bool laik_mpi_useDatatypes(Laik_ActionSeq* as)
+{
+    // must not have new actions, we want to start a new build
+    assert(as->newActionCount == 0);
+
+    if ((as->actionCount == 0) || (as->action->type != LAIK_AT_MpiReq))
+        return false;
+    Laik_A_MpiReq* ra = (Laik_A_MpiReq*) as->action;
+    assert(ra->typeCount == 0);
+
+    MpiTypeKey* keys = 0;
+    bool changed = false;
+    Laik_Action* a = as->action;
+    for(unsigned int i = 0; i < as->actionCount; i++, a = nextAction(a))
+        a->mark = 0;
+
+    a = as->action;
+    for(unsigned int i = 0; i < as->actionCount; i++, a = nextAction(a)) {
+        if ((a->type != LAIK_AT_PackToBuf) && (a->type != LAIK_AT_UnpackFromBuf))
+            continue;
+
+        Laik_BackendAction* ba = (Laik_BackendAction*) a;
+        Laik_Mapping* m = ba->map;
+        if ((m == 0) || (m->base == 0)) continue;
+        if ((ba->range->space->dims < 2) || !laik_layout_is_lex(m->layout))
+            continue;
+
+        bool isPack = (a->type == LAIK_AT_PackToBuf);
+        char* buf = isPack ? ba->toBuf : ba->fromBuf;
+
+        // find ISend/IRecv using the buffer
+        Laik_Action* a2 = as->action;
+        for(unsigned int i2 = 0; i2 < as->actionCount; i2++, a2 = nextAction(a2)) {
+            char** pBuf;
+            MPI_Datatype* pType;
+            if (isPack && (a2->type == LAIK_AT_MpiIsend)) {
+                Laik_A_MpiIsend* aa = (Laik_A_MpiIsend*) a2;
+                if ((aa->buf != buf) || (aa->count != ba->count)) continue;
+                pBuf = &(aa->buf);
+                pType = &(aa->type);
+            }
+            else if (!isPack && (a2->type == LAIK_AT_MpiIrecv)) {
+                Laik_A_MpiIrecv* aa = (Laik_A_MpiIrecv*) a2;
+                if ((aa->buf != buf) || (aa->count != ba->count)) continue;
+                pBuf = &(aa->buf);
+                pType = &(aa->type);
+            }
+            else
+                continue;
+
+            int64_t off = laik_offset(m->layout, m->layoutSection, &(ba->range->from));
+            *pBuf = m->start + off * m->data->elemsize;
+            *pType = getRangeDatatype(m, ba->range,
+                                      &(ra->typeCount), &(ra->type), &keys);
+            a->mark = 1;
+            changed = true;
+            break;
+        }
+    }
+    free(keys);
+    if (!changed) return false;
+
+    a = as->action;
+    for(unsigned int i = 0; i < as->actionCount; i++, a = nextAction(a))
+        if (a->mark == 0)
+            laik_aseq_add(a, as, -1);
+
+    laik_aseq_activateNewActions(as);
+    return true;
+}
+
+// sort key for renumbering requests, see laik_mpi_persistentRequests
+typedef struct {
+    int startRound, waitRound, id;
+} MpiReqOrder;
+
+static
+int cmpReqOrder(const void* p1, const void* p2)
+{
+    const MpiReqOrder* o1 = (const MpiReqOrder*) p1;
+    const MpiReqOrder* o2 = (const MpiReqOrder*) p2;
+    if (o1->startRound != o2->startRound) return o1->startRound - o2->startRound;
+    if (o1->waitRound != o2->waitRound) return o1->waitRound - o2->waitRound;
+    return o1->id - o2->id;
+}
+
+// transformation: create persistent requests for all ISend/IRecv actions
+// once, started by one StartAll action per round (after the last ISend/IRecv
+// of that round). Waits of a round are replaced by one WaitAll action.
+// For this, requests get renumbered such that the ones started/waited for
+// in the same round have consecutive IDs. If not possible, or if a request
+// could be waited for before being started, the sequence is not changed.
+// Must be run after laik_mpi_asyncSendRecv and sorting rounds
+static
+bool laik_mpi_persistentRequests(Laik_ActionSeq* as)
+{
+    // must not have new actions, we want to start a new build
+    assert(as->newActionCount == 0);
+
+    if ((as->actionCount == 0) || (as->action->type != LAIK_AT_MpiReq))
+        return false;
+    Laik_A_MpiReq* ra = (Laik_A_MpiReq*) as->action;
+    assert(ra->persistent == 0);
+    int count = (int) ra->count;
+
+    int maxround = 0;
+    Laik_Action* a = as->action;
+    for(unsigned int i = 0; i < as->actionCount; i++, a = nextAction(a))
+        if (a->round > maxround) maxround = a->round;
+
+    // per round: first new request ID and number of requests started,
+    // still to start (for placing StartAll), and waited for, plus whether
+    // a wait was seen already
+    int rounds = maxround + 1;
+    int* perRound = calloc(6 * rounds, sizeof(int));
+    MpiReqOrder* order = malloc(count * sizeof(MpiReqOrder));
+    int* newID = malloc(count * sizeof(int));
+    if (!perRound || !order || !newID) {
+        laik_panic("Out of memory allocating request order for MPI backend");
+        exit(1); // not actually needed, laik_panic never returns
+    }
+    int* startFirst = perRound;
+    int* startCount = perRound + rounds;
+    int* startLeft  = perRound + 2 * rounds;
+    int* waitFirst  = perRound + 3 * rounds;
+    int* waitCount  = perRound + 4 * rounds;
+    int* waitSeen   = perRound + 5 * rounds;
+
+    for(int i = 0; i < count; i++) {
+        order[i].startRound = -1;
+        order[i].waitRound = -1;
+        order[i].id = i;
+    }
+    bool ok = true;
+    a = as->action;
+    for(unsigned int i = 0; i < as->actionCount; i++, a = nextAction(a)) {
+        int id;
+        switch(a->type) {
+        case LAIK_AT_MpiIsend: id = ((Laik_A_MpiIsend*) a)->req_id; break;
+        case LAIK_AT_MpiIrecv: id = ((Laik_A_MpiIrecv*) a)->req_id; break;
+        case LAIK_AT_MpiWait:
+            id = ((Laik_A_MpiWait*) a)->req_id;
+            assert((id < count) && (order[id].waitRound < 0));
+            order[id].waitRound = a->round;
+            waitSeen[a->round] = 1;
+            continue;
+        default:
+            continue;
+        }
+        assert((id < count) && (order[id].startRound < 0));
+        order[id].startRound = a->round;
+        // StartAll is placed after last start: must not be after a wait
+        if (waitSeen[a->round]) ok = false;
+    }
+
+    qsort(order, count, sizeof(MpiReqOrder), cmpReqOrder);
+    for(int i = 0; ok && (i < count); i++) {
+        MpiReqOrder* o = &(order[i]);
+        assert((o->startRound >= 0) && (o->waitRound >= o->startRound));
+        newID[o->id] = i;
+        // requests started in same round are consecutive due to sorting
+        if (startCount[o->startRound] == 0) startFirst[o->startRound] = i;
+        startCount[o->startRound]++;
+        startLeft[o->startRound]++;
+        if (waitCount[o->waitRound] == 0)
+            waitFirst[o->waitRound] = i;
+        else if (waitFirst[o->waitRound] + waitCount[o->waitRound] != i)
+            ok = false;
+        waitCount[o->waitRound]++;
+    }
+    free(order);
+    if (!ok) {
+        laik_log(1, "MPI backend: waits not groupable, no persistent requests");
+        free(perRound);
+        free(newID);
+        return false;
+    }
+
+    // create persistent requests with new IDs
+    int tag = MSGTAG;
+    Laik_TransitionContext* tc = as->context[0];
+    MPIGroupData* gd = mpiGroupData(tc->transition->group);
+    assert(gd);
+    int err = MPI_SUCCESS;
+    a = as->action;
+    for(unsigned int i = 0; i < as->actionCount; i++, a = nextAction(a)) {
+        tc = as->context[a->tid];
+        Laik_Data* d = tc->data;
+        switch(a->type) {
+        case LAIK_AT_MpiIsend: {
+            Laik_A_MpiIsend* aa = (Laik_A_MpiIsend*) a;
+            aa->req_id = newID[aa->req_id];
+            if (aa->type != MPI_DATATYPE_NULL)
+                err = MPI_Send_init(aa->buf, 1, aa->type, aa->to_rank,
+                                    tag, gd->comm, ra->req + aa->req_id);
+            else
+                err = MPI_Send_init(aa->buf, aa->count, getMPIDataType(d),
+                                    aa->to_rank, tag, gd->comm,
+                                    ra->req + aa->req_id);
+            break;
+        }
+
+        case LAIK_AT_MpiIrecv: {
+            Laik_A_MpiIrecv* aa = (Laik_A_MpiIrecv*) a;
+            aa->req_id = newID[aa->req_id];
+            if (aa->type != MPI_DATATYPE_NULL)
+                err = MPI_Recv_init(aa->buf, 1, aa->type, aa->from_rank,
+                                    tag, gd->comm, ra->req + aa->req_id);
+            else
+                err = MPI_Recv_init(aa->buf, aa->count, getMPIDataType(d),
+                                    aa->from_rank, tag, gd->comm,
+                                    ra->req + aa->req_id);
+            break;
+        }
+
+        default:
+            break;
+        }
+        if (err != MPI_SUCCESS) laik_mpi_panic(err);
+    }
+    ra->persistent = 1;
+    free(newID);
+
+    // rebuild with StartAll/WaitAll actions
+    a = as->action;
+    for(unsigned int i = 0; i < as->actionCount; i++, a = nextAction(a)) {
+        int r = a->round;
+        as->currentTID = a->tid;
+        switch(a->type) {
+        case LAIK_AT_MpiIsend:
+        case LAIK_AT_MpiIrecv:
+            laik_aseq_add(a, as, -1);
+            if (--startLeft[r] == 0)
+                laik_mpi_addMpiReqRange(as, LAIK_AT_MpiStartAll, r,
+                                        startFirst[r], startCount[r]);
+            break;
+
+        case LAIK_AT_MpiWait:
+            // one WaitAll at position of first Wait in round
+            if (waitCount[r] > 0)
+                laik_mpi_addMpiReqRange(as, LAIK_AT_MpiWaitAll, r,
+                                        waitFirst[r], waitCount[r]);
+            waitCount[r] = 0;
+            break;
+
+        default:
+            laik_aseq_add(a, as, -1);
+            break;
+        }
+    }
+    free(perRound);
+
+    laik_aseq_activateNewActions(as);
+    return true;
+}
+
+// return index of graph communicator in <gd> with given neighbors, or -1
+static
+int findNeighborComm(MPIGroupData* gd, int indegree, int outdegree, int* ranks)
+{
+    for(int i = 0; i < gd->nbCommCount; i++) {
+        MPINeighborComm* nc = &(gd->nbComm[i]);
+        if ((nc->indegree != indegree) || (nc->outdegree != outdegree))
+            continue;
+        if (memcmp(nc->ranks, ranks, (indegree + outdegree) * sizeof(int)) == 0)
+            return i;
+    }
+    return -1;
+}
+
+// is action a local one which can be done before/after a neighborhood
+// exchange? Returns 1 for before (packing), 2 for after (unpacking), else 0
+static
+int neighborPhase(Laik_Action* a)
+{
+    switch(a->type) {
+    case LAIK_AT_PackToBuf:
+    case LAIK_AT_MapPackToBuf:
+    case LAIK_AT_CopyToBuf:
+        return 1;
+    case LAIK_AT_UnpackFromBuf:
+    case LAIK_AT_MapUnpackFromBuf:
+    case LAIK_AT_CopyFromBuf:
+        return 2;
+    default:
+        break;
+    }
+    return 0;
+}
+
+// transformation: if sequences of all processes in the group only consist
+// of send/recv actions (at most one per peer) and packing/unpacking, do
+// all send/recv as one MPI_Neighbor_alltoallw with absolute buffer
+// addresses on a graph communicator. This needs agreement of all
+// processes, thus must be called on prepare by all, even with empty
+// sequences. Graph communicators are created on first use for a set of
+// neighbors, and cached in the group. Sets <collective> for the sequence
+static
+bool laik_mpi_neighborExchange(Laik_ActionSeq* as)
+{
+    // must not have new actions, we want to start a new build
+    assert(as->newActionCount == 0);
+
+    Laik_TransitionContext* tc = as->context[0];
+    Laik_Group* g = tc->transition->group;
+    if (g->myid < 0) return false;
+    MPIGroupData* gd = mpiGroupData(g);
+    assert(gd);
+
+    // position of peers in destinations/sources (+1, 0 for none)
+    int* sendPos = calloc(2 * g->size, sizeof(int));
+    if (!sendPos) {
+        laik_panic("Out of memory allocating neighbor array for MPI backend");
+        exit(1); // not actually needed, laik_panic never returns
+    }
+    int* recvPos = sendPos + g->size;
+
+    bool ok = true;
+    int sendCount = 0, recvCount = 0;
+    Laik_Action* a = as->action;
+    for(unsigned int i = 0; i < as->actionCount; i++, a = nextAction(a)) {
+        if (a->type == LAIK_AT_BufSend) {
+            int to = ((Laik_A_BufSend*) a)->to_rank;
+            if (sendPos[to]) ok = false;
+            sendPos[to] = 1;
+            sendCount++;
+        }
+        else if (a->type == LAIK_AT_BufRecv) {
+            int from = ((Laik_A_BufRecv*) a)->from_rank;
+            if (recvPos[from]) ok = false;
+            recvPos[from] = 1;
+            recvCount++;
+        }
+        else if ((a->type != LAIK_AT_Nop) && (neighborPhase(a) == 0))
+            ok = false;
+    }
+
+    // neighbors: sources followed by destinations, both ascending
+    int* ranks = malloc((recvCount + sendCount + 1) * sizeof(int));
+    if (!ranks) {
+        laik_panic("Out of memory allocating neighbor array for MPI backend");
+        exit(1); // not actually needed, laik_panic never returns
+    }
+    int sources = 0, dests = 0;
+    for(int r = 0; r < g->size; r++) {
+        if (recvPos[r]) recvPos[r] = ++sources;
+        if (sendPos[r]) sendPos[r] = ++dests;
+    }
+    sources = 0;
+    dests = 0;
+    for(int r = 0; r < g->size; r++) {
+        if (recvPos[r]) ranks[sources++] = r;
+        if (sendPos[r]) ranks[recvCount + dests++] = r;
+    }
+
+    // agree on use (only if any process communicates), and on communicator
+    // to use (same index for all)
+    int idx = ok ? findNeighborComm(gd, recvCount, sendCount, ranks) : -1;
+    int v[4] = { ok ? 1 : 0, idx, -idx, (sendCount + recvCount > 0) ? -1 : 0 };
+    int err = MPI_Allreduce(MPI_IN_PLACE, v, 4, MPI_INT, MPI_MIN, gd->comm);
+    if (err != MPI_SUCCESS) laik_mpi_panic(err);
+    if ((v[0] == 0) || (v[3] == 0)) {
+        laik_log(1, "MPI backend: no neighborhood exchange %s",
+                 (v[0] == 0) ? "possible" : "needed");
+        free(ranks);
+        free(sendPos);
+        return false;
+    }
+    if ((v[1] < 0) || (v[1] != -v[2])) {
+        // not found in all processes: create new communicator.
+        // Use weights of 1 instead of MPI_UNWEIGHTED, which is a sentinel
+        // pointer gcc warns about (read from zero-size region) and must be
+        // given by all processes. Arrays are never empty (one extra entry),
+        // as processes may have no sources or destinations
+        int maxCount = (recvCount > sendCount) ? recvCount : sendCount;
+        int* weights = malloc((maxCount + 1) * sizeof(int));
+        if (!weights) {
+            laik_panic("Out of memory allocating neighbor weights for MPI backend");
+            exit(1); // not actually needed, laik_panic never returns
+        }
+        for(int i = 0; i <= maxCount; i++)
+            weights[i] = 1;
+        MPI_Comm comm;
+        err = MPI_Dist_graph_create_adjacent(gd->comm,
+                                             recvCount, ranks, weights,
+                                             sendCount, ranks + recvCount,
+                                             weights, MPI_INFO_NULL,
+                                             0, &comm);
+        free(weights);
+        if (err != MPI_SUCCESS) laik_mpi_panic(err);
+        gd->nbComm = realloc(gd->nbComm,
+                             (gd->nbCommCount + 1) * sizeof(MPINeighborComm));
+        if (!gd->nbComm) {
+            laik_panic("Out of memory allocating MPINeighborComm object");
+            exit(1); // not actually needed, laik_panic never returns
+        }
+        idx = gd->nbCommCount++;
+        gd->nbComm[idx].comm = comm;
+        gd->nbComm[idx].indegree = recvCount;
+        gd->nbComm[idx].outdegree = sendCount;
+        gd->nbComm[idx].ranks = ranks;
+        laik_log(1, "MPI backend: new graph comm %d (%d sources, %d destinations)",
+                 idx, recvCount, sendCount);
+    }
+    else {
+        assert(idx == v[1]);
+        free(ranks);
+    }
+
+    // arrays for neighbor action: destinations followed by sources
+    int n = sendCount + recvCount;
+    int* count = malloc((n + 1) * sizeof(int));
+    MPI_Aint* addr = malloc((n + 1) * sizeof(MPI_Aint));
+    MPI_Datatype* type = malloc((n + 1) * sizeof(MPI_Datatype));
+    if (!count || !addr || !type) {
+        laik_panic("Out of memory allocating neighbor arrays for MPI backend");
+        exit(1); // not actually needed, laik_panic never returns
+    }
+
+    // packing before exchange, unpacking after
+    a = as->action;
+    for(unsigned int i = 0; i < as->actionCount; i++, a = nextAction(a)) {
+        tc = as->context[a->tid];
+        int j;
+        char* buf;
+        if (a->type == LAIK_AT_BufSend) {
+            Laik_A_BufSend* aa = (Laik_A_BufSend*) a;
+            j = sendPos[aa->to_rank] - 1;
+            count[j] = aa->count;
+            buf = aa->buf;
+        }
+        else if (a->type == LAIK_AT_BufRecv) {
+            Laik_A_BufRecv* aa = (Laik_A_BufRecv*) a;
+            j = sendCount + recvPos[aa->from_rank] - 1;
+            count[j] = aa->count;
+            buf = aa->buf;
+        }
+        else {
+            if (neighborPhase(a) == 1)
+                laik_aseq_add(a, as, 0);
+            continue;
+        }
+        err = MPI_Get_address(buf, &(addr[j]));
+        if (err != MPI_SUCCESS) laik_mpi_panic(err);
+        type[j] = getMPIDataType(tc->data);
+    }
+    free(sendPos);
+
+    as->currentTID = 0;
+    Laik_A_MpiNeighbor* na;
+    na = (Laik_A_MpiNeighbor*) laik_aseq_addAction(as, sizeof(*na),
+                                                   LAIK_AT_MpiNeighbor, 1, 0);
+    na->comm = idx;
+    na->sendCount = sendCount;
+    na->recvCount = recvCount;
+    na->count = count;
+    na->addr = addr;
+    na->type = type;
+
+    a = as->action;
+    for(unsigned int i = 0; i < as->actionCount; i++, a = nextAction(a))
+        if (neighborPhase(a) == 2)
+            laik_aseq_add(a, as, 2);
+
+    laik_aseq_activateNewActions(as);
+    as->collective = true;
+    return true;
+}
+
 static
 void laik_mpi_prepare(Laik_ActionSeq* as)
 {
@@ -1003,7 +1839,13 @@ void laik_mpi_prepare(Laik_ActionSeq* as)
     bool changed = laik_aseq_splitTransitionExecs(as);
     laik_log_ActionSeqIfChanged(changed, as, "After splitting transition execs");
     if (as->actionCount == 0) {
+        // may need to take part in a neighborhood exchange nevertheless
+        if (mpi_neighbor) {
+            changed = laik_mpi_neighborExchange(as);
+            laik_log_ActionSeqIfChanged(changed, as, "After using neighborhood exchange");
+        }
         laik_aseq_calc_stats(as);
+        laik_mpi_aseq_calc_stats(as);
         return;
     }
 
@@ -1042,12 +1884,31 @@ void laik_mpi_prepare(Laik_ActionSeq* as)
     //changed = laik_aseq_sort_rankdigits(as);
     laik_log_ActionSeqIfChanged(changed, as, "After sorting for deadlock avoidance");
 
-    if (mpi_async) {
+    changed = laik_aseq_avoidPacking(as);
+    laik_log_ActionSeqIfChanged(changed, as, "After avoiding packing");
+
+    if (mpi_neighbor) {
+        changed = laik_mpi_neighborExchange(as);
+        laik_log_ActionSeqIfChanged(changed, as, "After using neighborhood exchange");
+    }
+
+    if (mpi_async && !as->collective) {
         changed = laik_mpi_asyncSendRecv(as);
         laik_log_ActionSeqIfChanged(changed, as, "After makeing send/recv async");
 
+        if (mpi_datatypes) {
+            changed = laik_mpi_useDatatypes(as);
+            laik_log_ActionSeqIfChanged(changed, as, "After using derived datatypes");
+        }
+
         changed = laik_aseq_sort_rounds(as);
         laik_log_ActionSeqIfChanged(changed, as, "After sorting rounds 2");
+
+        // setting up persistent requests only pays off on re-execution
+        if (mpi_persistent && as->reused) {
+            changed = laik_mpi_persistentRequests(as);
+            laik_log_ActionSeqIfChanged(changed, as, "After using persistent requests");
+        }
     }
     laik_aseq_freeTempSpace(as);
 
@@ -1067,8 +1928,23 @@ static void laik_mpi_cleanup(Laik_ActionSeq* as)
 
     if ((as->actionCount > 0) && (as->action->type == LAIK_AT_MpiReq)) {
         Laik_A_MpiReq* aa = (Laik_A_MpiReq*) as->action;
+        if (aa->persistent)
+            for(unsigned int i = 0; i < aa->count; i++)
+                MPI_Request_free(&(aa->req[i]));
         free(aa->req);
         laik_log(1, "  freed MPI_Request array with %d entries", aa->count);
+        for(unsigned int i = 0; i < aa->typeCount; i++)
+            MPI_Type_free(&(aa->type[i]));
+        free(aa->type);
+    }
+
+    Laik_Action* a = as->action;
+    for(unsigned int i = 0; i < as->actionCount; i++, a = nextAction(a)) {
+        if (a->type != LAIK_AT_MpiNeighbor) continue;
+        Laik_A_MpiNeighbor* aa = (Laik_A_MpiNeighbor*) a;
+        free(aa->count);
+        free(aa->addr);
+        free(aa->type);
     }
 }
 
@@ -1076,6 +1952,118 @@ static void laik_mpi_cleanup(Laik_ActionSeq* as)
 //----------------------------------------------------------------------------
 // KV store
 
+// send change journal <c> to <to>
+static void kvs_send_changes(Laik_KVS_Changes* c, int to, MPI_Comm comm)
+{
+    int count[2];
+    count[0] = c->offUsed;
+    assert((count[0] == 0) || ((count[0] & 1) == 1)); // 0 or odd number of offsets
+    count[1] = c->dataUsed;
+    laik_log(1, "MPI sync: sending %d changes (total %d chars) to T%d",
+             count[0] / 2, count[1], to);
+    int err = MPI_Send(count, 2, MPI_INTEGER, to, 0, comm);
+    if (err != MPI_SUCCESS) laik_mpi_panic(err);
+    if (count[0] == 0) {
+        assert(count[1] == 0);
+        return;
+    }
+    err = MPI_Send(c->off, count[0], MPI_INTEGER, to, 0, comm);
+    if (err != MPI_SUCCESS) laik_mpi_panic(err);
+    err = MPI_Send(c->data, count[1], MPI_CHAR, to, 0, comm);
+    if (err != MPI_SUCCESS) laik_mpi_panic(err);
+}
+
+// receive change journal from <from> into <c> and sort it
+static void kvs_recv_changes(Laik_KVS_Changes* c, int from, MPI_Comm comm)
+{
+    MPI_Status status;
+    int count[2];
+    int err = MPI_Recv(count, 2, MPI_INTEGER, from, 0, comm, &status);
+    if (err != MPI_SUCCESS) laik_mpi_panic(err);
+    laik_log(1, "MPI sync: getting %d changes (total %d chars) from T%d",
+             count[0] / 2, count[1], from);
+    laik_kvs_changes_set_size(c, 0, 0); // fresh reuse
+    if (count[0] == 0) {
+        assert(count[1] == 0);
+        return;
+    }
+    assert(count[1] > 0);
+    laik_kvs_changes_ensure_size(c, count[0], count[1]);
+    err = MPI_Recv(c->off, count[0], MPI_INTEGER, from, 0, comm, &status);
+    if (err != MPI_SUCCESS) laik_mpi_panic(err);
+    err = MPI_Recv(c->data, count[1], MPI_CHAR, from, 0, comm, &status);
+    if (err != MPI_SUCCESS) laik_mpi_panic(err);
+    laik_kvs_changes_set_size(c, count[0], count[1]);
+    laik_kvs_changes_sort(c);
+}
+
+// KVS sync with O(log P) steps: sorted change journals are merged along a
+// binomial tree towards T0, with identical changes from different processes
+// merged into one. The result is broadcast, and each process only applies
+// changes not done by itself
+static void kvs_sync_tree(Laik_KVStore* kvs, MPI_Comm comm)
+{
+    Laik_Group* world = kvs->inst->world;
+    int myid = world->myid;
+    int err;
+
+    // own changes, sorted: used for merging and to skip them when applying
+    Laik_KVS_Changes* own = &(kvs->changes);
+    laik_kvs_changes_sort(own);
+
+    Laik_KVS_Changes recvd, merged[2];
+    laik_kvs_changes_init(&recvd);
+    laik_kvs_changes_init(&merged[0]);
+    laik_kvs_changes_init(&merged[1]);
+
+    // reduction: in step with distance <mask>, processes with that bit
+    // set send their merged changes to partner and are done
+    Laik_KVS_Changes* cur = own;
+    for(int mask = 1; mask < world->size; mask <<= 1) {
+        if (myid & mask) {
+            kvs_send_changes(cur, myid - mask, comm);
+            break;
+        }
+        if (myid + mask >= world->size) continue;
+
+        kvs_recv_changes(&recvd, myid + mask, comm);
+        if (recvd.entryUsed == 0) continue;
+        Laik_KVS_Changes* dst = (cur == &merged[0]) ? &merged[1] : &merged[0];
+        laik_kvs_changes_merge(dst, cur, &recvd);
+        cur = dst;
+    }
+
+    // broadcast merged changes from T0 (already sorted)
+    int count[2];
+    if (myid == 0) {
+        count[0] = cur->offUsed;
+        count[1] = cur->dataUsed;
+    }
+    err = MPI_Bcast(count, 2, MPI_INTEGER, 0, comm);
+    if (err != MPI_SUCCESS) laik_mpi_panic(err);
+    laik_log(1, "MPI sync: %d merged changes (total %d chars) in broadcast",
+             count[0] / 2, count[1]);
+    if (count[0] > 0) {
+        if (myid > 0) {
+            cur = &recvd;
+            laik_kvs_changes_set_size(cur, 0, 0);
+            laik_kvs_changes_ensure_size(cur, count[0], count[1]);
+        }
+        err = MPI_Bcast(cur->off, count[0], MPI_INTEGER, 0, comm);
+        if (err != MPI_SUCCESS) laik_mpi_panic(err);
+        err = MPI_Bcast(cur->data, count[1], MPI_CHAR, 0, comm);
+        if (err != MPI_SUCCESS) laik_mpi_panic(err);
+        if (myid > 0) {
+            laik_kvs_changes_set_size(cur, count[0], count[1]);
+            laik_kvs_changes_sort(cur);
+        }
+        laik_kvs_changes_apply_other(cur, own, kvs);
+    }
+
+    laik_kvs_changes_free(&recvd);
+    laik_kvs_changes_free(&merged[0]);
+    laik_kvs_changes_free(&merged[1]);
+}
 
 static void laik_mpi_sync(Laik_KVStore* kvs)
 {
@@ -1087,6 +2075,11 @@ static void laik_mpi_sync(Laik_KVStore* kvs)
     int count[2] = {0,0};
     int err;
 
+    if (mpi_kvstree) {
+        kvs_sync_tree(kvs, comm);
+        return;
+    }
+
     if (myid > 0) {
         // send to master, receive from master
         count[0] = (int) kvs->changes.offUsed;
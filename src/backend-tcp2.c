@@ -25,9 +25,20 @@
  *
  * For acceptable performance, a binary mode for data is supported but needs
  * to be announced at registration time, so it is easy to fall back to ASCII
- * with nc/telnet. Also, data packages are only accepted if permission is given
- * by receiver. This enables immediate consumption of all messages without
- * blocking.
+ * with nc/telnet. Data transfers use credit-based flow control: at start of
+ * an action sequence, receivers post all their receives and grant the senders
+ * credits for large transfers, one "allowsend" line each. Large data is only
+ * sent with a credit, small data (up to LAIK_TCP2_EAGER bytes, which must be
+ * the same in all processes) is sent eagerly and buffered by the receiver if no
+ * matching receive is posted yet. Writes never block without consuming
+ * incoming data, so there is no need for lock-step send/receive ordering.
+ *
+ * Binary data is sent as one frame per range: 'B' followed by the transfer
+ * tag as 32-bit and the payload length as 64-bit little-endian integer,
+ * followed by the payload. The payload is sent directly from mapping memory
+ * via writev() if rows are large enough, otherwise it is packed in chunks via
+ * the layout pack function. If the receiving range is contiguous in memory,
+ * the receiver reads the payload directly into the mapping.
  *
  * Startup (master)
  * - master process (location ID 0) is the process started on LAIK_TCP2_HOST
@@ -131,9 +142,15 @@
  * - if no connection exists yet
  *     - receiver always waits to be connected
  *     - sender connects to listening port of receiver, sends "myid <id>\n"
- * - when receiver reaches application phase where it wants to receive the data,
- *   it give permission via "allowdata"
- * - sender sends "data <container name> <start index> <element count> <value>"
+ * - each transfer between two processes is identified by a tag: a counter
+ *   per direction, separate for point-to-point transfers and transfers
+ *   within collective operations (with highest bit set). As both sides
+ *   execute the same transfers in same order, tags match
+ * - receiver posts receives and gives permission via
+ *   "allowsend <tag> <element count> <element size>"
+ * - sender sends a binary frame (see above), or in ASCII mode one command
+ *   "data <element size> (<tag>:<element number>:<index>) <hex bytes>"
+ *   per element
  * - connections can be used bidirectionally
  *
  * KVS Sync:
@@ -167,6 +184,7 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <arpa/inet.h>
 #include <netinet/tcp.h>
 // for VSC to see def of addrinfo
@@ -182,7 +200,16 @@
 #define MAX_PEERS 256
 #define MAX_FDS 256
 // receive buffer length
-#define RBUF_LEN 8*1024
+#define RBUF_LEN 64*1024
+// header of binary data frame: 'B' + 4 bytes tag + 8 bytes length
+#define BIN_HEADER_LEN 13
+// default for maximal size of data sent eagerly, without credit (bytes)
+#define TCP2_EAGER_BYTES 64*1024
+
+// transfer tags: highest bit set for transfers in collective operations
+#define TAG_P2P  0
+#define TAG_COLL 1
+#define TAG_MASK 0x7fffffff
 
 // forward decl
 void tcp2_exec(Laik_ActionSeq* as);
@@ -190,6 +217,7 @@ void tcp2_sync(Laik_KVStore* kvs);
 Laik_Group* tcp2_resize(Laik_ResizeRequests*);
 void tcp2_finish_resize();
 void tcp2_make_progress();
+void tcp2_finalize(Laik_Instance*);
 
 typedef struct _InstData InstData;
 
@@ -200,7 +228,8 @@ static Laik_Backend laik_backend = {
     .sync = tcp2_sync,
     .resize = tcp2_resize,
     .finish_resize = tcp2_finish_resize,
-    .make_progress = tcp2_make_progress
+    .make_progress = tcp2_make_progress,
+    .finalize = tcp2_finalize
 };
 
 static Laik_Instance* instance = 0;
@@ -233,6 +262,31 @@ typedef enum _PeerState {
     PS_InResizeRemove3 // master: peer marked for removal, got confirmation
 } PeerState;
 
+// a receive from a peer into a range of a mapping, or a buffer with data
+// received before a matching receive was posted (unexpected data)
+typedef struct _Recv {
+    uint32_t tag;  // transfer tag
+    int count;     // element count in receive
+    int elemsize;  // expected byte count per element
+    int off;       // receive offset (elements)
+    uint64_t bytes; // bytes received
+    bool credited; // credit given to sender (or not needed)?
+    char* direct;  // if set, range is contiguous in memory at this address
+    char* ubuf;    // buffer for unexpected data (then also <direct>)
+    Laik_Type* type; // element type, for reductions
+    Laik_Mapping* map; // mapping to write received data to (0 if <direct>)
+    Laik_Range* range; // range to write received data to
+    Laik_Index idx; // index representing receive progress
+    Laik_ReductionOperation ro; // reduction with existing value
+} Recv;
+
+// credit for sending data with given tag to a peer
+typedef struct _Credit {
+    uint32_t tag;
+    int count;     // element count allowed to send
+    int elemsize;  // byte count expected per element
+} Credit;
+
 // communicating peer
 // can be connected (fd >=0) or not
 typedef struct _Peer {
@@ -245,18 +299,19 @@ typedef struct _Peer {
     // capabilities
     bool accepts_bin_data; // accepts binary data
 
-    // data we are currently receiving from peer
-    int rcount;    // element count in receive
-    int relemsize; // expected byte count per element
-    int roff;      // receive offset
-    Laik_Mapping* rmap; // mapping to write received data to
-    Laik_Range* rcv_range; // range to write received data to
-    Laik_Index rcv_idx; // index representing receive progress
-    Laik_ReductionOperation rro; // reduction with existing value
+    // next tags for transfers to/from peer (point-to-point, collective)
+    uint32_t stag[2], rtag[2];
 
-    // allowed to send data to peer?
-    int scount;    // element count allowed to send, 0 if not
-    int selemsize; // byte count expected per element
+    // posted receives, no data received yet
+    int rq_used, rq_size;
+    Recv* rq;
+    // completely received data without posted receive yet
+    int uq_used, uq_size;
+    Recv* uq;
+
+    // credits for sending data to peer
+    int cr_used, cr_size;
+    Credit* cr;
 
     // info on early-entered resize phase (only used at master)
     int phase, epoch;
@@ -274,7 +329,10 @@ typedef struct {
     int rbuf_used;
     char* rbuf;
     // if > 0 we are in binary data receive mode, outstanding bytes
-    int outstanding_bin;
+    int64_t outstanding_bin;
+    // data we are currently receiving via this connection
+    bool ractive;
+    Recv rcur;
 } FDState;
 
 struct _InstData {
@@ -288,6 +346,9 @@ struct _InstData {
     int phase;        // current phase
     int epoch;        // current epoch
     bool accept_bin_data; // configured to accept binary data
+    int sockbuf;      // socket buffer size to set, 0 for OS default
+    int eager;        // max. bytes sent without credit
+    int rpending;     // number of posted receives not yet completed
 
     // event loop
     int maxfds;       // highest fd in rset
@@ -463,6 +524,7 @@ void add_rfd(InstData* d, int fd, loop_cb_t cb)
     d->fds[fd].rbuf = malloc(RBUF_LEN);
     d->fds[fd].rbuf_used = 0;
     d->fds[fd].outstanding_bin = 0;
+    d->fds[fd].ractive = false;
 }
 
 void rm_rfd(InstData* d, int fd)
@@ -477,6 +539,12 @@ void rm_rfd(InstData* d, int fd)
     d->fds[fd].state = PS_Invalid;
     free(d->fds[fd].rbuf);
     d->fds[fd].rbuf = 0;
+    if (d->fds[fd].ractive) {
+        // connection closed while receiving
+        laik_log(LAIK_LL_Warning, "TCP2 FD %d closed in middle of receive", fd);
+        free(d->fds[fd].rcur.ubuf);
+        d->fds[fd].ractive = false;
+    }
 }
 
 // run event loop until an event handler asks to exit
@@ -551,6 +619,17 @@ bool check_local(char* host)
     return (p != 0);
 }
 
+// set socket buffer sizes of <fd> if configured via LAIK_TCP2_SOCKBUF.
+// To be effective, this must be done before connect() / listen()
+void set_sockbuf(InstData* d, int fd)
+{
+    if (d->sockbuf <= 0) return;
+    if ((setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &(d->sockbuf), sizeof(int)) < 0) ||
+        (setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &(d->sockbuf), sizeof(int)) < 0))
+        laik_log(LAIK_LL_Warning, "TCP2 cannot set socket buffer size %d",
+                 d->sockbuf);
+}
+
 // forward decl
 void got_bytes(InstData* d, int fd);
 void send_cmd(InstData* d, int lid, char* cmd);
@@ -591,6 +670,7 @@ void ensure_conn(InstData* d, int lid)
     for(p = info; p; p = p->ai_next) {
         fd = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
         if (fd == -1) continue;
+        set_sockbuf(d, fd);
         if (connect(fd, p->ai_addr, p->ai_addrlen) == 0) break;
         close(fd);
     }
@@ -659,91 +739,456 @@ void send_cmd(InstData* d, int lid, char* cmd)
 
     if (res < 0) {
         int e = errno;
-        laik_log(LAIK_LL_Panic, "TCP2 write error on FD %d: %s\n",
+        // connections without LID may already be closed by other side,
+        // e.g. a peer which only sent data and finished
+        laik_log((lid < 0) ? 1 : LAIK_LL_Panic, "TCP2 write error on FD %d: %s\n",
                  fd, strerror(e));
     }
 }
 
-void send_bin(InstData* d, int lid, char* buf, int len)
+// wait until <fd> becomes writable, meanwhile handling incoming data and
+// commands. Data from peers concurrently sending to us gets consumed, so
+// there is no deadlock with both sides writing
+static
+void wait_writable(InstData* d, int fd)
+{
+    fd_set rset = d->rset;
+    fd_set wset;
+    FD_ZERO(&wset);
+    FD_SET(fd, &wset);
+    int maxfd = (fd > d->maxfds) ? fd : d->maxfds;
+    if (select(maxfd + 1, &rset, &wset, 0, 0) < 0) return;
+    for(int i = 0; i <= d->maxfds; i++)
+        if (FD_ISSET(i, &rset)) {
+            assert(d->fds[i].cb != 0);
+            (d->fds[i].cb)(d, i);
+        }
+}
+
+// send binary data given as <iovcnt> buffers in <iov> to peer <lid>.
+// <iov> gets modified on partial writes
+void send_binv(InstData* d, int lid, struct iovec* iov, int iovcnt)
 {
     ensure_conn(d, lid);
     if (d->peer[lid].state == PS_Error) {
-        laik_log(1, "TCP2 Send bin (len %d) to LID %d: Cannot send, broken connection\n",
-                 len, lid);
+        laik_log(1, "TCP2 Send bin (%d buffers) to LID %d: Cannot send, broken connection\n",
+                 iovcnt, lid);
         return;
     }
 
     int fd = d->peer[lid].fd;
-    laik_log(1, "TCP2 Sent bin (len %d) to LID %d (FD %d)\n",
-             len, lid, fd);
+    if (laik_log_begin(1)) {
+        size_t len = 0;
+        for(int i = 0; i < iovcnt; i++) len += iov[i].iov_len;
+        laik_log_flush("TCP2 Sent bin (len %lu, %d buffers) to LID %d (FD %d)\n",
+                       (unsigned long) len, iovcnt, lid, fd);
+    }
+
+    // cope with partial writes and errors. Never block in write, but
+    // handle incoming data while waiting for the socket to become writable
+    while(iovcnt > 0) {
+        struct msghdr mh;
+        memset(&mh, 0, sizeof(mh));
+        mh.msg_iov = iov;
+        mh.msg_iovlen = iovcnt;
+        ssize_t res = sendmsg(fd, &mh, MSG_DONTWAIT);
+        if (res < 0) {
+            if (errno == EINTR) continue;
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+                wait_writable(d, fd);
+                continue;
+            }
+            int e = errno;
+            laik_log(LAIK_LL_Panic, "TCP2 write error on FD %d: %s\n",
+                     fd, strerror(e));
+            return;
+        }
+        // skip fully written buffers, adjust partially written one
+        while((iovcnt > 0) && ((size_t) res >= iov->iov_len)) {
+            res -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char*) iov->iov_base + res;
+            iov->iov_len -= res;
+        }
+    }
+}
 
-    // cope with partial writes and errors
-    int res, written = 0;
-    while(written < len) {
-        res = write(fd, buf + written, len - written);
-        if (res < 0) break;
-        written += res;
+void send_bin(InstData* d, int lid, char* buf, int len)
+{
+    struct iovec iov = { .iov_base = buf, .iov_len = len };
+    send_binv(d, lid, &iov, 1);
+}
+
+
+// transfer state with peers
+
+void init_transfers(Peer* p)
+{
+    p->stag[TAG_P2P] = p->stag[TAG_COLL] = 0;
+    p->rtag[TAG_P2P] = p->rtag[TAG_COLL] = 0;
+    p->rq_used = p->rq_size = 0;
+    p->rq = 0;
+    p->uq_used = p->uq_size = 0;
+    p->uq = 0;
+    p->cr_used = p->cr_size = 0;
+    p->cr = 0;
+}
+
+// return tag of next transfer of class <cls> (TAG_P2P/TAG_COLL),
+// using counters <tags>. Counters are incremented by caller
+static
+uint32_t get_tag(uint32_t* tags, int cls)
+{
+    uint32_t tag = tags[cls] & TAG_MASK;
+    return (cls == TAG_COLL) ? (tag | ~TAG_MASK) : tag;
+}
+
+// append an entry to array <arr> of receives, growing it if needed
+static
+Recv* append_recv(Recv** arr, int* used, int* size)
+{
+    if (*used == *size) {
+        *size = (*size == 0) ? 8 : 2 * (*size);
+        *arr = realloc(*arr, *size * sizeof(Recv));
+        if (*arr == 0) {
+            laik_panic("TCP2 out of memory allocating receive queue");
+            exit(1); // not actually needed, laik_panic never returns
+        }
     }
-    if (res < 0) {
-        int e = errno;
-        laik_log(LAIK_LL_Panic, "TCP2 write error on FD %d: %s\n",
-                 fd, strerror(e));
+    return &((*arr)[(*used)++]);
+}
+
+// return index of receive with <tag> in array <arr>, -1 if not found
+static
+int find_recv(Recv* arr, int used, uint32_t tag)
+{
+    for(int i = 0; i < used; i++)
+        if (arr[i].tag == tag) return i;
+    return -1;
+}
+
+// remove entry <i> from array <arr> of receives (order is not kept)
+static
+void remove_recv(Recv* arr, int* used, int i)
+{
+    assert((i >= 0) && (i < *used));
+    (*used)--;
+    arr[i] = arr[*used];
+}
+
+// return number of elements in range of receive <r> which are
+// consecutive in memory, starting at current receive index
+static
+int rcv_run_length(Recv* r)
+{
+    if (!laik_layout_is_lex(r->map->layout)) return 1;
+    // lex layout: up to end of row
+    return (int) (r->range->to.i[0] - r->idx.i[0]);
+}
+
+// consume binary data in <buf> for receive <r>.
+// Only whole elements are consumed, unless the receive range is contiguous.
+// Return number of consumed bytes
+static
+int recv_consume(Recv* r, char* buf, int len)
+{
+    int esize = r->elemsize;
+    uint64_t rsize = (uint64_t) r->count * esize;
+    int consumed = 0;
+    int n = (len / esize);
+    if (n > r->count - r->off) n = r->count - r->off;
+    if (r->direct) {
+        if (r->ro == LAIK_RO_None) {
+            // contiguous range: copy bytes directly
+            consumed = len;
+            if (r->bytes + consumed > rsize) consumed = (int) (rsize - r->bytes);
+            memcpy(r->direct + r->bytes, buf, consumed);
+            r->bytes += consumed;
+            r->off = (int) (r->bytes / esize);
+            return consumed;
+        }
+        // contiguous range: reduce all complete elements with existing values
+        char* ptr = r->direct + r->bytes;
+        (r->type->reduce)(ptr, ptr, buf, n, r->ro);
+        consumed = n * esize;
+        r->off += n;
+        r->bytes += consumed;
+        return consumed;
     }
+
+    Laik_Mapping* m = r->map;
+    assert(m != 0);
+    if (r->ro == LAIK_RO_None) {
+        // unpack all complete elements
+        if (n > 0) {
+            n = (m->layout->unpack)(m, r->range, &(r->idx), buf, n * esize);
+            consumed = n * esize;
+            r->off += n;
+        }
+    }
+    else {
+        // reduction with existing values, done for consecutive elements
+        Laik_Type* t = r->type;
+        Laik_Layout* ll = m->layout;
+        while(n > 0) {
+            int c = rcv_run_length(r);
+            if (c > n) c = n;
+            int64_t off = ll->offset(ll, m->layoutSection, &(r->idx));
+            char* idxPtr = m->start + off * esize;
+            (t->reduce)(idxPtr, idxPtr, buf + consumed, c, r->ro);
+            consumed += c * esize;
+            r->off += c;
+            n -= c;
+            // advance index: last element of run, then traverse to next
+            r->idx.i[0] += c - 1;
+            next_lex(r->range, &(r->idx));
+        }
+    }
+    r->bytes += consumed;
+    assert(r->off <= r->count);
+    return consumed;
 }
 
-int got_binary_data(InstData* d, int lid, char* buf, int len)
+// consume buffered unexpected data <u> for receive <r>, free buffer
+static
+void recv_from_buffer(Recv* r, Recv* u)
 {
-    laik_log(1, "TCP2 got binary data (from LID %d, len %d)", lid, len);
+    if ((uint64_t) u->count != (uint64_t) r->count * r->elemsize) {
+        laik_log(LAIK_LL_Panic, "TCP2 got %d bytes for tag %x, expected %d x %d",
+                 u->count, r->tag, r->count, r->elemsize);
+        exit(1);
+    }
+    int consumed = recv_consume(r, u->ubuf, u->count);
+    assert(consumed == u->count);
+    free(u->ubuf);
+}
 
+// current receive via connection <fd> is completed
+static
+void recv_done(InstData* d, int fd)
+{
+    int lid = d->fds[fd].lid;
     Peer* p = &(d->peer[lid]);
-    if ((p->rcount == 0) || (p->rcount == p->roff)) {
-        laik_log(LAIK_LL_Warning, "TCP2 ignoring data from LID %d without send permission", lid);
-        return len;
+    Recv* r = &(d->fds[fd].rcur);
+    assert(d->fds[fd].ractive && (r->bytes == (uint64_t) r->count * r->elemsize));
+    d->fds[fd].ractive = false;
+    d->exit = 1;
+
+    if (r->ubuf == 0) {
+        laik_log(1, "TCP2 receive from LID %d (tag %x) done", lid, r->tag);
+        d->rpending--;
+        return;
     }
 
-    int esize = p->relemsize;
-    Laik_Mapping* m = p->rmap;
-    assert(m != 0);
-    Laik_Layout* ll = m->layout;
-    bool inTraversal = true;
-    int consumed = 0;
-    while(len - consumed >= esize) {
-        assert(inTraversal);
-        int64_t off = ll->offset(ll, m->layoutSection, &(p->rcv_idx));
-        char* idxPtr = m->start + off * p->relemsize;
-        if (p->rro == LAIK_RO_None)
-            memcpy(idxPtr, buf, esize);
-        else {
-            Laik_Type* t = p->rmap->data->type;
-            assert(t->reduce);
-            (t->reduce)(idxPtr, idxPtr, buf, 1, p->rro);
+    // unexpected data: matching receive posted meanwhile?
+    int i = find_recv(p->rq, p->rq_used, r->tag);
+    if (i >= 0) {
+        laik_log(1, "TCP2 receive from LID %d (tag %x) done via buffer", lid, r->tag);
+        recv_from_buffer(&(p->rq[i]), r);
+        remove_recv(p->rq, &(p->rq_used), i);
+        d->rpending--;
+        return;
+    }
+    laik_log(1, "TCP2 buffered unexpected data from LID %d (tag %x, %d bytes)",
+             lid, r->tag, r->count);
+    *append_recv(&(p->uq), &(p->uq_used), &(p->uq_size)) = *r;
+}
+
+// binary frame with <len> bytes for transfer <tag> starts on connection <fd>:
+// make matching posted receive the current one, or buffer unexpected data
+static
+void start_frame(InstData* d, int fd, uint32_t tag, uint64_t len)
+{
+    int lid = d->fds[fd].lid;
+    Peer* p = &(d->peer[lid]);
+    assert(!d->fds[fd].ractive);
+    Recv* r = &(d->fds[fd].rcur);
+    int i = find_recv(p->rq, p->rq_used, tag);
+    if (i >= 0) {
+        *r = p->rq[i];
+        remove_recv(p->rq, &(p->rq_used), i);
+        if (len != (uint64_t) r->count * r->elemsize) {
+            laik_log(LAIK_LL_Panic, "TCP2 got %llu bytes from LID %d for tag %x, expected %d x %d",
+                     (unsigned long long) len, lid, tag, r->count, r->elemsize);
+            exit(1);
         }
-        if ((esize == 8) && laik_log_begin(1)) {
-            char pstr[70];
-            int dims = p->rcv_range->space->dims;
-            sprintf(pstr, "(%d:%s)", p->roff, istr(dims, &(p->rcv_idx)));
-            laik_log(1, " pos %s: in %f res %f\n", pstr, *((double*)buf), *((double*)idxPtr));
+    }
+    else {
+        // no receive posted yet: buffer data
+        if (len > (uint64_t) d->eager) {
+            laik_log(LAIK_LL_Warning, "TCP2 LID %d sends %llu bytes without credit",
+                     lid, (unsigned long long) len);
         }
-        buf += p->relemsize;
-        consumed += p->relemsize;
-        p->roff++;
-        inTraversal = next_lex(p->rcv_range, &(p->rcv_idx));
+        assert((len > 0) && (len < 0x7fffffff));
+        r->tag = tag;
+        r->count = (int) len;
+        r->elemsize = 1;
+        r->credited = false;
+        r->ubuf = malloc(len);
+        r->direct = r->ubuf;
+        r->type = 0;
+        r->map = 0;
+        r->range = 0;
+        r->ro = LAIK_RO_None;
+    }
+    r->off = 0;
+    r->bytes = 0;
+    d->fds[fd].ractive = true;
+}
+
+// initialize receive <r> for transfer <tag> into <range> of mapping <m>,
+// eventually reducing with existing values via <ro>
+static
+void init_recv_map(Recv* r, uint32_t tag,
+                   Laik_Mapping* m, Laik_Range* range, Laik_ReductionOperation ro)
+{
+    assert(m->start != 0); // must be backed by memory
+    r->tag = tag;
+    r->count = laik_range_size(range);
+    assert(r->count > 0);
+    r->elemsize = m->data->elemsize;
+    r->ubuf = 0;
+    r->type = m->data->type;
+    r->map = m;
+    r->range = range;
+    r->idx = range->from;
+    r->ro = ro;
+    // direct placement of received bytes possible?
+    r->direct = 0;
+    if (laik_layout_lex_isContiguous(m->layout, m->layoutSection, range)) {
+        int64_t off = laik_offset(m->layout, m->layoutSection, &(range->from));
+        r->direct = m->start + off * r->elemsize;
     }
-    assert(p->roff <= p->rcount);
+}
 
-    laik_log(1, "TCP2 consumed %d bytes, received %d/%d", consumed, p->roff, p->rcount);
+// initialize receive <r> for transfer <tag> of <count> elements of type <t>
+// into contiguous buffer <buf>, eventually reducing via <ro>
+static
+void init_recv_buf(Recv* r, uint32_t tag, char* buf, int count,
+                   Laik_Type* t, Laik_ReductionOperation ro)
+{
+    assert(count > 0);
+    r->tag = tag;
+    r->count = count;
+    r->elemsize = t->size;
+    r->ubuf = 0;
+    r->type = t;
+    r->map = 0;
+    r->range = 0;
+    r->ro = ro;
+    r->direct = buf;
+}
 
-    if (p->roff == p->rcount)
-        d->exit = 1;
+// post receive <r> for a transfer from peer <lid>.
+// If data already arrived, it is consumed immediately
+static
+void post_recv(InstData* d, int lid, Recv* r)
+{
+    Peer* p = &(d->peer[lid]);
+    r->off = 0;
+    r->bytes = 0;
+    // small data is sent eagerly without credit
+    r->credited = d->accept_bin_data &&
+                  ((uint64_t) r->count * r->elemsize <= (uint64_t) d->eager);
+    assert((r->ro == LAIK_RO_None) || r->type->reduce);
+
+    int i = find_recv(p->uq, p->uq_used, r->tag);
+    if (i >= 0) {
+        laik_log(1, "TCP2 receive from LID %d (tag %x): data already buffered",
+                 lid, r->tag);
+        recv_from_buffer(r, &(p->uq[i]));
+        remove_recv(p->uq, &(p->uq_used), i);
+        return;
+    }
+    *append_recv(&(p->rq), &(p->rq_used), &(p->rq_size)) = *r;
+    d->rpending++;
+}
+
+// is receive for transfer <tag> from peer <lid> completed?
+static
+bool recv_finished(InstData* d, int lid, uint32_t tag)
+{
+    for(int fd = 0; fd <= d->maxfds; fd++) {
+        FDState* fds = &(d->fds[fd]);
+        if ((fds->cb == 0) || (fds->lid != lid) || !fds->ractive) continue;
+        if ((fds->rcur.ubuf == 0) && (fds->rcur.tag == tag)) return false;
+    }
+    Peer* p = &(d->peer[lid]);
+    return (find_recv(p->rq, p->rq_used, tag) < 0);
+}
+
+// give peer <lid> credits for all posted receives not yet credited,
+// using one message
+static
+void send_credits(InstData* d, int lid)
+{
+    Peer* p = &(d->peer[lid]);
+    int n = 0;
+    for(int i = 0; i < p->rq_used; i++)
+        if (!p->rq[i].credited) n++;
+    if (n == 0) return;
+
+    char* msg = malloc(n * 48 + 1);
+    int o = 0;
+    for(int i = 0; i < p->rq_used; i++) {
+        Recv* r = &(p->rq[i]);
+        if (r->credited) continue;
+        o += sprintf(msg + o, "allowsend %u %d %d\n", r->tag, r->count, r->elemsize);
+        r->credited = true;
+    }
+    send_cmd(d, lid, msg);
+    free(msg);
+}
+
+// take credit for transfer <tag> to peer <p>, return false if not available
+static
+bool take_credit(Peer* p, uint32_t tag, int count, int elemsize)
+{
+    for(int i = 0; i < p->cr_used; i++) {
+        Credit* c = &(p->cr[i]);
+        if (c->tag != tag) continue;
+        if ((c->count != count) || (c->elemsize != elemsize)) {
+            laik_log(LAIK_LL_Panic, "TCP2 credit for tag %x is %d x %d, need %d x %d",
+                     tag, c->count, c->elemsize, count, elemsize);
+            exit(1);
+        }
+        p->cr_used--;
+        *c = p->cr[p->cr_used];
+        return true;
+    }
+    return false;
+}
+
+// binary data for current receive via connection <fd> arrived in <buf>.
+// Return number of consumed bytes
+int got_binary_data(InstData* d, int fd, char* buf, int len)
+{
+    int lid = d->fds[fd].lid;
+    laik_log(1, "TCP2 got binary data (from LID %d, len %d)", lid, len);
+
+    if (lid < 0) {
+        laik_log(LAIK_LL_Warning, "TCP2 ignoring data from unknown sender");
+        return len;
+    }
+    assert(d->fds[fd].ractive);
+    Recv* r = &(d->fds[fd].rcur);
+    int consumed = recv_consume(r, buf, len);
+
+    laik_log(1, "TCP2 consumed %d bytes, received %d/%d", consumed, r->off, r->count);
+
+    if (r->off == r->count)
+        recv_done(d, fd);
 
     return consumed;
 }
 
-// "data" command received
-// return false if command cannot be processed yet, no matching receive
-void got_data(InstData* d, int lid, char* msg)
+// "data" command received via connection <fd>
+void got_data(InstData* d, int fd, int lid, char* msg)
 {
-    // data <len> <hexbyte> ...
+    // data <len> [(<tag>:<n>:<pos>)] <hexbyte> ...
     char cmd[21];
     int len, i;
     if (sscanf(msg, "%20s %d %n", cmd, &len, &i) < 2) {
@@ -752,23 +1197,37 @@ void got_data(InstData* d, int lid, char* msg)
     }
 
     Peer* p = &(d->peer[lid]);
-    if ((p->rcount == 0) || (p->rcount == p->roff)) {
-        laik_log(LAIK_LL_Warning, "TCP2 ignoring data from LID %d without send permission", lid);
-        return;
+    FDState* fds = &(d->fds[fd]);
+    if (!fds->ractive) {
+        // start next receive: use tag from position if given, or any posted
+        int ri = -1;
+        unsigned int tag;
+        if ((msg[i] == '(') && (sscanf(msg + i, "(%u:", &tag) == 1))
+            ri = find_recv(p->rq, p->rq_used, tag);
+        else if (p->rq_used > 0)
+            ri = 0;
+        if (ri < 0) {
+            laik_log(LAIK_LL_Warning, "TCP2 ignoring data from LID %d without posted receive", lid);
+            return;
+        }
+        fds->rcur = p->rq[ri];
+        remove_recv(p->rq, &(p->rq_used), ri);
+        fds->ractive = true;
     }
+    Recv* r = &(fds->rcur);
 
     // assume only one element per data command
-    assert(p->relemsize == len);
-    Laik_Mapping* m = p->rmap;
+    assert(r->elemsize == len);
+    Laik_Mapping* m = r->map;
     assert(m != 0);
     Laik_Layout* ll = m->layout;
-    int64_t off = ll->offset(ll, m->layoutSection, &(p->rcv_idx));
-    char* idxPtr = m->start + off * p->relemsize;
+    int64_t off = ll->offset(ll, m->layoutSection, &(r->idx));
+    char* idxPtr = m->start + off * r->elemsize;
 
     // position string for check
-    char pstr[70];
-    int dims = p->rcv_range->space->dims;
-    int s = sprintf(pstr, "(%d:%s)", p->roff, istr(dims, &(p->rcv_idx)));
+    char pstr[80];
+    int dims = r->range->space->dims;
+    int s = sprintf(pstr, "(%u:%d:%s)", r->tag, r->off, istr(dims, &(r->idx)));
 
     if (msg[i] == '(') {
         assert(strncmp(msg+i, pstr, s) == 0);
@@ -798,28 +1257,27 @@ void got_data(InstData* d, int lid, char* msg)
     }
     assert(l == len);
 
-    assert(l == p->relemsize);
-    if (p->rro == LAIK_RO_None)
+    assert(l == r->elemsize);
+    if (r->ro == LAIK_RO_None)
         memcpy(idxPtr, data_in, len);
     else {
-        Laik_Type* t = p->rmap->data->type;
+        Laik_Type* t = m->data->type;
         assert(t->reduce);
-        (t->reduce)(idxPtr, idxPtr, data_in, 1, p->rro);
+        (t->reduce)(idxPtr, idxPtr, data_in, 1, r->ro);
     }
 
     if (len == 8) laik_log(1, " pos %s: in %f res %f\n", pstr, *((double*)data_in), *((double*)idxPtr));
 
-    p->roff++;
-    bool inTraversal = next_lex(p->rcv_range, &(p->rcv_idx));
-    assert(inTraversal == (p->roff < p->rcount));
+    r->off++;
+    r->bytes += len;
+    bool inTraversal = next_lex(r->range, &(r->idx));
+    assert(inTraversal == (r->off < r->count));
 
     laik_log(1, "TCP2 got data, len %d, received %d/%d",
-             len, p->roff, p->rcount);
-
-    if (p->roff == p->rcount)
-        d->exit = 1;
+             len, r->off, r->count);
 
-    return;
+    if (r->off == r->count)
+        recv_done(d, fd);
 }
 
 void got_register(InstData* d, int fd, int lid, char* msg)
@@ -897,9 +1355,8 @@ void got_register(InstData* d, int fd, int lid, char* msg)
     d->peer[lid].location = strdup(loc);
     d->peer[lid].port = p;
     d->peer[lid].accepts_bin_data = accepts_bin_data;
-    // first time we use this id for a peer: init receive
-    d->peer[lid].rcount = 0;
-    d->peer[lid].scount = 0;
+    // first time we use this id for a peer: init transfer state
+    init_transfers(&(d->peer[lid]));
 
     // send response to registering process: notify about assigned LID
     char str[150];
@@ -942,9 +1399,12 @@ void got_myid(InstData* d, int fd, int lid, char* msg)
     lid = peerid;
     assert((lid >= 0) && (lid < MAX_PEERS));
     assert(lid <= d->maxid);
-    d->peer[lid].fd = fd;
     assert(fd >= 0);
     d->fds[fd].lid = lid;
+    // if we concurrently connected to peer ourself, we keep sending via our
+    // own connection, to have one connection per direction for data frames
+    if (d->peer[lid].fd < 0)
+        d->peer[lid].fd = fd;
 
     // must already be known, announced by master
     assert(d->peer[lid].location != 0);
@@ -1193,9 +1653,8 @@ void got_id(InstData* d, int from_lid, char* msg)
     d->peer[lid].port = p;
     d->peer[lid].accepts_bin_data = accepts_bin_data;
 
-    // first time we see this peer: init receive
-    d->peer[lid].rcount = 0;
-    d->peer[lid].scount = 0;
+    // first time we see this peer: init transfer state
+    init_transfers(&(d->peer[lid]));
 
     d->peers++;
 
@@ -1289,22 +1748,30 @@ void got_backedout(InstData* d, int lid, char* msg)
 
 void got_allowsend(InstData* d, int lid, char* msg)
 {
-    // allowsend <count> <elemsize>
+    // allowsend <tag> <count> <elemsize>
     char cmd[21];
+    unsigned int tag;
     int count, esize;
-    if (sscanf(msg, "%20s %d %d", cmd, &count, &esize) < 3) {
+    if (sscanf(msg, "%20s %u %d %d", cmd, &tag, &count, &esize) < 4) {
         laik_log(LAIK_LL_Warning, "cannot parse allowsend command '%s'; ignoring", msg);
         return;
     }
 
-    laik_log(1, "TCP2 got allowsend %d %d", count, esize);
-    if (d->peer[lid].scount != 0) {
-        laik_log(LAIK_LL_Warning, "already have send right; ignoring");
-        return;
-    }
+    laik_log(1, "TCP2 got allowsend %x %d %d", tag, count, esize);
+    Peer* p = &(d->peer[lid]);
 
-    d->peer[lid].scount = count;
-    d->peer[lid].selemsize = esize;
+    if (p->cr_used == p->cr_size) {
+        p->cr_size = (p->cr_size == 0) ? 8 : 2 * p->cr_size;
+        p->cr = realloc(p->cr, p->cr_size * sizeof(Credit));
+        if (p->cr == 0) {
+            laik_panic("TCP2 out of memory allocating credits");
+            exit(1); // not actually needed, laik_panic never returns
+        }
+    }
+    Credit* c = &(p->cr[p->cr_used++]);
+    c->tag = tag;
+    c->count = count;
+    c->elemsize = esize;
     d->exit = 1;
 }
 
@@ -1505,8 +1972,8 @@ void got_cmd(InstData* d, int fd, char* msg, int len)
     case 'e': got_enterresize(d, lid, msg); return; // enterresize <phase> <epoch>
     case 'b': got_backedout(d, lid, msg); return; // backedout <lid>
     case 'p': got_phase(d, msg); return; // phase <phaseid>
-    case 'a': got_allowsend(d, lid, msg); return; // allowsend <count> <elemsize>
-    case 'd': got_data(d, lid, msg); return; // data <len> [(<pos>)] <hex> ...
+    case 'a': got_allowsend(d, lid, msg); return; // allowsend <tag> <count> <elemsize>
+    case 'd': got_data(d, fd, lid, msg); return; // data <len> [(<tag>:<n>:<pos>)] <hex> ...
     case 'k': got_kvs(d, lid, msg); return; // kvs ...
     case 'g': got_getready(d, lid, msg); return; // getready
     case 'o': got_ok(d, lid, msg); return; // ok
@@ -1522,7 +1989,7 @@ void process_rbuf(InstData* d, int fd)
     FDState* fds = &(d->fds[fd]);
     char* rbuf = fds->rbuf;
     int used = fds->rbuf_used;
-    int outstanding_bin = fds->outstanding_bin;
+    int64_t outstanding_bin = fds->outstanding_bin;
     assert(rbuf != 0);
 
     laik_log(1, "TCP2 handle commands in receive buf of FD %d (LID %d, %d bytes)\n",
@@ -1534,9 +2001,9 @@ void process_rbuf(InstData* d, int fd)
     while(pos2 < used) {
         // section in bin mode?
         if (outstanding_bin > 0) {
-            if (used - pos1 < outstanding_bin) {
+            if ((int64_t) (used - pos1) < outstanding_bin) {
                 // all bytes in receive buffer are in bin mode
-                consumed = got_binary_data(d, fds->lid, rbuf + pos1, used - pos1);
+                consumed = got_binary_data(d, fd, rbuf + pos1, used - pos1);
                 if (consumed == 0) {
                     // may happen if available chunk too small, need more data
                     pos2 = used;
@@ -1544,7 +2011,7 @@ void process_rbuf(InstData* d, int fd)
                 }
             }
             else {
-                consumed = got_binary_data(d, fds->lid, rbuf + pos1, outstanding_bin);
+                consumed = got_binary_data(d, fd, rbuf + pos1, (int) outstanding_bin);
                 assert(consumed > 0); // we provided all bytes until end, ensure progress
             }
             outstanding_bin -= consumed;
@@ -1554,16 +2021,24 @@ void process_rbuf(InstData* d, int fd)
         }
         // start of bin mode?
         if (rbuf[pos1] == 'B') {
-            // 3 bytes header: 'B' + 2 bytes count (up to 64k of binary)
-            if (pos1 + 2 >= used) {
+            // header: 'B' + 4 bytes tag + 8 bytes length (little-endian)
+            if (pos1 + BIN_HEADER_LEN > used) {
                 // not enough bytes to cover header: stop
                 pos2 = used;
                 break;
             }
-            outstanding_bin  = ((int)((unsigned char*)rbuf)[pos1 + 1]);
-            outstanding_bin += ((int)((unsigned char*)rbuf)[pos1 + 2]) << 8;
-            laik_log(1, "TCP2 bin mode started with %d bytes\n", outstanding_bin);
-            pos1 += 3;
+            unsigned char* h = (unsigned char*) rbuf + pos1;
+            uint32_t tag = 0;
+            for(int i = 4; i > 0; i--)
+                tag = (tag << 8) + h[i];
+            outstanding_bin = 0;
+            for(int i = BIN_HEADER_LEN - 1; i > 4; i--)
+                outstanding_bin = (outstanding_bin << 8) + h[i];
+            laik_log(1, "TCP2 bin mode started with %lld bytes (tag %x)\n",
+                     (long long) outstanding_bin, tag);
+            if (fds->lid >= 0)
+                start_frame(d, fd, tag, outstanding_bin);
+            pos1 += BIN_HEADER_LEN;
             pos2 = pos1;
             continue;
         }
@@ -1604,6 +2079,30 @@ void got_bytes(InstData* d, int fd)
         exit(1);
     }
 
+    // in binary mode with receive buffer consumed: if the data goes
+    // to a contiguous range, read directly into the mapping
+    int lid = d->fds[fd].lid;
+    if ((used == 0) && (d->fds[fd].outstanding_bin > 0) && (lid >= 0) &&
+        d->fds[fd].ractive && (d->fds[fd].rcur.direct != 0) &&
+        (d->fds[fd].rcur.ro == LAIK_RO_None)) {
+        Recv* r = &(d->fds[fd].rcur);
+        uint64_t left = (uint64_t) r->count * r->elemsize - r->bytes;
+        if ((uint64_t) d->fds[fd].outstanding_bin < left)
+            left = d->fds[fd].outstanding_bin;
+        ssize_t len = read(fd, r->direct + r->bytes, left);
+        if (len > 0) {
+            laik_log(1, "TCP2 got_bytes(FD %d, peer LID %d): read %ld bytes directly",
+                     fd, lid, (long) len);
+            r->bytes += len;
+            r->off = (int) (r->bytes / r->elemsize);
+            d->fds[fd].outstanding_bin -= len;
+            if (r->off == r->count)
+                recv_done(d, fd);
+            return;
+        }
+        // on error or closed connection: handle below
+    }
+
     char* rbuf = d->fds[fd].rbuf;
     int len = read(fd, rbuf + used, RBUF_LEN - used);
     if (len == -1) {
@@ -1622,19 +2121,18 @@ void got_bytes(InstData* d, int fd)
             process_rbuf(d, fd);
         }
 
-        int lid = d->fds[fd].lid;
         laik_log(1, "TCP2 FD %d closed (peer LID %d, %d bytes unprocessed)\n",
                  fd, lid, d->fds[fd].rbuf_used);
 
-        if (lid >= 0) {
-            assert(d->peer[lid].fd == fd);
-            // peer may still be alive and just have closed connection to avoid
-            // too many open connections: thus, only mark as "not connected"
+        // peer may still be alive and just have closed connection to avoid
+        // too many open connections: thus, only mark as "not connected".
+        // There may be two connections to a peer, the other one being in use
+        if ((lid >= 0) && (d->peer[lid].fd == fd))
             d->peer[lid].fd = -1;
-        }
 
         close(fd);
         rm_rfd(d, fd);
+        d->exit = 1;
         return;
     }
 
@@ -1705,8 +2203,7 @@ InstData* new_inst_data(char* host, char* location)
         d->peer[i].host = 0;
         d->peer[i].location = 0;
         d->peer[i].accepts_bin_data = false;
-        d->peer[i].rcount = 0;
-        d->peer[i].scount = 0;
+        init_transfers(&(d->peer[i]));
     }
 
     FD_ZERO(&d->rset);
@@ -1727,6 +2224,13 @@ InstData* new_inst_data(char* host, char* location)
     // announce capability to accept binary data? Defaults to yes, can be switched off
     char* str = getenv("LAIK_TCP2_BIN");
     d->accept_bin_data = str ? atoi(str) : 1;
+    // socket send/receive buffer size (bytes), default: OS default (autotuning)
+    str = getenv("LAIK_TCP2_SOCKBUF");
+    d->sockbuf = str ? atoi(str) : 0;
+    // data up to this size (bytes) is sent without waiting for credit
+    str = getenv("LAIK_TCP2_EAGER");
+    d->eager = str ? atoi(str) : TCP2_EAGER_BYTES;
+    d->rpending = 0;
     d->kvs = 0;       // only set during tcp2_sync()
     d->kvs_changes = 0;
     d->kvs_received = 0;
@@ -1891,6 +2395,8 @@ Laik_Instance* laik_init_tcp2(int* argc, char*** argv)
             laik_panic("TCP2 cannot create listening socket");
             exit(1); // not actually needed, laik_panic never returns
         }
+        // inherited by accepted connections
+        set_sockbuf(d, listenfd);
         if (try_master) {
             // mainly for development: avoid wait time to bind to same port
             if (setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR,
@@ -2071,151 +2577,265 @@ Laik_Instance* laik_init_tcp2(int* argc, char*** argv)
 // helper for exec
 
 // send data with one element of size <s> at pointer <p> to process <lid>
-// position <n/idx> added only to allow check at receiver
+// for transfer <tag>. Position <n/idx> added only to allow check at receiver
 static
-void send_data(int n, int dims, Laik_Index* idx, int toLID, void* p, int s)
+void send_data(uint32_t tag, int n, int dims, Laik_Index* idx, int toLID, void* p, int s)
 {
-    char str[100];
+    char str[150];
     int o = 0;
-    o += sprintf(str, "data %d (%d:%s)", s, n, istr(dims, idx));
+    o += sprintf(str, "data %d (%u:%d:%s)", s, tag, n, istr(dims, idx));
     for(int i = 0; i < s; i++) {
         int v = ((unsigned char*)p)[i];
         o += sprintf(str+o, " %02x", v);
     }
+    str[o++] = '\n';
 
     if (laik_log_begin(1)) {
         laik_log_append("TCP2 %d bytes data to LID %d", s, toLID);
         if (s == 8)
-            laik_log_flush(", pos (%d:%s): %f\n", n, istr(dims, idx), *((double*)p));
+            laik_log_flush(", pos (%u:%d:%s): %f\n", tag, n, istr(dims, idx), *((double*)p));
         else
             laik_log_flush("");
     }
 
-    send_cmd((InstData*)instance->backend_data, toLID, str);
+    // use non-blocking send also for ASCII data to avoid deadlocks
+    send_bin((InstData*)instance->backend_data, toLID, str, o);
 }
 
 // send
 
-#define SBUF_LEN 8*1024
-int sbuf_used = 3; // reserve space for header
-int sbuf_toLID = -1;
-char sbuf[SBUF_LEN];
+// send buffer for packing
+#define SBUF_LEN 256*1024
+static char sbuf[SBUF_LEN];
+
+// rows with at least this number of bytes are sent directly from mapping
+#define TCP2_MIN_IOV_BYTES 512
+// maximum number of buffers given to one writev() call
+#define TCP2_IOV_MAX 64
 
+// write header for binary frame of transfer <tag> with <len> bytes
+// payload into <buf>
 static
-void send_data_bin_flush(int toLID)
+void set_bin_header(char* buf, uint32_t tag, uint64_t len)
 {
-    if (sbuf_used == 0) return;
-    assert(sbuf_toLID == toLID);
-
-    // prepend data to send with header with byte count
-    int bytes = sbuf_used - 3;
-    sbuf[0] = 'B';
-    sbuf[1] = bytes & 255;
-    sbuf[2] = bytes >> 8;
-    send_bin((InstData*)instance->backend_data, toLID, sbuf, sbuf_used);
-    sbuf_used = 3; // reserve space for header
-    sbuf_toLID = -1;
+    buf[0] = 'B';
+    for(int i = 1; i < 5; i++) {
+        buf[i] = tag & 255;
+        tag = tag >> 8;
+    }
+    for(int i = 5; i < BIN_HEADER_LEN; i++) {
+        buf[i] = len & 255;
+        len = len >> 8;
+    }
 }
 
+// send range directly from mapping memory, using one buffer per row.
+// only for lexicographical layouts
 static
-void send_data_bin(int n, int dims, Laik_Index* idx, int toLID, void* p, int s)
+void send_range_rows(InstData* d, Laik_Mapping* fromMap, Laik_Range* range,
+                     int toLID, char* header)
 {
-    if (sbuf_used + s > SBUF_LEN)
-        send_data_bin_flush(toLID);
-    if (sbuf_toLID < 0)
-        sbuf_toLID = toLID;
-    else
-        assert(sbuf_toLID == toLID);
+    int esize = fromMap->data->elemsize;
+    int dims = range->space->dims;
+    size_t rowBytes = (range->to.i[0] - range->from.i[0]) * esize;
 
-    memcpy(sbuf + sbuf_used, p, s);
-    sbuf_used += s;
+    struct iovec iov[TCP2_IOV_MAX];
+    iov[0].iov_base = header;
+    iov[0].iov_len = BIN_HEADER_LEN;
+    int iovcnt = 1;
 
-    if (laik_log_begin(1)) {
-        laik_log_append("TCP2 add %d bytes bin data to LID %d", s, toLID);
-        if (s == 8)
-            laik_log_flush(", pos (%d:%s): %f\n", n, istr(dims, idx), *((double*)p));
-        else
-            laik_log_flush("");
+    Laik_Index idx = range->from;
+    while(1) {
+        int64_t off = laik_offset(fromMap->layout, fromMap->layoutSection, &idx);
+        char* rowPtr = fromMap->start + off * esize;
+        struct iovec* last = &(iov[iovcnt - 1]);
+        if ((iovcnt > 1) && ((char*) last->iov_base + last->iov_len == rowPtr))
+            last->iov_len += rowBytes; // row follows previous one in memory
+        else {
+            if (iovcnt == TCP2_IOV_MAX) {
+                send_binv(d, toLID, iov, iovcnt);
+                iovcnt = 0;
+            }
+            iov[iovcnt].iov_base = rowPtr;
+            iov[iovcnt].iov_len = rowBytes;
+            iovcnt++;
+        }
+
+        // go to next row
+        if (dims == 1) break;
+        idx.i[1]++;
+        if (idx.i[1] < range->to.i[1]) continue;
+        if (dims == 2) break;
+        idx.i[1] = range->from.i[1];
+        idx.i[2]++;
+        if (idx.i[2] == range->to.i[2]) break;
     }
+    send_binv(d, toLID, iov, iovcnt);
 }
 
-
-// send a range of data from mapping <m> to process <lid>
-// if not yet allowed to send data, we have to wait.
-// the action sequence ordering makes sure that there must
-// be a matching receive action on the receiver side
+// send range packed via layout pack function, in chunks of send buffer size
 static
-void send_range(Laik_Mapping* fromMap, Laik_Range* range, int toLID)
+void send_range_packed(InstData* d, Laik_Mapping* fromMap, Laik_Range* range,
+                       int toLID, char* header)
 {
-    Laik_Layout* l = fromMap->layout;
-    int esize = fromMap->data->elemsize;
     int dims = range->space->dims;
-    assert(fromMap->start != 0); // must be backed by memory
+    memcpy(sbuf, header, BIN_HEADER_LEN);
+    int used = BIN_HEADER_LEN;
+    Laik_Index idx = range->from;
+    while(1) {
+        unsigned int packed = (fromMap->layout->pack)(fromMap, range, &idx,
+                                                      sbuf + used,
+                                                      SBUF_LEN - used);
+        assert(packed > 0);
+        send_bin(d, toLID, sbuf, used + packed * fromMap->data->elemsize);
+        used = 0;
+        if (laik_index_isEqual(dims, &idx, &(range->to))) break;
+    }
+}
 
-    InstData* d = (InstData*)instance->backend_data;
+// start next transfer of class <cls> (TAG_P2P/TAG_COLL) with <count>
+// elements of size <esize> to peer <toLID>, return its tag.
+// Small data is sent eagerly, otherwise we have to wait for credit from the
+// receiver. The action sequence ordering makes sure that there is a
+// matching receive action on the receiver side
+static
+uint32_t begin_send(InstData* d, int toLID, int cls, uint64_t count, int esize)
+{
     Peer* p = &(d->peer[toLID]);
-    if (p->scount == 0) {
-        // we need to wait for right to send data
-        while(p->scount == 0)
+    uint32_t tag = get_tag(p->stag, cls);
+    if (!p->accepts_bin_data || (count * esize > (uint64_t) d->eager)) {
+        // we need to wait for credit
+        while(!take_credit(p, tag, (int) count, esize))
             run_loop(d);
     }
-    assert(p->scount == (int) laik_range_size(range));
-    assert(p->selemsize == esize);
+    p->stag[cls]++;
+    return tag;
+}
 
-    bool send_binary_data = p->accepts_bin_data;
-    Laik_Index idx = range->from;
-    int ecount = 0;
-    while(1) {
-        int64_t off = l->offset(l, fromMap->layoutSection, &idx);
-        void* idxPtr = fromMap->start + off * esize;
-        if (send_binary_data)
-            send_data_bin(ecount, dims, &idx, toLID, idxPtr, esize);
+// send a range of data from mapping <m> to process <lid> as next transfer
+// of class <cls> (TAG_P2P/TAG_COLL)
+static
+void send_range(Laik_Mapping* fromMap, Laik_Range* range, int toLID, int cls)
+{
+    int esize = fromMap->data->elemsize;
+    assert(fromMap->start != 0); // must be backed by memory
+
+    InstData* d = (InstData*)instance->backend_data;
+    Peer* p = &(d->peer[toLID]);
+    uint64_t count = laik_range_size(range);
+    uint32_t tag = begin_send(d, toLID, cls, count, esize);
+
+    if (p->accepts_bin_data) {
+        char header[BIN_HEADER_LEN];
+        set_bin_header(header, tag, count * esize);
+        uint64_t rowBytes = (range->to.i[0] - range->from.i[0]) * esize;
+        if (laik_layout_is_lex(fromMap->layout) &&
+            ((rowBytes >= TCP2_MIN_IOV_BYTES) ||
+             laik_layout_lex_isContiguous(fromMap->layout,
+                                          fromMap->layoutSection, range)))
+            send_range_rows(d, fromMap, range, toLID, header);
         else
-            send_data(ecount, dims, &idx, toLID, idxPtr, esize);
-        ecount++;
-        if (!next_lex(range, &idx)) break;
-    }
-    assert(ecount == (int) laik_range_size(range));
-    if (send_binary_data)
-        send_data_bin_flush(toLID);
+            send_range_packed(d, fromMap, range, toLID, header);
 
-    // withdraw our right to send further data
-    p->scount = 0;
+        laik_log(1, "TCP2 sent %llu elements (%llu bytes, tag %x) to LID %d",
+                 (unsigned long long) count,
+                 (unsigned long long) count * esize, tag, toLID);
+    }
+    else {
+        // ASCII mode: one command per element
+        Laik_Layout* l = fromMap->layout;
+        int dims = range->space->dims;
+        Laik_Index idx = range->from;
+        int ecount = 0;
+        while(1) {
+            int64_t off = l->offset(l, fromMap->layoutSection, &idx);
+            void* idxPtr = fromMap->start + off * esize;
+            send_data(tag, ecount, dims, &idx, toLID, idxPtr, esize);
+            ecount++;
+            if (!next_lex(range, &idx)) break;
+        }
+        assert(ecount == (int) count);
+    }
 }
 
-// queue receive action and run event loop until all data received
+// receive a range of data within a collective operation from process <lid>,
+// running event loop until all data received.
 // <ro> allows to request reduction with existing value
 // (use RO_None to overwrite with received value)
 static
 void recv_range(Laik_Range* range, int fromLID, Laik_Mapping* toMap, Laik_ReductionOperation ro)
 {
-    assert(toMap->start != 0); // must be backed by memory
-    // check no data still registered to be received from <fromID>
     InstData* d = (InstData*)instance->backend_data;
     Peer* p = &(d->peer[fromLID]);
-    assert(p->rcount == 0);
-
-    // write outstanding receive info into peer structure
-    p->rcount = laik_range_size(range);
-    assert(p->rcount > 0);
-    p->roff = 0;
-    p->relemsize = toMap->data->elemsize;
-    p->rmap = toMap;
-    p->rcv_range = range;
-    p->rcv_idx = range->from;
-    p->rro = ro;
-
-    // give peer the right to start sending data consisting of given number of elements
-    char msg[50];
-    sprintf(msg, "allowsend %d %d\n", p->rcount, p->relemsize);
-    send_cmd(d, fromLID, msg);
+    Recv r;
+    init_recv_map(&r, get_tag(p->rtag, TAG_COLL), toMap, range, ro);
+    p->rtag[TAG_COLL]++;
+
+    post_recv(d, fromLID, &r);
+    send_credits(d, fromLID);
 
     // wait until all data received from peer
-    while(p->roff < p->rcount)
+    while(!recv_finished(d, fromLID, r.tag))
         run_loop(d);
+}
+
+// send <count> elements of size <esize> from contiguous buffer <buf> to
+// process <toLID> within a collective operation (binary mode only)
+static
+void send_buf(InstData* d, char* buf, int count, int esize, int toLID)
+{
+    uint64_t len = (uint64_t) count * esize;
+    uint32_t tag = begin_send(d, toLID, TAG_COLL, count, esize);
+    char header[BIN_HEADER_LEN];
+    set_bin_header(header, tag, len);
+    struct iovec iov[2] = {
+        { .iov_base = header, .iov_len = BIN_HEADER_LEN },
+        { .iov_base = buf,    .iov_len = len }
+    };
+    send_binv(d, toLID, iov, 2);
+}
+
+// post receive of <count> elements of type <t> from process <fromLID> into
+// contiguous buffer <buf> within a collective operation, return its tag.
+// <ro> allows to request reduction with existing values
+static
+uint32_t post_recv_buf(InstData* d, int fromLID, char* buf, int count,
+                       Laik_Type* t, Laik_ReductionOperation ro)
+{
+    Peer* p = &(d->peer[fromLID]);
+    Recv r;
+    init_recv_buf(&r, get_tag(p->rtag, TAG_COLL), buf, count, t, ro);
+    p->rtag[TAG_COLL]++;
 
-    // done
-    p->rcount = 0;
+    post_recv(d, fromLID, &r);
+    send_credits(d, fromLID);
+    return r.tag;
+}
+
+// pack all elements of <range> in mapping <m> into contiguous buffer <buf>
+static
+void pack_range(Laik_Mapping* m, Laik_Range* range, char* buf)
+{
+    int dims = range->space->dims;
+    Laik_Index idx = range->from;
+    while(!laik_index_isEqual(dims, &idx, &(range->to))) {
+        unsigned int n = (m->layout->pack)(m, range, &idx, buf, SBUF_LEN);
+        assert(n > 0);
+        buf += (uint64_t) n * m->data->elemsize;
+    }
+}
+
+// unpack all elements of <range> from contiguous buffer <buf> into mapping <m>
+static
+void unpack_range(Laik_Mapping* m, Laik_Range* range, char* buf)
+{
+    int dims = range->space->dims;
+    Laik_Index idx = range->from;
+    while(!laik_index_isEqual(dims, &idx, &(range->to))) {
+        unsigned int n = (m->layout->unpack)(m, range, &idx, buf, SBUF_LEN);
+        assert(n > 0);
+        buf += (uint64_t) n * m->data->elemsize;
+    }
 }
 
 /* reduction at one process using send/recv
@@ -2224,11 +2844,12 @@ void recv_range(Laik_Range* range, int fromLID, Laik_Mapping* toMap, Laik_Reduct
  * to be the process with smallest id of all processes which are interested in the
  * result (input group). All other processes with input send their data to the
  * reduceProcess. It does the reduction, and then it sends the result to all
- * processes interested in the result (output group)
+ * processes interested in the result (output group).
+ * Only used in ASCII mode, which does not support sending from buffers.
 */
 static
-void exec_reduce(Laik_TransitionContext* tc,
-                 Laik_BackendAction* a)
+void exec_reduce_linear(Laik_TransitionContext* tc,
+                        Laik_BackendAction* a)
 {
     assert(a->h.type == LAIK_AT_MapGroupReduce);
     Laik_Transition* t = tc->transition;
@@ -2247,7 +2868,7 @@ void exec_reduce(Laik_TransitionContext* tc,
                      reduceTask, reduceLID);
             assert(tc->fromList && (a->fromMapNo < tc->fromList->count));
             Laik_Mapping* m = &(tc->fromList->map[a->fromMapNo]);
-            send_range(m, a->range, reduceLID);
+            send_range(m, a->range, reduceLID, TAG_COLL);
         }
         if (laik_trans_isInGroup(t, a->outputGroup, myid)) {
             laik_log(1, "  not reduce process: recv from T%d (LID%d)",
@@ -2302,8 +2923,257 @@ void exec_reduce(Laik_TransitionContext* tc,
         int outLID = laik_group_locationid(t->group, outTask);
 
         laik_log(1, "  reduce process: send result to T%d (LID %d)", outTask, outLID);
-        send_range(m, a->range, outLID);
+        send_range(m, a->range, outLID, TAG_COLL);
+    }
+}
+
+
+// reductions with data size of at least this number of bytes use the ring
+// algorithm, if input and output group are the same
+#define TCP2_RING_MIN_BYTES 256*1024
+
+// write <root> followed by all other tasks of task group <subgroup> of
+// transition <t> into <list>, return number of entries
+static
+int reduce_task_list(Laik_Transition* t, int subgroup, int root, int* list)
+{
+    int n = 0;
+    list[n++] = root;
+    int count = laik_trans_groupCount(t, subgroup);
+    for(int i = 0; i < count; i++) {
+        int task = laik_trans_taskInGroup(t, subgroup, i);
+        if (task != root) list[n++] = task;
+    }
+    return n;
+}
+
+// return index of <task> in <list> with <n> entries, -1 if not found
+static
+int reduce_list_index(int* list, int n, int task)
+{
+    for(int i = 0; i < n; i++)
+        if (list[i] == task) return i;
+    return -1;
+}
+
+/* reduction via binomial trees, for small data
+ *
+ * The first task of the output group (root) collects the reduction result
+ * from the input tasks via a binomial tree, and then broadcasts it to the
+ * other output tasks via a binomial tree. In a tree over list of tasks with
+ * the root at index 0, task at index i has parent i - lowbit(i) and children
+ * i + 2^k for 2^k < lowbit(i) (all 2^k for the root). Each task receives
+ * O(log P) messages.
+ * Inner tasks of the reduction tree accumulate in a temporary buffer, the
+ * root directly into its output mapping.
+ */
+static
+void exec_reduce_tree(Laik_TransitionContext* tc, Laik_BackendAction* a)
+{
+    InstData* d = (InstData*)instance->backend_data;
+    Laik_Transition* t = tc->transition;
+    Laik_Group* g = t->group;
+    int myid = g->myid;
+    int root = laik_trans_taskInGroup(t, a->outputGroup, 0);
+    Laik_Type* type = tc->data->type;
+    int esize = tc->data->elemsize;
+    int count = laik_range_size(a->range);
+
+    int* list = malloc((g->size + 1) * sizeof(int));
+    Laik_Mapping* fromMap = 0;
+    if (laik_trans_isInGroup(t, a->inputGroup, myid)) {
+        assert(tc->fromList && (a->fromMapNo < tc->fromList->count));
+        fromMap = &(tc->fromList->map[a->fromMapNo]);
+    }
+    Laik_Mapping* toMap = 0;
+    if (laik_trans_isInGroup(t, a->outputGroup, myid)) {
+        assert(tc->toList && (a->toMapNo < tc->toList->count));
+        toMap = &(tc->toList->map[a->toMapNo]);
+    }
+
+    // reduction to root
+    int n = reduce_task_list(t, a->inputGroup, root, list);
+    int me = reduce_list_index(list, n, myid);
+    if (me == 0) {
+        Laik_ReductionOperation op = LAIK_RO_None;
+        if (fromMap) {
+            // input from me: if from different map, copy to output map
+            if (fromMap != toMap)
+                laik_data_copy(a->range, fromMap, toMap);
+            op = a->redOp;
+        }
+        for(int mask = 1; mask < n; mask <<= 1) {
+            int child = list[mask];
+            laik_log(1, "  tree reduce: recv + %s from T%d",
+                     (op == LAIK_RO_None) ? "overwrite":"reduce", child);
+            recv_range(a->range, laik_group_locationid(g, child), toMap, op);
+            op = a->redOp; // eventually reset to reduction op from None
+        }
+    }
+    else if (me > 0) {
+        int lowbit = me & -me;
+        int parentLID = laik_group_locationid(g, list[me - lowbit]);
+        if ((lowbit == 1) || (me + 1 >= n)) {
+            // leaf: send input directly from mapping
+            laik_log(1, "  tree reduce: send to T%d", list[me - lowbit]);
+            send_range(fromMap, a->range, parentLID, TAG_COLL);
+        }
+        else {
+            char* buf = malloc((uint64_t) count * esize);
+            pack_range(fromMap, a->range, buf);
+            for(int mask = 1; (mask < lowbit) && (me + mask < n); mask <<= 1) {
+                int childLID = laik_group_locationid(g, list[me + mask]);
+                laik_log(1, "  tree reduce: recv + reduce from T%d", list[me + mask]);
+                uint32_t tag = post_recv_buf(d, childLID, buf, count, type, a->redOp);
+                while(!recv_finished(d, childLID, tag))
+                    run_loop(d);
+            }
+            laik_log(1, "  tree reduce: send to T%d", list[me - lowbit]);
+            send_buf(d, buf, count, esize, parentLID);
+            free(buf);
+        }
+    }
+
+    // broadcast from root
+    n = reduce_task_list(t, a->outputGroup, root, list);
+    me = reduce_list_index(list, n, myid);
+    if (me >= 0) {
+        int top = 1;
+        if (me > 0) {
+            top = me & -me;
+            laik_log(1, "  tree broadcast: recv from T%d", list[me - top]);
+            recv_range(a->range, laik_group_locationid(g, list[me - top]),
+                       toMap, LAIK_RO_None);
+        }
+        else
+            while(top < n) top <<= 1;
+
+        // send to children, largest subtree first
+        for(int mask = top >> 1; mask > 0; mask >>= 1) {
+            if (me + mask >= n) continue;
+            laik_log(1, "  tree broadcast: send to T%d", list[me + mask]);
+            send_range(toMap, a->range,
+                       laik_group_locationid(g, list[me + mask]), TAG_COLL);
+        }
+    }
+    free(list);
+}
+
+// start index of chunk <c> when splitting <count> elements into <chunks>
+static
+int ring_chunk(int count, int chunks, int c)
+{
+    return (int) ((int64_t) count * c / chunks);
+}
+
+// one step of the ring algorithm over contiguous buffer <buf> with <count>
+// elements split into <chunks> chunks: send chunk <sc> to <toLID> and
+// receive chunk <rc> from <fromLID>, using reduction <ro>. Empty chunks are
+// skipped on both sides
+static
+void ring_step(InstData* d, char* buf, int count, int chunks, Laik_Type* t,
+               int sc, int toLID, int rc, int fromLID, Laik_ReductionOperation ro)
+{
+    int esize = t->size;
+    int rfrom = ring_chunk(count, chunks, rc);
+    int rcount = ring_chunk(count, chunks, rc + 1) - rfrom;
+    uint32_t tag = 0;
+    // post receive first to give credit to sender as early as possible
+    if (rcount > 0)
+        tag = post_recv_buf(d, fromLID, buf + (uint64_t) rfrom * esize,
+                            rcount, t, ro);
+
+    int sfrom = ring_chunk(count, chunks, sc);
+    int scount = ring_chunk(count, chunks, sc + 1) - sfrom;
+    if (scount > 0)
+        send_buf(d, buf + (uint64_t) sfrom * esize, scount, esize, toLID);
+
+    if (rcount > 0)
+        while(!recv_finished(d, fromLID, tag))
+            run_loop(d);
+}
+
+/* all-reduction via ring, for large data with same input and output group
+ *
+ * With P tasks in a ring, the data is split into P chunks. In a reduce-scatter
+ * phase of P-1 steps, each task sends one chunk to its right neighbor while
+ * receiving and reducing another one from its left neighbor, resulting in
+ * each task owning one fully reduced chunk. In an allgather phase of P-1
+ * steps, the reduced chunks are passed around the ring. Each task sends and
+ * receives 2(P-1)/P times the data size, independent of P.
+ */
+static
+void exec_reduce_ring(Laik_TransitionContext* tc, Laik_BackendAction* a)
+{
+    InstData* d = (InstData*)instance->backend_data;
+    Laik_Transition* t = tc->transition;
+    Laik_Group* g = t->group;
+    int P = laik_trans_groupCount(t, a->inputGroup);
+    int me = -1;
+    for(int i = 0; i < P; i++)
+        if (laik_trans_taskInGroup(t, a->inputGroup, i) == g->myid) me = i;
+    if (me < 0) return; // not involved
+
+    assert(tc->fromList && (a->fromMapNo < tc->fromList->count));
+    assert(tc->toList && (a->toMapNo < tc->toList->count));
+    Laik_Mapping* fromMap = &(tc->fromList->map[a->fromMapNo]);
+    Laik_Mapping* toMap = &(tc->toList->map[a->toMapNo]);
+    Laik_Type* type = tc->data->type;
+    int count = laik_range_size(a->range);
+    int leftLID = laik_group_locationid(g,
+                      laik_trans_taskInGroup(t, a->inputGroup, (me + P - 1) % P));
+    int rightLID = laik_group_locationid(g,
+                       laik_trans_taskInGroup(t, a->inputGroup, (me + 1) % P));
+    laik_log(1, "  ring reduce: %d tasks, left LID %d, right LID %d",
+             P, leftLID, rightLID);
+
+    char* buf = malloc((uint64_t) count * tc->data->elemsize);
+    pack_range(fromMap, a->range, buf);
+
+    // reduce-scatter: afterwards, chunk (me+1) % P is fully reduced
+    for(int s = 0; s < P - 1; s++)
+        ring_step(d, buf, count, P, type,
+                  (me - s + P) % P, rightLID,
+                  (me - s - 1 + P) % P, leftLID, a->redOp);
+
+    // allgather
+    for(int s = 0; s < P - 1; s++)
+        ring_step(d, buf, count, P, type,
+                  (me + 1 - s + P) % P, rightLID,
+                  (me - s + P) % P, leftLID, LAIK_RO_None);
+
+    unpack_range(toMap, a->range, buf);
+    free(buf);
+}
+
+// reduction with algorithm selected by data size and group sizes
+static
+void exec_reduce(Laik_TransitionContext* tc, Laik_BackendAction* a)
+{
+    assert(a->h.type == LAIK_AT_MapGroupReduce);
+    InstData* d = (InstData*)instance->backend_data;
+    Laik_Transition* t = tc->transition;
+
+    if (!d->accept_bin_data) {
+        exec_reduce_linear(tc, a);
+        return;
     }
+
+    // ring if input group is same as output group, with enough data
+    int P = laik_trans_groupCount(t, a->inputGroup);
+    uint64_t count = laik_range_size(a->range);
+    bool useRing = (P > 2) && (count >= (uint64_t) P) &&
+                   (count * tc->data->elemsize >= TCP2_RING_MIN_BYTES) &&
+                   (P == laik_trans_groupCount(t, a->outputGroup));
+    for(int i = 0; useRing && (i < P); i++)
+        if (laik_trans_taskInGroup(t, a->inputGroup, i) !=
+            laik_trans_taskInGroup(t, a->outputGroup, i)) useRing = false;
+
+    laik_log(1, "  reduce via %s", useRing ? "ring" : "binomial trees");
+    if (useRing)
+        exec_reduce_ring(tc, a);
+    else
+        exec_reduce_tree(tc, a);
 }
 
 
@@ -2329,9 +3199,30 @@ void tcp2_exec(Laik_ActionSeq* as)
         as->backend = 0; // this tells LAIK that no cleanup needed
     }
 
-    Laik_TransitionContext* tc = as->context[0];
+    InstData* d = (InstData*)instance->backend_data;
+
+    // post all point-to-point receives up front and give credits to senders,
+    // using one message per sender
     Laik_Action* a = as->action;
     for(unsigned int i = 0; i < as->actionCount; i++, a = nextAction(a)) {
+        if (a->type != LAIK_AT_MapRecvAndUnpack) continue;
+        Laik_TransitionContext* tc = as->context[a->tid];
+        Laik_A_MapRecvAndUnpack* aa = (Laik_A_MapRecvAndUnpack*) a;
+        int fromLID = laik_group_locationid(tc->transition->group, aa->from_rank);
+        assert(tc->toList && (aa->toMapNo < tc->toList->count));
+        Laik_Mapping* m = &(tc->toList->map[aa->toMapNo]);
+        Peer* p = &(d->peer[fromLID]);
+        Recv r;
+        init_recv_map(&r, get_tag(p->rtag, TAG_P2P), m, aa->range, LAIK_RO_None);
+        post_recv(d, fromLID, &r);
+        p->rtag[TAG_P2P]++;
+    }
+    for(int lid = 0; lid <= d->maxid; lid++)
+        send_credits(d, lid);
+
+    a = as->action;
+    for(unsigned int i = 0; i < as->actionCount; i++, a = nextAction(a)) {
+        Laik_TransitionContext* tc = as->context[a->tid];
         switch(a->type) {
         case LAIK_AT_MapPackAndSend: {
             Laik_A_MapPackAndSend* aa = (Laik_A_MapPackAndSend*) a;
@@ -2340,17 +3231,15 @@ void tcp2_exec(Laik_ActionSeq* as)
                      aa->to_rank, toLID, aa->count, tc->data->elemsize);
             assert(tc->fromList && (aa->fromMapNo < tc->fromList->count));
             Laik_Mapping* m = &(tc->fromList->map[aa->fromMapNo]);
-            send_range(m, aa->range, toLID);
+            send_range(m, aa->range, toLID, TAG_P2P);
             break;
         }
         case LAIK_AT_MapRecvAndUnpack: {
             Laik_A_MapRecvAndUnpack* aa = (Laik_A_MapRecvAndUnpack*) a;
             int fromLID = laik_group_locationid(tc->transition->group, aa->from_rank);
+            // already posted, completion is waited for at end
             laik_log(1, "TCP2 MapRecvAndUnpack from T%d (LID %d), %d x %dB\n",
                      aa->from_rank, fromLID, aa->count, tc->data->elemsize);
-            assert(tc->toList && (aa->toMapNo < tc->toList->count));
-            Laik_Mapping* m = &(tc->toList->map[aa->toMapNo]);
-            recv_range(aa->range, fromLID, m, LAIK_RO_None);
             break;
         }
 
@@ -2367,6 +3256,10 @@ void tcp2_exec(Laik_ActionSeq* as)
             break;
         }
     }
+
+    // wait until all posted receives are completed
+    while(d->rpending > 0)
+        run_loop(d);
 }
 
 void tcp2_sync(Laik_KVStore* kvs)
@@ -2482,6 +3375,30 @@ void tcp2_make_progress()
     }
 }
 
+// graceful shutdown of connections: as data is sent eagerly, peers may not
+// have received all our data yet. Closing a connection with unread incoming
+// data (e.g. the greeting on a connection we opened) resets the connection,
+// discarding data in flight. Thus, stop writing and wait for the other sides
+// to close, consuming any incoming data
+void tcp2_finalize(Laik_Instance* inst)
+{
+    InstData* d = (InstData*)inst->backend_data;
+    int open = 0;
+    for(int fd = 0; fd <= d->maxfds; fd++) {
+        if (d->fds[fd].cb != got_bytes) continue;
+        shutdown(fd, SHUT_WR);
+        open++;
+    }
+    laik_log(1, "TCP2 finalize: waiting for %d connections to close", open);
+
+    while(open > 0) {
+        run_loop(d);
+        open = 0;
+        for(int fd = 0; fd <= d->maxfds; fd++)
+            if (d->fds[fd].cb == got_bytes) open++;
+    }
+}
+
 void tcp2_finish_resize()
 {
     // a resize must have been started
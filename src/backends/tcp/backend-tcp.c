@@ -527,24 +527,31 @@ void laik_tcp_exec(Laik_ActionSeq* as)
         laik_log_flush(0);
     }
 
-    // TODO: use transition context given by each action
-    Laik_TransitionContext* tc = as->context[0];
-    Laik_MappingList* fromList = tc->fromList;
-    Laik_MappingList* toList = tc->toList;
-    int elemsize = tc->data->elemsize;
-
-    // common for all MPI calls: tag, comm, datatype
+    // common for all MPI calls: tag, comm (same group for all contexts)
     int tag = 1;
+    Laik_TransitionContext* tc = as->context[0];
     TCPGroupData* gd = tcpGroupData(tc->transition->group);
     assert(gd);
     MPI_Comm comm = gd->comm;
-    MPI_Datatype dataType = getMPIDataType(tc->data);
     MPI_Status st;
     int err, count;
 
+    // mappings and datatype from transition context of current action
+    Laik_MappingList* fromList = tc->fromList;
+    Laik_MappingList* toList = tc->toList;
+    int elemsize = tc->data->elemsize;
+    MPI_Datatype dataType = getMPIDataType(tc->data);
+
     Laik_Action* a = as->action;
     for(unsigned int i = 0; i < as->actionCount; i++, a = nextAction(a)) {
         Laik_BackendAction* ba = (Laik_BackendAction*) a;
+        if (as->context[a->tid] != tc) {
+            tc = as->context[a->tid];
+            fromList = tc->fromList;
+            toList = tc->toList;
+            elemsize = tc->data->elemsize;
+            dataType = getMPIDataType(tc->data);
+        }
         if (laik_log_begin(1)) {
             laik_log_Action(a, as);
             laik_log_flush(0);
@@ -568,7 +575,7 @@ void laik_tcp_exec(Laik_ActionSeq* as)
 
         case LAIK_AT_RBufSend: {
             Laik_A_RBufSend* aa = (Laik_A_RBufSend*) a;
-            assert(aa->bufID < ASEQ_BUFFER_MAX);
+            assert(aa->bufID < as->bufferCount);
             err = MPI_Send(as->buf[aa->bufID] + aa->offset, aa->count,
                            dataType, aa->to_rank, tag, comm);
             if (err != MPI_SUCCESS) laik_tcp_panic(err);
@@ -600,7 +607,7 @@ void laik_tcp_exec(Laik_ActionSeq* as)
 
         case LAIK_AT_RBufRecv: {
             Laik_A_RBufRecv* aa = (Laik_A_RBufRecv*) a;
-            assert(aa->bufID < ASEQ_BUFFER_MAX);
+            assert(aa->bufID < as->bufferCount);
             err = MPI_Recv(as->buf[aa->bufID] + aa->offset, aa->count,
                            dataType, aa->from_rank, tag, comm, &st);
             if (err != MPI_SUCCESS) laik_tcp_panic(err);
@@ -705,14 +712,14 @@ void laik_tcp_exec(Laik_ActionSeq* as)
             break;
 
         case LAIK_AT_RBufLocalReduce:
-            assert(ba->bufID < ASEQ_BUFFER_MAX);
+            assert(ba->bufID < as->bufferCount);
             assert(ba->dtype->reduce != 0);
             (ba->dtype->reduce)(ba->toBuf, ba->toBuf, as->buf[ba->bufID] + ba->offset,
                                ba->count, ba->redOp);
             break;
 
         case LAIK_AT_RBufCopy:
-            assert(ba->bufID < ASEQ_BUFFER_MAX);
+            assert(ba->bufID < as->bufferCount);
             memcpy(ba->toBuf, as->buf[ba->bufID] + ba->offset, ba->count * elemsize);
             break;
 
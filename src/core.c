@@ -172,9 +172,21 @@ void laik_finalize(Laik_Instance* inst)
         }
         free(ss);
 
+        uint64_t cur, peak;
+        laik_get_partitioning_memory(&cur, &peak);
+        laik_log_append("  partitioning memory: %llu bytes (peak %llu)%s",
+                        (unsigned long long) cur, (unsigned long long) peak,
+                        inst->ownerRanges ? ", own ranges only" : "");
+
         laik_log_flush(0);
     }
 
+    laik_threads_finalize();
+
+    // return memory kept for reuse by default allocator
+    if (laik_allocator_def->policy == LAIK_MP_UsePool)
+        laik_mempool_release(laik_allocator_def);
+
     laik_close_profiling_file(inst);
     laik_free_profiling(inst);
     free(inst->control);
@@ -239,9 +251,16 @@ Laik_Instance* laik_new_instance(const Laik_Backend* b,
 
     instance->repart_ctrl = 0;
 
+    // only store own/neighbour ranges of partitionings?
+    char* str = getenv("LAIK_OWNER_RANGES");
+    instance->ownerRanges = str ? (atoi(str) > 0) : false;
+
     // logging (TODO: multiple instances)
     laik_log_init(instance);
 
+    // worker threads for local actions, if requested via LAIK_THREADS
+    laik_threads_init();
+
     if (laik_log_begin(2)) {
         laik_log_append_info();
         laik_log_flush(0);
@@ -281,6 +300,18 @@ void laik_addDataForInstance(Laik_Instance* inst, Laik_Data* d)
     inst->data_count++;
 }
 
+void laik_removeDataFromInstance(Laik_Instance* inst, Laik_Data* d)
+{
+    for(int i = 0; i < inst->data_count; i++) {
+        if (inst->data[i] != d) continue;
+        // keep order of remaining containers
+        for(int j = i + 1; j < inst->data_count; j++)
+            inst->data[j - 1] = inst->data[j];
+        inst->data_count--;
+        return;
+    }
+}
+
 
 // create a group to be used in this LAIK instance
 Laik_Group* laik_create_group(Laik_Instance* i, int maxsize)
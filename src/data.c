@@ -30,14 +30,27 @@
 // provided allocators
 Laik_Allocator *laik_allocator_def = 0;
 
+// use switch cache? can be disabled by setting LAIK_SWITCH_CACHE=0
+static int switch_cache = 1;
+
 
 // initialize the LAIK data module, called from laik_new_instance
 void laik_data_init()
 {
     laik_type_init();
 
+    char* str = getenv("LAIK_SWITCH_CACHE");
+    if (str) switch_cache = atoi(str);
+
     // default allocator used by containers
-    laik_allocator_def = laik_new_allocator_def();
+    str = getenv("LAIK_POOL");
+    if (str && (atoi(str) > 0)) {
+        // keep memory of freed mappings for reuse, optionally huge pages
+        str = getenv("LAIK_POOL_HUGEPAGES");
+        laik_allocator_def = laik_new_allocator_pool(str && (atoi(str) > 0));
+    }
+    else
+        laik_allocator_def = laik_new_allocator_def();
 }
 
 
@@ -58,6 +71,8 @@ Laik_SwitchStat* laik_newSwitchStat()
     ss->freedBytes         = 0;
     ss->currAllocedBytes   = 0;
     ss->maxAllocedBytes    = 0;
+    ss->poolHitCount       = 0;
+    ss->poolHitBytes       = 0;
     ss->initedBytes        = 0;
     ss->copiedBytes        = 0;
 
@@ -77,6 +92,11 @@ Laik_SwitchStat* laik_newSwitchStat()
     ss->reduceOpCount = 0;
     ss->byteBufCopyCount = 0;
 
+    ss->transCacheHits = 0;
+    ss->transCacheMisses = 0;
+    ss->aseqCacheHits = 0;
+    ss->aseqCacheMisses = 0;
+
     return ss;
 }
 
@@ -89,6 +109,8 @@ void laik_addSwitchStat(Laik_SwitchStat* target, Laik_SwitchStat* src)
     target->mallocedBytes      += src->mallocedBytes      ;
     target->freedBytes         += src->freedBytes         ;
     target->maxAllocedBytes    += src->maxAllocedBytes    ;
+    target->poolHitCount       += src->poolHitCount       ;
+    target->poolHitBytes       += src->poolHitBytes       ;
     target->initedBytes        += src->initedBytes        ;
     target->copiedBytes        += src->copiedBytes        ;
 
@@ -107,6 +129,11 @@ void laik_addSwitchStat(Laik_SwitchStat* target, Laik_SwitchStat* src)
     target->initOpCount        += src->initOpCount;
     target->reduceOpCount      += src->reduceOpCount;
     target->byteBufCopyCount   += src->byteBufCopyCount;
+
+    target->transCacheHits     += src->transCacheHits;
+    target->transCacheMisses   += src->transCacheMisses;
+    target->aseqCacheHits      += src->aseqCacheHits;
+    target->aseqCacheMisses    += src->aseqCacheMisses;
 }
 
 void laik_switchstat_addASeq(Laik_SwitchStat* target, Laik_ActionSeq* as)
@@ -185,6 +212,10 @@ Laik_Data* laik_new_data(Laik_Space* space, Laik_Type* type)
     d->map0_base = 0;
     d->map0_size = 0;
 
+    d->activeSwitch = 0;
+    d->switchCacheCount = 0;
+    d->switchCacheNext = 0;
+
     laik_log(1, "new data '%s':\n"
              "  type '%s' (elemsize %d), space '%s' (%lu elems, %.3f MB)\n",
              d->name, type->name, d->elemsize, space->name,
@@ -308,14 +339,15 @@ Laik_Range* coveringRanges(int n, Laik_RangeList* list, int myid)
     laik_log(1, "coveringRanges: %d maps", n);
 
     int mapNo = 0;
-    for(unsigned int o = list->off[myid]; o < list->off[myid+1]; o++, mapNo++) {
+    unsigned int lastOff = laik_rangelist_tidoff(list, myid + 1);
+    for(unsigned int o = laik_rangelist_tidoff(list, myid); o < lastOff; o++, mapNo++) {
         unsigned int firstOff = o;
         assert(mapNo == list->trange[o].mapNo);
         Laik_Range* range = &(ranges[mapNo]);
 
         // range covering all task ranges for a given map number
         *range = list->trange[o].range;
-        while((o+1 < list->off[myid+1]) && (list->trange[o+1].mapNo == mapNo)) {
+        while((o+1 < lastOff) && (list->trange[o+1].mapNo == mapNo)) {
             o++;
             laik_range_expand(range, &(list->trange[o].range));
         }
@@ -359,13 +391,8 @@ Laik_MappingList* prepareMaps(Laik_Data* d, Laik_Partitioning* p)
     Laik_RangeList* list = laik_partitioning_myranges(p);
     assert(list != 0); // TODO: API user error
 
-    // number of local ranges
-    int sn = list->off[myid+1] - list->off[myid];
-
     // number of maps
-    int n = 0;
-    if (sn > 0)
-        n = list->trange[list->off[myid+1] - 1].mapNo + 1;
+    int n = laik_rangelist_tidmapcount(list, myid);
 
     laik_log(1, "prepareMaps: %d maps for data '%s' (partitioning '%s')",
              n, d->name, p->name);
@@ -425,8 +452,12 @@ uint64_t freeMap(Laik_Mapping* m, Laik_Data* d, Laik_SwitchStat* ss)
         laik_switchstat_free(ss, m->capacity);
         freed = m->capacity;
 
-        assert(m->allocator->free);
-        (m->allocator->free)(d, m->start);
+        if (m->allocator->policy == LAIK_MP_UsePool)
+            laik_mempool_free(m->allocator, d, m->start, m->capacity);
+        else {
+            assert(m->allocator->free);
+            (m->allocator->free)(d, m->start);
+        }
     }
     m->base = 0;
     m->start = 0;
@@ -507,13 +538,20 @@ void laik_allocateMap(Laik_Mapping* m, Laik_SwitchStat* ss)
 
     // number of bytes to allocate: no space around required indexes
     uint64_t size = m->count * d->elemsize;
-    laik_switchstat_malloc(ss, size);
 
     // use the allocator of the mapping
     Laik_Allocator* a = m->allocator;
     assert(a != 0);
-    assert(a->malloc != 0);
-    char* start = (a->malloc)(d, size);
+    char* start;
+    if (a->policy == LAIK_MP_UsePool) {
+        // may round up <size> to size class of pool
+        start = laik_mempool_alloc(a, d, &size, ss);
+    }
+    else {
+        assert(a->malloc != 0);
+        start = (a->malloc)(d, size);
+    }
+    laik_switchstat_malloc(ss, size);
 
     if (!start) {
         laik_log(LAIK_LL_Panic,
@@ -530,19 +568,34 @@ void laik_allocateMap(Laik_Mapping* m, Laik_SwitchStat* ss)
              (unsigned long long) m->capacity, (void*) m->base);
 }
 
-// copy data in a range between mappings
-void laik_data_copy(Laik_Range* range,
-                    Laik_Mapping* from, Laik_Mapping* to)
+// copy of a sub-range, called via thread pool
+struct copyCtx {
+    Laik_Mapping* from;
+    Laik_Mapping* to;
+};
+
+static
+void copySubRange(void* ctx, Laik_Range* sub, uint64_t off)
 {
-    if (from->layout->copy && (from->layout->copy == to->layout->copy)) {
+    (void) off;
+    struct copyCtx* c = (struct copyCtx*) ctx;
+    if (c->from->layout->copy && (c->from->layout->copy == c->to->layout->copy)) {
         // same layout providing specific copy implementation: use it
-        (from->layout->copy)(range, from, to);
+        (c->from->layout->copy)(sub, c->from, c->to);
         return;
     }
 
     // different layouts in mappings or no specific copy implementation:
     // use generic variant
-    laik_layout_copy_gen(range, from, to);
+    laik_layout_copy_gen(sub, c->from, c->to);
+}
+
+// copy data in a range between mappings
+void laik_data_copy(Laik_Range* range,
+                    Laik_Mapping* from, Laik_Mapping* to)
+{
+    struct copyCtx c = { from, to };
+    laik_threads_run_range(range, from->data->elemsize, copySubRange, &c);
 }
 
 static
@@ -727,7 +780,7 @@ void initMaps(Laik_Transition* t,
             ss->initedBytes += elemCount * d->elemsize;
 
         if (d->type->init)
-            (d->type->init)(toBase, elemCount, op->redOp);
+            laik_threads_init_elems(d->type, toBase, elemCount, op->redOp);
         else {
             laik_log(LAIK_LL_Panic,
                      "Need initialization function for type '%s'. Not set!",
@@ -743,6 +796,9 @@ void initMaps(Laik_Transition* t,
 static
 void allocateMappings(Laik_MappingList* toList, Laik_SwitchStat* ss)
 {
+    // switching to no partitioning (releasing memory of container)
+    if (!toList) return;
+
     for(int i = 0; i < toList->count; i++) {
         Laik_Mapping* map = &(toList->map[i]);
         if (map->base) continue;
@@ -757,42 +813,122 @@ void allocateMappings(Laik_MappingList* toList, Laik_SwitchStat* ss)
     }
 }
 
+// create action sequence for transitions <t[i]> on <n> containers <d[i]>,
+// using one transition context per container. Mapping lists can be 0 if
+// not known yet (also <fromList>/<toList> themselves)
 static
-Laik_ActionSeq* createTransASeq(Laik_Data* d, Laik_Transition* t,
-                                Laik_MappingList* fromList,
-                                Laik_MappingList* toList)
-{
-    // never create a sequence with an invalid transition
-    assert(t != 0);
-
-    // create the action sequence for requested transition
-    Laik_ActionSeq* as = laik_aseq_new(d->space->inst);
-    int tid = laik_aseq_addTContext(as, d, t, fromList, toList);
-    laik_aseq_addTExec(as, tid);
+Laik_ActionSeq* createTransASeq(int n, Laik_Data** d, Laik_Transition** t,
+                                Laik_MappingList** fromList,
+                                Laik_MappingList** toList)
+{
+    assert(n > 0);
+
+    // create the action sequence for requested transitions
+    Laik_ActionSeq* as = laik_aseq_new(d[0]->space->inst);
+    for(int i = 0; i < n; i++) {
+        // never create a sequence with an invalid transition
+        assert(t[i] != 0);
+
+        int tid = laik_aseq_addTContext(as, d[i], t[i],
+                                        fromList ? fromList[i] : 0,
+                                        toList ? toList[i] : 0);
+        laik_aseq_addTExec(as, tid);
+    }
     laik_aseq_activateNewActions(as);
 
     return as;
 }
 
+// let backend prepare action sequence <as>, or just calculate statistics
+static
+void prepareASeq(Laik_ActionSeq* as)
+{
+    const Laik_Backend* backend = as->inst->backend;
+    if (backend->prepare)
+        (backend->prepare)(as);
+    else {
+        // for statistics: usually called in backend prepare function
+        laik_aseq_calc_stats(as);
+    }
+}
+
+// create action sequence for transitions on containers and let the backend
+// prepare it for given mappings (can be 0 if not known yet)
+static
+Laik_ActionSeq* prepareTransASeq(int n, Laik_Data** d, Laik_Transition** t,
+                                 Laik_MappingList** fromList,
+                                 Laik_MappingList** toList)
+{
+    Laik_ActionSeq* as = createTransASeq(n, d, t, fromList, toList);
+    // only called for sequences which are cached or held by the application
+    as->reused = true;
+    if (as->inst->backend->prepare) {
+        // remember mappings at prepare time
+        for(int i = 0; i < n; i++) {
+            Laik_TransitionContext* tc = as->context[i];
+            tc->prepFromList = fromList ? fromList[i] : 0;
+            tc->prepToList = toList ? toList[i] : 0;
+        }
+    }
+    prepareASeq(as);
+    return as;
+}
+
 
+// let backend execute actions of a transition, eventually only a first part
+// without blocking (for split-phase), or the remaining part
 static
-void doTransition(Laik_Data* d, Laik_Transition* t, Laik_ActionSeq* as,
-                  Laik_MappingList* fromList, Laik_MappingList* toList)
+void execTransition(Laik_SwitchHandle* h, bool beginPhase)
 {
+    Laik_Transition* t = h->t;
+    if ((t->sendCount + t->recvCount + t->redCount == 0) && !h->as->collective)
+        return;
+
+    // let backend do send/recv/reduce actions
+    Laik_Instance* inst = h->data->space->inst;
+    const Laik_Backend* backend = inst->backend;
+    if (inst->profiling->do_profiling)
+        inst->profiling->timer_backend = laik_wtime();
+
+    if (!h->split || !backend->exec_begin) {
+        // without split-phase support in backend, do everything at end
+        if (!beginPhase)
+            (backend->exec)(h->as);
+    }
+    else if (beginPhase)
+        h->actionsDone = (backend->exec_begin)(h->as);
+    else
+        (backend->exec_end)(h->as, h->actionsDone);
+
+    if (inst->profiling->do_profiling)
+        inst->profiling->time_backend += laik_wtime() - inst->profiling->timer_backend;
+}
+
+// initialize switch handle and allocate mappings for a transition
+static
+void beginSwitch(Laik_SwitchHandle* h, Laik_Data* d, Laik_Transition* t,
+                 Laik_MappingList* fromList, Laik_MappingList* toList,
+                 bool split)
+{
+    h->data = d;
+    h->t = t;
+    h->as = 0;
+    h->fromList = fromList;
+    h->toList = toList;
+    h->split = split;
+    h->freeASeq = false;
+    h->freeTransition = false;
+    h->done = false;
+    h->actionsDone = 0;
+
     if (d->stat) {
         d->stat->switches++;
         if (!t || (t->actionCount == 0))
             d->stat->switches_noactions++;
     }
 
-    if (t == 0) {
-        // no transition to exec, just free old mappings
-
-        // only free mappings if not part of a reservation
-        if (fromList->res == 0)
-            freeMappingList(fromList, d->stat);
-        return;
-    }
+    // no transition to exec: only need to free old mappings at finish
+    if (t == 0) return;
 
     // be careful when reusing mappings:
     // the backend wants to send/receive data in arbitrary order
@@ -805,40 +941,164 @@ void doTransition(Laik_Data* d, Laik_Transition* t, Laik_ActionSeq* as,
 
     // allocate space for mappings for which reuse is not possible
     allocateMappings(toList, d->stat);
+}
+
+// provide current mappings of the switch in <h> to the transition context
+// for it in the given prepared action sequence <as>
+static
+void setASeqMappings(Laik_SwitchHandle* h, Laik_ActionSeq* as)
+{
+    // check that <as> has actions for given transition
+    Laik_TransitionContext* tc = 0;
+    for(int i = 0; i < as->contextCount; i++) {
+        tc = as->context[i];
+        if (tc->data == h->data) break;
+    }
+    assert(tc && (tc->data == h->data));
+    assert(tc->transition == h->t);
+    // provide current mappings to context
+    tc->toList = h->toList;
+    tc->fromList = h->fromList;
+    // if sequence was prepared with mappings, they must be the same
+    if (tc->prepFromList) assert(tc->prepFromList == h->fromList);
+    if (tc->prepToList) assert(tc->prepToList == h->toList);
+}
+
+// start execution of a transition. if <split> is false, everything is
+// done in finishTransition(), otherwise communication is started and
+// local copy/init actions are done here already
+static
+void startTransition(Laik_SwitchHandle* h, Laik_Data* d, Laik_Transition* t,
+                     Laik_ActionSeq* as, Laik_MappingList* fromList,
+                     Laik_MappingList* toList, bool split)
+{
+    beginSwitch(h, d, t, fromList, toList, split);
+    if (t == 0) return;
 
-    bool doASeqCleanup = false;
     if (as) {
-        // we are given a prepared action sequence:
-        // check that <as> has actions for given transition
-        Laik_TransitionContext* tc = as->context[0];
-        assert(tc->data == d);
-        assert(tc->transition == t);
-        // provide current mappings to context
-        tc->toList = toList;
-        tc->fromList = fromList;
-        // if sequence was prepared with mappings, they must be the same
-        if (tc->prepFromList) assert(tc->prepFromList == fromList);
-        if (tc->prepToList) assert(tc->prepToList == toList);
+        // we are given a prepared action sequence
+        setASeqMappings(h, as);
     }
     else {
         // create the action sequence for requested transition on the fly
-        as = createTransASeq(d, t, fromList, toList);
-#if 1
-        const Laik_Backend* backend = d->space->inst->backend;
-        if (backend->prepare)
-            (backend->prepare)(as);
-        else {
-            // for statistics: usually called in backend prepare function
-            laik_aseq_calc_stats(as);
+        as = createTransASeq(1, &d, &t, &fromList, &toList);
+        prepareASeq(as);
+        h->freeASeq = true;
+    }
+    h->as = as;
+
+    if (!split) return;
+
+    execTransition(h, true);
+
+    // local copy/init actions do not depend on communication: do them
+    // now to make own ranges of new partitioning accessible
+    if (t->localCount > 0)
+        copyMaps(t, toList, fromList, d->stat);
+    if (t->initCount > 0)
+        initMaps(t, toList, fromList, d->stat);
+}
+
+// local actions of a transition after communication, and free old mappings
+static
+void endSwitch(Laik_SwitchHandle* h)
+{
+    Laik_Data* d = h->data;
+    Laik_Transition* t = h->t;
+    Laik_MappingList* fromList = h->fromList;
+
+    if (t) {
+        if (!h->split) {
+            // local copy actions
+            if (t->localCount > 0)
+                copyMaps(t, h->toList, fromList, d->stat);
+
+            // local init action
+            if (t->initCount > 0)
+                initMaps(t, h->toList, fromList, d->stat);
         }
-#endif
-        doASeqCleanup = true;
+
+        if (h->freeTransition)
+            laik_free_transition(t);
+    }
+
+    // free old mapping/partitioning
+    if (fromList) {
+        // only free mappings if not part of a reservation
+        if (fromList->res == 0)
+            freeMappingList(fromList, d->stat);
+    }
+}
+
+// finish execution of a transition started with startTransition()
+static
+void finishTransition(Laik_SwitchHandle* h)
+{
+    Laik_Data* d = h->data;
+
+    assert(!h->done);
+    h->done = true;
+
+    if (h->t) {
+        execTransition(h, false);
+
+        if (d->stat)
+            laik_switchstat_addASeq(d->stat, h->as);
+
+        if (h->freeASeq)
+            laik_aseq_free(h->as);
+    }
+    endSwitch(h);
+}
+
+static
+void doTransition(Laik_Data* d, Laik_Transition* t, Laik_ActionSeq* as,
+                  Laik_MappingList* fromList, Laik_MappingList* toList)
+{
+    Laik_SwitchHandle h;
+    startTransition(&h, d, t, as, fromList, toList, false);
+    finishTransition(&h);
+}
+
+// do transitions <t[i]> of <n> containers <d[i]> from their active mappings
+// to <toList[i]>, with the communication of all transitions done in one
+// execution of action sequence <as>, or of one created on the fly if 0.
+// Statistics of the sequence are accounted to the first container
+static
+void doTransitions(int n, Laik_Data** d, Laik_Transition** t,
+                   Laik_ActionSeq* as, Laik_MappingList** toList,
+                   bool freeTransitions)
+{
+    Laik_SwitchHandle* h = malloc(n * sizeof(Laik_SwitchHandle));
+    Laik_MappingList** fromList = malloc(n * sizeof(Laik_MappingList*));
+    if (!h || !fromList) {
+        laik_panic("Out of memory allocating Laik_SwitchHandle objects");
+        exit(1); // not actually needed, laik_panic never returns
     }
 
-    if (t->sendCount + t->recvCount + t->redCount > 0) {
-        // let backend do send/recv/reduce actions
+    bool comm = false;
+    for(int i = 0; i < n; i++) {
+        // only containers with transitions can be part of a sequence
+        assert(t[i] != 0);
+        fromList[i] = d[i]->activeMappings;
+        beginSwitch(&(h[i]), d[i], t[i], fromList[i], toList[i], false);
+        h[i].freeTransition = freeTransitions;
+        if (as)
+            setASeqMappings(&(h[i]), as);
+        if (t[i]->sendCount + t[i]->recvCount + t[i]->redCount > 0)
+            comm = true;
+    }
+
+    bool freeASeq = false;
+    if (!as) {
+        as = createTransASeq(n, d, t, fromList, toList);
+        prepareASeq(as);
+        freeASeq = true;
+    }
 
-        Laik_Instance* inst = d->space->inst;
+    if (comm || as->collective) {
+        // let backend do send/recv/reduce actions of all transitions
+        Laik_Instance* inst = d[0]->space->inst;
         if (inst->profiling->do_profiling)
             inst->profiling->timer_backend = laik_wtime();
 
@@ -846,29 +1106,130 @@ void doTransition(Laik_Data* d, Laik_Transition* t, Laik_ActionSeq* as,
 
         if (inst->profiling->do_profiling)
             inst->profiling->time_backend += laik_wtime() - inst->profiling->timer_backend;
+    }
+
+    if (d[0]->stat)
+        laik_switchstat_addASeq(d[0]->stat, as);
+    if (freeASeq)
+        laik_aseq_free(as);
 
+    for(int i = 0; i < n; i++) {
+        h[i].done = true;
+        endSwitch(&(h[i]));
     }
+    free(fromList);
+    free(h);
+}
 
-    if (d->stat)
-        laik_switchstat_addASeq(d->stat, as);
 
-    if (doASeqCleanup)
-        laik_aseq_free(as);
+//-------------------------------------------------------------------
+// switch cache: per container, remember transitions (and action sequences
+// prepared for mappings of reservations) for repeated switches
 
-    // local copy actions
-    if (t->localCount > 0)
-        copyMaps(t, toList, fromList, d->stat);
+static
+void freeSwitchCacheEntry(Laik_SwitchCacheEntry* e)
+{
+    if (e->as)
+        laik_aseq_free(e->as);
+    laik_free_transition(e->t);
+    e->as = 0;
+    e->t = 0;
+}
 
-    // local init action
-    if (t->initCount > 0)
-        initMaps(t, toList, fromList, d->stat);
+// drop entries referring to partitioning <p>, or all entries if <p> is 0
+static
+void invalidateSwitchCache(Laik_Data* d, Laik_Partitioning* p)
+{
+    int o = 0;
+    for(int i = 0; i < d->switchCacheCount; i++) {
+        Laik_SwitchCacheEntry* e = &(d->switchCache[i]);
+        if (p && (e->fromP != p) && (e->toP != p)) {
+            if (o < i) d->switchCache[o] = *e;
+            o++;
+            continue;
+        }
+        laik_log(1, "switch cache of data '%s': drop transition '%s'",
+                 d->name, e->t->name);
+        freeSwitchCacheEntry(e);
+    }
+    d->switchCacheCount = o;
+    if (d->switchCacheNext >= o)
+        d->switchCacheNext = 0;
+}
 
-    // free old mapping/partitioning
-    if (fromList) {
-        // only free mappings if not part of a reservation
-        if (fromList->res == 0)
-            freeMappingList(fromList, d->stat);
+void laik_data_invalidate_switchcache(Laik_Instance* inst, Laik_Partitioning* p)
+{
+    for(int i = 0; i < inst->data_count; i++)
+        invalidateSwitchCache(inst->data[i], p);
+}
+
+static
+Laik_SwitchCacheEntry* findSwitchCacheEntry(Laik_Data* d,
+                                            Laik_Partitioning* fromP,
+                                            Laik_Partitioning* toP,
+                                            Laik_DataFlow flow,
+                                            Laik_ReductionOperation redOp)
+{
+    for(int i = 0; i < d->switchCacheCount; i++) {
+        Laik_SwitchCacheEntry* e = &(d->switchCache[i]);
+        if ((e->fromP == fromP) && (e->toP == toP) &&
+            (e->fromGroup == fromP->group) && (e->toGroup == toP->group) &&
+            (e->flow == flow) && (e->redOp == redOp))
+            return e;
     }
+    return 0;
+}
+
+// add transition to cache, replacing oldest entry if cache is full
+static
+Laik_SwitchCacheEntry* addSwitchCacheEntry(Laik_Data* d, Laik_Transition* t)
+{
+    Laik_SwitchCacheEntry* e;
+    if (d->switchCacheCount < SWITCHCACHE_MAX)
+        e = &(d->switchCache[d->switchCacheCount++]);
+    else {
+        e = &(d->switchCache[d->switchCacheNext]);
+        d->switchCacheNext = (d->switchCacheNext + 1) % SWITCHCACHE_MAX;
+        freeSwitchCacheEntry(e);
+    }
+
+    e->fromP = t->fromPartitioning;
+    e->toP = t->toPartitioning;
+    e->fromGroup = t->fromPartitioning->group;
+    e->toGroup = t->toPartitioning->group;
+    e->flow = t->flow;
+    e->redOp = t->redOp;
+    e->t = t;
+    e->as = 0;
+    e->fromList = 0;
+    e->toList = 0;
+
+    return e;
+}
+
+// get action sequence for cached transition prepared for given mappings.
+// returns 0 if mappings are not part of reservations (no reuse possible)
+static
+Laik_ActionSeq* getSwitchCacheASeq(Laik_Data* d, Laik_SwitchCacheEntry* e,
+                                   Laik_MappingList* fromList,
+                                   Laik_MappingList* toList)
+{
+    if (!fromList || !toList || !fromList->res || !toList->res)
+        return 0;
+
+    if (e->as && (e->fromList == fromList) && (e->toList == toList)) {
+        if (d->stat) d->stat->aseqCacheHits++;
+        return e->as;
+    }
+
+    if (d->stat) d->stat->aseqCacheMisses++;
+    if (e->as)
+        laik_aseq_free(e->as);
+    e->as = prepareTransASeq(1, &d, &(e->t), &fromList, &toList);
+    e->fromList = fromList;
+    e->toList = toList;
+
+    return e->as;
 }
 
 // make data container aware of reservation
@@ -937,6 +1298,9 @@ void laik_reservation_add(Laik_Reservation* r, Laik_Partitioning* p)
 // free reservation and the memory space allocated
 void laik_reservation_free(Laik_Reservation* r)
 {
+    // cached action sequences may refer to mappings of the reservation
+    invalidateSwitchCache(r->data, 0);
+
     for(int i = 0; i < r->count; i++) {
         assert(r->entry[i].mList != 0);
         free(r->entry[i].mList);
@@ -1185,6 +1549,51 @@ void laik_reservation_alloc(Laik_Reservation* res)
     }
 }
 
+struct transCtx {
+    Laik_Data** d;
+    Laik_Partitioning** toP;
+    Laik_DataFlow flow;
+    Laik_ReductionOperation redOp;
+    Laik_Transition** t;
+};
+
+static
+void calcTransChunk(void* ctx, uint64_t from, uint64_t to)
+{
+    struct transCtx* c = (struct transCtx*) ctx;
+    for(uint64_t i = from; i < to; i++)
+        c->t[i] = do_calc_transition(c->d[i]->space,
+                                     c->d[i]->activePartitioning, c->toP[i],
+                                     c->flow, c->redOp);
+}
+
+// calculate transitions for multiple containers, in parallel if possible
+void laik_calc_transitions(int n, Laik_Data** d, Laik_Partitioning** toP,
+                           Laik_DataFlow flow, Laik_ReductionOperation redOp,
+                           Laik_Transition** t)
+{
+    for(int i = 0; i < n; i++) {
+        Laik_Partitioning* fromP = d[i]->activePartitioning;
+        // a transition always needs to be between the same process group
+        if (fromP && toP[i])
+            assert(fromP->group == toP[i]->group);
+        // not thread-safe: may run partitioners
+        laik_partitioning_prepare_transition(fromP, toP[i], redOp);
+    }
+
+    // transition calculation is reentrant, one container per chunk
+    struct transCtx c = { d, toP, flow, redOp, t };
+    laik_threads_run((uint64_t) n, 1, calcTransChunk, &c);
+
+    if (laik_log_begin(2)) {
+        laik_log_append("calc transitions for %d containers:", n);
+        for(int i = 0; i < n; i++)
+            laik_log_append(" '%s' %d actions", d[i]->name,
+                            t[i] ? t[i]->actionCount : 0);
+        laik_log_flush(0);
+    }
+}
+
 // execute a previously calculated transition on a data container
 void laik_exec_transition(Laik_Data* d, Laik_Transition* t)
 {
@@ -1213,32 +1622,43 @@ Laik_ActionSeq* laik_calc_actions(Laik_Data* d,
                                   Laik_Reservation* fromRes,
                                   Laik_Reservation* toRes)
 {
-    // never create a sequence with an invalid transition
-    if (t == 0) return 0;
-
-    Laik_MappingList* fromList = 0;
-    Laik_MappingList* toList = 0;
-    if (fromRes)
-        fromList = laik_reservation_getMList(fromRes, t->fromPartitioning);
-    if (toRes)
-        toList = laik_reservation_getMList(toRes, t->toPartitioning);
-
+    return laik_calc_actions_multi(1, &d, &t, &fromRes, &toRes);
+}
 
-    Laik_ActionSeq* as = createTransASeq(d, t, fromList, toList);
-    const Laik_Backend* backend = d->space->inst->backend;
-    if (backend->prepare) {
-        (backend->prepare)(as);
+Laik_ActionSeq* laik_calc_actions_multi(int n, Laik_Data** d,
+                                        Laik_Transition** t,
+                                        Laik_Reservation** fromRes,
+                                        Laik_Reservation** toRes)
+{
+    assert(n > 0);
+    for(int i = 0; i < n; i++) {
+        // never create a sequence with an invalid transition
+        if (t[i] == 0) return 0;
+        // a container can only be switched once by a sequence
+        for(int j = 0; j < i; j++)
+            assert(d[j] != d[i]);
+    }
 
-        // remember mappings at prepare time
-        Laik_TransitionContext* tc = as->context[0];
-        tc->prepFromList = fromList;
-        tc->prepToList = toList;
+    Laik_MappingList** fromList = malloc(2 * n * sizeof(Laik_MappingList*));
+    if (!fromList) {
+        laik_panic("Out of memory in laik_calc_actions_multi");
+        exit(1); // not actually needed, laik_panic never returns
     }
-    else {
-        // for statistics: usually called in backend prepare function
-        laik_aseq_calc_stats(as);
+    Laik_MappingList** toList = fromList + n;
+    for(int i = 0; i < n; i++) {
+        fromList[i] = 0;
+        toList[i] = 0;
+        if (fromRes && fromRes[i])
+            fromList[i] = laik_reservation_getMList(fromRes[i],
+                                                    t[i]->fromPartitioning);
+        if (toRes && toRes[i])
+            toList[i] = laik_reservation_getMList(toRes[i],
+                                                  t[i]->toPartitioning);
     }
 
+    Laik_ActionSeq* as = prepareTransASeq(n, d, t, fromList, toList);
+    free(fromList);
+
     if (laik_log_begin(2)) {
         laik_log_append("calculated ");
         laik_log_ActionSeq(as, laik_log_shown(1));
@@ -1248,55 +1668,83 @@ Laik_ActionSeq* laik_calc_actions(Laik_Data* d,
     return as;
 }
 
-// execute a previously calculated transition on a data container
+// execute a previously calculated action sequence, doing the transitions
+// of all containers recorded in it
 void laik_exec_actions(Laik_ActionSeq* as)
 {
-    Laik_TransitionContext* tc = as->context[0];
-    Laik_Transition* t = tc->transition;
-    Laik_Data* d = tc->data;
-
-    if (laik_log_begin(1)) {
-        laik_log_append("exec action seq '%s' for transition ", as->name);
-        laik_log_Transition(t, false);
-        laik_log_flush(" on data '%s'", d->name);
+    int n = as->contextCount;
+    Laik_Data** d = malloc(n * sizeof(Laik_Data*));
+    Laik_Transition** t = malloc(n * sizeof(Laik_Transition*));
+    Laik_MappingList** toList = malloc(n * sizeof(Laik_MappingList*));
+    if (!d || !t || !toList) {
+        laik_panic("Out of memory in laik_exec_actions");
+        exit(1); // not actually needed, laik_panic never returns
     }
 
-    // we only can execute transtion if start state in transition is correct
-    if (d->activePartitioning != t->fromPartitioning) {
-        laik_panic("laik_exec_actions starts in wrong partitioning!");
-        exit(1);
-    }
+    for(int i = 0; i < n; i++) {
+        Laik_TransitionContext* tc = as->context[i];
+        t[i] = tc->transition;
+        d[i] = tc->data;
 
-    Laik_MappingList* toList = prepareMaps(d, t->toPartitioning);
+        if (laik_log_begin(1)) {
+            laik_log_append("exec action seq '%s' for transition ", as->name);
+            laik_log_Transition(t[i], false);
+            laik_log_flush(" on data '%s'", d[i]->name);
+        }
 
-    if (tc->prepFromList && (tc->prepFromList != d->activeMappings)) {
-        laik_panic("laik_exec_actions: start mappings mismatch!");
-        exit(1);
-    }
-    if (tc->prepToList && (tc->prepToList != toList)) {
-        laik_panic("laik_exec_actions: end mappings mismatch!");
-        exit(1);
-    }
+        // we only can execute transtion if start state in transition is correct
+        if (d[i]->activePartitioning != t[i]->fromPartitioning) {
+            laik_panic("laik_exec_actions starts in wrong partitioning!");
+            exit(1);
+        }
 
-    // only execute by backend which optimized the sequence
-    if (as->backend)
-        assert(as->backend == d->space->inst->backend);
+        toList[i] = prepareMaps(d[i], t[i]->toPartitioning);
 
-    doTransition(d, t, as, d->activeMappings, toList);
+        if (tc->prepFromList && (tc->prepFromList != d[i]->activeMappings)) {
+            laik_panic("laik_exec_actions: start mappings mismatch!");
+            exit(1);
+        }
+        if (tc->prepToList && (tc->prepToList != toList[i])) {
+            laik_panic("laik_exec_actions: end mappings mismatch!");
+            exit(1);
+        }
+
+        // only execute by backend which optimized the sequence
+        if (as->backend)
+            assert(as->backend == d[i]->space->inst->backend);
+    }
+
+    doTransitions(n, d, t, as, toList, false);
 
     // set new mapping/partitioning active
-    d->activePartitioning = t->toPartitioning;
-    d->activeMappings = toList;
+    for(int i = 0; i < n; i++) {
+        d[i]->activePartitioning = t[i]->toPartitioning;
+        d[i]->activeMappings = toList[i];
+    }
+    free(d);
+    free(t);
+    free(toList);
 }
 
 
-// switch to given partitioning
-void laik_switchto_partitioning(Laik_Data* d,
-                                Laik_Partitioning* toP, Laik_DataFlow flow,
-                                Laik_ReductionOperation redOp)
+// start switching to given partitioning, and finish if not <split>.
+// with a switch involving a temporary common group, never split
+static
+void switchtoPartitioning(Laik_SwitchHandle* h, Laik_Data* d,
+                          Laik_Partitioning* toP, Laik_DataFlow flow,
+                          Laik_ReductionOperation redOp, bool split)
 {
+    h->done = true;
+    if (d->activeSwitch) {
+        laik_panic("Switch of data with split-phase switch in progress!");
+        exit(1); // not actually needed, laik_panic never returns
+    }
+
     // calculate actions to be done for switching
 
+    // ranges needed for transition calculation (with own groups)
+    laik_partitioning_prepare_transition(d->activePartitioning, toP, redOp);
+
     Laik_Group *toGroup = 0, *fromGroup = 0, *commonGroup = 0;
     if (d->activePartitioning) {
         if (toP && (d->activePartitioning->group != toP->group)) {
@@ -1304,8 +1752,9 @@ void laik_switchto_partitioning(Laik_Data* d,
             toGroup = toP->group;
             fromGroup = d->activePartitioning->group;
             commonGroup = laik_new_union_group(fromGroup, toGroup);
-            laik_partitioning_migrate(d->activePartitioning, commonGroup);
-            laik_partitioning_migrate(toP, commonGroup);
+            laik_partitioning_migrate_ranges(d->activePartitioning, commonGroup);
+            laik_partitioning_migrate_ranges(toP, commonGroup);
+            split = false;
         }
     }
     else {
@@ -1316,16 +1765,44 @@ void laik_switchto_partitioning(Laik_Data* d,
     }
 
     Laik_MappingList* toList = prepareMaps(d, toP);
-    Laik_Transition* t = do_calc_transition(d->space,
-                                            d->activePartitioning, toP,
-                                            flow, redOp);
 
-    doTransition(d, t, 0, d->activeMappings, toList);
+    // reuse transition/actions from previous switch with same parameters.
+    // not done if migrating to a temporary common group
+    Laik_SwitchCacheEntry* e = 0;
+    bool useCache = switch_cache && !commonGroup && d->activePartitioning && toP;
+    if (useCache) {
+        e = findSwitchCacheEntry(d, d->activePartitioning, toP, flow, redOp);
+        if (d->stat) {
+            if (e) d->stat->transCacheHits++;
+            else d->stat->transCacheMisses++;
+        }
+    }
+
+    Laik_Transition* t;
+    if (e)
+        t = e->t;
+    else {
+        t = do_calc_transition(d->space,
+                               d->activePartitioning, toP,
+                               flow, redOp);
+        if (useCache && t)
+            e = addSwitchCacheEntry(d, t);
+    }
+
+    Laik_ActionSeq* as = 0;
+    if (e)
+        as = getSwitchCacheASeq(d, e, d->activeMappings, toList);
+
+    startTransition(h, d, t, as, d->activeMappings, toList, split);
+    // transitions not in cache are not needed any more after the switch
+    h->freeTransition = (e == 0);
+    if (!split)
+        finishTransition(h);
 
     // if we migrated to common group before, migrate back
     if (commonGroup) {
-        laik_partitioning_migrate(d->activePartitioning, fromGroup);
-        laik_partitioning_migrate(toP, toGroup);
+        laik_partitioning_migrate_ranges(d->activePartitioning, fromGroup);
+        laik_partitioning_migrate_ranges(toP, toGroup);
     }
 
     // set new mapping/partitioning active
@@ -1333,6 +1810,214 @@ void laik_switchto_partitioning(Laik_Data* d,
     d->activeMappings = toList;
 }
 
+// switch to given partitioning
+void laik_switchto_partitioning(Laik_Data* d,
+                                Laik_Partitioning* toP, Laik_DataFlow flow,
+                                Laik_ReductionOperation redOp)
+{
+    Laik_SwitchHandle h;
+    switchtoPartitioning(&h, d, toP, flow, redOp, false);
+}
+
+// switch multiple containers to given partitionings, with communication
+// of all transitions done in one exchange (see data.h)
+void laik_switchto_partitionings(int n, Laik_Data** d,
+                                 Laik_Partitioning** toP, Laik_DataFlow flow,
+                                 Laik_ReductionOperation redOp)
+{
+    // containers switched together, transitions, and new mappings
+    Laik_Data** dd = malloc(n * sizeof(Laik_Data*));
+    Laik_Partitioning** pp = malloc(n * sizeof(Laik_Partitioning*));
+    Laik_Transition** t = malloc(n * sizeof(Laik_Transition*));
+    Laik_MappingList** toList = malloc(n * sizeof(Laik_MappingList*));
+    bool* cached = malloc(n * sizeof(bool));
+    if (!dd || !pp || !t || !toList || !cached) {
+        laik_panic("Out of memory in laik_switchto_partitionings");
+        exit(1); // not actually needed, laik_panic never returns
+    }
+
+    // containers not in the process group of the first one (or without
+    // active/new partitioning) are switched separately
+    Laik_Group* g = 0;
+    int count = 0;
+    for(int i = 0; i < n; i++) {
+        Laik_Partitioning* fromP = d[i]->activePartitioning;
+        if (d[i]->activeSwitch) {
+            laik_panic("Switch of data with split-phase switch in progress!");
+            exit(1); // not actually needed, laik_panic never returns
+        }
+        for(int j = 0; j < i; j++)
+            assert(d[j] != d[i]);
+
+        if (fromP && toP[i] && (fromP->group == toP[i]->group) &&
+            (fromP->group->myid >= 0) && (!g || (g == fromP->group))) {
+            g = fromP->group;
+            dd[count] = d[i];
+            pp[count] = toP[i];
+            count++;
+            continue;
+        }
+        laik_switchto_partitioning(d[i], toP[i], flow, redOp);
+    }
+    if (count == 0) {
+        free(dd); free(pp); free(t); free(toList); free(cached);
+        return;
+    }
+
+    laik_log(1, "switch %d containers together (first '%s' to '%s')",
+             count, dd[0]->name, pp[0]->name);
+
+    // reuse transitions from previous switches with same parameters,
+    // calculate the others (in parallel if possible)
+    int missing = 0;
+    for(int i = 0; i < count; i++) {
+        // ranges needed for transition calculation and mappings
+        laik_partitioning_prepare_transition(dd[i]->activePartitioning,
+                                             pp[i], redOp);
+        Laik_SwitchCacheEntry* e = 0;
+        if (switch_cache) {
+            e = findSwitchCacheEntry(dd[i], dd[i]->activePartitioning, pp[i],
+                                     flow, redOp);
+            if (dd[i]->stat) {
+                if (e) dd[i]->stat->transCacheHits++;
+                else dd[i]->stat->transCacheMisses++;
+            }
+        }
+        t[i] = e ? e->t : 0;
+        cached[i] = (e != 0);
+        if (!e) missing++;
+    }
+    if (missing > 0) {
+        // calculate into the slots of containers without cached transition
+        Laik_Data** md = malloc(missing * sizeof(Laik_Data*));
+        Laik_Partitioning** mp = malloc(missing * sizeof(Laik_Partitioning*));
+        Laik_Transition** mt = malloc(missing * sizeof(Laik_Transition*));
+        if (!md || !mp || !mt) {
+            laik_panic("Out of memory in laik_switchto_partitionings");
+            exit(1); // not actually needed, laik_panic never returns
+        }
+        int m = 0;
+        for(int i = 0; i < count; i++) {
+            if (cached[i]) continue;
+            md[m] = dd[i];
+            mp[m] = pp[i];
+            m++;
+        }
+        laik_calc_transitions(missing, md, mp, flow, redOp, mt);
+        m = 0;
+        for(int i = 0; i < count; i++) {
+            if (cached[i]) continue;
+            t[i] = mt[m++];
+            assert(t[i] != 0);
+            if (switch_cache) {
+                addSwitchCacheEntry(dd[i], t[i]);
+                cached[i] = true;
+            }
+        }
+        free(md);
+        free(mp);
+        free(mt);
+    }
+
+    for(int i = 0; i < count; i++)
+        toList[i] = prepareMaps(dd[i], pp[i]);
+
+    // transitions not in cache are not needed any more after the switch
+    doTransitions(count, dd, t, 0, toList, !switch_cache);
+
+    // set new mapping/partitioning active
+    for(int i = 0; i < count; i++) {
+        dd[i]->activePartitioning = pp[i];
+        dd[i]->activeMappings = toList[i];
+    }
+    free(dd);
+    free(pp);
+    free(t);
+    free(toList);
+    free(cached);
+}
+
+// start split-phase switch to given partitioning
+Laik_SwitchHandle* laik_switchto_begin(Laik_Data* d,
+                                       Laik_Partitioning* toP,
+                                       Laik_DataFlow flow,
+                                       Laik_ReductionOperation redOp)
+{
+    Laik_SwitchHandle* h = malloc(sizeof(Laik_SwitchHandle));
+    if (!h) {
+        laik_panic("Out of memory allocating Laik_SwitchHandle object");
+        exit(1); // not actually needed, laik_panic never returns
+    }
+
+    laik_log(1, "begin split-phase switch of data '%s' to '%s'",
+             d->name, toP ? toP->name : "(none)");
+
+    switchtoPartitioning(h, d, toP, flow, redOp, true);
+    h->data = d;
+    if (!h->done)
+        d->activeSwitch = h;
+
+    return h;
+}
+
+// finish split-phase switch, waiting for communication to complete
+void laik_switchto_end(Laik_SwitchHandle* h)
+{
+    Laik_Data* d = h->data;
+
+    laik_log(1, "end split-phase switch of data '%s'", d->name);
+
+    if (!h->done) {
+        assert(d->activeSwitch == h);
+        finishTransition(h);
+        d->activeSwitch = 0;
+    }
+    free(h);
+}
+
+// bytes this process would send/receive when switching <d> to <toP>
+// (preserving data). The transition is calculated and kept in the switch
+// cache, so a following switch to <toP> does not calculate it again
+void laik_data_migration_bytes(Laik_Data* d, Laik_Partitioning* toP,
+                               uint64_t* sendBytes, uint64_t* recvBytes)
+{
+    Laik_Partitioning* fromP = d->activePartitioning;
+    if (sendBytes) *sendBytes = 0;
+    if (recvBytes) *recvBytes = 0;
+    if (!fromP || !toP) return;
+    if (fromP->group != toP->group) {
+        laik_panic("laik_data_migration_bytes: partitionings of different groups");
+        exit(1); // not actually needed, laik_panic never returns
+    }
+
+    laik_partitioning_prepare_transition(fromP, toP, LAIK_RO_None);
+
+    Laik_SwitchCacheEntry* e = 0;
+    if (switch_cache)
+        e = findSwitchCacheEntry(d, fromP, toP, LAIK_DF_Preserve, LAIK_RO_None);
+    Laik_Transition* t;
+    if (e)
+        t = e->t;
+    else {
+        t = do_calc_transition(d->space, fromP, toP,
+                               LAIK_DF_Preserve, LAIK_RO_None);
+        if (switch_cache && t)
+            e = addSwitchCacheEntry(d, t);
+    }
+    if (!t) return;
+
+    uint64_t sent = 0, received = 0;
+    for(int i = 0; i < t->sendCount; i++)
+        sent += laik_range_size(&(t->send[i].range));
+    for(int i = 0; i < t->recvCount; i++)
+        received += laik_range_size(&(t->recv[i].range));
+    if (sendBytes) *sendBytes = sent * d->elemsize;
+    if (recvBytes) *recvBytes = received * d->elemsize;
+
+    if (!e)
+        laik_free_transition(t);
+}
+
 
 // switch to another data flow, keep partitioning
 void laik_switchto_flow(Laik_Data* d,
@@ -1397,6 +2082,32 @@ void laik_fill_double(Laik_Data* d, double v)
         base[i] = v;
 }
 
+// collective: element-wise reduction of <n> values of type <t> in <buf>
+// over all processes of group <g>, using a temporary container <name>
+void laik_allreduce(Laik_Group* g, Laik_Type* t, int n, void* buf,
+                    Laik_ReductionOperation op, const char* name)
+{
+    Laik_Space* s = laik_new_space_1d(g->inst, n);
+    Laik_Partitioning* pAll = laik_new_partitioning(laik_All, g, s, 0);
+    Laik_Data* d = laik_new_data(s, t);
+    laik_data_set_name(d, (char*) name);
+
+    void* base;
+    uint64_t count;
+    laik_switchto_partitioning(d, pAll, LAIK_DF_None, LAIK_RO_None);
+    laik_get_map_1d(d, 0, &base, &count);
+    assert(count == (uint64_t) n);
+    memcpy(base, buf, (uint64_t) n * t->size);
+    laik_switchto_flow(d, LAIK_DF_Preserve, op);
+    laik_get_map_1d(d, 0, &base, &count);
+    memcpy(buf, base, (uint64_t) n * t->size);
+
+    laik_switchto_partitioning(d, 0, LAIK_DF_None, LAIK_RO_None);
+    laik_free(d);
+    laik_free_partitioning(pAll);
+    laik_free_space(s);
+}
+
 // for a local index (1d/2d/3d), return offset into memory mapping
 // e.g. for (0) / (0,0) / (0,0,0) it returns offset 0
 int64_t laik_offset(Laik_Layout* l, int section, Laik_Index* idx)
@@ -1618,6 +2329,9 @@ void laik_free(Laik_Data* d)
 {
     // TODO: free space, partitionings
 
+    invalidateSwitchCache(d, 0);
+    laik_removeDataFromInstance(d->space->inst, d);
+
     free(d);
 }
 
@@ -1627,14 +2341,14 @@ void laik_free(Laik_Data* d)
 //
 
 // default malloc/free functions
-void* def_malloc(Laik_Data* d, size_t size)
+void* laik_def_malloc(Laik_Data* d, size_t size)
 {
     (void)d; // not used in this implementation of interface
 
     return malloc(size);
 }
 
-void def_free(Laik_Data* d, void* ptr)
+void laik_def_free(Laik_Data* d, void* ptr)
 {
     (void)d; // not used in this implementation of interface
 
@@ -1657,6 +2371,7 @@ Laik_Allocator* laik_new_allocator(Laik_malloc_t malloc_func,
     a->free = free_func;
     a->realloc = realloc_func;
     a->unmap = 0;   // no notification
+    a->pool = 0;    // created on first use with LAIK_MP_UsePool
 
     return a;
 }
@@ -1676,7 +2391,7 @@ Laik_Allocator* laik_get_allocator(Laik_Data* d)
 // returns an allocator with default policy LAIK_MP_NewAllocOnRepartition
 Laik_Allocator* laik_new_allocator_def()
 {
-    Laik_Allocator* a = laik_new_allocator(def_malloc, def_free, 0);
+    Laik_Allocator* a = laik_new_allocator(laik_def_malloc, laik_def_free, 0);
     a->policy = LAIK_MP_NewAllocOnRepartition;
 
     return a;
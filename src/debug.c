@@ -289,8 +289,8 @@ void laik_log_Partitioning(Laik_Partitioning* p)
             laik_log_append("(run filtered with task %d): ", e->filter_tid);
             break;
         case LAIK_RI_INTERSECT:
-            laik_log_append("(run filtered with intersection with part '%s'): ",
-                            e->other);
+            laik_log_append("(run filtered with intersection with part id %d): ",
+                            e->otherId);
             break;
         }
         laik_log_RangeList(e->ranges);
@@ -320,6 +320,11 @@ void laik_log_SwitchStat(Laik_SwitchStat* ss)
 {
     laik_log_append("%d switches (%d without actions, %d transitions)\n",
                     ss->switches, ss->switches_noactions, ss->transitionCount);
+    if (ss->transCacheHits + ss->transCacheMisses > 0)
+        laik_log_append("    switch cache: transitions %d hits / %d misses, "
+                        "action seqs %d hits / %d misses\n",
+                        ss->transCacheHits, ss->transCacheMisses,
+                        ss->aseqCacheHits, ss->aseqCacheMisses);
     if (ss->switches == ss->switches_noactions) return;
 
     if (ss->mallocCount > 0) {
@@ -327,7 +332,13 @@ void laik_log_SwitchStat(Laik_SwitchStat* ss)
         laik_log_PrettyInt(ss->mallocedBytes);
         laik_log_append("B (max ");
         laik_log_PrettyInt(ss->maxAllocedBytes);
-        laik_log_append("B), free: %dx, ", ss->freeCount);
+        laik_log_append("B)");
+        if (ss->poolHitCount > 0) {
+            laik_log_append(" (%dx from pool, ", ss->poolHitCount);
+            laik_log_PrettyInt(ss->poolHitBytes);
+            laik_log_append("B)");
+        }
+        laik_log_append(", free: %dx, ", ss->freeCount);
         laik_log_PrettyInt(ss->freedBytes);
         laik_log_append("B, init ");
         laik_log_PrettyInt(ss->initedBytes);
@@ -729,11 +740,10 @@ void laik_log_ActionSeq(Laik_ActionSeq *as, bool showDetails)
     Laik_TransitionContext* tc = 0;
     for(int i = 0; i < as->contextCount; i++) {
         tc = as->context[i];
-        laik_log_append("  transition %d: ", 0);
+        laik_log_append("  transition %d: ", i);
         laik_log_Transition(tc->transition, false);
         laik_log_append(" on data '%s'\n", tc->data->name);
     }
-    assert(as->contextCount == 1);
     if (!showDetails) return;
 
     for(int i = 0; i < as->bufferCount; i++) {
@@ -18,9 +18,6 @@
 
 #include <laik-internal.h>
 
-// for string.h to declare strdup
-#define __STDC_WANT_LIB_EXT2__ 1
-
 #include <assert.h>
 #include <string.h>
 
@@ -185,10 +182,22 @@ static int entrycmp(const void * v1, const void * v2)
     return strcmp(e1->key, e2->key);
 }
 
+// for qsort in laik_kvs_changes_sort: changes for same key ordered by
+// position in data array, i.e. by time of change
+static int changecmp(const void * v1, const void * v2)
+{
+    const Laik_KVS_Entry* e1 = (const Laik_KVS_Entry*) v1;
+    const Laik_KVS_Entry* e2 = (const Laik_KVS_Entry*) v2;
+    int res = strcmp(e1->key, e2->key);
+    if (res != 0) return res;
+    return (e1->key < e2->key) ? -1 : 1;
+}
+
 void laik_kvs_changes_sort(Laik_KVS_Changes* c)
 {
     // first fill entry array from data/offset array, then sort
-    // this array by keys
+    // this array by keys. If a key was changed multiple times, only
+    // the last change is kept in the entry array (offsets unchanged)
 
     if (c->offUsed == 0) return;
     assert((c->offUsed & 1) == 1); // must be odd number if not 0
@@ -217,7 +226,15 @@ void laik_kvs_changes_sort(Laik_KVS_Changes* c)
     assert(c->entryUsed * 2 + 1 == c->offUsed);
 
     // now sort
-    qsort(c->entry, (size_t) c->entryUsed, sizeof(Laik_KVS_Entry), entrycmp);
+    qsort(c->entry, (size_t) c->entryUsed, sizeof(Laik_KVS_Entry), changecmp);
+
+    int used = 0;
+    for(int i = 0; i < c->entryUsed; i++) {
+        if ((i + 1 < c->entryUsed) &&
+            (strcmp(c->entry[i].key, c->entry[i + 1].key) == 0)) continue;
+        c->entry[used++] = c->entry[i];
+    }
+    c->entryUsed = used;
 }
 
 void laik_kvs_changes_merge(Laik_KVS_Changes* dst,
@@ -284,10 +301,108 @@ void laik_kvs_changes_apply(Laik_KVS_Changes* c, Laik_KVStore *kvs)
     }
 }
 
+// apply sorted changes <c> except entries also found in sorted changes <own>
+// (own changes from this process already are set in <kvs>)
+void laik_kvs_changes_apply_other(Laik_KVS_Changes* c, Laik_KVS_Changes* own,
+                                  Laik_KVStore *kvs)
+{
+    int off = 0, skipped = 0;
+    for(int i = 0; i < c->entryUsed; i++) {
+        Laik_KVS_Entry* e = c->entry + i;
+        int res = 1;
+        while(off < own->entryUsed) {
+            res = strcmp(own->entry[off].key, e->key);
+            if (res >= 0) break;
+            off++;
+        }
+        if ((res == 0) && (own->entry[off].vlen == e->vlen) &&
+            (memcmp(own->entry[off].value, e->value, e->vlen) == 0)) {
+            skipped++;
+            continue;
+        }
+        laik_kvs_set(kvs, e->key, e->vlen, e->value);
+    }
+    laik_log(1, "KVS '%s': applied %d changes, %d own skipped",
+             kvs->name, c->entryUsed - skipped, skipped);
+}
+
 
 //
 // Laik_KVStore
 //
+// Entries are found via an open-addressing hash index over keys (linear
+// probing), rebuilt when entries get reordered by sorting. Keys and values
+// are stored in an arena of chunks: values are updated in place if they
+// fit into the space used before, otherwise new space is taken from the
+// arena (old space only gets freed with the store).
+
+#define KVS_CHUNKSIZE (64 * 1024)
+
+struct _Laik_KVS_Chunk {
+    Laik_KVS_Chunk* next;
+    size_t size, used;
+    char data[];
+};
+
+static char* arena_alloc(Laik_KVStore* kvs, size_t size)
+{
+    size = (size + 7) & ~((size_t) 7);
+    Laik_KVS_Chunk* c = kvs->arena;
+    if (!c || (c->used + size > c->size)) {
+        size_t csize = (size > KVS_CHUNKSIZE) ? size : KVS_CHUNKSIZE;
+        c = (Laik_KVS_Chunk*) malloc(sizeof(Laik_KVS_Chunk) + csize);
+        if (!c) {
+            laik_panic("Out of memory allocating memory for Laik_KVStore");
+            exit(1); // not actually needed, laik_panic never returns
+        }
+        c->size = csize;
+        c->used = 0;
+        c->next = kvs->arena;
+        kvs->arena = c;
+    }
+    char* p = c->data + c->used;
+    c->used += size;
+    return p;
+}
+
+// FNV-1a
+static unsigned int key_hash(const char* key)
+{
+    uint64_t h = 14695981039346656037ull;
+    for(; *key; key++) {
+        h ^= (unsigned char) *key;
+        h *= 1099511628211ull;
+    }
+    return (unsigned int) (h ^ (h >> 32));
+}
+
+static void hash_insert(Laik_KVStore* kvs, unsigned int i)
+{
+    unsigned int mask = kvs->hashSize - 1;
+    unsigned int h = key_hash(kvs->entry[i].key) & mask;
+    while(kvs->hash[h] != 0)
+        h = (h + 1) & mask;
+    kvs->hash[h] = i + 1;
+}
+
+// rebuild hash index with at least 2x space of <n> entries
+static void hash_rebuild(Laik_KVStore* kvs, unsigned int n)
+{
+    unsigned int size = kvs->hashSize;
+    while(size < 2 * n) size *= 2;
+    if (size != kvs->hashSize) {
+        free(kvs->hash);
+        kvs->hash = (unsigned int*) malloc(size * sizeof(unsigned int));
+        if (!kvs->hash) {
+            laik_panic("Out of memory allocating memory for Laik_KVStore");
+            exit(1); // not actually needed, laik_panic never returns
+        }
+        kvs->hashSize = size;
+    }
+    memset(kvs->hash, 0, size * sizeof(unsigned int));
+    for(unsigned int i = 0; i < kvs->used; i++)
+        hash_insert(kvs, i);
+}
 
 Laik_KVStore* laik_kvs_new(const char* name, Laik_Instance *inst)
 {
@@ -301,6 +416,14 @@ Laik_KVStore* laik_kvs_new(const char* name, Laik_Instance *inst)
     kvs->used = 0;
     kvs->sorted_upto = 0;
 
+    kvs->hashSize = 1024;
+    kvs->hash = (unsigned int*) calloc(kvs->hashSize, sizeof(unsigned int));
+    if (!kvs->hash) {
+        laik_panic("Out of memory allocating memory for Laik_KVStore");
+        exit(1); // not actually needed, laik_panic never returns
+    }
+    kvs->arena = 0;
+
     kvs->created_func = 0;
     kvs->changed_func = 0;
     kvs->removed_func = 0;
@@ -317,6 +440,12 @@ void laik_kvs_free(Laik_KVStore* kvs)
     assert(kvs);
 
     free(kvs->entry);
+    free(kvs->hash);
+    while(kvs->arena) {
+        Laik_KVS_Chunk* c = kvs->arena;
+        kvs->arena = c->next;
+        free(c);
+    }
     laik_kvs_changes_free(&(kvs->changes));
     free(kvs);
 }
@@ -328,9 +457,9 @@ static void remove_entry(Laik_KVStore* kvs, Laik_KVS_Entry* e)
         (kvs->removed_func)(kvs, e->key);
 
     // key of removed entry still exists but with empty data
-    free(e->value);
     e->value = 0;
     e->vlen = 0;
+    e->vcap = 0;
     e->data = 0;
 
     if (!kvs->in_sync)
@@ -371,12 +500,11 @@ Laik_KVS_Entry* laik_kvs_set(Laik_KVStore* kvs, char* key, unsigned int size, ch
     bool created;
     if (e) {
         if (e->value) {
-            if (memcmp(e->value, value, (size_t) size) == 0) {
+            if ((e->vlen == size) && (memcmp(e->value, value, (size_t) size) == 0)) {
                 laik_log(1, "KVS '%s': entry '%s' (size %d, '%.20s') already existing",
                          kvs->name, key, size, value);
                 return e;
             }
-            free(e->value);
             created = false;
         }
         else {
@@ -393,11 +521,20 @@ Laik_KVS_Entry* laik_kvs_set(Laik_KVStore* kvs, char* key, unsigned int size, ch
         }
         e = &kvs->entry[kvs->used];
         kvs->used++;
-        e->key = strdup(key);
+        size_t klen = strlen(key) + 1;
+        e->key = arena_alloc(kvs, klen);
+        memcpy(e->key, key, klen);
         e->value = 0;
+        e->vlen = 0;
+        e->vcap = 0;
         e->data = 0;
         e->updated = false;
         created = true;
+
+        if (2 * kvs->used > kvs->hashSize)
+            hash_rebuild(kvs, kvs->used);
+        else
+            hash_insert(kvs, kvs->used - 1);
     }
 
     if (e->updated && kvs->in_sync) {
@@ -408,8 +545,11 @@ Laik_KVS_Entry* laik_kvs_set(Laik_KVStore* kvs, char* key, unsigned int size, ch
         exit(1);
     }
 
-    e->value = (char*) malloc(size);
-    assert(e->value);
+    // in-place update if new value fits
+    if (!e->value || (size > e->vcap)) {
+        e->value = arena_alloc(kvs, size);
+        e->vcap = size;
+    }
     memcpy(e->value, value, size);
     e->vlen = size;
 
@@ -466,32 +606,14 @@ void laik_kvs_sync(Laik_KVStore* kvs)
 
 Laik_KVS_Entry* laik_kvs_entry(Laik_KVStore* kvs, char* key)
 {
-    Laik_KVS_Entry* e;
-
-    // do binary search in range [0 .. (sorted_upto-1)]
-    int low = 0, high = ((int)kvs->sorted_upto) - 1, mid, res;
-    //laik_log(1, "  binary search in KVS '%s' for '%s' in [%d,%d]",
-    //         kvs->name, key, low, high);
-    while(low <= high) {
-        mid = (low + high) / 2;
-        e = &(kvs->entry[mid]);
-        res = strcmp(key, e->key);
-        //laik_log(1, "    test [%d] '%s': %d", mid, e->key, res);
-        if (res == 0)
-            return e;
-        if (res < 0)
-            high = mid-1;
-        else
-            low = mid+1;
-    }
-
-    // linear search for unsorted items
-    for(unsigned int i = kvs->sorted_upto; i < kvs->used; i++) {
-        e = &(kvs->entry[i]);
+    unsigned int mask = kvs->hashSize - 1;
+    unsigned int h = key_hash(key) & mask;
+    while(kvs->hash[h] != 0) {
+        Laik_KVS_Entry* e = &(kvs->entry[kvs->hash[h] - 1]);
         if (strcmp(e->key, key) == 0)
             return e;
+        h = (h + 1) & mask;
     }
-
     return 0;
 }
 
@@ -544,10 +666,36 @@ unsigned int laik_kvs_copy(Laik_KVS_Entry* e, char* mem, unsigned int size)
     return size;
 }
 
+// only new entries get sorted, and merged with already sorted ones
 void laik_kvs_sort(Laik_KVStore* kvs)
 {
-    qsort(kvs->entry, kvs->used, sizeof(Laik_KVS_Entry), entrycmp);
-    kvs->sorted_upto = kvs->used;
+    unsigned int n = kvs->used, sorted = kvs->sorted_upto;
+    if (sorted == n) return;
+
+    Laik_KVS_Entry* e = kvs->entry;
+    qsort(e + sorted, n - sorted, sizeof(Laik_KVS_Entry), entrycmp);
+    if ((sorted > 0) && (strcmp(e[sorted - 1].key, e[sorted].key) > 0)) {
+        Laik_KVS_Entry* tmp = (Laik_KVS_Entry*) malloc(n * sizeof(Laik_KVS_Entry));
+        if (!tmp) {
+            laik_panic("Out of memory allocating memory for Laik_KVStore");
+            exit(1); // not actually needed, laik_panic never returns
+        }
+        unsigned int i1 = 0, i2 = sorted, o = 0;
+        while((i1 < sorted) && (i2 < n)) {
+            if (strcmp(e[i1].key, e[i2].key) < 0)
+                tmp[o++] = e[i1++];
+            else
+                tmp[o++] = e[i2++];
+        }
+        while(i1 < sorted) tmp[o++] = e[i1++];
+        while(i2 < n) tmp[o++] = e[i2++];
+        memcpy(e, tmp, n * sizeof(Laik_KVS_Entry));
+        free(tmp);
+    }
+    kvs->sorted_upto = n;
+
+    // entries moved
+    hash_rebuild(kvs, n);
 }
 
 void laik_kvs_reg_callbacks(Laik_KVStore* kvs,
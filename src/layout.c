@@ -27,6 +27,69 @@
 // this file:
 // - generic interface implementations
 // - implementation of lexicographical layout
+// - copy kernels to be used by layout implementations
+
+
+//--------------------------------------------------------------
+// copy kernels
+//
+// with GCC on x86-64 Linux, the element-size specific kernels are compiled
+// in multiple versions (AVX-512, AVX2, default), selected at runtime
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && defined(__linux__)
+#define LAIK_TARGET_CLONES __attribute__((target_clones("avx512f","avx2","default")))
+#else
+#define LAIK_TARGET_CLONES
+#endif
+
+// blocks with at least this number of bytes are copied with memcpy
+#define COPY_MEMCPY_MIN 64
+
+// kernels for element sizes 4/8/16: constant-size memcpy compiles
+// to plain loads/stores without alignment and aliasing issues
+#define COPY_BLOCKS_KERNEL(esize) \
+LAIK_TARGET_CLONES \
+static void copy_blocks_##esize(char* restrict to, uint64_t toStride, \
+                                const char* restrict from, uint64_t fromStride, \
+                                uint64_t len, uint64_t count) \
+{ \
+    for(uint64_t b = 0; b < count; b++) { \
+        char* t = to + b * toStride * esize; \
+        const char* f = from + b * fromStride * esize; \
+        for(uint64_t i = 0; i < len; i++) \
+            memcpy(t + i * esize, f + i * esize, esize); \
+    } \
+}
+
+COPY_BLOCKS_KERNEL(4)
+COPY_BLOCKS_KERNEL(8)
+COPY_BLOCKS_KERNEL(16)
+
+// contiguous blocks are copied with one memcpy, small blocks of
+// common element sizes with specialized kernels
+void laik_copy_blocks(char* to, uint64_t toStride,
+                      const char* from, uint64_t fromStride,
+                      uint64_t len, uint64_t count, unsigned int elemsize)
+{
+    if ((len == 0) || (count == 0)) return;
+
+    if ((count == 1) || ((toStride == len) && (fromStride == len))) {
+        memcpy(to, from, len * count * elemsize);
+        return;
+    }
+
+    if (len * elemsize < COPY_MEMCPY_MIN) {
+        switch(elemsize) {
+        case 4:  copy_blocks_4(to, toStride, from, fromStride, len, count); return;
+        case 8:  copy_blocks_8(to, toStride, from, fromStride, len, count); return;
+        case 16: copy_blocks_16(to, toStride, from, fromStride, len, count); return;
+        default: break;
+        }
+    }
+
+    for(uint64_t b = 0; b < count; b++)
+        memcpy(to + b * toStride * elemsize,
+               from + b * fromStride * elemsize, len * elemsize);
+}
 
 
 // generic variants of layout interface functions
@@ -123,21 +186,19 @@ unsigned int laik_layout_pack_gen(Laik_Mapping* m, Laik_Range* range,
         laik_log_flush(" into buf (size %d)", size);
     }
 
-    unsigned int count = 0;
+    // elements with consecutive offsets are copied together (<run>)
+    unsigned int count = 0, run = 0;
+    int64_t runOff = 0;
     while(size >= elemsize) {
         int64_t off = layout->offset(layout, m->layoutSection, idx);
-        void* idxPtr = m->start + off * elemsize;
-#if 0
-        if (laik_log_begin(1)) {
-            laik_log_append(" idx ");
-            laik_log_Index(dims, &idx);
-            laik_log_flush(": off %lu (ptr %p), left %d", off, ptr, size);
+        if ((run > 0) && (off != runOff + run)) {
+            memcpy(buf, m->start + runOff * elemsize, run * elemsize);
+            buf += run * elemsize;
+            run = 0;
         }
-#endif
-        // copy element into buffer
-        memcpy(buf, idxPtr, elemsize);
+        if (run == 0) runOff = off;
+        run++;
         size -= elemsize;
-        buf += elemsize;
         count++;
 
         if (!next_lex(range, idx)) {
@@ -145,6 +206,7 @@ unsigned int laik_layout_pack_gen(Laik_Mapping* m, Laik_Range* range,
             break;
         }
     }
+    memcpy(buf, m->start + runOff * elemsize, run * elemsize);
 
     if (laik_log_begin(1)) {
         laik_log_append("        packed '%s': end (", m->data->name);
@@ -184,21 +246,19 @@ unsigned int laik_layout_unpack_gen(Laik_Mapping* m, Laik_Range* range,
         laik_log_flush(" from buf (size %d)", size);
     }
 
-    unsigned int count = 0;
+    // elements with consecutive offsets are copied together (<run>)
+    unsigned int count = 0, run = 0;
+    int64_t runOff = 0;
     while(size >= elemsize) {
         int64_t off = layout->offset(layout, m->layoutSection, idx);
-        void* idxPtr = m->start + off * elemsize;
-#if 0
-        if (laik_log_begin(1)) {
-            laik_log_append(" idx ");
-            laik_log_Index(dims, &idx);
-            laik_log_flush(": off %lu (ptr %p), left %d", off, ptr, size);
+        if ((run > 0) && (off != runOff + run)) {
+            memcpy(m->start + runOff * elemsize, buf, run * elemsize);
+            buf += run * elemsize;
+            run = 0;
         }
-#endif
-        // copy element from buffer into mapping
-        memcpy(idxPtr, buf, elemsize);
+        if (run == 0) runOff = off;
+        run++;
         size -= elemsize;
-        buf += elemsize;
         count++;
 
         if (!next_lex(range, idx)) {
@@ -206,6 +266,7 @@ unsigned int laik_layout_unpack_gen(Laik_Mapping* m, Laik_Range* range,
             break;
         }
     }
+    memcpy(m->start + runOff * elemsize, buf, run * elemsize);
 
     if (laik_log_begin(1)) {
         laik_log_append("        unpacked '%s': end (", m->data->name);
@@ -180,8 +180,8 @@ void copy_lex(Laik_Range* range,
     Laik_Layout_Lex* toLayout = laik_is_layout_lex(to->layout);
     assert(fromLayout != 0);
     assert(toLayout != 0);
-    Lex_Entry* fromLayoutEntry = &(fromLayout->e[0]);
-    Lex_Entry* toLayoutEntry = &(toLayout->e[0]);
+    Lex_Entry* fromLayoutEntry = &(fromLayout->e[from->layoutSection]);
+    Lex_Entry* toLayoutEntry = &(toLayout->e[to->layoutSection]);
 
     unsigned int elemsize = from->data->elemsize;
     assert(elemsize == to->data->elemsize);
@@ -219,13 +219,10 @@ void copy_lex(Laik_Range* range,
     }
 
     for(int64_t i3 = 0; i3 < count.i[2]; i3++) {
-        char *fromPtr2 = fromPtr;
-        char *toPtr2 = toPtr;
-        for(int64_t i2 = 0; i2 < count.i[1]; i2++) {
-            memcpy(toPtr2, fromPtr2, count.i[0] * elemsize);
-            fromPtr2 += fromLayoutEntry->stride[1] * elemsize;
-            toPtr2   += toLayoutEntry->stride[1] * elemsize;
-        }
+        // all rows of a plane at once
+        laik_copy_blocks(toPtr, toLayoutEntry->stride[1],
+                         fromPtr, fromLayoutEntry->stride[1],
+                         count.i[0], count.i[1], elemsize);
         fromPtr += fromLayoutEntry->stride[2] * elemsize;
         toPtr   += toLayoutEntry->stride[2] * elemsize;
     }
@@ -233,20 +230,34 @@ void copy_lex(Laik_Range* range,
 
 
 // pack/unpack routines for lexicographical layout
+//
+// Instead of going over single elements, the index range to process is
+// split into a partial row at start, sequences of full rows within a
+// (z-)plane, and a partial row at end if the buffer is too small.
+// Full rows of multiple planes are merged if rows are contiguous in memory.
+// Each part is copied via laik_copy_blocks().
+
+// copy <count> blocks of <len> elements between mapping and buffer
+static inline
+void packunpack_blocks(bool pack, char* mPtr, uint64_t mStride, char* buf,
+                       uint64_t len, uint64_t count, unsigned int elemsize)
+{
+    if (pack)
+        laik_copy_blocks(buf, len, mPtr, mStride, len, count, elemsize);
+    else
+        laik_copy_blocks(mPtr, mStride, buf, len, len, count, elemsize);
+}
+
 static
-unsigned int pack_lex(Laik_Mapping* m, Laik_Range* s,
-                      Laik_Index* idx, char* buf, unsigned int size)
+unsigned int packunpack_lex(bool pack, Laik_Mapping* m, Laik_Range* s,
+                            Laik_Index* idx, char* buf, unsigned int size)
 {
     unsigned int elemsize = m->data->elemsize;
     Laik_Layout_Lex* layout = laik_is_layout_lex(m->layout);
-    Lex_Entry* layoutEntry = &(layout->e[0]);
+    assert(layout != 0);
+    Lex_Entry* layoutEntry = &(layout->e[m->layoutSection]);
     int dims = m->layout->dims;
 
-    if (laik_index_isEqual(dims, idx, &(s->to))) {
-        // nothing left to pack
-        return 0;
-    }
-
     // TODO: only default layout with order 1/2/3
     assert(layoutEntry->stride[0] == 1);
     if (dims > 1) {
@@ -255,7 +266,7 @@ unsigned int pack_lex(Laik_Mapping* m, Laik_Range* s,
             assert(layoutEntry->stride[1] <= layoutEntry->stride[2]);
     }
 
-    // range to pack must within local valid range of mapping
+    // range to pack from/unpack into must be within local valid range of mapping
     assert(laik_range_within_range(s, &(m->requiredRange)));
 
     // calculate address of starting index
@@ -279,17 +290,21 @@ unsigned int pack_lex(Laik_Mapping* m, Laik_Range* s,
     }
     count = 0;
 
-    // elements to skip after to0 reached
-    int64_t skip0 = layoutEntry->stride[1] - (to0 - from0);
-    // elements to skip after to1 reached
-    int64_t skip1 = layoutEntry->stride[2] - layoutEntry->stride[1] * (to1 - from1);
+    // strides in elements, 0 if not used
+    uint64_t stride1 = (dims > 1) ? layoutEntry->stride[1] : 0;
+    uint64_t stride2 = (dims > 2) ? layoutEntry->stride[2] : 0;
+    uint64_t rowLen = (uint64_t) (to0 - from0);
+    uint64_t planeLen = rowLen * (uint64_t) (to1 - from1);
+    // rows of range contiguous in memory?
+    bool contRows = (dims == 1) || (rowLen == stride1);
 
     if (laik_log_begin(1)) {
         Laik_Index slcsize, localFrom;
         laik_sub_index(&localFrom, &(s->from), &(m->requiredRange.from));
         laik_sub_index(&slcsize, &(s->to), &(s->from));
 
-        laik_log_append("        packing '%s', size (", m->data->name);
+        laik_log_append("        %s '%s', size (",
+                        pack ? "packing" : "unpacking", m->data->name);
         laik_log_Index(dims, &slcsize);
         laik_log_append(") x %d from global (", elemsize);
         laik_log_Index(dims, &(s->from));
@@ -300,40 +315,65 @@ unsigned int pack_lex(Laik_Mapping* m, Laik_Range* s,
         laik_log_flush(") off %lu, buf size %d", idxOff, size);
     }
 
-    bool stop = false;
-    for(; i2 < to2; i2++) {
-        for(; i1 < to1; i1++) {
-            for(; i0 < to0; i0++) {
-                if (size < elemsize) {
-                    stop = true;
-                    break;
-                }
-
-#if DEBUG_PACK
-                laik_log(1, "packing (%lu/%lu/%lu) off %lu: %.3f, left %d",
-                         i0, i1, i2,
-                         (idxPtr - m->base)/elemsize, *(double*)idxPtr,
-                         size - elemsize);
-#endif
-
-                // copy element into buffer
-                memcpy(buf, idxPtr, elemsize);
-
-                idxPtr += elemsize; // stride[0] is 1
-                size -= elemsize;
-                buf += elemsize;
-                count++;
-
+    // number of elements fitting into buffer
+    uint64_t left = size / elemsize;
+    while((i2 < to2) && (left > 0)) {
+        uint64_t n;
+        if ((i0 > from0) || (left < rowLen)) {
+            // partial row
+            n = (uint64_t) (to0 - i0);
+            if (n > left) n = left;
+            packunpack_blocks(pack, idxPtr, n, buf, n, 1, elemsize);
+            i0 += n;
+            if (i0 < to0) {
+                // buffer full
+                idxPtr += n * elemsize;
+                buf += n * elemsize;
+                left -= n;
+                count += n;
+                break;
             }
-            if (stop) break;
-            idxPtr += skip0 * elemsize;
+            // go to start of next row
+            idxPtr += ((int64_t) stride1 - (i0 - (int64_t) n - from0)) * elemsize;
             i0 = from0;
+            i1++;
+        }
+        else if ((i1 == from1) && contRows && (left >= planeLen) && (dims > 2)) {
+            // full planes, each contiguous
+            uint64_t planes = left / planeLen;
+            if (planes > (uint64_t) (to2 - i2)) planes = (uint64_t) (to2 - i2);
+            packunpack_blocks(pack, idxPtr, stride2, buf,
+                              planeLen, planes, elemsize);
+            n = planes * planeLen;
+            idxPtr += planes * stride2 * elemsize;
+            i2 += planes;
+            buf += n * elemsize;
+            left -= n;
+            count += n;
+            continue;
+        }
+        else {
+            // full rows within current plane
+            uint64_t rows = left / rowLen;
+            if (rows > (uint64_t) (to1 - i1)) rows = (uint64_t) (to1 - i1);
+            packunpack_blocks(pack, idxPtr, stride1, buf,
+                              rowLen, rows, elemsize);
+            n = rows * rowLen;
+            idxPtr += rows * stride1 * elemsize;
+            i1 += rows;
+        }
+        buf += n * elemsize;
+        left -= n;
+        count += n;
+
+        if (i1 == to1) {
+            // go to start of next plane
+            idxPtr += ((int64_t) stride2 - (int64_t) stride1 * (to1 - from1)) * elemsize;
+            i1 = from1;
+            i2++;
         }
-        if (stop) break;
-        idxPtr += skip1 * elemsize;
-        i1 = from1;
     }
-    if (!stop) {
+    if (i2 == to2) {
         // we reached end, set i0/i1 to last positions
         i0 = to0;
         i1 = to1;
@@ -343,10 +383,12 @@ unsigned int pack_lex(Laik_Mapping* m, Laik_Range* s,
         Laik_Index idx2;
         laik_index_init(&idx2, i0, i1, i2);
 
-        laik_log_append("        packed '%s': end (", m->data->name);
+        laik_log_append("        %s '%s': end (",
+                        pack ? "packed" : "unpacked", m->data->name);
         laik_log_Index(dims, &idx2);
         laik_log_flush("), %lu elems = %lu bytes, %d left",
-                       count, count * elemsize, size);
+                       count, count * elemsize,
+                       (int) (size - count * elemsize));
     }
 
     // save position we reached
@@ -356,126 +398,26 @@ unsigned int pack_lex(Laik_Mapping* m, Laik_Range* s,
     return count;
 }
 
+static
+unsigned int pack_lex(Laik_Mapping* m, Laik_Range* s,
+                      Laik_Index* idx, char* buf, unsigned int size)
+{
+    if (laik_index_isEqual(m->layout->dims, idx, &(s->to))) {
+        // nothing left to pack
+        return 0;
+    }
+    return packunpack_lex(true, m, s, idx, buf, size);
+}
+
 static
 unsigned int unpack_lex(Laik_Mapping* m, Laik_Range* s,
                         Laik_Index* idx, char* buf, unsigned int size)
 {
-    unsigned int elemsize = m->data->elemsize;
-    Laik_Layout_Lex* layout = laik_is_layout_lex(m->layout);
-    Lex_Entry* layoutEntry = &(layout->e[0]);
-    int dims = m->layout->dims;
-
     // there should be something to unpack
     assert(size > 0);
-    assert(!laik_index_isEqual(dims, idx, &(s->to)));
-
-    // TODO: only default layout with order 1/2/3
-    assert(layoutEntry->stride[0] == 1);
-    if (dims > 1) {
-        assert(layoutEntry->stride[0] <= layoutEntry->stride[1]);
-        if (dims > 2)
-            assert(layoutEntry->stride[1] <= layoutEntry->stride[2]);
-    }
-
-    // range to unpack into must be within local valid range of mapping
-    assert(laik_range_within_range(s, &(m->requiredRange)));
-
-    // calculate address of starting index
-    uint64_t idxOff = offset_lex(m->layout, m->layoutSection, idx);
-    char* idxPtr = m->start + idxOff * elemsize;
-
-    int64_t i0, i1, i2, from0, from1, to0, to1, to2, count;
-    from0 = s->from.i[0];
-    from1 = s->from.i[1];
-    to0 = s->to.i[0];
-    to1 = s->to.i[1];
-    to2 = s->to.i[2];
-    i0 = idx->i[0];
-    i1 = idx->i[1];
-    i2 = idx->i[2];
-    if (dims < 3) {
-        to2 = 1; i2 = 0;
-        if (dims < 2) {
-            from1 = 0; to1 = 1; i1 = 0;
-        }
-    }
-    count = 0;
-
-    // elements to skip after to0 reached
-    uint64_t skip0 = layoutEntry->stride[1] - (to0 - from0);
-    // elements to skip after to1 reached
-    uint64_t skip1 = layoutEntry->stride[2] - layoutEntry->stride[1] * (to1 - from1);
-
-    if (laik_log_begin(1)) {
-        Laik_Index slcsize, localFrom;
-        laik_sub_index(&localFrom, &(s->from), &(m->requiredRange.from));
-        laik_sub_index(&slcsize, &(s->to), &(s->from));
-
-        laik_log_append("        unpacking '%s', size (", m->data->name);
-        laik_log_Index(dims, &slcsize);
-        laik_log_append(") x %d from global (", elemsize);
-        laik_log_Index(dims, &(s->from));
-        laik_log_append(") / local (");
-        laik_log_Index(dims, &localFrom);
-        laik_log_append(")/%d, start (", m->mapNo);
-        laik_log_Index(dims, idx);
-        laik_log_flush(") off %lu, buf size %d", idxOff, size);
-
-    }
-
-    bool stop = false;
-    for(; i2 < to2; i2++) {
-        for(; i1 < to1; i1++) {
-            for(; i0 < to0; i0++) {
-                if (size < elemsize) {
-                    stop = true;
-                    break;
-                }
-
-#ifdef DEBUG_UNPACK
-                laik_log(1, "unpacking (%lu/%lu/%lu) off %lu: %.3f, left %d",
-                         i0, i1, i2,
-                         (idxPtr - m->base)/elemsize, *(double*)buf,
-                         size - elemsize);
-#endif
-                // copy element from buffer into local data
-                memcpy(idxPtr, buf, elemsize);
-
-                idxPtr += elemsize; // stride[0] is 1
-                size -= elemsize;
-                buf += elemsize;
-                count++;
-
-            }
-            if (stop) break;
-            idxPtr += skip0 * elemsize;
-            i0 = from0;
-        }
-        if (stop) break;
-        idxPtr += skip1 * elemsize;
-        i1 = from1;
-    }
-    if (!stop) {
-        // we reached end, set i0/i1 to last positions
-        i0 = to0;
-        i1 = to1;
-    }
-
-    if (laik_log_begin(1)) {
-        Laik_Index idx2;
-        laik_index_init(&idx2, i0, i1, i2);
-
-        laik_log_append("        unpacked '%s': end (", m->data->name);
-        laik_log_Index(dims, &idx2);
-        laik_log_flush("), %lu elems = %lu bytes, %d left",
-                       count, count * elemsize, size);
-    }
+    assert(!laik_index_isEqual(m->layout->dims, idx, &(s->to)));
 
-    // save position we reached
-    idx->i[0] = i0;
-    idx->i[1] = i1;
-    idx->i[2] = i2;
-    return count;
+    return packunpack_lex(false, m, s, idx, buf, size);
 }
 
 
@@ -541,3 +483,31 @@ uint64_t laik_layout_lex_stride(Laik_Layout* l, int n, int d)
 
     return ll->e[n].stride[d];
 }
+
+// return true if <l> is a lexicographical layout
+bool laik_layout_is_lex(Laik_Layout* l)
+{
+    return laik_is_layout_lex(l) != 0;
+}
+
+// return true if range <r> is stored contiguously in map <n> of layout <l>,
+// ie. elements in lexicographical order of <r> are consecutive in memory.
+// Always false if <l> is not a lexicographical layout
+bool laik_layout_lex_isContiguous(Laik_Layout* l, int n, Laik_Range* r)
+{
+    Laik_Layout_Lex* ll = laik_is_layout_lex(l);
+    if (ll == 0) return false;
+    assert((n >= 0) && (n < l->map_count));
+    Lex_Entry* e = &(ll->e[n]);
+    int dims = l->dims;
+
+    // find outermost dimension with more than one index: all inner
+    // dimensions must be covered fully by the range
+    int d = dims - 1;
+    while((d > 0) && (r->to.i[d] - r->from.i[d] == 1)) d--;
+    for(int dd = 0; dd < d; dd++) {
+        if (r->from.i[dd] != e->range.from.i[dd]) return false;
+        if (r->to.i[dd] != e->range.to.i[dd]) return false;
+    }
+    return true;
+}
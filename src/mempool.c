@@ -0,0 +1,211 @@
+/*
+ * This file is part of the LAIK library.
+ * Copyright (c) 2017, 2018 Josef Weidendorfer <Josef.Weidendorfer@gmx.de>
+ *
+ * LAIK is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3 or later.
+ *
+ * LAIK is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "laik-internal.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+/**
+ * Memory pool for mappings (allocators with policy LAIK_MP_UsePool)
+ *
+ * Memory of freed mappings is not returned to the backing allocator but
+ * kept in free lists, one per size class. Later mappings of any container
+ * using the same allocator get memory from these lists if available.
+ * This avoids malloc/free churn and repeated page faults in applications
+ * switching between partitionings again and again.
+ *
+ * Size classes: 4 classes per power of two (max. 25% overhead), with
+ * sizes up to 1 KB rounded up to 1 KB. Free lists are LIFO, returning the
+ * most recently used memory first. Retained memory is limited to
+ * LAIK_POOL_MAXMB megabytes (default 1024); blocks freed beyond that are
+ * returned to the backing allocator.
+ *
+ * Memory newly requested from the backing allocator is not touched by
+ * the pool, so pages are first touched by the copy/init actions of the
+ * switch (which may be spread over multiple threads, see thread.c).
+ */
+
+#define POOL_MINSIZE 1024
+#define POOL_CLASSES (4 * 64)
+
+// free block: link is stored in the memory of the block itself
+typedef struct _PoolBlock PoolBlock;
+struct _PoolBlock {
+    PoolBlock* next;
+};
+
+struct _Laik_MemPool {
+    PoolBlock* freeList[POOL_CLASSES];
+    uint64_t bytes;    // bytes currently kept in free lists
+    uint64_t maxBytes; // maximum bytes to keep in free lists
+};
+
+// round <size> up to its size class, return class index in <cls>
+static
+uint64_t classSize(uint64_t size, int* cls)
+{
+    if (size <= POOL_MINSIZE) {
+        *cls = 0;
+        return POOL_MINSIZE;
+    }
+
+    // size in ]2^e;2^(e+1)], with 4 classes in steps of 2^e/4
+    int e = 63 - __builtin_clzll(size - 1);
+    uint64_t step = (1ull << e) / 4;
+    uint64_t c = (size + step - 1) / step;
+    assert((c >= 5) && (c <= 8));
+    *cls = 1 + (e - 10) * 4 + (int) (c - 5);
+    assert(*cls < POOL_CLASSES);
+    return c * step;
+}
+
+static
+Laik_MemPool* newPool(void)
+{
+    Laik_MemPool* p = malloc(sizeof(Laik_MemPool));
+    if (!p) {
+        laik_panic("Out of memory allocating Laik_MemPool object");
+        exit(1); // not actually needed, laik_panic never returns
+    }
+    for(int i = 0; i < POOL_CLASSES; i++)
+        p->freeList[i] = 0;
+    p->bytes = 0;
+
+    char* str = getenv("LAIK_POOL_MAXMB");
+    int mb = str ? atoi(str) : 1024;
+    if (mb < 0) mb = 0;
+    p->maxBytes = (uint64_t) mb * 1024 * 1024;
+
+    return p;
+}
+
+// allocate memory for a mapping of data <d> with at least <*size> bytes
+// via pool of allocator <a>. <*size> is updated to the usable size
+void* laik_mempool_alloc(Laik_Allocator* a, Laik_Data* d,
+                         uint64_t* size, Laik_SwitchStat* ss)
+{
+    assert(a->policy == LAIK_MP_UsePool);
+    if (!a->pool) a->pool = newPool();
+    Laik_MemPool* p = a->pool;
+
+    int cls;
+    uint64_t csize = classSize(*size, &cls);
+    *size = csize;
+
+    PoolBlock* b = p->freeList[cls];
+    if (b) {
+        p->freeList[cls] = b->next;
+        p->bytes -= csize;
+        if (ss) {
+            ss->poolHitCount++;
+            ss->poolHitBytes += csize;
+        }
+        laik_log(1, "mempool: reusing %llu bytes at %p for '%s'",
+                 (unsigned long long) csize, (void*) b, d->name);
+        return b;
+    }
+
+    assert(a->malloc != 0);
+    return (a->malloc)(d, csize);
+}
+
+// return memory of mapping with <size> bytes at <ptr> to pool of <a>
+void laik_mempool_free(Laik_Allocator* a, Laik_Data* d,
+                       void* ptr, uint64_t size)
+{
+    assert(a->policy == LAIK_MP_UsePool);
+    if (!a->pool) a->pool = newPool();
+    Laik_MemPool* p = a->pool;
+
+    int cls;
+    uint64_t csize = classSize(size, &cls);
+
+    // not allocated via pool (policy changed) or pool full: free directly
+    if ((csize != size) || (p->bytes + csize > p->maxBytes)) {
+        assert(a->free != 0);
+        (a->free)(d, ptr);
+        return;
+    }
+
+    PoolBlock* b = (PoolBlock*) ptr;
+    b->next = p->freeList[cls];
+    p->freeList[cls] = b;
+    p->bytes += csize;
+}
+
+// return all memory kept in the pool of <a> to the backing allocator
+void laik_mempool_release(Laik_Allocator* a)
+{
+    Laik_MemPool* p = a->pool;
+    if (!p) return;
+
+    for(int i = 0; i < POOL_CLASSES; i++) {
+        while(p->freeList[i]) {
+            PoolBlock* b = p->freeList[i];
+            p->freeList[i] = b->next;
+            (a->free)(0, b);
+        }
+    }
+    p->bytes = 0;
+}
+
+//--------------------------------------------------------------
+// backing allocator using huge pages for large allocations
+//
+
+#define HUGEPAGE_SIZE (2 * 1024 * 1024)
+
+static
+void* hugepage_malloc(Laik_Data* d, size_t size)
+{
+    (void) d; // not used in this implementation of interface
+
+    if (size < HUGEPAGE_SIZE)
+        return malloc(size);
+
+    void* ptr;
+    if (posix_memalign(&ptr, HUGEPAGE_SIZE, size) != 0)
+        return 0;
+#ifdef MADV_HUGEPAGE
+    // only a hint, failure is not a problem
+    madvise(ptr, size & ~((size_t) HUGEPAGE_SIZE - 1), MADV_HUGEPAGE);
+#endif
+    return ptr;
+}
+
+static
+void hugepage_free(Laik_Data* d, void* ptr)
+{
+    (void) d; // not used in this implementation of interface
+
+    free(ptr);
+}
+
+// returns an allocator with policy LAIK_MP_UsePool
+Laik_Allocator* laik_new_allocator_pool(bool hugepages)
+{
+    Laik_Allocator* a;
+    if (hugepages)
+        a = laik_new_allocator(hugepage_malloc, hugepage_free, 0);
+    else
+        a = laik_new_allocator(laik_def_malloc, laik_def_free, 0);
+    a->policy = LAIK_MP_UsePool;
+
+    return a;
+}
@@ -19,6 +19,7 @@
 
 #include <assert.h>
 #include <stdint.h>
+#include <stdlib.h>
 
 
 //
@@ -41,6 +42,7 @@ Laik_Partitioner* laik_new_partitioner(const char* name,
     pr->run = run;
     pr->flags = flags;
     pr->data = d;
+    pr->firstRerun = 0;
 
     return pr;
 }
@@ -504,6 +506,402 @@ laik_new_grid_partitioner(int xblocks, int yblocks, int zblocks)
 }
 
 
+//-------------------------------------------------------------------
+// space-filling curve (SFC) partitioner
+//
+// the space is split into cubic blocks, which are ordered along a Morton
+// (Z-order) or Hilbert curve. Each task gets a contiguous segment of the
+// curve, with segment borders chosen such that index weights (sum over
+// indexes of a block) are distributed according to task weights.
+// Both curves enumerate aligned cubes of side 2^k at aligned key ranges
+// of length 2^(dims*k). Thus, the curve segment of a task is decomposed
+// into few such cubes, which are merged into larger rectangles where
+// possible. Rectangles near to each other get the same tag to go into
+// one mapping, as long as the covering range does not waste more than
+// half of its size.
+
+typedef struct _Laik_SFCPartitionerData {
+    Laik_SFCType type;
+    int64_t blocksize; // 0: automatic
+    Laik_GetIdxWeight_t getIdxW;
+    Laik_GetTaskWeight_t getTaskW;
+    const void* userData;
+} Laik_SFCPartitionerData;
+
+// a block with its position on the curve and its weight
+typedef struct {
+    uint64_t key;
+    double w;
+} SFCBlock;
+
+static
+int sfcblock_cmp(const void* p1, const void* p2)
+{
+    const SFCBlock* b1 = (const SFCBlock*) p1;
+    const SFCBlock* b2 = (const SFCBlock*) p2;
+    if (b1->key == b2->key) return 0;
+    return (b1->key < b2->key) ? -1 : 1;
+}
+
+// Hilbert curve: conversion between coordinates and "transposed" index,
+// see J. Skilling, "Programming the Hilbert curve", AIP Conf. Proc. 707, 2004
+static
+void hilbertAxesToTranspose(uint64_t* x, int bits, int dims)
+{
+    uint64_t m = 1ull << (bits - 1), p, q, t;
+
+    // inverse undo
+    for(q = m; q > 1; q >>= 1) {
+        p = q - 1;
+        for(int i = 0; i < dims; i++) {
+            if (x[i] & q)
+                x[0] ^= p;
+            else {
+                t = (x[0] ^ x[i]) & p;
+                x[0] ^= t;
+                x[i] ^= t;
+            }
+        }
+    }
+    // gray encode
+    for(int i = 1; i < dims; i++)
+        x[i] ^= x[i-1];
+    t = 0;
+    for(q = m; q > 1; q >>= 1)
+        if (x[dims-1] & q) t ^= q - 1;
+    for(int i = 0; i < dims; i++)
+        x[i] ^= t;
+}
+
+static
+void hilbertTransposeToAxes(uint64_t* x, int bits, int dims)
+{
+    uint64_t n = 2ull << (bits - 1), p, q, t;
+
+    // gray decode
+    t = x[dims-1] >> 1;
+    for(int i = dims - 1; i > 0; i--)
+        x[i] ^= x[i-1];
+    x[0] ^= t;
+    // undo excess work
+    for(q = 2; q != n; q <<= 1) {
+        p = q - 1;
+        for(int i = dims - 1; i >= 0; i--) {
+            if (x[i] & q)
+                x[0] ^= p;
+            else {
+                t = (x[0] ^ x[i]) & p;
+                x[0] ^= t;
+                x[i] ^= t;
+            }
+        }
+    }
+}
+
+// position on curve for block coordinates <c> (<bits> per dimension)
+static
+uint64_t sfcKey(Laik_SFCType type, int dims, int bits, const int64_t* c)
+{
+    uint64_t x[3];
+    for(int d = 0; d < dims; d++)
+        x[d] = (uint64_t) c[d];
+    if ((type == LAIK_SFC_Hilbert) && (dims > 1) && (bits > 0))
+        hilbertAxesToTranspose(x, bits, dims);
+
+    // interleave bits, most significant first
+    uint64_t key = 0;
+    for(int j = bits - 1; j >= 0; j--)
+        for(int d = 0; d < dims; d++)
+            key = (key << 1) | ((x[d] >> j) & 1);
+    return key;
+}
+
+// block coordinates <c> for position <key> on curve
+static
+void sfcCoords(Laik_SFCType type, int dims, int bits, uint64_t key, int64_t* c)
+{
+    uint64_t x[3] = { 0, 0, 0 };
+    for(int j = bits - 1; j >= 0; j--)
+        for(int d = 0; d < dims; d++)
+            x[d] |= ((key >> (j * dims + dims - 1 - d)) & 1) << j;
+    if ((type == LAIK_SFC_Hilbert) && (dims > 1) && (bits > 0))
+        hilbertTransposeToAxes(x, bits, dims);
+
+    for(int d = 0; d < dims; d++)
+        c[d] = (int64_t) x[d];
+}
+
+// can ranges be merged into one range? If yes, do it into <r1>
+static
+bool mergeRanges(int dims, Laik_Range* r1, const Laik_Range* r2)
+{
+    int mdim = -1;
+    for(int d = 0; d < dims; d++) {
+        if ((r1->from.i[d] == r2->from.i[d]) && (r1->to.i[d] == r2->to.i[d]))
+            continue;
+        if (mdim >= 0) return false;
+        if ((r1->to.i[d] != r2->from.i[d]) && (r2->to.i[d] != r1->from.i[d]))
+            return false;
+        mdim = d;
+    }
+    if (mdim < 0) return false; // same range, should not happen
+
+    if (r2->from.i[mdim] < r1->from.i[mdim])
+        r1->from.i[mdim] = r2->from.i[mdim];
+    else
+        r1->to.i[mdim] = r2->to.i[mdim];
+    return true;
+}
+
+// append ranges for curve segment [<from>;<to>[ of a task
+static
+void appendSFCSegment(Laik_RangeReceiver* r, Laik_PartitionerParams* p,
+                      Laik_SFCType type, int bits, int64_t bs,
+                      int task, uint64_t from, uint64_t to,
+                      Laik_Range* buf)
+{
+    Laik_Space* s = p->space;
+    int dims = s->dims;
+    int n = 0;
+
+    // decompose into aligned cubes, clipped to space
+    uint64_t key = from;
+    while(key < to) {
+        int k = 0;
+        while(k < bits) {
+            uint64_t len = 1ull << (dims * (k + 1));
+            if (((key & (len - 1)) != 0) || (key + len > to)) break;
+            k++;
+        }
+
+        int64_t c[3];
+        sfcCoords(type, dims, bits, key, c);
+        Laik_Range range = s->range;
+        bool empty = false;
+        for(int d = 0; d < dims; d++) {
+            int64_t cfrom = (c[d] >> k) << k;
+            range.from.i[d] = s->range.from.i[d] + cfrom * bs;
+            range.to.i[d] = range.from.i[d] + (bs << k);
+            if (range.to.i[d] > s->range.to.i[d])
+                range.to.i[d] = s->range.to.i[d];
+            if (range.from.i[d] >= range.to.i[d]) empty = true;
+        }
+        key += 1ull << (dims * k);
+        if (empty) continue;
+
+        // merge with previous ranges as long as possible
+        bool merged = true;
+        while(merged) {
+            merged = false;
+            for(int i = n - 1; i >= 0; i--) {
+                if (!mergeRanges(dims, &range, &(buf[i]))) continue;
+                buf[i] = buf[n - 1];
+                n--;
+                merged = true;
+                break;
+            }
+        }
+        buf[n++] = range;
+    }
+
+    if (n == 0) return;
+
+    // ranges near to each other go into same mapping
+    int tag = 1;
+    Laik_Range cover = buf[0];
+    uint64_t used = 0;
+    for(int i = 0; i < n; i++) {
+        uint64_t size = laik_range_size(&(buf[i]));
+        Laik_Range c = cover;
+        laik_range_expand(&c, &(buf[i]));
+        if ((used > 0) && (laik_range_size(&c) > 2 * (used + size))) {
+            tag++;
+            c = buf[i];
+            used = 0;
+        }
+        cover = c;
+        used += size;
+        laik_append_range(r, task, &(buf[i]), tag, 0);
+    }
+}
+
+// choose largest block size resulting in at least 64 blocks per task,
+// allowing a good balance also with varying index weights
+static
+int64_t sfcBlocksize(int dims, const int64_t* size, int count)
+{
+    int64_t bs = 1;
+    while(1) {
+        int64_t bs2 = 2 * bs;
+        uint64_t blocks = 1;
+        for(int d = 0; d < dims; d++)
+            blocks *= (uint64_t) ((size[d] + bs2 - 1) / bs2);
+        if (blocks < 64 * (uint64_t) count) break;
+        bs = bs2;
+    }
+    return bs;
+}
+
+void runSFCPartitioner(Laik_RangeReceiver* r, Laik_PartitionerParams* p)
+{
+    Laik_SFCPartitionerData* data;
+    data = (Laik_SFCPartitionerData*) p->partitioner->data;
+    assert(data);
+
+    Laik_Space* s = p->space;
+    Laik_Range* ss = &(s->range);
+    int dims = s->dims;
+    int count = p->group->size;
+
+    int64_t size[3] = { 1, 1, 1 };
+    for(int d = 0; d < dims; d++)
+        size[d] = ss->to.i[d] - ss->from.i[d];
+    int64_t bs = data->blocksize;
+    if (bs <= 0)
+        bs = sfcBlocksize(dims, size, count);
+
+    // blocks per dimension and bits needed for block coordinates
+    int64_t nb[3] = { 1, 1, 1 }, maxnb = 1;
+    for(int d = 0; d < dims; d++) {
+        nb[d] = (size[d] + bs - 1) / bs;
+        if (nb[d] > maxnb) maxnb = nb[d];
+    }
+    int bits = 0;
+    while((1ll << bits) < maxnb) bits++;
+    if (bits * dims > 63) {
+        laik_log(LAIK_LL_Panic,
+                 "sfc partitioner: too many blocks, use larger block size than %lld",
+                 (long long) bs);
+        exit(1); // not actually needed, panic never returns
+    }
+
+    uint64_t n = (uint64_t) (nb[0] * nb[1] * nb[2]);
+    SFCBlock* b = malloc(n * sizeof(SFCBlock));
+    double* th = malloc(count * sizeof(double));
+    uint64_t* start = malloc((count + 1) * sizeof(uint64_t));
+    if (!b || !th || !start) {
+        laik_panic("Out of memory in sfc partitioner");
+        exit(1); // not actually needed, laik_panic never returns
+    }
+
+    // weight of blocks: sum of index weights, or number of indexes
+    double totalW = 0.0;
+    uint64_t i = 0;
+    int64_t c[3];
+    Laik_Index idx;
+    laik_index_init(&idx, 0, 0, 0);
+    for(c[2] = 0; c[2] < nb[2]; c[2]++)
+        for(c[1] = 0; c[1] < nb[1]; c[1]++)
+            for(c[0] = 0; c[0] < nb[0]; c[0]++, i++) {
+                Laik_Range range = *ss;
+                for(int d = 0; d < dims; d++) {
+                    range.from.i[d] = ss->from.i[d] + c[d] * bs;
+                    range.to.i[d] = range.from.i[d] + bs;
+                    if (range.to.i[d] > ss->to.i[d])
+                        range.to.i[d] = ss->to.i[d];
+                }
+                double w = 0.0;
+                if (data->getIdxW) {
+                    // indexes of unused dimensions are 0
+                    int64_t from[3] = { 0, 0, 0 }, to[3] = { 1, 1, 1 };
+                    for(int d = 0; d < dims; d++) {
+                        from[d] = range.from.i[d];
+                        to[d] = range.to.i[d];
+                    }
+                    int64_t* x = idx.i;
+                    for(x[2] = from[2]; x[2] < to[2]; x[2]++)
+                        for(x[1] = from[1]; x[1] < to[1]; x[1]++)
+                            for(x[0] = from[0]; x[0] < to[0]; x[0]++)
+                                w += (data->getIdxW)(&idx, data->userData);
+                }
+                else
+                    w = (double) laik_range_size(&range);
+
+                b[i].key = sfcKey(data->type, dims, bits, c);
+                b[i].w = w;
+                totalW += w;
+            }
+    qsort(b, n, sizeof(SFCBlock), sfcblock_cmp);
+
+    // weight thresholds at which curve segments of tasks end
+    double totalTW = (double) count;
+    if (data->getTaskW) {
+        totalTW = 0.0;
+        for(int task = 0; task < count; task++)
+            totalTW += (data->getTaskW)(task, data->userData);
+    }
+    double sum = 0.0;
+    for(int task = 0; task < count; task++) {
+        double taskW = 1.0;
+        if (data->getTaskW)
+            taskW = (data->getTaskW)(task, data->userData) * count / totalTW;
+        sum += totalW / count * taskW;
+        th[task] = sum;
+    }
+
+    // a block goes to the task in whose segment the middle of its weight is
+    int task = 0;
+    sum = 0.0;
+    start[0] = 0;
+    for(i = 0; i < n; i++) {
+        double mid = sum + b[i].w / 2;
+        while((task < count - 1) && (mid >= th[task])) {
+            task++;
+            start[task] = b[i].key;
+        }
+        sum += b[i].w;
+    }
+    while(task < count - 1) {
+        task++;
+        start[task] = b[n - 1].key + 1;
+    }
+    start[count] = (bits * dims == 0) ? 1 : (1ull << (bits * dims));
+
+    laik_log(1, "sfc partitioner: %llu blocks of side %lld, curve order %d",
+             (unsigned long long) n, (long long) bs, bits);
+
+    // buffer for ranges of a segment, at most 2^dims-1 cubes per level
+    // at start and at end of segment
+    Laik_Range* buf = malloc(2 * (bits + 1) * (1 << dims) * sizeof(Laik_Range));
+    if (!buf) {
+        laik_panic("Out of memory in sfc partitioner");
+        exit(1); // not actually needed, laik_panic never returns
+    }
+    for(task = 0; task < count; task++) {
+        if (start[task] < start[task + 1])
+            appendSFCSegment(r, p, data->type, bits, bs, task,
+                             start[task], start[task + 1], buf);
+    }
+
+    free(buf);
+    free(b);
+    free(th);
+    free(start);
+}
+
+Laik_Partitioner* laik_new_sfc_partitioner(Laik_SFCType type, int64_t blocksize,
+                                           Laik_GetIdxWeight_t ifunc,
+                                           Laik_GetTaskWeight_t tfunc,
+                                           const void* userData)
+{
+    Laik_SFCPartitionerData* data;
+    data = malloc(sizeof(Laik_SFCPartitionerData));
+    if (!data) {
+        laik_panic("Out of memory allocating Laik_SFCPartitionerData object");
+        exit(1); // not actually needed, laik_panic never returns
+    }
+
+    data->type = type;
+    data->blocksize = blocksize;
+    data->getIdxW = ifunc;
+    data->getTaskW = tfunc;
+    data->userData = userData;
+
+    const char* name = (type == LAIK_SFC_Hilbert) ? "sfc-hilbert" : "sfc-morton";
+    return laik_new_partitioner(name, runSFCPartitioner, data, 0);
+}
+
+
 
 //-------------------------------------------------------------------
 // block partitioner: split one dimension of space into blocks
@@ -514,6 +912,12 @@ laik_new_grid_partitioner(int xblocks, int yblocks, int zblocks)
 //
 // when distributing indexes, a given number of rounds is done over tasks,
 // defaulting to 1 (see cycle parameter).
+//
+// Instead of a callback, index weights can be given as array (known in
+// every process) or as 1d container distributed among processes. Then,
+// prefix sums over weights are calculated once and kept, and range
+// borders are found by binary search. Changing task weights or cycles
+// does not require to go over index weights again.
 
 typedef struct _Laik_BlockPartitionerData Laik_BlockPartitionerData;
 struct _Laik_BlockPartitionerData {
@@ -527,8 +931,249 @@ struct _Laik_BlockPartitionerData {
     Laik_GetIdxWeight_t getIdxW;
     Laik_GetTaskWeight_t getTaskW;
     const void* userData;
+
+    // task weights given as array with <taskWCount> entries (alternative
+    // to getTaskW), read on every run
+    const double* taskW;
+    int taskWCount;
+
+    // index weights given as array with <wSize> entries (alternative to
+    // getIdxW), with prefix sums calculated on first use
+    const double* idxW;
+    int64_t wSize;
+    double* prefixW; // <wSize>+1 entries, prefixW[i]: sum of weights < i
+
+    // index weights from distributed container (see
+    // laik_set_index_weight_data): borders of all ranges of the container
+    // sorted by index, prefix sums at range starts, and prefix sums within
+    // own ranges (at offset <wOff>[k] for range k, -1 if not own)
+    int wRanges;
+    int64_t* wFrom;
+    double* wStart;  // <wRanges>+1 entries
+    int64_t* wOff;
+    double* wLocal;
+    Laik_Group* wGroup;
+
+    // range borders calculated from distributed weights for <splitCount>
+    // tasks/cycles, with thresholds used (to detect task weight changes)
+    int splitCount;
+    int64_t* split;
+    double* splitTh;
+};
+
+// weight of <task>, 1.0 without task weights
+static
+double blockTaskWeight(Laik_BlockPartitionerData* data, int task)
+{
+    if (data->taskW) {
+        if (task >= data->taskWCount) {
+            laik_panic("block partitioner: task weight array too small");
+            exit(1); // not actually needed, laik_panic never returns
+        }
+        return data->taskW[task];
+    }
+    if (data->getTaskW)
+        return (data->getTaskW)(task, data->userData);
+    return 1.0;
+}
+
+// weight thresholds at which ranges of the <n> tasks/cycles end
+// (cumulative, relative to start of partitioned dimension)
+static
+void calcThresholds(Laik_BlockPartitionerData* data, int count,
+                    double totalW, double* th)
+{
+    double totalTW = 0.0;
+    for(int task = 0; task < count; task++)
+        totalTW += blockTaskWeight(data, task);
+
+    // same as in index traversal below, which starts with weight -0.5
+    double perPart = totalW / count / data->cycles;
+    double c = 0.5;
+    for(int i = 0; i < count * data->cycles; i++) {
+        int task = i % count;
+        double taskW = blockTaskWeight(data, task) * ((double) count) / totalTW;
+        c += perPart * taskW;
+        th[i] = c;
+    }
+}
+
+// first index j in [0;n] with pre[j] >= v, or n+1 if not existing
+static
+int64_t findPrefix(const double* pre, int64_t n, double v)
+{
+    int64_t lo = 0, hi = n + 1;
+    while(lo < hi) {
+        int64_t mid = lo + (hi - lo) / 2;
+        if (pre[mid] >= v) hi = mid;
+        else lo = mid + 1;
+    }
+    return lo;
+}
+
+// append ranges for tasks/cycles ending at borders <split>
+// (relative to start of partitioned dimension)
+static
+void appendSplitRanges(Laik_RangeReceiver* r, Laik_PartitionerParams* p,
+                       int pdim, int n, const int64_t* split)
+{
+    Laik_Space* s = p->space;
+    Laik_Range range = s->range;
+    int64_t off = s->range.from.i[pdim];
+    int64_t size = s->range.to.i[pdim] - off;
+    int count = p->group->size;
+
+    int64_t from = 0;
+    for(int i = 0; i < n; i++) {
+        int64_t to = (i == n - 1) ? size : split[i];
+        if (to < from) to = from;
+        if (to > size) to = size;
+        if (from < to) {
+            range.from.i[pdim] = from + off;
+            range.to.i[pdim] = to + off;
+            laik_append_range(r, i % count, &range, 0, 0);
+        }
+        from = to;
+    }
+}
+
+// prefix sums over weights, calculated in chunks of fixed size using the
+// thread pool: results do not depend on the number of threads used
+#define PREFIX_CHUNK (64 * 1024)
+
+struct prefixCtx {
+    const double* w;
+    double* pre;
+    int64_t n;
+    double* chunkSum;
 };
 
+static
+void prefixChunkSum(void* ctx, uint64_t from, uint64_t to)
+{
+    struct prefixCtx* c = (struct prefixCtx*) ctx;
+    for(uint64_t ch = from; ch < to; ch++) {
+        int64_t i1 = (int64_t) ch * PREFIX_CHUNK;
+        int64_t i2 = i1 + PREFIX_CHUNK;
+        if (i2 > c->n) i2 = c->n;
+        double sum = 0.0;
+        for(int64_t i = i1; i < i2; i++)
+            sum += c->w[i];
+        c->chunkSum[ch] = sum;
+    }
+}
+
+static
+void prefixChunkFill(void* ctx, uint64_t from, uint64_t to)
+{
+    struct prefixCtx* c = (struct prefixCtx*) ctx;
+    for(uint64_t ch = from; ch < to; ch++) {
+        int64_t i1 = (int64_t) ch * PREFIX_CHUNK;
+        int64_t i2 = i1 + PREFIX_CHUNK;
+        if (i2 > c->n) i2 = c->n;
+        double sum = c->chunkSum[ch];
+        for(int64_t i = i1; i < i2; i++) {
+            sum += c->w[i];
+            c->pre[i + 1] = sum;
+        }
+    }
+}
+
+// write prefix sums of <n> weights <w> into <pre> (<n>+1 entries)
+static
+void calcPrefixSum(const double* w, int64_t n, double* pre)
+{
+    uint64_t chunks = (uint64_t) (n + PREFIX_CHUNK - 1) / PREFIX_CHUNK;
+    double* chunkSum = malloc((chunks + 1) * sizeof(double));
+    if (!chunkSum) {
+        laik_panic("Out of memory allocating prefix sums");
+        exit(1); // not actually needed, laik_panic never returns
+    }
+    struct prefixCtx c = { w, pre, n, chunkSum };
+
+    laik_threads_run(chunks, 1, prefixChunkSum, &c);
+    // exclusive scan over chunk sums
+    double sum = 0.0;
+    for(uint64_t ch = 0; ch < chunks; ch++) {
+        double v = chunkSum[ch];
+        chunkSum[ch] = sum;
+        sum += v;
+    }
+    pre[0] = 0.0;
+    laik_threads_run(chunks, 1, prefixChunkFill, &c);
+
+    free(chunkSum);
+}
+
+// block partitioning using prefix sums over weight array
+static
+void runBlockPrefix(Laik_RangeReceiver* r, Laik_PartitionerParams* p,
+                    Laik_BlockPartitionerData* data, int64_t size)
+{
+    if (size != data->wSize) {
+        laik_log(LAIK_LL_Panic,
+                 "block partitioner: %lld index weights given, but %lld required",
+                 (long long) data->wSize, (long long) size);
+        exit(1); // not actually needed, panic never returns
+    }
+    if (!data->prefixW) {
+        data->prefixW = malloc((size + 1) * sizeof(double));
+        if (!data->prefixW) {
+            laik_panic("Out of memory allocating prefix sums");
+            exit(1); // not actually needed, laik_panic never returns
+        }
+        calcPrefixSum(data->idxW, size, data->prefixW);
+    }
+
+    int n = p->group->size * data->cycles;
+    double* th = malloc(n * sizeof(double));
+    int64_t* split = malloc(n * sizeof(int64_t));
+    if (!th || !split) {
+        laik_panic("Out of memory in block partitioner");
+        exit(1); // not actually needed, laik_panic never returns
+    }
+    calcThresholds(data, p->group->size, data->prefixW[size], th);
+
+    // a range ends before the index at which the threshold is reached
+    for(int i = 0; i < n; i++)
+        split[i] = findPrefix(data->prefixW, size, th[i]) - 1;
+    appendSplitRanges(r, p, data->pdim, n, split);
+
+    free(th);
+    free(split);
+}
+
+// block partitioning using borders from distributed weights
+static
+void runBlockSplit(Laik_RangeReceiver* r, Laik_PartitionerParams* p,
+                   Laik_BlockPartitionerData* data, int64_t size)
+{
+    int n = p->group->size * data->cycles;
+    if ((p->group != data->wGroup) || (n != data->splitCount) ||
+        (data->wFrom[data->wRanges] != size)) {
+        laik_panic("block partitioner: weight container does not match");
+        exit(1); // not actually needed, laik_panic never returns
+    }
+
+    // borders are only valid for the task weights used when calculating
+    double* th = malloc(n * sizeof(double));
+    if (!th) {
+        laik_panic("Out of memory in block partitioner");
+        exit(1); // not actually needed, laik_panic never returns
+    }
+    calcThresholds(data, p->group->size, data->wStart[data->wRanges], th);
+    for(int i = 0; i < n; i++) {
+        if (th[i] != data->splitTh[i]) {
+            laik_panic("block partitioner: task weights changed, "
+                       "call laik_update_block_partitioner");
+            exit(1); // not actually needed, laik_panic never returns
+        }
+    }
+    free(th);
+
+    appendSplitRanges(r, p, data->pdim, n, data->split);
+}
+
 void runBlockPartitioner(Laik_RangeReceiver* r, Laik_PartitionerParams* p)
 {
     Laik_BlockPartitionerData* data;
@@ -542,6 +1187,15 @@ void runBlockPartitioner(Laik_RangeReceiver* r, Laik_PartitionerParams* p)
     int64_t size = s->range.to.i[pdim] - s->range.from.i[pdim];
     assert(size > 0);
 
+    if (data->split) {
+        runBlockSplit(r, p, data, size);
+        return;
+    }
+    if (data->idxW) {
+        runBlockPrefix(r, p, data, size);
+        return;
+    }
+
     Laik_Index idx;
     double totalW;
     if (data && data->getIdxW) {
@@ -558,17 +1212,10 @@ void runBlockPartitioner(Laik_RangeReceiver* r, Laik_PartitionerParams* p)
         totalW = (double) size;
     }
 
+    // task-wise weighting (weight 1 for every task without task weights)
     double totalTW = 0.0;
-    if (data && data->getTaskW) {
-        // task-wise weighting
-        totalTW = 0.0;
-        for(int task = 0; task < count; task++)
-            totalTW += (data->getTaskW)(task, data->userData);
-    }
-    else {
-        // without task weighting function, use weight 1 for every task
-        totalTW = (double) count;
-    }
+    for(int task = 0; task < count; task++)
+        totalTW += blockTaskWeight(data, task);
 
     int cycles = data ? data->cycles : 1;
     double perPart = totalW / count / cycles;
@@ -577,12 +1224,7 @@ void runBlockPartitioner(Laik_RangeReceiver* r, Laik_PartitionerParams* p)
     int cycle = 0;
 
     // taskW is a correction factor, which is 1.0 without task weights
-    double taskW;
-    if (data && data->getTaskW)
-        taskW = (data->getTaskW)(task, data->userData)
-                * ((double) count) / totalTW;
-    else
-        taskW = 1.0;
+    double taskW = blockTaskWeight(data, task) * ((double) count) / totalTW;
 
     range.from.i[pdim] = s->range.from.i[pdim];
     for(int64_t i = 0; i < size; i++) {
@@ -605,11 +1247,7 @@ void runBlockPartitioner(Laik_RangeReceiver* r, Laik_PartitionerParams* p)
                 cycle++;
             }
             // update taskW
-            if (data && data->getTaskW)
-                taskW = (data->getTaskW)(task, data->userData)
-                        * ((double) count) / totalTW;
-            else
-                taskW = 1.0;
+            taskW = blockTaskWeight(data, task) * ((double) count) / totalTW;
 
             // start new range
             range.from.i[pdim] = i + s->range.from.i[pdim];
@@ -639,6 +1277,21 @@ Laik_Partitioner* laik_new_block_partitioner(int pdim, int cycles,
     data->getIdxW = ifunc;
     data->userData = userData;
     data->getTaskW = tfunc;
+    data->taskW = 0;
+    data->taskWCount = 0;
+
+    data->idxW = 0;
+    data->wSize = 0;
+    data->prefixW = 0;
+    data->wRanges = 0;
+    data->wFrom = 0;
+    data->wStart = 0;
+    data->wOff = 0;
+    data->wLocal = 0;
+    data->wGroup = 0;
+    data->splitCount = 0;
+    data->split = 0;
+    data->splitTh = 0;
 
     return laik_new_partitioner("block", runBlockPartitioner, data, 0);
 }
@@ -660,33 +1313,276 @@ Laik_Partitioner* laik_new_block_partitioner_tw1(Laik_GetTaskWeight_t f,
     return laik_new_block_partitioner(0, 1, 0, f, userData);
 }
 
+// forget index weights given as array or container
+static
+void clearIdxWeights(Laik_BlockPartitionerData* data)
+{
+    free(data->prefixW);
+    free(data->wFrom);
+    free(data->wStart);
+    free(data->wOff);
+    free(data->wLocal);
+    free(data->split);
+    free(data->splitTh);
+
+    data->idxW = 0;
+    data->wSize = 0;
+    data->prefixW = 0;
+    data->wRanges = 0;
+    data->wFrom = 0;
+    data->wStart = 0;
+    data->wOff = 0;
+    data->wLocal = 0;
+    data->wGroup = 0;
+    data->splitCount = 0;
+    data->split = 0;
+    data->splitTh = 0;
+}
+
+// weights of block partitioner <pr> get changed. In owner-only mode, the
+// partitioner may not be run again for existing partitionings. Weights given
+// by the application may change at any time without notice (e.g. via
+// <userData>): partitionings created afterwards have to store all ranges
+static
+void setWeightsChanged(Laik_Partitioner* pr)
+{
+    laik_partitioner_changed(pr);
+    pr->flags |= LAIK_PF_NoRerun;
+}
+
 void laik_set_index_weight(Laik_Partitioner* pr, Laik_GetIdxWeight_t f,
                            const void* userData)
 {
     assert(pr->run == runBlockPartitioner);
+    setWeightsChanged(pr);
 
     Laik_BlockPartitionerData* data;
     data = (Laik_BlockPartitionerData*) pr->data;
 
+    clearIdxWeights(data);
     data->getIdxW = f;
     data->userData = userData;
 }
 
+void laik_set_index_weight_array(Laik_Partitioner* pr,
+                                 const double* w, int64_t count)
+{
+    assert(pr->run == runBlockPartitioner);
+    setWeightsChanged(pr);
+
+    Laik_BlockPartitionerData* data;
+    data = (Laik_BlockPartitionerData*) pr->data;
+
+    clearIdxWeights(data);
+    data->getIdxW = 0;
+    data->idxW = w;
+    data->wSize = count;
+}
+
+typedef struct {
+    int64_t from, to;
+    int task;
+} WeightRange;
+
+static
+int wrange_cmp(const void* p1, const void* p2)
+{
+    const WeightRange* r1 = (const WeightRange*) p1;
+    const WeightRange* r2 = (const WeightRange*) p2;
+    if (r1->from == r2->from) return 0;
+    return (r1->from < r2->from) ? -1 : 1;
+}
+
+void laik_set_index_weight_data(Laik_Partitioner* pr, Laik_Data* d)
+{
+    assert(pr->run == runBlockPartitioner);
+    setWeightsChanged(pr);
+
+    Laik_BlockPartitionerData* data;
+    data = (Laik_BlockPartitionerData*) pr->data;
+
+    clearIdxWeights(data);
+    data->getIdxW = 0;
+
+    Laik_Space* s = laik_data_get_space(d);
+    Laik_Partitioning* p = laik_data_get_partitioning(d);
+    Laik_Group* g = laik_data_get_group(d);
+    if ((s->dims != 1) || (d->type != laik_Double) || (p == 0)) {
+        laik_panic("block partitioner: index weights must be given in "
+                   "partitioned 1d container of doubles");
+        exit(1); // not actually needed, laik_panic never returns
+    }
+    // a process not in the group cannot take part
+    if (g->myid < 0) return;
+
+    // borders of all ranges, sorted by index. They must cover the space
+    // without overlap (e.g. block partitioning of the container)
+    int n = laik_partitioning_rangecount(p);
+    WeightRange* wr = malloc(n * sizeof(WeightRange));
+    data->wFrom = malloc((n + 1) * sizeof(int64_t));
+    data->wStart = malloc((n + 1) * sizeof(double));
+    data->wOff = malloc(n * sizeof(int64_t));
+    if (!wr || !data->wFrom || !data->wStart || !data->wOff) {
+        laik_panic("Out of memory in block partitioner");
+        exit(1); // not actually needed, laik_panic never returns
+    }
+    for(int i = 0; i < n; i++) {
+        Laik_TaskRange* ts = laik_partitioning_get_taskrange(p, i);
+        const Laik_Range* r = laik_taskrange_get_range(ts);
+        wr[i].from = r->from.i[0] - s->range.from.i[0];
+        wr[i].to = r->to.i[0] - s->range.from.i[0];
+        wr[i].task = laik_taskrange_get_task(ts);
+    }
+    qsort(wr, n, sizeof(WeightRange), wrange_cmp);
+
+    int64_t pos = 0, ownSize = 0;
+    int i;
+    for(i = 0; i < n; i++) {
+        if (wr[i].from != pos) break;
+        pos = wr[i].to;
+        data->wFrom[i] = wr[i].from;
+        data->wOff[i] = -1;
+        if (wr[i].task == g->myid) {
+            data->wOff[i] = ownSize;
+            ownSize += wr[i].to - wr[i].from + 1;
+        }
+    }
+    // all ranges must be consecutive (otherwise wFrom/wOff are incomplete)
+    if ((i < n) || (pos != s->range.to.i[0] - s->range.from.i[0])) {
+        laik_panic("block partitioner: partitioning of weight container "
+                   "must cover space without overlap");
+        exit(1); // not actually needed, laik_panic never returns
+    }
+    data->wFrom[n] = pos;
+    data->wRanges = n;
+    data->wGroup = g;
+
+    // prefix sums within own ranges, and sums of all ranges
+    data->wLocal = malloc((ownSize + 1) * sizeof(double));
+    if (!data->wLocal) {
+        laik_panic("Out of memory in block partitioner");
+        exit(1); // not actually needed, laik_panic never returns
+    }
+    for(int i = 0; i < n; i++) {
+        data->wStart[i] = 0.0;
+        if (data->wOff[i] < 0) continue;
+
+        int64_t len = wr[i].to - wr[i].from;
+        int mapNo;
+        uint64_t lidx, count;
+        double* base;
+        laik_global2maplocal_1d(d, wr[i].from + s->range.from.i[0], &mapNo, &lidx);
+        assert(mapNo >= 0);
+        laik_get_map_1d(d, mapNo, (void**) &base, &count);
+        assert(lidx + (uint64_t) len <= count);
+
+        double* pre = data->wLocal + data->wOff[i];
+        calcPrefixSum(base + lidx, len, pre);
+        data->wStart[i] = pre[len];
+    }
+    free(wr);
+    laik_allreduce(g, laik_Double, n, data->wStart, LAIK_RO_Sum,
+                   "block-weights");
+
+    // exclusive scan: weight sum before start of each range
+    double sum = 0.0;
+    for(int i = 0; i < n; i++) {
+        double v = data->wStart[i];
+        data->wStart[i] = sum;
+        sum += v;
+    }
+    data->wStart[n] = sum;
+
+    laik_log(1, "block partitioner: weights from '%s' (%d ranges, total %f)",
+             d->name, n, sum);
+
+    laik_update_block_partitioner(pr);
+}
+
+void laik_update_block_partitioner(Laik_Partitioner* pr)
+{
+    assert(pr->run == runBlockPartitioner);
+    laik_partitioner_changed(pr);
+
+    Laik_BlockPartitionerData* data;
+    data = (Laik_BlockPartitionerData*) pr->data;
+    // nothing to do without weight container
+    if (data->wGroup == 0) return;
+
+    int count = data->wGroup->size;
+    int n = count * data->cycles;
+    free(data->split);
+    free(data->splitTh);
+    data->splitCount = n;
+    data->split = malloc(n * sizeof(int64_t));
+    data->splitTh = malloc(n * sizeof(double));
+    if (!data->split || !data->splitTh) {
+        laik_panic("Out of memory in block partitioner");
+        exit(1); // not actually needed, laik_panic never returns
+    }
+    calcThresholds(data, count, data->wStart[data->wRanges], data->splitTh);
+
+    // each border is found by the process owning the range it is in
+    for(int i = 0; i < n; i++) {
+        double th = data->splitTh[i];
+        data->split[i] = -1;
+
+        // first range with weight sum at its end reaching threshold
+        int64_t k = findPrefix(data->wStart + 1, data->wRanges - 1, th);
+        if ((k >= data->wRanges) || (data->wOff[k] < 0)) continue;
+
+        // first index in range reaching threshold (exists, see above)
+        const double* pre = data->wLocal + data->wOff[k];
+        int64_t lo = 1, hi = data->wFrom[k + 1] - data->wFrom[k];
+        while(lo < hi) {
+            int64_t mid = lo + (hi - lo) / 2;
+            if (data->wStart[k] + pre[mid] >= th) hi = mid;
+            else lo = mid + 1;
+        }
+        data->split[i] = data->wFrom[k] + lo - 1;
+    }
+    laik_allreduce(data->wGroup, laik_Int64, n, data->split, LAIK_RO_Max,
+                   "block-weights");
+
+    // threshold not reached within space: range up to end
+    for(int i = 0; i < n; i++)
+        if (data->split[i] < 0)
+            data->split[i] = data->wFrom[data->wRanges];
+}
+
 void laik_set_task_weight(Laik_Partitioner* pr, Laik_GetTaskWeight_t f,
                           const void* userData)
 {
     assert(pr->run == runBlockPartitioner);
+    setWeightsChanged(pr);
 
     Laik_BlockPartitionerData* data;
     data = (Laik_BlockPartitionerData*) pr->data;
 
     data->getTaskW = f;
     data->userData = userData;
+    data->taskW = 0;
+    data->taskWCount = 0;
+}
+
+void laik_set_task_weight_array(Laik_Partitioner* pr, const double* w,
+                                int count)
+{
+    assert(pr->run == runBlockPartitioner);
+    setWeightsChanged(pr);
+
+    Laik_BlockPartitionerData* data;
+    data = (Laik_BlockPartitionerData*) pr->data;
+
+    data->getTaskW = 0;
+    data->taskW = w;
+    data->taskWCount = count;
 }
 
 void laik_set_cycle_count(Laik_Partitioner* pr, int cycles)
 {
     assert(pr->run == runBlockPartitioner);
+    laik_partitioner_changed(pr);
 
     Laik_BlockPartitionerData* data;
     data = (Laik_BlockPartitionerData*) pr->data;
@@ -837,3 +1733,234 @@ laik_new_reassign_partitioner(Laik_Group* newg,
     return laik_new_partitioner("reassign", runReassignPartitioner,
                                 data, 0);
 }
+
+
+
+//-------------------------------------------------------------------
+// Incremental partitioner: rebalance
+// move borders of a 1d partitioning according to new index/task weights,
+// with as few indexes as possible changing owner
+//
+// The base partitioning must have one range per task (tasks without ranges
+// stay without indexes), and tasks keep their order. Borders only are
+// moved if a task gets a weight sum larger than (1 + <tolerance>) times its
+// share. Then, borders are moved as little as needed: we go over borders in
+// index order, keeping each old border if the weight limits of the task
+// before and of the tasks after it still can be met, or moving it to the
+// nearest position possible otherwise. The same is done in reverse order,
+// and the result with less indexes changing owner is used.
+
+typedef struct {
+    Laik_GetIdxWeight_t getIdxW;
+    Laik_GetTaskWeight_t getTaskW;
+    const void* userData;
+    double tolerance;
+} RebalanceData;
+
+typedef struct {
+    int64_t from, to;
+    int task;
+} RebalanceRange;
+
+static
+int rrange_cmp(const void* p1, const void* p2)
+{
+    const RebalanceRange* r1 = (const RebalanceRange*) p1;
+    const RebalanceRange* r2 = (const RebalanceRange*) p2;
+    if (r1->from == r2->from) return 0;
+    return (r1->from < r2->from) ? -1 : 1;
+}
+
+// last index j in [0;n] with pre[j] <= v, or -1 if not existing
+static
+int64_t findPrefixLast(const double* pre, int64_t n, double v)
+{
+    int64_t lo = 0, hi = n + 1;
+    while(lo < hi) {
+        int64_t mid = lo + (hi - lo) / 2;
+        if (pre[mid] > v) hi = mid;
+        else lo = mid + 1;
+    }
+    return lo - 1;
+}
+
+// number of indexes changing owner if borders <b> are moved to <nb>
+static
+int64_t movedIndexes(int m, const int64_t* b, const int64_t* nb)
+{
+    int64_t kept = 0;
+    for(int k = 0; k < m; k++) {
+        int64_t from = (b[k] > nb[k]) ? b[k] : nb[k];
+        int64_t to = (b[k+1] < nb[k+1]) ? b[k+1] : nb[k+1];
+        if (from < to) kept += to - from;
+    }
+    return b[m] - kept;
+}
+
+void runRebalancePartitioner(Laik_RangeReceiver* r, Laik_PartitionerParams* p)
+{
+    RebalanceData* data = (RebalanceData*) p->partitioner->data;
+    Laik_Space* s = p->space;
+
+    // there must be old borders
+    Laik_Partitioning* oldP = p->other;
+    assert(oldP);
+    // only 1d for now
+    assert(s->dims == 1);
+    int64_t off = s->range.from.i[0];
+    int64_t size = s->range.to.i[0] - off;
+
+    // old ranges in index order, must be one range per task covering space
+    int m = laik_partitioning_rangecount(oldP);
+    RebalanceRange* rr = malloc(m * sizeof(RebalanceRange));
+    int64_t* b = malloc((m + 1) * sizeof(int64_t));
+    int64_t* b1 = malloc((m + 1) * sizeof(int64_t));
+    int64_t* b2 = malloc((m + 1) * sizeof(int64_t));
+    double* u = malloc((m + 1) * sizeof(double));
+    double* pre = malloc((size + 1) * sizeof(double));
+    if (!rr || !b || !b1 || !b2 || !u || !pre) {
+        laik_panic("Out of memory in rebalance partitioner");
+        exit(1); // not actually needed, laik_panic never returns
+    }
+    for(int k = 0; k < m; k++) {
+        Laik_TaskRange* ts = laik_partitioning_get_taskrange(oldP, k);
+        const Laik_Range* range = laik_taskrange_get_range(ts);
+        rr[k].from = range->from.i[0] - off;
+        rr[k].to = range->to.i[0] - off;
+        rr[k].task = laik_taskrange_get_task(ts);
+    }
+    qsort(rr, m, sizeof(RebalanceRange), rrange_cmp);
+    for(int k = 0; k < m; k++) {
+        if ((rr[k].from != ((k == 0) ? 0 : rr[k-1].to)) ||
+            ((k > 0) && (rr[k].task == rr[k-1].task))) {
+            laik_panic("rebalance partitioner: base partitioning must have "
+                       "one range per task, covering the space");
+            exit(1); // not actually needed, laik_panic never returns
+        }
+        b[k] = rr[k].from;
+    }
+    b[m] = size;
+
+    // prefix sums of index weights
+    Laik_Index idx;
+    laik_index_init(&idx, 0, 0, 0);
+    pre[0] = 0.0;
+    for(int64_t i = 0; i < size; i++) {
+        double w = 1.0;
+        if (data->getIdxW) {
+            idx.i[0] = i + off;
+            w = (data->getIdxW)(&idx, data->userData);
+        }
+        pre[i + 1] = pre[i] + w;
+    }
+    double totalW = pre[size];
+
+    // weight limit of tasks in index order, u[m] = 0 as sentinel
+    double totalTW = 0.0;
+    for(int k = 0; k < m; k++) {
+        u[k] = 1.0;
+        if (data->getTaskW)
+            u[k] = (data->getTaskW)(rr[k].task, data->userData);
+        totalTW += u[k];
+    }
+    double maxLoad = 0.0;
+    for(int k = 0; k < m; k++) {
+        double share = totalW * u[k] / totalTW;
+        double load = pre[b[k+1]] - pre[b[k]];
+        if ((share > 0.0) && (load / share > maxLoad))
+            maxLoad = load / share;
+        u[k] = share * (1.0 + data->tolerance);
+    }
+    u[m] = 0.0;
+
+    // left to right: task before border must stay below limit,
+    // tasks after border must be able to take the rest
+    double rest = 0.0;
+    for(int k = 0; k < m; k++)
+        rest += u[k];
+    b1[0] = 0;
+    for(int k = 1; k < m; k++) {
+        rest -= u[k-1];
+        int64_t lo = findPrefix(pre, size, totalW - rest);
+        int64_t hi = findPrefixLast(pre, size, pre[b1[k-1]] + u[k-1]);
+        int64_t v = b[k];
+        if (v < lo) v = lo;
+        if (v > hi) v = hi;
+        if (v < b1[k-1]) v = b1[k-1];
+        if (v > size) v = size;
+        b1[k] = v;
+    }
+    b1[m] = size;
+
+    // right to left: same constraints in reverse
+    rest = 0.0;
+    for(int k = 0; k < m; k++)
+        rest += u[k];
+    b2[m] = size;
+    for(int k = m - 1; k > 0; k--) {
+        rest -= u[k];
+        int64_t lo = findPrefix(pre, size, pre[b2[k+1]] - u[k]);
+        int64_t hi = findPrefixLast(pre, size, rest);
+        int64_t v = b[k];
+        if (v > hi) v = hi;
+        if (v < lo) v = lo;
+        if (v > b2[k+1]) v = b2[k+1];
+        if (v < 0) v = 0;
+        b2[k] = v;
+    }
+    b2[0] = 0;
+
+    int64_t moved1 = movedIndexes(m, b, b1);
+    int64_t moved2 = movedIndexes(m, b, b2);
+    int64_t* nb = (moved2 < moved1) ? b2 : b1;
+
+    if (laik_log_begin(1)) {
+        double newMax = 0.0;
+        for(int k = 0; k < m; k++) {
+            double share = u[k] / (1.0 + data->tolerance);
+            double load = pre[nb[k+1]] - pre[nb[k]];
+            if ((share > 0.0) && (load / share > newMax))
+                newMax = load / share;
+        }
+        laik_log_flush("rebalance: max. load %.3f => %.3f of share, "
+                       "%lld of %lld indexes change owner",
+                       maxLoad, newMax, (long long) ((nb == b2) ? moved2 : moved1),
+                       (long long) size);
+    }
+
+    Laik_Range range = s->range;
+    for(int k = 0; k < m; k++) {
+        if (nb[k] == nb[k+1]) continue;
+        range.from.i[0] = nb[k] + off;
+        range.to.i[0] = nb[k+1] + off;
+        laik_append_range(r, rr[k].task, &range, 0, 0);
+    }
+
+    free(rr);
+    free(b);
+    free(b1);
+    free(b2);
+    free(u);
+    free(pre);
+}
+
+Laik_Partitioner*
+laik_new_rebalance_partitioner(Laik_GetIdxWeight_t getIdxW,
+                               Laik_GetTaskWeight_t getTaskW,
+                               const void* userData, double tolerance)
+{
+    RebalanceData* data = malloc(sizeof(RebalanceData));
+    if (!data) {
+        laik_panic("Out of memory allocating RebalanceData object");
+        exit(1); // not actually needed, laik_panic never returns
+    }
+
+    data->getIdxW = getIdxW;
+    data->getTaskW = getTaskW;
+    data->userData = userData;
+    data->tolerance = tolerance;
+
+    // borders depend on base partitioning and weights at time of run
+    return laik_new_partitioner("rebalance", runRebalancePartitioner,
+                                data, LAIK_PF_NoRerun);
+}
@@ -140,11 +140,32 @@ static bool idxfilter_check(int64_t from, int64_t to, PFilterPar* par)
 }
 
 
+// check if 2d/3d range <s> intersects ranges given in par
+static bool idxfilter_checkND(const Laik_Range* s, PFilterPar* par)
+{
+    // quick check with borders of all ranges in first dimension
+    if ((s->from.i[0] >= par->to) || (s->to.i[0] <= par->from))
+        return false;
+
+    // own ranges typically are few: check all
+    Laik_Range r;
+    for(unsigned int i = 0; i < par->len; i++)
+        if (laik_range_intersection(s, &(par->ts[i].range), &r))
+            return true;
+    return false;
+}
+
 static
 bool idxfilter(Laik_RangeFilter* sf, int task, const Laik_Range* s)
 {
     (void) task; // unused parameter of filter signature
 
+    if (s->space->dims > 1) {
+        if (sf->pfilter1 && idxfilter_checkND(s, sf->pfilter1)) return true;
+        if (sf->pfilter2 && idxfilter_checkND(s, sf->pfilter2)) return true;
+        return false;
+    }
+
     int64_t from = s->from.i[0];
     int64_t to = s->to.i[0];
 
@@ -158,21 +179,29 @@ void laik_rangefilter_add_idxfilter(Laik_RangeFilter* sf, Laik_RangeList* list,
 {
     assert(list);
     assert(list->off != 0);
-    assert(list->space->dims == 1); // TODO: only for 1d for now
 
     assert((tid >= 0) && (tid < (int) list->tid_count));
+
+    // install filter function (without any own ranges, nothing is kept)
+    assert((sf->filter_func == 0) || (sf->filter_func == idxfilter));
+    sf->filter_func = idxfilter;
+
     // no own ranges?
-    unsigned mycount = list->off[tid+1] - list->off[tid];
+    unsigned mycount = (unsigned) laik_rangelist_tidrangecount(list, tid);
     if (mycount == 0) return;
 
-    Laik_TaskRange_Gen* ts1 = list->trange + list->off[tid];
-    Laik_TaskRange_Gen* ts2 = list->trange + list->off[tid+1]-1;
+    Laik_TaskRange_Gen* ts1 = list->trange + laik_rangelist_tidoff(list, tid);
 
     PFilterPar* par = malloc(sizeof(PFilterPar));
     par->len = mycount;
-    par->from = ts1->range.from.i[0];
-    par->to   = ts2->range.to.i[0];
     par->ts = ts1;
+    // borders of own ranges in 1st dimension (1d: sorted, not overlapping)
+    par->from = ts1->range.from.i[0];
+    par->to   = ts1->range.to.i[0];
+    for(unsigned i = 1; i < mycount; i++) {
+        if (ts1[i].range.from.i[0] < par->from) par->from = ts1[i].range.from.i[0];
+        if (ts1[i].range.to.i[0] > par->to) par->to = ts1[i].range.to.i[0];
+    }
 
     if      (sf->pfilter1 == 0) sf->pfilter1 = par;
     else if (sf->pfilter2 == 0) sf->pfilter2 = par;
@@ -180,9 +209,6 @@ void laik_rangefilter_add_idxfilter(Laik_RangeFilter* sf, Laik_RangeList* list,
 
     laik_log(1,"Set pfilter to intersection with %d ranges between [%lld;%lld[",
              par->len, (long long) par->from, (long long) par->to);
-
-    // install filter function
-    sf->filter_func = idxfilter;
 }
 
 
@@ -229,6 +255,16 @@ void laik_rangefilter_add_idxfilter(Laik_RangeFilter* sf, Laik_RangeList* list,
 
 static int partitioning_id = 0;
 
+// memory used for range lists stored in partitionings of this process
+static uint64_t rangeMemory = 0, rangeMemoryPeak = 0;
+
+static void addRangeMemory(int64_t bytes)
+{
+    rangeMemory += bytes;
+    if (rangeMemory > rangeMemoryPeak)
+        rangeMemoryPeak = rangeMemory;
+}
+
 // internal helper
 Laik_Partitioning* laik_partitioning_new(char* name,
                                          Laik_Group* g, Laik_Space* s,
@@ -258,6 +294,7 @@ Laik_Partitioning* laik_partitioning_new(char* name,
     p->rangeList = 0;
 
     p->other = other;
+    p->nextRerun = 0;
 
     return p;
 }
@@ -290,13 +327,51 @@ Laik_Partitioning* laik_clone_empty_partitioning(Laik_Partitioning* p)
                                  p->partitioner, p->other);
 }
 
+// add/remove partitioning to/from list of partitionings which may need
+// to run their partitioner again (see laik_partitioner_changed)
+static
+void addRerun(Laik_Partitioning* p)
+{
+    Laik_Partitioner* pr = p->partitioner;
+    for(Laik_Partitioning* pp = pr->firstRerun; pp; pp = pp->nextRerun)
+        if (pp == p) return; // already in list
+
+    p->nextRerun = pr->firstRerun;
+    pr->firstRerun = p;
+}
+
+static
+void removeRerun(Laik_Partitioning* p)
+{
+    if (!p->partitioner) return;
+
+    Laik_Partitioning** prev = &(p->partitioner->firstRerun);
+    while(*prev) {
+        if (*prev == p) {
+            *prev = p->nextRerun;
+            break;
+        }
+        prev = &((*prev)->nextRerun);
+    }
+    p->nextRerun = 0;
+}
+
 // free resources allocated for a partitioning object
 void laik_free_partitioning(Laik_Partitioning* p)
 {
+    removeRerun(p);
+
+    // switch caches of containers must not refer to freed partitioning
+    laik_data_invalidate_switchcache(p->space->inst, p);
+
     RangeList_Entry* e = p->rangeList;
     while(e) {
+        RangeList_Entry* next = e->next;
+        addRangeMemory(- (int64_t) e->bytes);
         laik_rangelist_free(e->ranges);
-        e = e->next;
+        free(e->ranges);
+        free(e);
+        e = next;
     }
     free(p);
 }
@@ -350,7 +425,7 @@ Laik_RangeList* laik_partitioning_interranges(Laik_Partitioning* p,
             return e->ranges;
         }
         if ((e->info == LAIK_RI_INTERSECT) &&
-            (e->other == p2)) {
+            (e->other == p2) && (e->otherId == p2->id)) {
             return e->ranges;
         }
 
@@ -378,9 +453,31 @@ RangeList_Entry* laik_partitioning_add_ranges(Laik_Partitioning* p, Laik_RangeLi
     e->next = p->rangeList;
     p->rangeList = e;
 
+    e->bytes = sizeof(RangeList_Entry) + laik_rangelist_memory(list);
+    addRangeMemory((int64_t) e->bytes);
+
     return e;
 }
 
+// remove range lists of given type from partitioning
+static
+void laik_partitioning_remove_ranges(Laik_Partitioning* p, RangeInfo info)
+{
+    RangeList_Entry** prev = &(p->rangeList);
+    while(*prev) {
+        RangeList_Entry* e = *prev;
+        if (e->info != info) {
+            prev = &(e->next);
+            continue;
+        }
+        *prev = e->next;
+        addRangeMemory(- (int64_t) e->bytes);
+        laik_rangelist_free(e->ranges);
+        free(e->ranges);
+        free(e);
+    }
+}
+
 // internal: run partitioner given for partitioning, using given filter
 // and add resulting range list to partitioning
 static
@@ -394,9 +491,21 @@ RangeList_Entry* laik_partitioning_run(Laik_Partitioning* p, Laik_RangeFilter* s
     params.partitioner = p->partitioner;
     params.other       = p->other;
 
+    // in owner-only mode, ranges of a base partitioning needed by the
+    // partitioner (e.g. to extend them by halos) are only kept for this run
+    bool dropOther = p->other && p->group->inst->ownerRanges &&
+                     (laik_partitioning_allranges(p->other) == 0);
+
     Laik_RangeList* list;
     list = laik_run_partitioner(&params, sf);
 
+    if (dropOther) {
+        laik_partitioning_remove_ranges(p->other, LAIK_RI_FULL);
+        // the partitioner of the base partitioning may be run again
+        if (p->other->partitioner)
+            addRerun(p->other);
+    }
+
     if (laik_log_begin(2)) {
         laik_log_append("run partitioner '%s' for '%s' (group %d, space '%s'): %d ranges",
                         p->partitioner->name, p->name,
@@ -417,22 +526,79 @@ void laik_partitioning_store_allranges(Laik_Partitioning* p)
 {
     RangeList_Entry* e = laik_partitioning_run(p, 0);
     e->info = LAIK_RI_FULL;
+
+    // all other range lists can be derived without partitioner run
+    removeRerun(p);
+}
+
+
+// own ranges in <list> from a re-run of the partitioner of <p> must match
+// the ones stored before. This is not the case if parameters of the
+// partitioner were changed in-between (e.g. task weights)
+static
+void checkOwnRanges(Laik_Partitioning* p, Laik_RangeList* list)
+{
+    int myid = p->group->myid;
+    Laik_RangeList* myList = laik_partitioning_myranges(p);
+    if ((myid < 0) || (myList == 0) || (myList == list)) return;
+
+    int n = laik_rangelist_tidrangecount(myList, myid);
+    bool same = (n == laik_rangelist_tidrangecount(list, myid));
+    unsigned int o1 = laik_rangelist_tidoff(myList, myid);
+    unsigned int o2 = laik_rangelist_tidoff(list, myid);
+    for(int i = 0; same && (i < n); i++)
+        same = laik_range_isEqual(&(myList->trange[o1 + i].range),
+                                  &(list->trange[o2 + i].range));
+    if (!same) {
+        laik_log(LAIK_LL_Panic,
+                 "partitioner '%s' for '%s' gave different own ranges when"
+                 " run again: not supported with owner-only range lists",
+                 p->partitioner->name, p->name);
+        exit(1); // not actually needed, panic never returns
+    }
+}
+
+// run partitioner without filter if not done yet (owner-only mode), for
+// functions which need to check ranges of all processes
+static
+Laik_RangeList* needAllRanges(Laik_Partitioning* p)
+{
+    Laik_RangeList* list = laik_partitioning_allranges(p);
+    if (list || !p->partitioner) return list;
+
+    laik_log(1, "partitioning '%s': all ranges required", p->name);
+    laik_partitioning_store_allranges(p);
+    list = laik_partitioning_allranges(p);
+    checkOwnRanges(p, list);
+    return list;
 }
 
 
 // run the partitioner specified for the partitioning, keeping only ranges of this task
 void laik_partitioning_store_myranges(Laik_Partitioning* p)
 {
-    if (p->group->myid < 0) return;
-
-    Laik_RangeFilter* sf = laik_rangefilter_new();
-    laik_rangefilter_set_myfilter(sf, p->group);
+    RangeList_Entry* e;
+    if (p->group->myid < 0) {
+        // not part of group: no own ranges. An empty list still is stored,
+        // as own ranges are needed after migration to a common group
+        Laik_RangeList* list = laik_rangelist_new(p->space, (unsigned) p->group->size);
+        laik_rangelist_freeze(list, false);
+        e = laik_partitioning_add_ranges(p, list);
+    }
+    else {
+        Laik_RangeFilter* sf = laik_rangefilter_new();
+        laik_rangefilter_set_myfilter(sf, p->group);
 
-    RangeList_Entry* e = laik_partitioning_run(p, sf);
-    laik_rangefilter_free(sf);
+        e = laik_partitioning_run(p, sf);
+        laik_rangefilter_free(sf);
+    }
 
     e->info = LAIK_RI_SINGLETASK;
     e->filter_tid = p->group->myid;
+
+    // ranges of other processes may be required later
+    if (laik_partitioning_allranges(p) == 0)
+        addRerun(p);
 }
 
 // run the partitioner specified for the partitioning, keeping ranges
@@ -454,23 +620,30 @@ void laik_partitioning_store_intersectranges(Laik_Partitioning* p,
         exit(1); // not actually needed, laik_panic never returns
     }
 
+    // own ranges only exist in partitionings of groups we are part of
     sf = laik_rangefilter_new();
-    list = laik_partitioning_myranges(p);
-    list2 = laik_partitioning_myranges(p2);
-    if ((list == 0) || (list2 == 0)) {
+    list = (p->group->myid >= 0) ? laik_partitioning_myranges(p) : 0;
+    list2 = (p2->group->myid >= 0) ? laik_partitioning_myranges(p2) : 0;
+    if (((list == 0) && (p->group->myid >= 0)) ||
+        ((list2 == 0) && (p2->group->myid >= 0))) {
         // partitioner for own ranges not run yet: but we need them!
         laik_panic("Request for intersection without base ranges");
         exit(1); // not actually needed, laik_panic never returns
     }
-    laik_rangefilter_add_idxfilter(sf, list, p->group->myid);
-    if (p2 != p) // no need to add same ranges twice to filter
+    if (list)
+        laik_rangefilter_add_idxfilter(sf, list, p->group->myid);
+    if (list2 && (p2 != p)) // no need to add same ranges twice to filter
         laik_rangefilter_add_idxfilter(sf, list2, p2->group->myid);
+    if (sf->filter_func == 0) // not in any of the groups: keep no range
+        sf->filter_func = idxfilter;
 
     RangeList_Entry* e = laik_partitioning_run(p, sf);
     laik_rangefilter_free(sf);
+    checkOwnRanges(p, e->ranges);
 
     e->info = LAIK_RI_INTERSECT;
     e->other = p2;
+    e->otherId = p2->id;
 }
 
 
@@ -491,7 +664,7 @@ Laik_Group* laik_partitioning_get_group(Laik_Partitioning* p)
 // only allowed for offline partitioners, may be expensive
 int laik_partitioning_rangecount(Laik_Partitioning* p)
 {
-    Laik_RangeList* list = laik_partitioning_allranges(p);
+    Laik_RangeList* list = needAllRanges(p);
     assert(list != 0); // TODO: API user error
     return laik_rangelist_rangecount(list);
 }
@@ -504,7 +677,7 @@ Laik_TaskRange* laik_partitioning_get_taskrange(Laik_Partitioning* p, int n)
 {
     static Laik_TaskRange ts;
 
-    Laik_RangeList* list = laik_partitioning_allranges(p);
+    Laik_RangeList* list = needAllRanges(p);
     assert(list != 0); // TODO: API user error
 
     if (n >= (int) list->count) return 0;
@@ -525,7 +698,7 @@ Laik_TaskRange* laik_partitioning_get_taskrange(Laik_Partitioning* p, int n)
 bool laik_partitioning_isAll(Laik_Partitioning* p)
 {
     // no filter allowed
-    Laik_RangeList* list = laik_partitioning_allranges(p);
+    Laik_RangeList* list = needAllRanges(p);
     assert(list != 0); // TODO: API user error
 
     return laik_rangelist_isAll(list);
@@ -538,7 +711,7 @@ bool laik_partitioning_isAll(Laik_Partitioning* p)
 int laik_partitioning_isSingle(Laik_Partitioning* p)
 {
     // no filter allowed
-    Laik_RangeList* list = laik_partitioning_allranges(p);
+    Laik_RangeList* list = needAllRanges(p);
     assert(list != 0); // TODO: API user error
 
     return laik_rangelist_isSingle(list);
@@ -548,7 +721,7 @@ int laik_partitioning_isSingle(Laik_Partitioning* p)
 bool laik_partitioning_coversSpace(Laik_Partitioning* p)
 {
     // no filter allowed
-    Laik_RangeList* list = laik_partitioning_allranges(p);
+    Laik_RangeList* list = needAllRanges(p);
     assert(list != 0); // TODO: API user error
 
     return laik_rangelist_coversSpace(list);
@@ -558,9 +731,9 @@ bool laik_partitioning_coversSpace(Laik_Partitioning* p)
 bool laik_partitioning_isEqual(Laik_Partitioning* p1, Laik_Partitioning* p2)
 {
     // no filters allowed
-    Laik_RangeList* sa1 = laik_partitioning_allranges(p1);
+    Laik_RangeList* sa1 = needAllRanges(p1);
     assert(sa1 != 0); // TODO: API user error
-    Laik_RangeList* sa2 = laik_partitioning_allranges(p2);
+    Laik_RangeList* sa2 = needAllRanges(p2);
     assert(sa2 != 0); // TODO: API user error
 
     return laik_rangelist_isEqual(sa1, sa2);
@@ -577,16 +750,105 @@ Laik_Partitioning* laik_new_partitioning(Laik_Partitioner* pr,
 {
     Laik_Partitioning* p;
     p = laik_new_empty_partitioning(g, space, pr, otherP);
-    laik_partitioning_store_allranges(p);
+    if (g->inst->ownerRanges && !(pr->flags & LAIK_PF_NoRerun))
+        laik_partitioning_store_myranges(p);
+    else
+        laik_partitioning_store_allranges(p);
     return p;
 }
 
+// internal: parameters of partitioner <pr> are about to change (e.g. new
+// weights). Partitionings created before with only own ranges stored must
+// not run <pr> again, as results would differ: store all ranges now
+void laik_partitioner_changed(Laik_Partitioner* pr)
+{
+    while(pr->firstRerun) {
+        Laik_Partitioning* p = pr->firstRerun;
+        laik_log(1, "partitioner '%s' changed: storing all ranges of '%s'",
+                 pr->name, p->name);
+        needAllRanges(p);
+        removeRerun(p);
+    }
+}
+
+// public: only store own ranges for partitionings created afterwards.
+// Ranges of other processes required for transitions are calculated on
+// demand, keeping only the ranges intersecting own ranges. This way,
+// memory for partitionings does not grow with the number of processes.
+// Default is set by environment variable LAIK_OWNER_RANGES
+void laik_set_owner_ranges(Laik_Instance* inst, bool enable)
+{
+    inst->ownerRanges = enable;
+}
+
+// internal: make sure ranges required for calculating the transition
+// from <fromP> to <toP> are stored (only needed in owner-only mode).
+// <fromP> and <toP> may be based on different groups: this must be called
+// before migrating them to a common group, as partitioners are run with
+// the group of the partitioning
+void laik_partitioning_prepare_transition(Laik_Partitioning* fromP,
+                                          Laik_Partitioning* toP,
+                                          Laik_ReductionOperation redOp)
+{
+    if (toP && toP->partitioner && (laik_partitioning_myranges(toP) == 0))
+        laik_partitioning_store_myranges(toP);
+
+    if ((fromP == 0) || (toP == 0)) return;
+    if (!fromP->partitioner || !toP->partitioner) return;
+
+    if (laik_partitioning_myranges(fromP) == 0)
+        laik_partitioning_store_myranges(fromP);
+
+    // detection of reductions on full space in 2d/3d needs all ranges
+    if ((fromP->space->dims > 1) && laik_is_reduction(redOp)) {
+        needAllRanges(fromP);
+        needAllRanges(toP);
+        return;
+    }
+
+    // ranges of other processes intersecting own ones
+    if (laik_partitioning_interranges(fromP, toP) == 0)
+        laik_partitioning_store_intersectranges(fromP, toP);
+    if (laik_partitioning_interranges(toP, fromP) == 0)
+        laik_partitioning_store_intersectranges(toP, fromP);
+}
+
+// public: bytes used for ranges stored with partitioning <p>
+uint64_t laik_partitioning_memory(Laik_Partitioning* p)
+{
+    uint64_t bytes = sizeof(Laik_Partitioning);
+    for(RangeList_Entry* e = p->rangeList; e; e = e->next)
+        bytes += e->bytes;
+    return bytes;
+}
+
+// public: bytes used for range lists stored with partitionings in this
+// process, currently and maximum so far
+void laik_get_partitioning_memory(uint64_t* current, uint64_t* peak)
+{
+    if (current) *current = rangeMemory;
+    if (peak) *peak = rangeMemoryPeak;
+}
+
 
 
 // migrate partitioning borders to new group without changing borders
 // - added tasks get empty partitions
 // - removed tasks must have empty partitiongs
 void laik_partitioning_migrate(Laik_Partitioning* p, Laik_Group* newg)
+{
+    // the partitioner cannot be run again afterwards, as it would use
+    // the new group: in owner-only mode, all ranges are needed now
+    if ((p->group != newg) && p->group->inst->ownerRanges)
+        needAllRanges(p);
+
+    laik_partitioning_migrate_ranges(p, newg);
+}
+
+// internal: migrate stored range lists of partitioning to new group.
+// Used for temporary migration to a common group in switches, with ranges
+// required for the transition prepared before
+void laik_partitioning_migrate_ranges(Laik_Partitioning* p, Laik_Group* newg)
 {
     Laik_Group* oldg = p->group;
     if (oldg == newg) return;
@@ -614,13 +876,22 @@ void laik_partitioning_migrate(Laik_Partitioning* p, Laik_Group* newg)
         assert(0);
     }
 
+    // cached transitions for this partitioning become invalid
+    laik_data_invalidate_switchcache(p->space->inst, p);
+
     RangeList_Entry* e = p->rangeList;
     while(e) {
         if (e->info == LAIK_RI_SINGLETASK) {
+            // own ranges: -1 if this process is not part of the old group
             assert(e->filter_tid < oldg->size);
-            e->filter_tid = fromOld[e->filter_tid];
+            e->filter_tid = (e->filter_tid < 0) ? newg->myid : fromOld[e->filter_tid];
         }
         laik_rangelist_migrate(e->ranges, fromOld, (unsigned int) newg->size);
+
+        // offset array may have changed size
+        addRangeMemory(- (int64_t) e->bytes);
+        e->bytes = sizeof(RangeList_Entry) + laik_rangelist_memory(e->ranges);
+        addRangeMemory((int64_t) e->bytes);
         e = e->next;
     }
 
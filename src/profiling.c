@@ -59,8 +59,8 @@
  * - API suggests that we can profile per LAIK instance, but
  *   profiling can be active only for one instance?!
  * - ensure user time to be mutual exclusive to LAIK times
- * - how to make this usable for automatic load balancing?
- *   (connect absolute times (!) with a partitioning to modify)
+ * - automatic load balancing (see below) uses own timers, as
+ *   times have to be connected with the partitioning to modify
  * - global user time instead of per-LAIK-instance user times
  * - control this from outside (environment variables)
  * - keep it usable also for production mode (too much
@@ -257,3 +257,132 @@ void laik_profile_printf(const char* msg, ...)
     }
 }
 
+
+//----------------------------------------------------------------------
+// automatic load balancing
+//
+// The application measures its compute time per iteration with
+// laik_lb_start/laik_lb_stop. laik_lb_balance collects the times of all
+// tasks with one reduction. If the slowest task needs more than
+// (1 + threshold) times the average, and at least <interval> checks were
+// done since the last repartitioning, new task weights are set for the
+// block partitioner and a new partitioning is returned.
+// The time of a task is assumed to be proportional to its weight divided
+// by its speed, so the new weight of a task is its old weight divided by
+// its time. Tasks without measured time keep their weight.
+
+Laik_LoadBalancer* laik_new_load_balancer(Laik_Partitioner* pr,
+                                          double threshold, int interval)
+{
+    Laik_LoadBalancer* lb = malloc(sizeof(Laik_LoadBalancer));
+    if (!lb) {
+        laik_panic("Out of memory allocating Laik_LoadBalancer object");
+        exit(1); // not actually needed, laik_panic never returns
+    }
+
+    lb->pr = pr;
+    lb->threshold = threshold;
+    lb->interval = interval;
+    lb->size = 0;
+    lb->weight = 0;
+    lb->time = 0;
+    lb->start = 0.0;
+    lb->myTime = 0.0;
+    lb->calls = 0;
+
+    return lb;
+}
+
+void laik_free_load_balancer(Laik_LoadBalancer* lb)
+{
+    if (lb->weight)
+        laik_set_task_weight_array(lb->pr, 0, 0);
+    free(lb->weight);
+    free(lb->time);
+    free(lb);
+}
+
+void laik_lb_start(Laik_LoadBalancer* lb)
+{
+    lb->start = laik_wtime();
+}
+
+void laik_lb_stop(Laik_LoadBalancer* lb)
+{
+    if (lb->start == 0.0) return;
+
+    lb->myTime += laik_wtime() - lb->start;
+    lb->start = 0.0;
+}
+
+Laik_Partitioning* laik_lb_balance(Laik_LoadBalancer* lb, Laik_Partitioning* p)
+{
+    Laik_Group* g = p->group;
+    if (g->myid < 0) return 0;
+
+    // task weights start with 1, also after group size changes
+    if (lb->size != g->size) {
+        // partitioner may still use the old weights: without a new array,
+        // it uses weight 1 for all tasks until the next repartitioning
+        if (lb->weight)
+            laik_set_task_weight_array(lb->pr, 0, 0);
+        free(lb->weight);
+        free(lb->time);
+        lb->size = g->size;
+        lb->weight = malloc(lb->size * sizeof(double));
+        lb->time = malloc(lb->size * sizeof(double));
+        if (!lb->weight || !lb->time) {
+            laik_panic("Out of memory in load balancer");
+            exit(1); // not actually needed, laik_panic never returns
+        }
+        for(int i = 0; i < lb->size; i++)
+            lb->weight[i] = 1.0;
+        lb->calls = 0;
+    }
+
+    for(int i = 0; i < lb->size; i++)
+        lb->time[i] = 0.0;
+    lb->time[g->myid] = lb->myTime;
+    laik_allreduce(g, laik_Double, lb->size, lb->time, LAIK_RO_Sum, "lb-times");
+    lb->myTime = 0.0;
+    lb->calls++;
+
+    double sum = 0.0, max = 0.0;
+    for(int i = 0; i < lb->size; i++) {
+        sum += lb->time[i];
+        if (lb->time[i] > max) max = lb->time[i];
+    }
+    double avg = sum / lb->size;
+    if (avg <= 0.0) return 0;
+
+    double imbalance = max / avg;
+    laik_log(1, "load balancer: imbalance %.3f (max %.3fs, avg %.3fs)",
+             imbalance, max, avg);
+    if ((imbalance <= 1.0 + lb->threshold) || (lb->calls < lb->interval))
+        return 0;
+
+    // in owner-only mode, the partitioner may be run again for <p>, which
+    // would use the new weights: store all ranges of <p> before
+    if (g->inst->ownerRanges && (p->partitioner == lb->pr) &&
+        (laik_partitioning_allranges(p) == 0))
+        laik_partitioning_store_allranges(p);
+
+    // new weights, normalized to average 1
+    double wsum = 0.0;
+    for(int i = 0; i < lb->size; i++) {
+        if (lb->time[i] > 0.0)
+            lb->weight[i] = lb->weight[i] * avg / lb->time[i];
+        wsum += lb->weight[i];
+    }
+    for(int i = 0; i < lb->size; i++)
+        lb->weight[i] = lb->weight[i] * lb->size / wsum;
+
+    laik_set_task_weight_array(lb->pr, lb->weight, lb->size);
+    laik_update_block_partitioner(lb->pr);
+    lb->calls = 0;
+
+    laik_log(2, "load balancer: imbalance %.3f > %.3f, repartitioning",
+             imbalance, 1.0 + lb->threshold);
+
+    return laik_new_partitioning(lb->pr, g, p->space, 0);
+}
@@ -18,6 +18,8 @@
 #include "laik-internal.h"
 
 #include <assert.h>
+#include <limits.h>
+#include <pthread.h>
 #include <string.h>
 
 /// Laik_RangeList
@@ -42,21 +44,28 @@ Laik_RangeList* laik_rangelist_new(Laik_Space* space, unsigned int tid_count)
 
     // as long as no offset array is set, this range list is invalid
     list->off = 0;
+    list->off_first = 0;
+    list->off_count = 0;
 
     // number of maps still unknown
     list->map_tid = -1; // not used
     list->map_off = 0;
     list->map_count = 0;
 
+    list->index = 0;
+
     return list;
 }
 
+static void freeIndex(Laik_RangeList* list);
+
 void laik_rangelist_free(Laik_RangeList* list)
 {
     free(list->trange);
     free(list->tss1d);
     free(list->off);
     free(list->map_off);
+    freeIndex(list);
 }
 
 // does this cover the full space with one range for each process?
@@ -92,7 +101,10 @@ bool laik_rangelist_isEqual(Laik_RangeList* r1, Laik_RangeList* r2)
     if (r1->space != r2->space) return false;
     if (r1->count != r2->count) return false;
 
-    for(unsigned int i = 0; i < r1->tid_count; i++)
+    // offset arrays cover tasks from first to last with ranges
+    if (r1->off_first != r2->off_first) return false;
+    if (r1->off_count != r2->off_count) return false;
+    for(unsigned int i = 0; i < r1->off_count; i++)
         if (r1->off[i] != r2->off[i]) return false;
 
     for(unsigned int i = 0; i < r1->count; i++) {
@@ -111,23 +123,37 @@ int laik_rangelist_rangecount(Laik_RangeList* list)
     return (int) list->count;
 }
 
-int laik_rangelist_tidrangecount(Laik_RangeList* list, int tid)
+// get offset of first range of task <tid> in frozen list.
+// <tid> may be <tid_count>, returning the number of ranges
+unsigned int laik_rangelist_tidoff(Laik_RangeList* list, int tid)
 {
     assert(list->off != 0);
+    assert((tid >= 0) && (tid <= (int) list->tid_count));
+
+    // offsets only stored for tasks from first to last with ranges
+    if (tid <= (int) list->off_first) return 0;
+    if (tid >= (int) (list->off_first + list->off_count)) return list->count;
+    return list->off[tid - list->off_first];
+}
+
+int laik_rangelist_tidrangecount(Laik_RangeList* list, int tid)
+{
     assert((tid >= 0) && (tid < (int) list->tid_count));
 
-    return (int)(list->off[tid+1] - list->off[tid]);
+    return (int)(laik_rangelist_tidoff(list, tid + 1) -
+                 laik_rangelist_tidoff(list, tid));
 }
 
 // get number of mappings for this task
 int laik_rangelist_tidmapcount(Laik_RangeList* list, int tid)
 {
-    assert(list->off != 0);
     assert((tid >= 0) && (tid < (int) list->tid_count));
-    if (list->off[tid+1] == list->off[tid]) return 0;
+    unsigned int first = laik_rangelist_tidoff(list, tid);
+    unsigned int last = laik_rangelist_tidoff(list, tid + 1);
+    if (last == first) return 0;
 
     // map number of my last range, incremented by one to get count
-    return list->trange[list->off[tid+1] - 1].mapNo + 1;
+    return list->trange[last - 1].mapNo + 1;
 }
 
 Laik_TaskRange* laik_rangelist_taskrange(Laik_RangeList* list, int n)
@@ -146,13 +172,13 @@ Laik_TaskRange* laik_rangelist_taskrange(Laik_RangeList* list, int n)
 // returns a pointer to a global instance, needs to be copied of stored
 Laik_TaskRange* laik_rangelist_tidrange(Laik_RangeList* list, int tid, int n)
 {
-    assert(list->off != 0);
     assert((tid >= 0) && (tid < (int) list->tid_count));
-    int count = (int)(list->off[tid + 1] - list->off[tid]);
+    unsigned int first = laik_rangelist_tidoff(list, tid);
+    int count = (int)(laik_rangelist_tidoff(list, tid + 1) - first);
 
     // range <n> invalid?
     if ((n < 0) || (n >= count)) return 0;
-    int o = (int) list->off[tid] + n;
+    int o = (int) first + n;
     assert(list->trange[o].task == tid);
     return laik_rangelist_taskrange(list, o);
 }
@@ -163,25 +189,33 @@ Laik_TaskRange* laik_rangelist_tidrange(Laik_RangeList* list, int tid, int n)
 // print verbose debug output?
 //#define DEBUG_COVERSPACE 1
 
-// TODO: use dynamic list
-#define COVERLIST_MAX 100
-static Laik_Range notcovered[COVERLIST_MAX];
-static int notcovered_count;
+// list of ranges not yet covered, growing as needed
+typedef struct {
+    Laik_Range* range;
+    int count, size;
+} NotCovered;
 
-static void appendToNotcovered(Laik_Range* s)
+static void appendToNotcovered(NotCovered* nc, Laik_Range* s)
 {
-    assert(notcovered_count < COVERLIST_MAX);
-    notcovered[notcovered_count] = *s;
-    notcovered_count++;
+    if (nc->count == nc->size) {
+        nc->size = (nc->size == 0) ? 100 : 2 * nc->size;
+        nc->range = realloc(nc->range, nc->size * sizeof(Laik_Range));
+        if (!nc->range) {
+            laik_panic("Out of memory allocating memory for coversSpace");
+            exit(1); // not actually needed, laik_panic never returns
+        }
+    }
+    nc->range[nc->count] = *s;
+    nc->count++;
 }
 
 #ifdef DEBUG_COVERSPACE
-static void log_Notcovered(int dims, Laik_Range* toRemove)
+static void log_Notcovered(NotCovered* nc, int dims, Laik_Range* toRemove)
 {
     laik_log_append("not covered: (");
-    for(int j = 0; j < notcovered_count; j++) {
+    for(int j = 0; j < nc->count; j++) {
         if (j>0) laik_log_append(", ");
-        laik_log_Range(dims, &(notcovered[j]));
+        laik_log_Range(dims, &(nc->range[j]));
     }
     laik_log_append(")");
     if (toRemove) {
@@ -216,10 +250,10 @@ int trgen_cmpfrom(const void *p1, const void *p2)
 bool laik_rangelist_coversSpace(Laik_RangeList* list)
 {
     int dims = list->space->dims;
-    notcovered_count = 0;
+    NotCovered nc = { 0, 0, 0 };
 
     // start with full space not-yet-covered
-    appendToNotcovered(&(list->space->range));
+    appendToNotcovered(&nc, &(list->space->range));
 
     // use a copy of range list which is just sorted by range start
     Laik_TaskRange_Gen* trlist;
@@ -239,18 +273,19 @@ bool laik_rangelist_coversSpace(Laik_RangeList* list)
 #ifdef DEBUG_COVERSPACE
         if (laik_log_begin(1)) {
             laik_log_append("coversSpace - ");
-            log_Notcovered(dims, toRemove);
+            log_Notcovered(&nc, dims, toRemove);
             laik_log_flush(0);
         }
 #endif
 
-        int count = notcovered_count; // number of ranges to visit
+        int count = nc.count; // number of ranges to visit
         for(int j = 0; j < count; j++) {
-            Laik_Range* orig = &(notcovered[j]);
+            // copy, as appending may move the list
+            Laik_Range orig = nc.range[j];
 
-            if (laik_range_intersect(orig, toRemove) == 0) {
+            if (laik_range_intersect(&orig, toRemove) == 0) {
                 // range to remove does not overlap with orig: keep original
-                appendToNotcovered(orig);
+                appendToNotcovered(&nc, &orig);
                 continue;
             }
 
@@ -259,47 +294,48 @@ bool laik_rangelist_coversSpace(Laik_RangeList* list)
             // check for space not covered in orig, loop through valid dims
             for(int d = 0; d < dims; d++) {
                 // space in dim <d> before <toRemove> ?
-                if (orig->from.i[d] < toRemove->from.i[d]) {
+                if (orig.from.i[d] < toRemove->from.i[d]) {
                     // yes, add to not-covered
-                    Laik_Range s = *orig;
+                    Laik_Range s = orig;
                     s.to.i[d] = toRemove->from.i[d];
-                    appendToNotcovered(&s);
+                    appendToNotcovered(&nc, &s);
                     // remove appended part from <orig>
-                    orig->from.i[d] = toRemove->from.i[d];
+                    orig.from.i[d] = toRemove->from.i[d];
                 }
                 // space in dim <d> after <toRemove> ?
-                if (orig->to.i[d] > toRemove->to.i[d]) {
-                    Laik_Range s = *orig;
+                if (orig.to.i[d] > toRemove->to.i[d]) {
+                    Laik_Range s = orig;
                     s.from.i[d] = toRemove->to.i[d];
-                    appendToNotcovered(&s);
+                    appendToNotcovered(&nc, &s);
                     // remove appended part from <orig>
-                    orig->to.i[d] = toRemove->to.i[d];
+                    orig.to.i[d] = toRemove->to.i[d];
                 }
             }
         }
-        if (notcovered_count == count) {
+        if (nc.count == count) {
             // nothing appended, ie. nothing left?
-            notcovered_count = 0;
+            nc.count = 0;
             break;
         }
         // move appended ranges to start
-        for(int j = 0; j < notcovered_count - count; j++)
-            notcovered[j] = notcovered[count + j];
-        notcovered_count = notcovered_count - count;
+        for(int j = 0; j < nc.count - count; j++)
+            nc.range[j] = nc.range[count + j];
+        nc.count = nc.count - count;
     }
 
 #ifdef DEBUG_COVERSPACE
     if (laik_log_begin(1)) {
         laik_log_append("coversSpace - remaining ");
-        log_Notcovered(dims, 0);
+        log_Notcovered(&nc, dims, 0);
         laik_log_flush(0);
     }
 #endif
 
     free(trlist);
+    free(nc.range);
 
     // only if no ranges are left, we did cover full space
-    return (notcovered_count == 0);
+    return (nc.count == 0);
 }
 
 
@@ -341,6 +377,16 @@ void laik_rangelist_append_single1d(Laik_RangeList* list, int tid, int64_t idx)
     // not allowed to add ranges with different APIs
     assert(list->trange == 0);
 
+    // partitioners often append indexes of a task in order: extend last run
+    if (list->count > 0) {
+        Laik_TaskRange_Single1d* last = &(list->tss1d[list->count - 1]);
+        if ((last->task == tid) && (last->idx + last->len == idx) &&
+            (last->len < UINT_MAX)) {
+            last->len++;
+            return;
+        }
+    }
+
     if (list->count == list->capacity) {
         assert(list->trange == 0);
         list->capacity = (list->capacity + 2) * 2;
@@ -359,6 +405,7 @@ void laik_rangelist_append_single1d(Laik_RangeList* list, int tid, int64_t idx)
     list->count++;
 
     ts->task = tid;
+    ts->len = 1;
     ts->idx = idx;
 }
 
@@ -395,6 +442,64 @@ static int tss1d_cmp(const void *p1, const void *p2)
     return ts1->task - ts2->task;
 }
 
+// Sorting on freezing: partitioners often append ranges in order already,
+// which is checked first. Otherwise, large lists are sorted via a stable
+// LSD radix sort of (key, index) pairs, with one sort per key (starting
+// with the least significant). Elements are moved only once at the end.
+// Small lists are sorted with qsort.
+
+#define RADIX_BITS 11
+#define RADIX_MIN  256
+
+typedef struct {
+    uint64_t key;
+    unsigned int idx;
+} SortEntry;
+
+// stable sort of <n> entries in <e> by key, using <tmp> with space for <n>
+// entries. Digits equal in all keys are skipped.
+// Returns <e> or <tmp>, whichever holds the sorted result
+static SortEntry* radixSort(SortEntry* e, SortEntry* tmp, unsigned int n)
+{
+    unsigned int pos[1 << RADIX_BITS];
+    const uint64_t mask = (1 << RADIX_BITS) - 1;
+
+    uint64_t diff = 0;
+    for(unsigned int i = 1; i < n; i++)
+        diff |= e[i].key ^ e[0].key;
+
+    for(int shift = 0; shift < 64; shift += RADIX_BITS) {
+        if (((diff >> shift) & mask) == 0) continue;
+
+        memset(pos, 0, sizeof(pos));
+        for(unsigned int i = 0; i < n; i++)
+            pos[(e[i].key >> shift) & mask]++;
+        unsigned int sum = 0;
+        for(unsigned int d = 0; d <= mask; d++) {
+            unsigned int c = pos[d];
+            pos[d] = sum;
+            sum += c;
+        }
+        for(unsigned int i = 0; i < n; i++)
+            tmp[pos[(e[i].key >> shift) & mask]++] = e[i];
+
+        SortEntry* t = e;
+        e = tmp;
+        tmp = t;
+    }
+    return e;
+}
+
+static SortEntry* allocSortEntries(unsigned int n)
+{
+    SortEntry* e = malloc(2 * (size_t) n * sizeof(SortEntry));
+    if (!e) {
+        laik_panic("Out of memory sorting Laik_RangeList");
+        exit(1); // not actually needed, laik_panic never returns
+    }
+    return e;
+}
+
 static void sortRanges(Laik_RangeList* list)
 {
     // nothing to sort?
@@ -404,8 +509,81 @@ static void sortRanges(Laik_RangeList* list)
     //  then per tag (to go into one mapping),
     //  then per start index (to enable merging)
     assert(list->trange);
-    qsort(&(list->trange[0]), list->count,
-          sizeof(Laik_TaskRange_Gen), trgen_cmp);
+    unsigned int n = list->count;
+    unsigned int i;
+    for(i = 1; i < n; i++)
+        if (trgen_cmp(&(list->trange[i-1]), &(list->trange[i])) > 0) break;
+    if (i == n) return;
+
+    if (n < RADIX_MIN) {
+        qsort(&(list->trange[0]), n, sizeof(Laik_TaskRange_Gen), trgen_cmp);
+        return;
+    }
+
+    SortEntry* e = allocSortEntries(n);
+    int64_t from0 = list->space->range.from.i[0];
+    for(i = 0; i < n; i++) {
+        e[i].key = (uint64_t) (list->trange[i].range.from.i[0] - from0);
+        e[i].idx = i;
+    }
+    SortEntry* s = radixSort(e, e + n, n);
+    // tags compared as signed integers
+    for(i = 0; i < n; i++) {
+        Laik_TaskRange_Gen* tr = &(list->trange[s[i].idx]);
+        s[i].key = ((uint64_t) tr->task << 32) |
+                   ((uint32_t) tr->tag ^ 0x80000000u);
+    }
+    s = radixSort(s, (s == e) ? e + n : e, n);
+
+    Laik_TaskRange_Gen* sorted = malloc(sizeof(Laik_TaskRange_Gen) * n);
+    if (!sorted) {
+        laik_panic("Out of memory sorting Laik_RangeList");
+        exit(1); // not actually needed, laik_panic never returns
+    }
+    for(i = 0; i < n; i++)
+        sorted[i] = list->trange[s[i].idx];
+    free(e);
+    free(list->trange);
+    list->trange = sorted;
+    list->capacity = n;
+}
+
+// sort single index runs by task and index
+static void sortRangesSI(Laik_RangeList* list)
+{
+    unsigned int n = list->count;
+    unsigned int i;
+    for(i = 1; i < n; i++)
+        if (tss1d_cmp(&(list->tss1d[i-1]), &(list->tss1d[i])) > 0) break;
+    if (i == n) return;
+
+    if (n < RADIX_MIN) {
+        qsort(&(list->tss1d[0]), n, sizeof(Laik_TaskRange_Single1d), tss1d_cmp);
+        return;
+    }
+
+    SortEntry* e = allocSortEntries(n);
+    int64_t from0 = list->space->range.from.i[0];
+    for(i = 0; i < n; i++) {
+        e[i].key = (uint64_t) (list->tss1d[i].idx - from0);
+        e[i].idx = i;
+    }
+    SortEntry* s = radixSort(e, e + n, n);
+    for(i = 0; i < n; i++)
+        s[i].key = (uint64_t) list->tss1d[s[i].idx].task;
+    s = radixSort(s, (s == e) ? e + n : e, n);
+
+    Laik_TaskRange_Single1d* sorted = malloc(sizeof(Laik_TaskRange_Single1d) * n);
+    if (!sorted) {
+        laik_panic("Out of memory sorting Laik_RangeList");
+        exit(1); // not actually needed, laik_panic never returns
+    }
+    for(i = 0; i < n; i++)
+        sorted[i] = list->tss1d[s[i].idx];
+    free(e);
+    free(list->tss1d);
+    list->tss1d = sorted;
+    list->capacity = n;
 }
 
 static void mergeSortedRanges(Laik_RangeList* list)
@@ -442,6 +620,30 @@ static void mergeSortedRanges(Laik_RangeList* list)
     list->count = dstOff + 1;
 }
 
+// (re)allocate offset array for sorted ranges. To not grow with the
+// number of task ids for lists with ranges of few tasks only (e.g.
+// from filtered partitioner runs), offsets are only stored for tasks
+// from the first to the last task with ranges
+static void allocOffsets(Laik_RangeList* list)
+{
+    if (list->count > 0) {
+        list->off_first = (unsigned int) list->trange[0].task;
+        list->off_count = (unsigned int) list->trange[list->count - 1].task
+                          + 1 - list->off_first;
+    }
+    else {
+        list->off_first = 0;
+        list->off_count = 0;
+    }
+
+    free(list->off);
+    list->off = malloc(sizeof(int) * (list->off_count + 1));
+    if (list->off == 0) {
+        laik_panic("Out of memory allocating space for Laik_RangeList object");
+        exit(1); // not actually needed, laik_panic never returns
+    }
+}
+
 // (1) update offset array from ranges,
 // (2) calculate map numbers from tags
 static void updateOffsets(Laik_RangeList* list)
@@ -450,11 +652,13 @@ static void updateOffsets(Laik_RangeList* list)
         assert(list->trange);
 
     // we assume that the ranges where sorted with sortRanges()
+    allocOffsets(list);
 
     int task, mapNo, lastTag;
+    int lastTask = (int) (list->off_first + list->off_count);
     unsigned int off = 0;
-    for(task = 0; task < (int) list->tid_count; task++) {
-        list->off[task] = off;
+    for(task = (int) list->off_first; task < lastTask; task++) {
+        list->off[task - list->off_first] = off;
         mapNo = -1; // for numbering of mappings according to tags
         lastTag = -1;
         while(off < list->count) {
@@ -469,7 +673,7 @@ static void updateOffsets(Laik_RangeList* list)
             off++;
         }
     }
-    list->off[task] = off;
+    list->off[list->off_count] = off;
     assert(off == list->count);
 }
 
@@ -481,28 +685,26 @@ static void updateOffsetsSI(Laik_RangeList* list)
     assert(list->count > 0);
 
     // make sure ranges are sorted according by task IDs
-    qsort(&(list->tss1d[0]), list->count,
-          sizeof(Laik_TaskRange_Single1d), tss1d_cmp);
+    sortRangesSI(list);
 
-    // count ranges
-    int64_t idx, idx0;
+    // count ranges: runs of same task overlapping or directly following
+    // each other are merged (<end> is end of current merged range)
+    int64_t end, idx0;
     int task;
     unsigned int count = 1;
     task = list->tss1d[0].task;
-    idx = list->tss1d[0].idx;
+    end = list->tss1d[0].idx + list->tss1d[0].len;
     for(unsigned int i = 1; i < list->count; i++) {
-        if (list->tss1d[i].task == task) {
-            if (list->tss1d[i].idx == idx) continue;
-            if (list->tss1d[i].idx == idx + 1) {
-                idx++;
-                continue;
-            }
+        Laik_TaskRange_Single1d* ts = &(list->tss1d[i]);
+        if ((ts->task == task) && (ts->idx <= end)) {
+            if (ts->idx + ts->len > end) end = ts->idx + ts->len;
+            continue;
         }
-        task = list->tss1d[i].task;
-        idx = list->tss1d[i].idx;
+        task = ts->task;
+        end = ts->idx + ts->len;
         count++;
     }
-    laik_log(1, "Merging single indexes: %d original, %d merged",
+    laik_log(1, "Merging single indexes: %d runs, %d merged",
              list->count, count);
 
     list->trange = malloc(sizeof(Laik_TaskRange_Gen) * count);
@@ -514,18 +716,19 @@ static void updateOffsetsSI(Laik_RangeList* list)
     // convert into generic ranges (already sorted)
     unsigned int off = 0, j = 0;
     task = list->tss1d[0].task;
-    idx0 = idx = list->tss1d[0].idx;
+    idx0 = list->tss1d[0].idx;
+    end = idx0 + list->tss1d[0].len;
     for(unsigned int i = 1; i <= list->count; i++) {
-        if ((i < list->count) && (list->tss1d[i].task == task)) {
-            if (list->tss1d[i].idx == idx) continue;
-            if (list->tss1d[i].idx == idx + 1) {
-                idx++;
+        if (i < list->count) {
+            Laik_TaskRange_Single1d* ts = &(list->tss1d[i]);
+            if ((ts->task == task) && (ts->idx <= end)) {
+                if (ts->idx + ts->len > end) end = ts->idx + ts->len;
                 continue;
             }
         }
         laik_log(1, "  adding range for offsets %d - %d: task %d, [%lld;%lld[",
                  j, i-1, task,
-                 (long long) idx0, (long long) (idx + 1) );
+                 (long long) idx0, (long long) end);
 
         Laik_TaskRange_Gen* ts = &(list->trange[off]);
         ts->task = task;
@@ -534,12 +737,13 @@ static void updateOffsetsSI(Laik_RangeList* list)
         ts->data = 0;
         ts->range.space = list->space;
         ts->range.from.i[0] = idx0;
-        ts->range.to.i[0] = idx + 1;
+        ts->range.to.i[0] = end;
         off++;
         if (i == list->count) break;
 
         task = list->tss1d[i].task;
-        idx0 = idx = list->tss1d[i].idx;
+        idx0 = list->tss1d[i].idx;
+        end = idx0 + list->tss1d[i].len;
         j = i;
     }
     assert(count == off);
@@ -548,9 +752,11 @@ static void updateOffsetsSI(Laik_RangeList* list)
     list->tss1d = 0;
 
     // update offsets
+    allocOffsets(list);
+    int lastTask = (int) (list->off_first + list->off_count);
     off = 0;
-    for(task = 0; task < (int) list->tid_count; task++) {
-        list->off[task] = off;
+    for(task = (int) list->off_first; task < lastTask; task++) {
+        list->off[task - list->off_first] = off;
         while(off < list->count) {
             Laik_TaskRange_Gen* ts = &(list->trange[off]);
             if (ts->task > task) break;
@@ -558,7 +764,7 @@ static void updateOffsetsSI(Laik_RangeList* list)
             off++;
         }
     }
-    list->off[task] = off;
+    list->off[list->off_count] = off;
     assert(off == list->count);
 }
 
@@ -572,8 +778,8 @@ void laik_updateMapOffsets(Laik_RangeList* list, int tid)
 
     assert((tid >= 0) && (tid < (int) list->tid_count));
 
-    unsigned int firstOff = list->off[tid];
-    unsigned int lastOff = list->off[tid + 1];
+    unsigned int firstOff = laik_rangelist_tidoff(list, tid);
+    unsigned int lastOff = laik_rangelist_tidoff(list, tid + 1);
     if (lastOff > firstOff)
         list->map_count = (unsigned)(list->trange[lastOff - 1].mapNo + 1);
     else {
@@ -647,12 +853,6 @@ void laik_rangelist_freeze(Laik_RangeList* list, bool doMerge)
     assert(list->off == 0);
 
     // set partitioning valid by allocating/updating offsets
-    list->off = malloc(sizeof(int) * (list->tid_count + 1));
-    if (list->off == 0) {
-        laik_panic("Out of memory allocating space for Laik_RangeList object");
-        exit(1); // not actually needed, laik_panic never returns
-    }
-
     if (list->tss1d) {
         // merge and convert to generic
         updateOffsetsSI(list);
@@ -665,7 +865,15 @@ void laik_rangelist_freeze(Laik_RangeList* list, bool doMerge)
             mergeSortedRanges(list);
 
         updateOffsets(list);
+
+        // no ranges can be added any more: release unused space
+        if ((list->count > 0) && (list->count < list->capacity)) {
+            list->trange = realloc(list->trange,
+                                   sizeof(Laik_TaskRange_Gen) * list->count);
+            assert(list->trange != 0);
+        }
     }
+    list->capacity = list->count;
 }
 
 // translate task ids using <idmap> array: idmap[old_id] = new_id
@@ -677,7 +885,7 @@ void laik_rangelist_migrate(Laik_RangeList* list, int* idmap, unsigned int new_c
     // check that there are no ranges of removed task ids
     for(unsigned int i = 0; i < list->tid_count; i++) {
         if (idmap[i] < 0)
-            assert(list->off[i] == list->off[i+1]);
+            assert(laik_rangelist_tidrangecount(list, (int) i) == 0);
     }
 
     // update range task ids
@@ -689,16 +897,212 @@ void laik_rangelist_migrate(Laik_RangeList* list, int* idmap, unsigned int new_c
         list->trange[i].task = new_id;
     }
 
-    // resize offset array if needed
-    if (new_count > list->tid_count) {
-        free(list->off);
-        list->off = malloc((new_count +1) * sizeof(int));
-        if (!list->off) {
-            laik_panic("Out of memory allocating space for Laik_RangeList");
-            exit(1); // not actually needed, laik_panic never returns
-        }
-    }
+    // offset array gets reallocated for new task ids
     list->tid_count = new_count;
     sortRanges(list);
     updateOffsets(list);
+
+    // range offsets changed
+    freeIndex(list);
+}
+
+
+//-------------------------------------------------------------
+// spatial index for intersection queries
+//
+// A bounding volume hierarchy over the ranges of a frozen list, built
+// by recursively splitting the ranges at the median of their centers in
+// the dimension with largest spread. Each node stores the bounding box
+// of its ranges, so queries only descend into subtrees which may contain
+// intersecting ranges: O(log n + hits) for typical grid-like partitionings
+// instead of checking all n ranges.
+
+// maximal number of ranges in a leaf node
+#define INDEX_LEAFSIZE 4
+
+typedef struct _IndexNode {
+    int64_t from[3], to[3]; // bounding box
+    unsigned int first, count; // ranges in <idx> if leaf (count > 0)
+    int left, right; // child nodes if inner node
+} IndexNode;
+
+struct _Laik_RangeIndex {
+    unsigned int* idx; // offsets of ranges, ordered by leaf
+    IndexNode* node;
+    int nodeCount;
+};
+
+static void freeIndex(Laik_RangeList* list)
+{
+    if (!list->index) return;
+    free(list->index->idx);
+    free(list->index->node);
+    free(list->index);
+    list->index = 0;
+}
+
+// doubled center of range with offset <o> in dimension <d>
+static int64_t center2(Laik_RangeList* list, unsigned int o, int d)
+{
+    Laik_Range* r = &(list->trange[o].range);
+    return r->from.i[d] + r->to.i[d];
+}
+
+// partially sort idx[lo;hi[ such that idx[k] has the median center in <d>
+static void selectMedian(Laik_RangeList* list, unsigned int* idx,
+                         long lo, long hi, long k, int d)
+{
+    while(hi - lo > 1) {
+        int64_t pivot = center2(list, idx[lo + (hi - lo) / 2], d);
+        long i = lo, j = hi - 1;
+        while(i <= j) {
+            while(center2(list, idx[i], d) < pivot) i++;
+            while(center2(list, idx[j], d) > pivot) j--;
+            if (i <= j) {
+                unsigned int tmp = idx[i]; idx[i] = idx[j]; idx[j] = tmp;
+                i++;
+                j--;
+            }
+        }
+        if (k <= j) hi = j + 1;
+        else if (k >= i) lo = i;
+        else return;
+    }
+}
+
+static int buildNode(Laik_RangeList* list, Laik_RangeIndex* ri,
+                     unsigned int lo, unsigned int hi)
+{
+    int dims = list->space->dims;
+    int n = ri->nodeCount++;
+    IndexNode* node = &(ri->node[n]);
+
+    // bounding box and spread of centers
+    int64_t cmin[3], cmax[3];
+    for(int d = 0; d < dims; d++) {
+        Laik_Range* r = &(list->trange[ri->idx[lo]].range);
+        node->from[d] = r->from.i[d];
+        node->to[d] = r->to.i[d];
+        cmin[d] = cmax[d] = center2(list, ri->idx[lo], d);
+    }
+    for(unsigned int i = lo + 1; i < hi; i++) {
+        Laik_Range* r = &(list->trange[ri->idx[i]].range);
+        for(int d = 0; d < dims; d++) {
+            if (r->from.i[d] < node->from[d]) node->from[d] = r->from.i[d];
+            if (r->to.i[d] > node->to[d]) node->to[d] = r->to.i[d];
+            int64_t c = center2(list, ri->idx[i], d);
+            if (c < cmin[d]) cmin[d] = c;
+            if (c > cmax[d]) cmax[d] = c;
+        }
+    }
+
+    if (hi - lo <= INDEX_LEAFSIZE) {
+        node->first = lo;
+        node->count = hi - lo;
+        node->left = node->right = -1;
+        return n;
+    }
+
+    int splitDim = 0;
+    for(int d = 1; d < dims; d++)
+        if (cmax[d] - cmin[d] > cmax[splitDim] - cmin[splitDim])
+            splitDim = d;
+
+    unsigned int mid = lo + (hi - lo) / 2;
+    selectMedian(list, ri->idx, lo, hi, mid, splitDim);
+
+    node->first = lo;
+    node->count = 0; // inner node
+    // <node> may be invalidated by recursion: use index
+    int left = buildNode(list, ri, lo, mid);
+    int right = buildNode(list, ri, mid, hi);
+    ri->node[n].left = left;
+    ri->node[n].right = right;
+    return n;
+}
+
+// serializes lazy index creation if lists are queried concurrently
+static pthread_mutex_t indexLock = PTHREAD_MUTEX_INITIALIZER;
+
+static Laik_RangeIndex* buildIndex(Laik_RangeList* list)
+{
+    assert(list->off != 0); // must be frozen
+
+    pthread_mutex_lock(&indexLock);
+    if (list->index) {
+        // built by another thread in the meantime
+        pthread_mutex_unlock(&indexLock);
+        return list->index;
+    }
+
+    Laik_RangeIndex* ri = malloc(sizeof(Laik_RangeIndex));
+    unsigned int n = list->count;
+    if (ri) {
+        ri->idx = malloc((n > 0 ? n : 1) * sizeof(unsigned int));
+        // a binary tree with leaves of at least 1 range has < 2n nodes
+        ri->node = malloc((n > 0 ? 2 * n : 1) * sizeof(IndexNode));
+    }
+    if (!ri || !ri->idx || !ri->node) {
+        laik_panic("Out of memory allocating range index");
+        exit(1); // not actually needed, laik_panic never returns
+    }
+    for(unsigned int i = 0; i < n; i++)
+        ri->idx[i] = i;
+    ri->nodeCount = 0;
+    if (n > 0)
+        buildNode(list, ri, 0, n);
+
+    __atomic_store_n(&(list->index), ri, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&indexLock);
+    return ri;
+}
+
+void laik_rangelist_query(Laik_RangeList* list, const Laik_Range* range,
+                          laik_rangelist_hit_t f, void* ctx)
+{
+    if (list->count == 0) return;
+    Laik_RangeIndex* ri = __atomic_load_n(&(list->index), __ATOMIC_ACQUIRE);
+    if (!ri) ri = buildIndex(list);
+    int dims = list->space->dims;
+
+    // depth of tree is logarithmic in number of ranges
+    int stack[128];
+    int sp = 0;
+    stack[sp++] = 0;
+    while(sp > 0) {
+        IndexNode* node = &(ri->node[stack[--sp]]);
+
+        // same check as in laik_range_intersect: prune only if no range
+        // in this subtree can give a non-zero intersection
+        bool disjoint = false;
+        for(int d = 0; d < dims; d++) {
+            if ((node->from[d] >= range->to.i[d]) ||
+                (range->from.i[d] >= node->to[d])) {
+                disjoint = true;
+                break;
+            }
+        }
+        if (disjoint) continue;
+
+        if (node->count > 0) {
+            for(unsigned int i = 0; i < node->count; i++)
+                (f)(ctx, ri->idx[node->first + i]);
+            continue;
+        }
+        assert(sp + 2 <= 128);
+        stack[sp++] = node->right;
+        stack[sp++] = node->left;
+    }
+}
+
+// bytes allocated for frozen <list>, without range index built on demand
+uint64_t laik_rangelist_memory(Laik_RangeList* list)
+{
+    uint64_t bytes = sizeof(Laik_RangeList);
+    bytes += (uint64_t) list->capacity * sizeof(Laik_TaskRange_Gen);
+    if (list->off)
+        bytes += (uint64_t) (list->off_count + 1) * sizeof(unsigned int);
+    if (list->map_off)
+        bytes += (uint64_t) (list->map_count + 1) * sizeof(unsigned int);
+    return bytes;
 }
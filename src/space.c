@@ -174,34 +174,43 @@ bool intersectRange(int64_t from1, int64_t to1, int64_t from2, int64_t to2,
 }
 
 // get the intersection of two ranges; return 0 if intersection is empty
+// (not reentrant: returned range is overwritten by next call)
 Laik_Range* laik_range_intersect(const Laik_Range* r1, const Laik_Range* r2)
 {
     static Laik_Range r;
 
+    if (!laik_range_intersection(r1, r2, &r)) return 0;
+    return &r;
+}
+
+// store intersection of two ranges into <r>; return false if empty
+bool laik_range_intersection(const Laik_Range* r1, const Laik_Range* r2,
+                             Laik_Range* r)
+{
     // intersection with invalid range gives invalid range
     if ((r1->space == 0) || (r2->space == 0)) {
-        r.space = 0;
-        return &r;
+        r->space = 0;
+        return true;
     }
 
     assert(r1->space == r2->space);
     int dims = r1->space->dims;
-    r.space = r1->space;
+    r->space = r1->space;
 
     if (!intersectRange(r1->from.i[0], r1->to.i[0],
                         r2->from.i[0], r2->to.i[0],
-                        &(r.from.i[0]), &(r.to.i[0])) ) return 0;
+                        &(r->from.i[0]), &(r->to.i[0])) ) return false;
     if (dims>1) {
         if (!intersectRange(r1->from.i[1], r1->to.i[1],
                             r2->from.i[1], r2->to.i[1],
-                            &(r.from.i[1]), &(r.to.i[1])) ) return 0;
+                            &(r->from.i[1]), &(r->to.i[1])) ) return false;
         if (dims>2) {
             if (!intersectRange(r1->from.i[2], r1->to.i[2],
                                 r2->from.i[2], r2->to.i[2],
-                                &(r.from.i[2]), &(r.to.i[2])) ) return 0;
+                                &(r->from.i[2]), &(r->to.i[2])) ) return false;
         }
     }
-    return &r;
+    return true;
 }
 
 // expand range <dst> such that it contains <src>
@@ -593,8 +602,8 @@ const Laik_Range* laik_taskrange_get_range(Laik_TaskRange* trange)
 
     if (trange->list->tss1d) {
         static Laik_Range range;
-        int64_t idx = trange->list->tss1d[trange->no].idx;
-        laik_range_init_1d(&range, trange->list->space, idx, idx + 1);
+        Laik_TaskRange_Single1d* ts = &(trange->list->tss1d[trange->no]);
+        laik_range_init_1d(&range, trange->list->space, ts->idx, ts->idx + ts->len);
         return &range;
     }
     return 0;
@@ -682,134 +691,215 @@ bool laik_index_global2local(Laik_Partitioning* p,
 // helper functions for laik_calc_transition
 
 // TODO:
-// - quadratic complexity for 2d/3d spaces
 // - for 1d, does not cope with overlapping ranges belonging to same task
 
 // print verbose debug output for creating ranges for reductions?
 #define DEBUG_REDUCTIONRANGES 1
 
 
-static TaskGroup* groupList = 0;
-static int groupListSize = 0, groupListCount = 0;
+// only for 1d
+typedef struct _RangeBorder {
+    int64_t b;
+    int task;
+    int rangeNo, mapNo;
+    unsigned int isStart :1;
+    unsigned int isInput :1;
+} RangeBorder;
+
+// candidate range pairs for intersection found via range index:
+// own range <o1> (in own list) and range <o2> of <task> (in other list)
+typedef struct _RangePair {
+    int task;
+    unsigned int o1, o2;
+} RangePair;
+
+// block of arena memory; blocks are chained, newest first
+typedef struct _ArenaBlock ArenaBlock;
+struct _ArenaBlock {
+    ArenaBlock* next;
+    size_t size, used;
+    size_t last; // offset of last allocation, may be grown in-place
+    char data[];
+};
+
+#define ARENA_MINBLOCK (64 * 1024)
+
+// Context of one transition calculation.
+// All temporary data lives in this context, allocated from an arena which
+// is released in one go at the end. Thus, transitions can be calculated
+// concurrently, e.g. for multiple containers in different threads
+typedef struct _TransBuilder {
+    ArenaBlock* arena;
+
+    // task groups used in reductions, with hash table for lookup
+    TaskGroup* group;
+    int groupSize, groupCount;
+    int* groupHash; // index into <group>, -1 if empty
+    int groupHashSize;
+
+    RangeBorder* border;
+    int borderSize, borderCount;
+
+    RangePair* pair;
+    int pairSize, pairCount;
+
+    struct localTOp *local;
+    struct initTOp  *init;
+    struct sendTOp  *send;
+    struct recvTOp  *recv;
+    struct redTOp   *red;
+    int localSize, localCount;
+    int initSize, initCount;
+    int sendSize, sendCount;
+    int recvSize, recvCount;
+    int redSize, redCount;
+} TransBuilder;
 
 static
-void cleanGroupList()
+void initTransBuilder(TransBuilder* tb)
 {
-    for(int i = 0; i < groupListCount; i++)
-        free(groupList[i].task);
-    groupListCount = 0;
-
-    // we keep the groupList array
+    memset(tb, 0, sizeof(TransBuilder));
 }
 
 static
-TaskGroup* newTaskGroup(int* group)
+void freeTransBuilder(TransBuilder* tb)
 {
-    if (groupListCount == groupListSize) {
-        // enlarge group list
-        groupListSize = (groupListSize + 10) * 2;
-        groupList = realloc(groupList, groupListSize * sizeof(TaskGroup));
-        if (!groupList) {
+    ArenaBlock* b = tb->arena;
+    while(b) {
+        ArenaBlock* next = b->next;
+        free(b);
+        b = next;
+    }
+    initTransBuilder(tb);
+}
+
+// allocate <size> bytes from arena of <tb>
+static
+void* arenaAlloc(TransBuilder* tb, size_t size)
+{
+    size = (size + 15) & ~((size_t) 15);
+    ArenaBlock* b = tb->arena;
+    if (!b || (b->used + size > b->size)) {
+        size_t bsize = b ? 2 * b->size : ARENA_MINBLOCK;
+        if (bsize < size) bsize = size;
+        ArenaBlock* nb = malloc(sizeof(ArenaBlock) + bsize);
+        if (!nb) {
             laik_panic("Out of memory allocating memory for Laik_Transition");
             exit(1); // not actually needed, laik_panic never returns
         }
+        nb->next = b;
+        nb->size = bsize;
+        nb->used = 0;
+        nb->last = 0;
+        tb->arena = b = nb;
     }
-    TaskGroup* g = &(groupList[groupListCount]);
-    if (group) *group = groupListCount;
-    groupListCount++;
-
-    g->count = 0; // invalid
-    g->task = 0;
-
-    return g;
+    void* p = b->data + b->used;
+    b->last = b->used;
+    b->used += size;
+    return p;
 }
 
-static int getTaskGroupSingle(int task)
+// enlarge array <buf> with <*size> elements of <esize> bytes allocated
+// from arena of <tb>; grows in-place if <buf> was the last allocation
+static
+void* arenaGrow(TransBuilder* tb, void* buf, int* size, size_t esize)
 {
-    // already existing?
-    for(int i = 0; i < groupListCount; i++)
-        if ((groupList[i].count == 1) && (groupList[i].task[0] == task))
-            return i;
+    size_t oldBytes = (size_t) *size * esize;
+    *size = (*size + 20) * 2;
+    size_t newBytes = ((size_t) *size * esize + 15) & ~((size_t) 15);
 
-    int group;
-    TaskGroup* g = newTaskGroup(&group);
+    ArenaBlock* b = tb->arena;
+    if (buf && b && (buf == b->data + b->last) &&
+        (b->last + newBytes <= b->size)) {
+        b->used = b->last + newBytes;
+        return buf;
+    }
+    void* p = arenaAlloc(tb, newBytes);
+    if (buf) memcpy(p, buf, oldBytes);
+    return p;
+}
 
-    g->count = 1;
-    g->task = malloc(sizeof(int));
-    assert(g->task);
-    g->task[0] = task;
+static
+unsigned int hashTaskGroup(TaskGroup* tg)
+{
+    // FNV-1a over task IDs
+    unsigned int h = 2166136261u;
+    for(int i = 0; i < tg->count; i++) {
+        h ^= (unsigned int) tg->task[i];
+        h *= 16777619u;
+    }
+    return h;
+}
 
-    return group;
+// insert group with index <g> into hash table, which must have space
+static
+void insertGroupHash(TransBuilder* tb, int g)
+{
+    unsigned int mask = tb->groupHashSize - 1;
+    unsigned int h = hashTaskGroup(&(tb->group[g])) & mask;
+    while(tb->groupHash[h] >= 0)
+        h = (h + 1) & mask;
+    tb->groupHash[h] = g;
 }
 
-// append given task group if not already in groupList, return index
-static int getTaskGroup(TaskGroup* tg)
+// append given task group if not already existing, return index
+static int getTaskGroup(TransBuilder* tb, TaskGroup* tg)
 {
     // already existing?
-    int i, j;
-    for(i = 0; i < groupListCount; i++) {
-        if (tg->count != groupList[i].count) continue;
-        for(j = 0; j < tg->count; j++)
-            if (tg->task[j] != groupList[i].task[j]) break;
-        if (j == tg->count)
-            return i; // found
+    if (tb->groupHashSize > 0) {
+        unsigned int mask = tb->groupHashSize - 1;
+        unsigned int h = hashTaskGroup(tg) & mask;
+        while(tb->groupHash[h] >= 0) {
+            TaskGroup* g = &(tb->group[tb->groupHash[h]]);
+            if ((g->count == tg->count) &&
+                (memcmp(g->task, tg->task, tg->count * sizeof(int)) == 0))
+                return tb->groupHash[h]; // found
+            h = (h + 1) & mask;
+        }
     }
 
-    int group;
-    TaskGroup* g = newTaskGroup(&group);
+    if (tb->groupCount == tb->groupSize)
+        tb->group = arenaGrow(tb, tb->group, &(tb->groupSize), sizeof(TaskGroup));
+    int group = tb->groupCount;
+    tb->groupCount++;
 
+    TaskGroup* g = &(tb->group[group]);
     g->count = tg->count;
-    int tsize = tg->count * sizeof(int);
-    g->task = malloc(tsize);
-    assert(g->task);
-    memcpy(g->task, tg->task, tsize);
+    g->task = arenaAlloc(tb, tg->count * sizeof(int));
+    memcpy(g->task, tg->task, tg->count * sizeof(int));
+
+    // keep hash table at most half full
+    if (2 * tb->groupCount > tb->groupHashSize) {
+        int hsize = tb->groupHashSize ? 2 * tb->groupHashSize : 64;
+        tb->groupHash = arenaAlloc(tb, hsize * sizeof(int));
+        tb->groupHashSize = hsize;
+        for(int i = 0; i < hsize; i++)
+            tb->groupHash[i] = -1;
+        for(int i = 0; i < tb->groupCount; i++)
+            insertGroupHash(tb, i);
+    }
+    else
+        insertGroupHash(tb, group);
 
     return group;
 }
 
-
-// only for 1d
-typedef struct _RangeBorder {
-    int64_t b;
-    int task;
-    int rangeNo, mapNo;
-    unsigned int isStart :1;
-    unsigned int isInput :1;
-} RangeBorder;
-
-static RangeBorder* borderList = 0;
-int borderListSize = 0, borderListCount = 0;
-
-static
-void cleanBorderList()
-{
-    borderListCount = 0;
-}
-
-static
-void freeBorderList()
+static int getTaskGroupSingle(TransBuilder* tb, int task)
 {
-    free(borderList);
-    borderList = 0;
-    borderListCount = 0;
-    borderListSize = 0;
+    TaskGroup tg;
+    tg.count = 1;
+    tg.task = &task;
+    return getTaskGroup(tb, &tg);
 }
 
 static
-void appendBorder(int64_t b, int task, int rangeNo, int mapNo,
+void appendBorder(TransBuilder* tb, int64_t b, int task, int rangeNo, int mapNo,
                   bool isStart, bool isInput)
 {
-    if (borderListCount == borderListSize) {
-        // enlarge list
-        borderListSize = (borderListSize + 10) * 2;
-        borderList = realloc(borderList, borderListSize * sizeof(RangeBorder));
-        if (!borderList) {
-            laik_panic("Out of memory allocating memory for Laik_Transition");
-            exit(1); // not actually needed, laik_panic never returns
-        }
-    }
-    RangeBorder *sb = &(borderList[borderListCount]);
-    borderListCount++;
+    if (tb->borderCount == tb->borderSize)
+        tb->border = arenaGrow(tb, tb->border, &(tb->borderSize), sizeof(RangeBorder));
+    RangeBorder *sb = &(tb->border[tb->borderCount]);
+    tb->borderCount++;
 
     sb->b = b;
     sb->task = task;
@@ -882,52 +972,72 @@ static bool isInTaskGroup(TaskGroup* g, int task)
     return false;
 }
 
+typedef struct _PairQuery {
+    TransBuilder* tb;
+    Laik_RangeList* list; // list queried
+    unsigned int o1;      // own range used for query
+    int myid;             // ranges of own task are skipped
+} PairQuery;
 
-// temporary buffers used when calculating a transition
-static struct localTOp *localBuf = 0;
-static struct initTOp  *initBuf = 0;
-static struct sendTOp  *sendBuf = 0;
-static struct recvTOp  *recvBuf = 0;
-static struct redTOp   *redBuf = 0;
-static int localBufSize = 0, localBufCount = 0;
-static int initBufSize = 0, initBufCount = 0;
-static int sendBufSize = 0, sendBufCount = 0;
-static int recvBufSize = 0, recvBufCount = 0;
-static int redBufSize = 0, redBufCount = 0;
+static
+void appendPair(void* ctx, unsigned int o2)
+{
+    PairQuery* q = (PairQuery*) ctx;
+    TransBuilder* tb = q->tb;
+    int task = q->list->trange[o2].task;
+    if (task == q->myid) return;
+
+    if (tb->pairCount == tb->pairSize)
+        tb->pair = arenaGrow(tb, tb->pair, &(tb->pairSize), sizeof(RangePair));
+    RangePair* p = &(tb->pair[tb->pairCount]);
+    tb->pairCount++;
+
+    p->task = task;
+    p->o1 = q->o1;
+    p->o2 = o2;
+}
 
+// add pairs of own range <o1> with ranges of other tasks in <list>
+// which may intersect <range>
 static
-void cleanTOpBufs(bool doFree)
-{
-    localBufCount = 0;
-    initBufCount = 0;
-    sendBufCount = 0;
-    recvBufCount = 0;
-    redBufCount = 0;
-    if (doFree) {
-        free(localBuf); localBufSize = 0;
-        free(initBuf); initBufSize = 0;
-        free(sendBuf); sendBufSize = 0;
-        free(recvBuf); recvBufSize = 0;
-        free(redBuf); redBufSize = 0;
-    }
+void collectPairs(TransBuilder* tb, Laik_RangeList* list,
+                  const Laik_Range* range, unsigned int o1, int myid)
+{
+    PairQuery q;
+    q.tb = tb;
+    q.list = list;
+    q.o1 = o1;
+    q.myid = myid;
+    laik_rangelist_query(list, range, appendPair, &q);
 }
 
+// order by task, own range, other range: same order as nested loops
+static int pair_cmp(const void *p1, const void *p2)
+{
+    const RangePair* rp1 = (const RangePair*) p1;
+    const RangePair* rp2 = (const RangePair*) p2;
+    if (rp1->task != rp2->task) return rp1->task - rp2->task;
+    if (rp1->o1 != rp2->o1) return (rp1->o1 < rp2->o1) ? -1 : 1;
+    if (rp1->o2 != rp2->o2) return (rp1->o2 < rp2->o2) ? -1 : 1;
+    return 0;
+}
+
+static
+void sortPairList(TransBuilder* tb)
+{
+    qsort(tb->pair, tb->pairCount, sizeof(RangePair), pair_cmp);
+}
+
+
 static
-struct localTOp* appendLocalTOp(Laik_Range* range,
+struct localTOp* appendLocalTOp(TransBuilder* tb, Laik_Range* range,
                                 int fromRangeNo, int toRangeNo,
                                 int fromMapNo, int toMapNo)
 {
-    if (localBufCount == localBufSize) {
-        // enlarge temp buffer
-        localBufSize = (localBufSize + 20) * 2;
-        localBuf = realloc(localBuf, localBufSize * sizeof(struct localTOp));
-        if (!localBuf) {
-            laik_panic("Out of memory allocating memory for Laik_Transition");
-            exit(1); // not actually needed, laik_panic never returns
-        }
-    }
-    struct localTOp* op = &(localBuf[localBufCount]);
-    localBufCount++;
+    if (tb->localCount == tb->localSize)
+        tb->local = arenaGrow(tb, tb->local, &(tb->localSize), sizeof(struct localTOp));
+    struct localTOp* op = &(tb->local[tb->localCount]);
+    tb->localCount++;
 
     op->range = *range;
     op->fromRangeNo = fromRangeNo;
@@ -939,21 +1049,14 @@ struct localTOp* appendLocalTOp(Laik_Range* range,
 }
 
 static
-struct initTOp* appendInitTOp(Laik_Range* range,
+struct initTOp* appendInitTOp(TransBuilder* tb, Laik_Range* range,
                               int rangeNo, int mapNo,
                               Laik_ReductionOperation redOp)
 {
-    if (initBufCount == initBufSize) {
-        // enlarge temp buffer
-        initBufSize = (initBufSize + 20) * 2;
-        initBuf = realloc(initBuf, initBufSize * sizeof(struct initTOp));
-        if (!initBuf) {
-            laik_panic("Out of memory allocating memory for Laik_Transition");
-            exit(1); // not actually needed, laik_panic never returns
-        }
-    }
-    struct initTOp* op = &(initBuf[initBufCount]);
-    initBufCount++;
+    if (tb->initCount == tb->initSize)
+        tb->init = arenaGrow(tb, tb->init, &(tb->initSize), sizeof(struct initTOp));
+    struct initTOp* op = &(tb->init[tb->initCount]);
+    tb->initCount++;
 
     op->range = *range;
     op->rangeNo = rangeNo;
@@ -964,20 +1067,13 @@ struct initTOp* appendInitTOp(Laik_Range* range,
 }
 
 static
-struct sendTOp* appendSendTOp(Laik_Range* range,
+struct sendTOp* appendSendTOp(TransBuilder* tb, Laik_Range* range,
                               int rangeNo, int mapNo, int toTask)
 {
-    if (sendBufCount == sendBufSize) {
-        // enlarge temp buffer
-        sendBufSize = (sendBufSize + 20) * 2;
-        sendBuf = realloc(sendBuf, sendBufSize * sizeof(struct sendTOp));
-        if (!sendBuf) {
-            laik_panic("Out of memory allocating memory for Laik_Transition");
-            exit(1); // not actually needed, laik_panic never returns
-        }
-    }
-    struct sendTOp* op = &(sendBuf[sendBufCount]);
-    sendBufCount++;
+    if (tb->sendCount == tb->sendSize)
+        tb->send = arenaGrow(tb, tb->send, &(tb->sendSize), sizeof(struct sendTOp));
+    struct sendTOp* op = &(tb->send[tb->sendCount]);
+    tb->sendCount++;
 
     op->range = *range;
     op->rangeNo = rangeNo;
@@ -988,20 +1084,13 @@ struct sendTOp* appendSendTOp(Laik_Range* range,
 }
 
 static
-struct recvTOp* appendRecvTOp(Laik_Range* range,
+struct recvTOp* appendRecvTOp(TransBuilder* tb, Laik_Range* range,
                               int rangeNo, int mapNo, int fromTask)
 {
-    if (recvBufCount == recvBufSize) {
-        // enlarge temp buffer
-        recvBufSize = (recvBufSize + 20) * 2;
-        recvBuf = realloc(recvBuf, recvBufSize * sizeof(struct recvTOp));
-        if (!recvBuf) {
-            laik_panic("Out of memory allocating memory for Laik_Transition");
-            exit(1); // not actually needed, laik_panic never returns
-        }
-    }
-    struct recvTOp* op = &(recvBuf[recvBufCount]);
-    recvBufCount++;
+    if (tb->recvCount == tb->recvSize)
+        tb->recv = arenaGrow(tb, tb->recv, &(tb->recvSize), sizeof(struct recvTOp));
+    struct recvTOp* op = &(tb->recv[tb->recvCount]);
+    tb->recvCount++;
 
     op->range = *range;
     op->rangeNo = rangeNo;
@@ -1012,23 +1101,16 @@ struct recvTOp* appendRecvTOp(Laik_Range* range,
 }
 
 static
-struct redTOp* appendRedTOp(Laik_Range* range,
+struct redTOp* appendRedTOp(TransBuilder* tb, Laik_Range* range,
                             Laik_ReductionOperation redOp,
                             int inputGroup, int outputGroup,
                             int myInputRangeNo, int myOutputRangeNo,
                             int myInputMapNo, int myOutputMapNo)
 {
-    if (redBufCount == redBufSize) {
-        // enlarge temp buffer
-        redBufSize = (redBufSize + 20) * 2;
-        redBuf = realloc(redBuf, redBufSize * sizeof(struct redTOp));
-        if (!redBuf) {
-            laik_panic("Out of memory allocating memory for Laik_Transition");
-            exit(1); // not actually needed, laik_panic never returns
-        }
-    }
-    struct redTOp* op = &(redBuf[redBufCount]);
-    redBufCount++;
+    if (tb->redCount == tb->redSize)
+        tb->red = arenaGrow(tb, tb->red, &(tb->redSize), sizeof(struct redTOp));
+    struct redTOp* op = &(tb->red[tb->redCount]);
+    tb->redCount++;
 
     op->range = *range;
     op->redOp = redOp;
@@ -1058,7 +1140,7 @@ bool oneInputIsCopy(Laik_ReductionOperation redOp)
 // TODO: we only support one mapping in each task for reductions
 //       better: support multiple mappings for same index in same task
 static
-void calcAddReductions(int tflags,
+void calcAddReductions(TransBuilder* tb, int tflags,
                        Laik_Group* group,
                        Laik_ReductionOperation redOp,
                        Laik_Partitioning* fromP, Laik_Partitioning* toP)
@@ -1085,7 +1167,7 @@ void calcAddReductions(int tflags,
     }
 
     // add range borders of all tasks
-    cleanBorderList();
+    tb->borderCount = 0;
     int rangeNo, lastTask, lastMapNo;
     rangeNo = 0;
     lastTask = -1;
@@ -1098,8 +1180,8 @@ void calcAddReductions(int tflags,
             lastTask = ts->task;
             lastMapNo = ts->mapNo;
         }
-        appendBorder(ts->range.from.i[0], ts->task, rangeNo, ts->mapNo, true, true);
-        appendBorder(ts->range.to.i[0], ts->task, rangeNo, ts->mapNo, false, true);
+        appendBorder(tb, ts->range.from.i[0], ts->task, rangeNo, ts->mapNo, true, true);
+        appendBorder(tb, ts->range.to.i[0], ts->task, rangeNo, ts->mapNo, false, true);
         rangeNo++;
     }
     lastTask = -1;
@@ -1112,23 +1194,22 @@ void calcAddReductions(int tflags,
             lastTask = tr->task;
             lastMapNo = tr->mapNo;
         }
-        appendBorder(tr->range.from.i[0], tr->task, rangeNo, tr->mapNo, true, false);
-        appendBorder(tr->range.to.i[0], tr->task, rangeNo, tr->mapNo, false, false);
+        appendBorder(tb, tr->range.from.i[0], tr->task, rangeNo, tr->mapNo, true, false);
+        appendBorder(tb, tr->range.to.i[0], tr->task, rangeNo, tr->mapNo, false, false);
         rangeNo++;
     }
 
-    if (borderListCount == 0) return;
+    if (tb->borderCount == 0) return;
 
     // order by border to travers in border order
-    qsort(borderList, borderListCount, sizeof(RangeBorder), rb_cmp);
+    qsort(tb->border, tb->borderCount, sizeof(RangeBorder), rb_cmp);
 
-#define MAX_TASKS 65536
-    int inputTask[MAX_TASKS], outputTask[MAX_TASKS];
+    int maxTasks = group->size;
     TaskGroup inputGroup, outputGroup;
     inputGroup.count = 0;
-    inputGroup.task = inputTask;
+    inputGroup.task = arenaAlloc(tb, maxTasks * sizeof(int));
     outputGroup.count = 0;
-    outputGroup.task = outputTask;
+    outputGroup.task = arenaAlloc(tb, maxTasks * sizeof(int));
 
     // travers borders and if this task has reduction input or wants output,
     // append reduction action to transaction
@@ -1142,8 +1223,8 @@ void calcAddReductions(int tflags,
     // all ranges are from same space
     range.space = fromP->space;
 
-    for(int i = 0; i < borderListCount; i++) {
-        RangeBorder* sb = &(borderList[i]);
+    for(int i = 0; i < tb->borderCount; i++) {
+        RangeBorder* sb = &(tb->border[i]);
 
 #ifdef DEBUG_REDUCTIONRANGES
         laik_log(1, "at border %lld, task %d (range %d, map %d): %s for %s",
@@ -1156,7 +1237,7 @@ void calcAddReductions(int tflags,
         bool isOk = true;
         if (sb->isInput) {
             if (sb->isStart) {
-                isOk = addTask(&inputGroup, sb->task, MAX_TASKS);
+                isOk = addTask(&inputGroup, sb->task, maxTasks);
                 if (sb->task == myid) {
                     myActivity |= 1;
                     myInputRangeNo = sb->rangeNo;
@@ -1170,7 +1251,7 @@ void calcAddReductions(int tflags,
         }
         else {
             if (sb->isStart) {
-                isOk = addTask(&outputGroup, sb->task, MAX_TASKS);
+                isOk = addTask(&outputGroup, sb->task, maxTasks);
                 if (sb->task == myid) {
                     myActivity |= 2;
                     myOutputRangeNo = sb->rangeNo;
@@ -1184,9 +1265,9 @@ void calcAddReductions(int tflags,
         }
         assert(isOk);
 
-        if ((i < borderListCount - 1) && (borderList[i + 1].b > sb->b)) {
+        if ((i < tb->borderCount - 1) && (tb->border[i + 1].b > sb->b)) {
             // about to leave a range with given input/output tasks
-            int64_t nextBorder = borderList[i + 1].b;
+            int64_t nextBorder = tb->border[i + 1].b;
 
 #ifdef DEBUG_REDUCTIONRANGES
             char* act[] = {"(none)", "input", "output", "in & out"};
@@ -1214,7 +1295,7 @@ void calcAddReductions(int tflags,
                             (outputGroup.task[0] == myid)) {
 
                             // local (copy) operation
-                            appendLocalTOp(&range,
+                            appendLocalTOp(tb, &range,
                                            myInputRangeNo, myOutputRangeNo,
                                            myInputMapNo, myOutputMapNo);
 #ifdef DEBUG_REDUCTIONRANGES
@@ -1233,7 +1314,7 @@ void calcAddReductions(int tflags,
                             for(int out = 0; out < outputGroup.count; out++) {
                                 if (outputGroup.task[out] == myid) {
                                     // local (copy) operation
-                                    appendLocalTOp(&range,
+                                    appendLocalTOp(tb, &range,
                                                    myInputRangeNo, myOutputRangeNo,
                                                    myInputMapNo, myOutputMapNo);
 #ifdef DEBUG_REDUCTIONRANGES
@@ -1248,7 +1329,7 @@ void calcAddReductions(int tflags,
                                 }
 
                                 // send operation
-                                appendSendTOp(&range,
+                                appendSendTOp(tb, &range,
                                               myInputRangeNo, myInputMapNo,
                                               outputGroup.task[out]);
 #ifdef DEBUG_REDUCTIONRANGES
@@ -1270,7 +1351,7 @@ void calcAddReductions(int tflags,
                                 if (outputGroup.task[out] != myid) continue;
 
                                 // receive operation
-                                appendRecvTOp(&range,
+                                appendRecvTOp(tb, &range,
                                               myOutputRangeNo, myOutputMapNo,
                                               inputGroup.task[0]);
 
@@ -1291,21 +1372,21 @@ void calcAddReductions(int tflags,
                 } // one input
 
                 // add reduction operation
-                int in = getTaskGroup(&inputGroup);
-                int out = getTaskGroup(&outputGroup);
+                int in = getTaskGroup(tb, &inputGroup);
+                int out = getTaskGroup(tb, &outputGroup);
 
 #ifdef DEBUG_REDUCTIONRANGES
                 laik_log_begin(1);
                 laik_log_append("  adding reduction (%lu - %lu), in %d:(",
                                 range.from.i[0], range.to.i[0], in);
-                for(int i = 0; i < groupList[in].count; i++) {
+                for(int i = 0; i < tb->group[in].count; i++) {
                     if (i > 0) laik_log_append(",");
-                    laik_log_append("T%d", groupList[in].task[i]);
+                    laik_log_append("T%d", tb->group[in].task[i]);
                 }
                 laik_log_append("), out %d:(", out);
-                for(int i = 0; i < groupList[out].count; i++) {
+                for(int i = 0; i < tb->group[out].count; i++) {
                     if (i > 0) laik_log_append(",");
-                    laik_log_append("T%d", groupList[out].task[i]);
+                    laik_log_append("T%d", tb->group[out].task[i]);
                 }
                 laik_log_flush("), in %d/%d out %d/%d (range/map)",
                                myInputRangeNo, myInputMapNo,
@@ -1313,11 +1394,11 @@ void calcAddReductions(int tflags,
 #endif
 
                 // convert to all-group if possible
-                if (groupList[in].count == group->size) in = -1;
-                if (groupList[out].count == group->size) out = -1;
+                if (tb->group[in].count == group->size) in = -1;
+                if (tb->group[out].count == group->size) out = -1;
 
                 assert(redOp != LAIK_RO_None); // must be a real reduction
-                appendRedTOp(&range, redOp, in, out,
+                appendRedTOp(tb, &range, redOp, in, out,
                              myInputRangeNo, myOutputRangeNo,
                              myInputMapNo, myOutputMapNo);
             }
@@ -1326,25 +1407,24 @@ void calcAddReductions(int tflags,
     // all tasks should be removed from input/output groups
     assert(inputGroup.count == 0);
     assert(outputGroup.count == 0);
-    freeBorderList();
 }
 
+// incremented atomically, transitions may be calculated concurrently
 static int trans_id = 0;
 
-// Calculate communication required for transitioning between partitionings
-Laik_Transition*
-do_calc_transition(Laik_Space* space,
-                   Laik_Partitioning* fromP, Laik_Partitioning* toP,
-                   Laik_DataFlow flow, Laik_ReductionOperation redOp)
+// Calculate communication required for transitioning between partitionings,
+// using temporary data of <tb>
+static Laik_Transition*
+calcTransition(TransBuilder* tb, Laik_Space* space,
+               Laik_Partitioning* fromP, Laik_Partitioning* toP,
+               Laik_DataFlow flow, Laik_ReductionOperation redOp)
 {
     Laik_Range* range;
+    Laik_Range isect; // result of intersections
 
     // flags for transition
     int tflags = 0; //LAIK_TF_KEEP_REDUCTIONS; // no_sendrev_actions
 
-    cleanTOpBufs(false);
-    cleanGroupList();
-
     // make sure requested operation is consistent
     Laik_Group* group = 0;
     if (fromP == 0) {
@@ -1392,12 +1472,14 @@ do_calc_transition(Laik_Space* space,
             exit(1); // not actually needed, laik_panic never returns
         }
 
-        for(o = toRL->off[myid]; o < toRL->off[myid+1]; o++) {
+        unsigned int myFirst = laik_rangelist_tidoff(toRL, myid);
+        unsigned int myLast = laik_rangelist_tidoff(toRL, myid + 1);
+        for(o = myFirst; o < myLast; o++) {
             if (laik_range_isEmpty(&(toRL->trange[o].range))) continue;
 
             assert(redOp != LAIK_RO_None);
-            appendInitTOp( &(toRL->trange[o].range),
-                           o - toRL->off[myid],
+            appendInitTOp(tb, &(toRL->trange[o].range),
+                           o - myFirst,
                            toRL->trange[o].mapNo,
                            redOp);
         }
@@ -1410,29 +1492,34 @@ do_calc_transition(Laik_Space* space,
 
             // just check for reduction action
             // TODO: Do this always, remove other cases
-            calcAddReductions(tflags, group, redOp, fromP, toP);
+            calcAddReductions(tb, tflags, group, redOp, fromP, toP);
         }
         else {
-            // we need intersection of own ranges in fromP/toP
-            Laik_RangeList* fromRL = laik_partitioning_allranges(fromP);
-            Laik_RangeList* toRL = laik_partitioning_allranges(toP);
+            // we need ranges intersecting own ranges in fromP/toP
+            // (all ranges if stored, see laik_partitioning_interranges)
+            Laik_RangeList* fromRL = laik_partitioning_interranges(fromP, toP);
+            Laik_RangeList* toRL = laik_partitioning_interranges(toP, fromP);
             if ((fromRL == 0) || (toRL == 0)) {
                 laik_panic("Ranges not known for transition calculation");
                 exit(1); // not actually needed, laik_panic never returns
             }
+            unsigned int fromFirst = laik_rangelist_tidoff(fromRL, myid);
+            unsigned int fromLast = laik_rangelist_tidoff(fromRL, myid + 1);
+            unsigned int toFirst = laik_rangelist_tidoff(toRL, myid);
+            unsigned int toLast = laik_rangelist_tidoff(toRL, myid + 1);
 
             // determine local ranges to keep
             // (may need local copy if from/to mappings are different).
             // reductions are not handled here, but by backend
-            for(o1 = fromRL->off[myid]; o1 < fromRL->off[myid+1]; o1++) {
-                for(o2 = toRL->off[myid]; o2 < toRL->off[myid+1]; o2++) {
-                    range = laik_range_intersect(&(fromRL->trange[o1].range),
-                                               &(toRL->trange[o2].range));
-                    if (range == 0) continue;
-
-                    appendLocalTOp(range,
-                                   o1 - fromRL->off[myid],
-                                   o2 - toRL->off[myid],
+            for(o1 = fromFirst; o1 < fromLast; o1++) {
+                for(o2 = toFirst; o2 < toLast; o2++) {
+                    if (!laik_range_intersection(&(fromRL->trange[o1].range),
+                                                 &(toRL->trange[o2].range),
+                                                 &isect)) continue;
+
+                    appendLocalTOp(tb, &isect,
+                                   o1 - fromFirst,
+                                   o2 - toFirst,
                                    fromRL->trange[o1].mapNo,
                                    toRL->trange[o2].mapNo);
                 }
@@ -1456,7 +1543,7 @@ do_calc_transition(Laik_Space* space,
                         }
                     }
                     else {
-                        outputGroup = getTaskGroupSingle(task);
+                        outputGroup = getTaskGroupSingle(tb, task);
                         if (taskCount == 1) {
                             // the process group only consists of 1 process:
                             // one output process is equivalent to all
@@ -1470,93 +1557,113 @@ do_calc_transition(Laik_Space* space,
                 if (fromAllto1OrAll) {
                     assert(outputGroup > -2);
                     // complete space, always rangeNo 0 and mapNo 0
-                    appendRedTOp( &(space->range), redOp,
+                    appendRedTOp(tb, &(space->range), redOp,
                                   -1, outputGroup, 0, 0, 0, 0);
                 }
                 else {
                     assert(dims == 1);
-                    calcAddReductions(tflags, group, redOp, fromP, toP);
+                    calcAddReductions(tb, tflags, group, redOp, fromP, toP);
                 }
             }
             else { // no reduction
 
                 // something to receive not coming from a reduction?
-                for(int task = 0; task < taskCount; task++) {
-                    if (task == myid) continue;
-                    for(o1 = toRL->off[myid]; o1 < toRL->off[myid+1]; o1++) {
-
-                        // everything we have local will not have been sent
-                        // TODO: we only check for exact match to catch All
-                        // FIXME: should print out a Warning/Error as the App
-                        //        was requesting for overwriting of values!
-                        range = &(toRL->trange[o1].range);
-                        for(o2 = fromRL->off[myid]; o2 < fromRL->off[myid+1]; o2++) {
-                            if (laik_range_isEqual(range,
-                                                   &(fromRL->trange[o2].range))) {
-                                range = 0;
-                                break;
-                            }
+                // only ranges of other tasks found via range index of fromP
+                // can intersect own ranges; pairs are sorted to get the
+                // same order as when iterating over tasks and own ranges
+                tb->pairCount = 0;
+                for(o1 = toFirst; o1 < toLast; o1++) {
+
+                    // everything we have local will not have been sent
+                    // TODO: we only check for exact match to catch All
+                    // FIXME: should print out a Warning/Error as the App
+                    //        was requesting for overwriting of values!
+                    range = &(toRL->trange[o1].range);
+                    for(o2 = fromFirst; o2 < fromLast; o2++) {
+                        if (laik_range_isEqual(range,
+                                               &(fromRL->trange[o2].range))) {
+                            range = 0;
+                            break;
                         }
-                        if (range == 0) continue;
+                    }
+                    if (range == 0) continue;
 
-                        for(o2 = fromRL->off[task]; o2 < fromRL->off[task+1]; o2++) {
+                    collectPairs(tb, fromRL, range, o1, myid);
+                }
+                sortPairList(tb);
 
-                            range = laik_range_intersect(&(fromRL->trange[o2].range),
-                                                       &(toRL->trange[o1].range));
-                            if (range == 0) continue;
+                for(int i = 0; i < tb->pairCount; i++) {
+                    RangePair* p = &(tb->pair[i]);
+                    if (!laik_range_intersection(&(fromRL->trange[p->o2].range),
+                                                 &(toRL->trange[p->o1].range),
+                                                 &isect)) continue;
 
-                            appendRecvTOp(range, o1 - toRL->off[myid],
-                                          toRL->trange[o1].mapNo, task);
-                        }
-                    }
+                    appendRecvTOp(tb, &isect, p->o1 - toFirst,
+                                  toRL->trange[p->o1].mapNo, p->task);
                 }
             }
 
             // something to send?
-            for(int task = 0; task < taskCount; task++) {
-                if (task == myid) continue;
-                for(o1 = fromRL->off[myid]; o1 < fromRL->off[myid+1]; o1++) {
+            // only ranges of other tasks found via range index of toP
+            // can intersect own ranges
+            tb->pairCount = 0;
+            for(o1 = fromFirst; o1 < fromLast; o1++)
+                collectPairs(tb, toRL, &(fromRL->trange[o1].range), o1, myid);
+            sortPairList(tb);
+
+            for(int i = 0; i < tb->pairCount; i++) {
+                RangePair* p = &(tb->pair[i]);
+                int task = p->task;
+                o1 = p->o1;
+
+                // first pair for this task and own range?
+                if ((i == 0) || (tb->pair[i-1].task != task) ||
+                    (tb->pair[i-1].o1 != o1)) {
 
                     // everything the receiver has local, no need to send
                     // TODO: we only check for exact match to catch All
                     // FIXME: should print out a Warning/Error as the App
                     //        requests overwriting of values!
                     range = &(fromRL->trange[o1].range);
-                    for(o2 = fromRL->off[task]; o2 < fromRL->off[task+1]; o2++) {
+                    unsigned int last = laik_rangelist_tidoff(fromRL, task + 1);
+                    for(o2 = laik_rangelist_tidoff(fromRL, task); o2 < last; o2++) {
                         if (laik_range_isEqual(range,
                                                &(fromRL->trange[o2].range))) {
                             range = 0;
                             break;
                         }
                     }
-                    if (range == 0) continue;
-
-                    // we may send multiple messages to same task
-                    for(o2 = toRL->off[task]; o2 < toRL->off[task+1]; o2++) {
-
-                        range = laik_range_intersect(&(fromRL->trange[o1].range),
-                                                   &(toRL->trange[o2].range));
-                        if (range == 0) continue;
-
-                        appendSendTOp(range, o1 - fromRL->off[myid],
-                                      fromRL->trange[o1].mapNo, task);
+                    if (range == 0) {
+                        // skip remaining pairs for this task and own range
+                        while((i + 1 < tb->pairCount) &&
+                              (tb->pair[i+1].task == task) &&
+                              (tb->pair[i+1].o1 == o1)) i++;
+                        continue;
                     }
                 }
+
+                // we may send multiple messages to same task
+                if (!laik_range_intersection(&(fromRL->trange[o1].range),
+                                             &(toRL->trange[p->o2].range),
+                                             &isect)) continue;
+
+                appendSendTOp(tb, &isect, o1 - fromFirst,
+                              fromRL->trange[o1].mapNo, task);
             }
         }
     }
 
     // allocate space as needed
-    int localSize = localBufCount * sizeof(struct localTOp);
-    int initSize  = initBufCount  * sizeof(struct initTOp);
-    int sendSize  = sendBufCount  * sizeof(struct sendTOp);
-    int recvSize  = recvBufCount  * sizeof(struct recvTOp);
-    int redSize   = redBufCount   * sizeof(struct redTOp);
+    int localSize = tb->localCount * sizeof(struct localTOp);
+    int initSize  = tb->initCount  * sizeof(struct initTOp);
+    int sendSize  = tb->sendCount  * sizeof(struct sendTOp);
+    int recvSize  = tb->recvCount  * sizeof(struct recvTOp);
+    int redSize   = tb->redCount   * sizeof(struct redTOp);
     // we copy group list into transition object
-    int gListSize = groupListCount * sizeof(TaskGroup);
+    int gListSize = tb->groupCount * sizeof(TaskGroup);
     int tListSize = 0;
-    for (int i = 0; i < groupListCount; i++)
-        tListSize += groupList[i].count * sizeof(int);
+    for (int i = 0; i < tb->groupCount; i++)
+        tListSize += tb->group[i].count * sizeof(int);
 
     int tsize = sizeof(Laik_Transition) + gListSize + tListSize +
                 localSize + initSize + sendSize + recvSize + redSize;
@@ -1577,7 +1684,7 @@ do_calc_transition(Laik_Space* space,
         exit(1); // not actually needed, laik_panic never returns
     }
 
-    t->id = trans_id++;
+    t->id = __atomic_fetch_add(&trans_id, 1, __ATOMIC_RELAXED);
     t->name = strdup("trans-0     ");
     sprintf(t->name, "trans-%d", t->id);
 
@@ -1590,33 +1697,33 @@ do_calc_transition(Laik_Space* space,
     t->redOp = redOp;
 
     t->dims = dims;
-    t->actionCount = localBufCount + initBufCount +
-                     sendBufCount + recvBufCount + redBufCount;
+    t->actionCount = tb->localCount + tb->initCount +
+                     tb->sendCount + tb->recvCount + tb->redCount;
     t->local = (struct localTOp*) (((char*)t) + localOff);
     t->init  = (struct initTOp*)  (((char*)t) + initOff);
     t->send  = (struct sendTOp*)  (((char*)t) + sendOff);
     t->recv  = (struct recvTOp*)  (((char*)t) + recvOff);
     t->red   = (struct redTOp*)   (((char*)t) + redOff);
     t->subgroup = (TaskGroup*)       (((char*)t) + gListOff);
-    t->localCount = localBufCount;
-    t->initCount  = initBufCount;
-    t->sendCount  = sendBufCount;
-    t->recvCount  = recvBufCount;
-    t->redCount   = redBufCount;
-    t->subgroupCount = groupListCount;
-    memcpy(t->local, localBuf, localSize);
-    memcpy(t->init, initBuf,  initSize);
-    memcpy(t->send, sendBuf,  sendSize);
-    memcpy(t->recv, recvBuf,  recvSize);
-    memcpy(t->red,  redBuf,   redSize);
+    t->localCount = tb->localCount;
+    t->initCount  = tb->initCount;
+    t->sendCount  = tb->sendCount;
+    t->recvCount  = tb->recvCount;
+    t->redCount   = tb->redCount;
+    t->subgroupCount = tb->groupCount;
+    memcpy(t->local, tb->local, localSize);
+    memcpy(t->init, tb->init,  initSize);
+    memcpy(t->send, tb->send,  sendSize);
+    memcpy(t->recv, tb->recv,  recvSize);
+    memcpy(t->red,  tb->red,   redSize);
 
     // copy group list and task list of each group into transition object
     char* tList = ((char*)t) + tListOff;
-    for (int i = 0; i < groupListCount; i++) {
-        t->subgroup[i].count = groupList[i].count;
+    for (int i = 0; i < tb->groupCount; i++) {
+        t->subgroup[i].count = tb->group[i].count;
         t->subgroup[i].task = (int*) tList;
-        tListSize = groupList[i].count * sizeof(int);
-        memcpy(tList, groupList[i].task, tListSize);
+        tListSize = tb->group[i].count * sizeof(int);
+        memcpy(tList, tb->group[i].task, tListSize);
         tList += tListSize;
     }
     assert(tList == ((char*)t) + tsize);
@@ -1630,6 +1737,21 @@ do_calc_transition(Laik_Space* space,
     return t;
 }
 
+// Calculate communication required for transitioning between partitionings.
+// Reentrant: can be called concurrently for different containers
+Laik_Transition*
+do_calc_transition(Laik_Space* space,
+                   Laik_Partitioning* fromP, Laik_Partitioning* toP,
+                   Laik_DataFlow flow, Laik_ReductionOperation redOp)
+{
+    TransBuilder tb;
+    initTransBuilder(&tb);
+    Laik_Transition* t = calcTransition(&tb, space, fromP, toP, flow, redOp);
+    freeTransBuilder(&tb);
+
+    return t;
+}
+
 
 // Calculate communication required for transitioning between partitionings
 Laik_Transition*
@@ -1641,6 +1763,7 @@ laik_calc_transition(Laik_Space* space,
         // a transition always needs to be between the same process group
         assert(fromP->group == toP->group);
     }
+    laik_partitioning_prepare_transition(fromP, toP, redOp);
 
     Laik_Transition* t;
     t = do_calc_transition(space, fromP, toP, flow, redOp);
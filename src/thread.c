@@ -0,0 +1,358 @@
+/*
+ * This file is part of the LAIK library.
+ * Copyright (c) 2017, 2018 Josef Weidendorfer <Josef.Weidendorfer@gmx.de>
+ *
+ * LAIK is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3 or later.
+ *
+ * LAIK is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "laik-internal.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Thread pool for process-local work
+ *
+ * Local actions (copies between mappings, packing/unpacking of ranges,
+ * buffer copies, initialization and local reductions) are executed by the
+ * calling thread by default. If the environment variable LAIK_THREADS is
+ * set to a number N > 1, N-1 worker threads are started which help the
+ * calling thread with large actions: the work is split into chunks of
+ * consecutive elements, with each element processed by exactly one thread.
+ * As element-wise results do not depend on which thread processes a chunk,
+ * results are the same for any number of threads.
+ *
+ * Work smaller than LAIK_THREADS_MINBYTES per chunk is never split.
+ * Detailed logging (level 1) disables splitting, as logging is not
+ * thread-safe.
+ */
+
+// minimal number of bytes touched per chunk given to a thread
+#ifndef LAIK_THREADS_MINBYTES
+#define LAIK_THREADS_MINBYTES (64 * 1024)
+#endif
+
+static int threads = 1;
+static pthread_t* worker = 0;
+
+// currently running job, protected by <lock>
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t startCond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t doneCond = PTHREAD_COND_INITIALIZER;
+static unsigned int generation = 0;
+static bool shutdownPool = false;
+static int busyWorkers = 0;
+
+static laik_chunk_func_t jobFunc;
+static void* jobCtx;
+static uint64_t jobCount, jobChunk, jobChunks;
+static uint64_t jobNext; // next chunk to process, incremented atomically
+
+// true while a job is running, protected by <lock>. Only one job can use
+// the pool at a time: further (nested or concurrent) calls run serially
+static bool inJob = false;
+
+static
+void runChunks(void)
+{
+    while(1) {
+        uint64_t c = __atomic_fetch_add(&jobNext, 1, __ATOMIC_RELAXED);
+        if (c >= jobChunks) break;
+        uint64_t from = c * jobChunk;
+        uint64_t to = from + jobChunk;
+        if (to > jobCount) to = jobCount;
+        (jobFunc)(jobCtx, from, to);
+    }
+}
+
+static
+void* workerMain(void* arg)
+{
+    (void) arg;
+    unsigned int seen = 0;
+
+    pthread_mutex_lock(&lock);
+    while(1) {
+        while((generation == seen) && !shutdownPool)
+            pthread_cond_wait(&startCond, &lock);
+        if (shutdownPool) break;
+        seen = generation;
+        pthread_mutex_unlock(&lock);
+
+        runChunks();
+
+        pthread_mutex_lock(&lock);
+        busyWorkers--;
+        if (busyWorkers == 0)
+            pthread_cond_signal(&doneCond);
+    }
+    pthread_mutex_unlock(&lock);
+    return 0;
+}
+
+// start worker threads as requested by LAIK_THREADS
+void laik_threads_init()
+{
+    if (worker) return; // already initialized
+
+    char* str = getenv("LAIK_THREADS");
+    int n = str ? atoi(str) : 1;
+    if (n < 1) n = 1;
+    if (n == 1) return;
+
+    worker = malloc((n - 1) * sizeof(pthread_t));
+    if (!worker) {
+        laik_panic("Out of memory allocating worker threads");
+        exit(1); // not actually needed, laik_panic never returns
+    }
+
+    shutdownPool = false;
+    for(int i = 0; i < n - 1; i++) {
+        if (pthread_create(&(worker[i]), 0, workerMain, 0) != 0) {
+            // continue with the threads we got
+            laik_log(LAIK_LL_Warning,
+                     "Could only start %d of %d worker threads", i, n - 1);
+            n = i + 1;
+            break;
+        }
+    }
+    threads = n;
+    laik_log(2, "thread pool: using %d threads for local actions", threads);
+}
+
+// stop worker threads
+void laik_threads_finalize()
+{
+    if (!worker) return;
+
+    pthread_mutex_lock(&lock);
+    shutdownPool = true;
+    pthread_cond_broadcast(&startCond);
+    pthread_mutex_unlock(&lock);
+
+    for(int i = 0; i < threads - 1; i++)
+        pthread_join(worker[i], 0);
+    free(worker);
+    worker = 0;
+    threads = 1;
+}
+
+// number of threads used for local actions (including the calling one)
+int laik_threads_count()
+{
+    return threads;
+}
+
+// call <f> on chunks covering [0;count[, with each chunk being at least
+// <minChunk> elements large (apart from the last one)
+void laik_threads_run(uint64_t count, uint64_t minChunk,
+                      laik_chunk_func_t f, void* ctx)
+{
+    if (count == 0) return;
+    if (minChunk == 0) minChunk = 1;
+
+    uint64_t chunk = (count + threads - 1) / threads;
+    if (chunk < minChunk) chunk = minChunk;
+
+    if ((threads == 1) || (chunk >= count) || laik_log_shown(1)) {
+        (f)(ctx, 0, count);
+        return;
+    }
+
+    // claim the pool, or do the work ourself if it is in use already
+    pthread_mutex_lock(&lock);
+    if (inJob) {
+        pthread_mutex_unlock(&lock);
+        (f)(ctx, 0, count);
+        return;
+    }
+    jobFunc = f;
+    jobCtx = ctx;
+    jobCount = count;
+    jobChunk = chunk;
+    jobChunks = (count + chunk - 1) / chunk;
+    jobNext = 0;
+    inJob = true;
+    busyWorkers = threads - 1;
+    generation++;
+    pthread_cond_broadcast(&startCond);
+    pthread_mutex_unlock(&lock);
+
+    runChunks();
+
+    pthread_mutex_lock(&lock);
+    while(busyWorkers > 0)
+        pthread_cond_wait(&doneCond, &lock);
+    inJob = false;
+    pthread_mutex_unlock(&lock);
+}
+
+// minimal chunk size in elements for elements of <size> bytes
+static
+uint64_t minElems(uint64_t size)
+{
+    if (size == 0) size = 1;
+    uint64_t n = LAIK_THREADS_MINBYTES / size;
+    return (n > 0) ? n : 1;
+}
+
+//--------------------------------------------------------------
+// memcpy
+//
+
+struct copyCtx {
+    char* to;
+    const char* from;
+};
+
+static
+void copyChunk(void* ctx, uint64_t from, uint64_t to)
+{
+    struct copyCtx* c = (struct copyCtx*) ctx;
+    memcpy(c->to + from, c->from + from, to - from);
+}
+
+void laik_threads_memcpy(void* to, const void* from, uint64_t bytes)
+{
+    struct copyCtx c = { (char*) to, (const char*) from };
+    laik_threads_run(bytes, LAIK_THREADS_MINBYTES, copyChunk, &c);
+}
+
+//--------------------------------------------------------------
+// copy entries (used by CopyToBuf/CopyFromBuf)
+//
+
+struct ceCtx {
+    Laik_CopyEntry* ce;
+    char* buf;
+    bool toBuf;
+};
+
+static
+void ceChunk(void* ctx, uint64_t from, uint64_t to)
+{
+    struct ceCtx* c = (struct ceCtx*) ctx;
+    for(uint64_t i = from; i < to; i++) {
+        Laik_CopyEntry* e = &(c->ce[i]);
+        if (c->toBuf)
+            memcpy(c->buf + e->offset, e->ptr, e->bytes);
+        else
+            memcpy(e->ptr, c->buf + e->offset, e->bytes);
+    }
+}
+
+void laik_threads_copyEntries(Laik_CopyEntry* ce, unsigned int count,
+                              char* buf, bool toBuf)
+{
+    if (count == 0) return;
+
+    // entries are expected to be of similar size
+    uint64_t bytes = 0;
+    for(unsigned int i = 0; i < count; i++)
+        bytes += ce[i].bytes;
+
+    struct ceCtx c = { ce, buf, toBuf };
+    laik_threads_run(count, minElems(bytes / count), ceChunk, &c);
+}
+
+//--------------------------------------------------------------
+// initialization and reduction of element arrays
+//
+
+struct redCtx {
+    Laik_Type* type;
+    char* out;
+    const char* in1;
+    const char* in2;
+    Laik_ReductionOperation op;
+};
+
+static
+void initChunk(void* ctx, uint64_t from, uint64_t to)
+{
+    struct redCtx* c = (struct redCtx*) ctx;
+    (c->type->init)(c->out + from * c->type->size, (int) (to - from), c->op);
+}
+
+void laik_threads_init_elems(Laik_Type* t, void* base, uint64_t count,
+                             Laik_ReductionOperation op)
+{
+    assert(t->init != 0);
+    struct redCtx c = { t, (char*) base, 0, 0, op };
+    laik_threads_run(count, minElems(t->size), initChunk, &c);
+}
+
+static
+void reduceChunk(void* ctx, uint64_t from, uint64_t to)
+{
+    struct redCtx* c = (struct redCtx*) ctx;
+    uint64_t off = from * c->type->size;
+    (c->type->reduce)(c->out + off,
+                      c->in1 ? c->in1 + off : 0,
+                      c->in2 ? c->in2 + off : 0,
+                      (int) (to - from), c->op);
+}
+
+void laik_threads_reduce(Laik_Type* t, void* out,
+                         const void* in1, const void* in2,
+                         uint64_t count, Laik_ReductionOperation op)
+{
+    assert(t->reduce != 0);
+    struct redCtx c = { t, (char*) out, (const char*) in1, (const char*) in2, op };
+    laik_threads_run(count, minElems(t->size), reduceChunk, &c);
+}
+
+//--------------------------------------------------------------
+// ranges: split into slabs along the highest dimension with extent > 1.
+// Slabs are consecutive in lexicographical traversal order, so the
+// elements of slab i start at offset i * <slab size> in a pack buffer.
+//
+
+struct rangeCtx {
+    Laik_Range* range;
+    int dim;
+    uint64_t slabElems;
+    laik_range_func_t f;
+    void* ctx;
+};
+
+static
+void rangeChunk(void* ctx, uint64_t from, uint64_t to)
+{
+    struct rangeCtx* c = (struct rangeCtx*) ctx;
+    Laik_Range sub = *(c->range);
+    sub.from.i[c->dim] = c->range->from.i[c->dim] + (int64_t) from;
+    sub.to.i[c->dim] = c->range->from.i[c->dim] + (int64_t) to;
+    (c->f)(c->ctx, &sub, from * c->slabElems);
+}
+
+void laik_threads_run_range(Laik_Range* range, int elemsize,
+                            laik_range_func_t f, void* ctx)
+{
+    int dims = range->space->dims;
+    int dim = dims - 1;
+    while((dim > 0) && (range->to.i[dim] - range->from.i[dim] <= 1))
+        dim--;
+
+    uint64_t slabElems = 1;
+    for(int i = 0; i < dim; i++)
+        slabElems *= (uint64_t) (range->to.i[i] - range->from.i[i]);
+    int64_t slabs = range->to.i[dim] - range->from.i[dim];
+    if (slabs <= 0) return;
+
+    struct rangeCtx c = { range, dim, slabElems, f, ctx };
+    laik_threads_run((uint64_t) slabs, minElems(slabElems * elemsize),
+                     rangeChunk, &c);
+}
@@ -52,6 +52,103 @@ Laik_Type *laik_Double;
 
 static int type_id = 0;
 
+// Reduction kernels
+//
+// For each built-in type, there are kernels for filling an array with a
+// value and for each supported reduction operation. Kernels are compiled
+// with vectorization enabled independent of the optimization level used
+// for LAIK. On x86-64 with GCC, multiple versions using SSE2, AVX2 and
+// AVX-512 are generated, with the best one selected at load time.
+//
+// For each operation, besides the 3-operand version, two fused in-place
+// variants are provided for output aliasing one of the inputs (the common
+// case when accumulating into a buffer), avoiding a third address stream
+// and aliasing checks. Operand order is kept in all variants, so results
+// are bitwise identical.
+
+#if defined(__GNUC__) && !defined(__clang__)
+#if defined(__x86_64__) && defined(__ELF__)
+#define LAIK_KERNEL __attribute__((optimize("O3"), \
+                                   target_clones("avx512f", "avx2", "default")))
+#else
+#define LAIK_KERNEL __attribute__((optimize("O3")))
+#endif
+// elements at same index may alias, but there are no loop-carried dependencies
+#define LAIK_IVDEP _Pragma("GCC ivdep")
+#else
+#define LAIK_KERNEL
+#define LAIK_IVDEP
+#endif
+
+// kernels for operation <op> on type <T>, result given as <expr> of a and b
+#define LAIK_REDUCE_KERNELS(name, T, op, expr) \
+static LAIK_KERNEL \
+void name##_##op(T* out, const T* in1, const T* in2, int count) \
+{ \
+    LAIK_IVDEP \
+    for(int i = 0; i < count; i++) { \
+        T a = in1[i], b = in2[i]; \
+        out[i] = (expr); \
+    } \
+} \
+static LAIK_KERNEL \
+void name##_##op##_io1(T* restrict io, const T* restrict in2, int count) \
+{ \
+    for(int i = 0; i < count; i++) { \
+        T a = io[i], b = in2[i]; \
+        io[i] = (expr); \
+    } \
+} \
+static LAIK_KERNEL \
+void name##_##op##_io2(T* restrict io, const T* restrict in1, int count) \
+{ \
+    for(int i = 0; i < count; i++) { \
+        T a = in1[i], b = io[i]; \
+        io[i] = (expr); \
+    } \
+}
+
+#define LAIK_FILL_KERNEL(name, T) \
+static LAIK_KERNEL \
+void name##_fill(T* restrict p, int count, T v) \
+{ \
+    for(int i = 0; i < count; i++) \
+        p[i] = v; \
+}
+
+#define LAIK_ARITH_KERNELS(name, T) \
+    LAIK_FILL_KERNEL(name, T) \
+    LAIK_REDUCE_KERNELS(name, T, sum,  a + b) \
+    LAIK_REDUCE_KERNELS(name, T, prod, a * b) \
+    LAIK_REDUCE_KERNELS(name, T, min,  (a < b) ? a : b) \
+    LAIK_REDUCE_KERNELS(name, T, max,  (a > b) ? a : b)
+
+#define LAIK_INT_KERNELS(name, T) \
+    LAIK_ARITH_KERNELS(name, T) \
+    LAIK_REDUCE_KERNELS(name, T, or,   a | b) \
+    LAIK_REDUCE_KERNELS(name, T, and,  a & b)
+
+// select the kernel variant for operation <op> depending on aliasing
+#define LAIK_REDUCE_CALL(name, op, out, in1, in2, count) \
+    if (in1 == in2) \
+        name##_##op(out, in1, in2, count); \
+    else if (out == in1) \
+        name##_##op##_io1(out, in2, count); \
+    else if (out == in2) \
+        name##_##op##_io2(out, in1, count); \
+    else \
+        name##_##op(out, in1, in2, count)
+
+LAIK_INT_KERNELS(char, signed char)
+LAIK_INT_KERNELS(uchar, unsigned char)
+LAIK_INT_KERNELS(int32, int32_t)
+LAIK_INT_KERNELS(uint32, uint32_t)
+LAIK_INT_KERNELS(int64, int64_t)
+LAIK_INT_KERNELS(uint64, uint64_t)
+LAIK_ARITH_KERNELS(double, double)
+LAIK_ARITH_KERNELS(float, float)
+
+
 // laik_Char (signed)
 
 void laik_char_init(void* base, int count, Laik_ReductionOperation o)
@@ -68,8 +165,7 @@ void laik_char_init(void* base, int count, Laik_ReductionOperation o)
     default:
         assert(0);
     }
-    for(int i = 0; i < count; i++)
-        p[i] = v;
+    char_fill(p, count, v);
 }
 
 void laik_char_reduce(void* out, const void* in1, const void* in2,
@@ -80,9 +176,9 @@ void laik_char_reduce(void* out, const void* in1, const void* in2,
     if (!in1 || !in2) {
         // for all supported reductions, only one input is copied as output
         if (in1)
-            memcpy(out, in1, count * sizeof(char));
+            memcpy(out, in1, count * sizeof(signed char));
         else if (in2)
-            memcpy(out, in2, count * sizeof(char));
+            memcpy(out, in2, count * sizeof(signed char));
         else
             laik_char_init(out, count, o);
         return;
@@ -93,33 +189,27 @@ void laik_char_reduce(void* out, const void* in1, const void* in2,
     signed char* pout = out;
     switch(o) {
     case LAIK_RO_Sum:
-        for(int i = 0; i < count; i++)
-            pout[i] = pin1[i] + pin2[i];
+        LAIK_REDUCE_CALL(char, sum, pout, pin1, pin2, count);
         break;
 
     case LAIK_RO_Prod:
-        for(int i = 0; i < count; i++)
-            pout[i] = pin1[i] * pin2[i];
+        LAIK_REDUCE_CALL(char, prod, pout, pin1, pin2, count);
         break;
 
     case LAIK_RO_Or:
-        for(int i = 0; i < count; i++)
-            pout[i] = pin1[i] | pin2[i];
+        LAIK_REDUCE_CALL(char, or, pout, pin1, pin2, count);
         break;
 
     case LAIK_RO_And:
-        for(int i = 0; i < count; i++)
-            pout[i] = pin1[i] & pin2[i];
+        LAIK_REDUCE_CALL(char, and, pout, pin1, pin2, count);
         break;
 
     case LAIK_RO_Min:
-        for(int i = 0; i < count; i++)
-            pout[i] = (pin1[i] < pin2[i]) ? pin1[i] : pin2[i];
+        LAIK_REDUCE_CALL(char, min, pout, pin1, pin2, count);
         break;
 
     case LAIK_RO_Max:
-        for(int i = 0; i < count; i++)
-            pout[i] = (pin1[i] > pin2[i]) ? pin1[i] : pin2[i];
+        LAIK_REDUCE_CALL(char, max, pout, pin1, pin2, count);
         break;
 
     default:
@@ -144,8 +234,7 @@ void laik_uchar_init(void* base, int count, Laik_ReductionOperation o)
     default:
         assert(0);
     }
-    for(int i = 0; i < count; i++)
-        p[i] = v;
+    uchar_fill(p, count, v);
 }
 
 void laik_uchar_reduce(void* out, const void* in1, const void* in2,
@@ -159,7 +248,7 @@ void laik_uchar_reduce(void* out, const void* in1, const void* in2,
         else if (in2)
             memcpy(out, in2, count * sizeof(unsigned char));
         else
-            laik_char_init(out, count, o);
+            laik_uchar_init(out, count, o);
         return;
     }
 
@@ -168,33 +257,27 @@ void laik_uchar_reduce(void* out, const void* in1, const void* in2,
     unsigned char* pout = out;
     switch(o) {
     case LAIK_RO_Sum:
-        for(int i = 0; i < count; i++)
-            pout[i] = pin1[i] + pin2[i];
+        LAIK_REDUCE_CALL(uchar, sum, pout, pin1, pin2, count);
         break;
 
     case LAIK_RO_Prod:
-        for(int i = 0; i < count; i++)
-            pout[i] = pin1[i] * pin2[i];
+        LAIK_REDUCE_CALL(uchar, prod, pout, pin1, pin2, count);
         break;
 
     case LAIK_RO_Or:
-        for(int i = 0; i < count; i++)
-            pout[i] = pin1[i] | pin2[i];
+        LAIK_REDUCE_CALL(uchar, or, pout, pin1, pin2, count);
         break;
 
     case LAIK_RO_And:
-        for(int i = 0; i < count; i++)
-            pout[i] = pin1[i] & pin2[i];
+        LAIK_REDUCE_CALL(uchar, and, pout, pin1, pin2, count);
         break;
 
     case LAIK_RO_Min:
-        for(int i = 0; i < count; i++)
-            pout[i] = (pin1[i] < pin2[i]) ? pin1[i] : pin2[i];
+        LAIK_REDUCE_CALL(uchar, min, pout, pin1, pin2, count);
         break;
 
     case LAIK_RO_Max:
-        for(int i = 0; i < count; i++)
-            pout[i] = (pin1[i] > pin2[i]) ? pin1[i] : pin2[i];
+        LAIK_REDUCE_CALL(uchar, max, pout, pin1, pin2, count);
         break;
 
     default:
@@ -219,8 +302,7 @@ void laik_int32_init(void* base, int count, Laik_ReductionOperation o)
     default:
         assert(0);
     }
-    for(int i = 0; i < count; i++)
-        p[i] = v;
+    int32_fill(p, count, v);
 }
 
 void laik_int32_reduce(void* out, const void* in1, const void* in2,
@@ -234,7 +316,7 @@ void laik_int32_reduce(void* out, const void* in1, const void* in2,
         else if (in2)
             memcpy(out, in2, count * sizeof(int32_t));
         else
-            laik_char_init(out, count, o);
+            laik_int32_init(out, count, o);
         return;
     }
 
@@ -243,33 +325,27 @@ void laik_int32_reduce(void* out, const void* in1, const void* in2,
     int32_t* pout = out;
     switch(o) {
     case LAIK_RO_Sum:
-        for(int i = 0; i < count; i++)
-            pout[i] = pin1[i] + pin2[i];
+        LAIK_REDUCE_CALL(int32, sum, pout, pin1, pin2, count);
         break;
 
     case LAIK_RO_Prod:
-        for(int i = 0; i < count; i++)
-            pout[i] = pin1[i] * pin2[i];
+        LAIK_REDUCE_CALL(int32, prod, pout, pin1, pin2, count);
         break;
 
     case LAIK_RO_Or:
-        for(int i = 0; i < count; i++)
-            pout[i] = pin1[i] | pin2[i];
+        LAIK_REDUCE_CALL(int32, or, pout, pin1, pin2, count);
         break;
 
     case LAIK_RO_And:
-        for(int i = 0; i < count; i++)
-            pout[i] = pin1[i] & pin2[i];
+        LAIK_REDUCE_CALL(int32, and, pout, pin1, pin2, count);
         break;
 
     case LAIK_RO_Min:
-        for(int i = 0; i < count; i++)
-            pout[i] = (pin1[i] < pin2[i]) ? pin1[i] : pin2[i];
+        LAIK_REDUCE_CALL(int32, min, pout, pin1, pin2, count);
         break;
 
     case LAIK_RO_Max:
-        for(int i = 0; i < count; i++)
-            pout[i] = (pin1[i] > pin2[i]) ? pin1[i] : pin2[i];
+        LAIK_REDUCE_CALL(int32, max, pout, pin1, pin2, count);
         break;
 
     default:
@@ -294,8 +370,7 @@ void laik_uint32_init(void* base, int count, Laik_ReductionOperation o)
     default:
         assert(0);
     }
-    for(int i = 0; i < count; i++)
-        p[i] = v;
+    uint32_fill(p, count, v);
 }
 
 void laik_uint32_reduce(void* out, const void* in1, const void* in2,
@@ -309,7 +384,7 @@ void laik_uint32_reduce(void* out, const void* in1, const void* in2,
         else if (in2)
             memcpy(out, in2, count * sizeof(uint32_t));
         else
-            laik_char_init(out, count, o);
+            laik_uint32_init(out, count, o);
         return;
     }
 
@@ -318,33 +393,27 @@ void laik_uint32_reduce(void* out, const void* in1, const void* in2,
     uint32_t* pout = out;
     switch(o) {
     case LAIK_RO_Sum:
-        for(int i = 0; i < count; i++)
-            pout[i] = pin1[i] + pin2[i];
+        LAIK_REDUCE_CALL(uint32, sum, pout, pin1, pin2, count);
         break;
 
     case LAIK_RO_Prod:
-        for(int i = 0; i < count; i++)
-            pout[i] = pin1[i] * pin2[i];
+        LAIK_REDUCE_CALL(uint32, prod, pout, pin1, pin2, count);
         break;
 
     case LAIK_RO_Or:
-        for(int i = 0; i < count; i++)
-            pout[i] = pin1[i] | pin2[i];
+        LAIK_REDUCE_CALL(uint32, or, pout, pin1, pin2, count);
         break;
 
     case LAIK_RO_And:
-        for(int i = 0; i < count; i++)
-            pout[i] = pin1[i] & pin2[i];
+        LAIK_REDUCE_CALL(uint32, and, pout, pin1, pin2, count);
         break;
 
     case LAIK_RO_Min:
-        for(int i = 0; i < count; i++)
-            pout[i] = (pin1[i] < pin2[i]) ? pin1[i] : pin2[i];
+        LAIK_REDUCE_CALL(uint32, min, pout, pin1, pin2, count);
         break;
 
     case LAIK_RO_Max:
-        for(int i = 0; i < count; i++)
-            pout[i] = (pin1[i] > pin2[i]) ? pin1[i] : pin2[i];
+        LAIK_REDUCE_CALL(uint32, max, pout, pin1, pin2, count);
         break;
 
     default:
@@ -369,8 +438,7 @@ void laik_int64_init(void* base, int count, Laik_ReductionOperation o)
     default:
         assert(0);
     }
-    for(int i = 0; i < count; i++)
-        p[i] = v;
+    int64_fill(p, count, v);
 }
 
 void laik_int64_reduce(void* out, const void* in1, const void* in2,
@@ -384,7 +452,7 @@ void laik_int64_reduce(void* out, const void* in1, const void* in2,
         else if (in2)
             memcpy(out, in2, count * sizeof(int64_t));
         else
-            laik_char_init(out, count, o);
+            laik_int64_init(out, count, o);
         return;
     }
 
@@ -393,33 +461,27 @@ void laik_int64_reduce(void* out, const void* in1, const void* in2,
     int64_t* pout = out;
     switch(o) {
     case LAIK_RO_Sum:
-        for(int i = 0; i < count; i++)
-            pout[i] = pin1[i] + pin2[i];
+        LAIK_REDUCE_CALL(int64, sum, pout, pin1, pin2, count);
         break;
 
     case LAIK_RO_Prod:
-        for(int i = 0; i < count; i++)
-            pout[i] = pin1[i] * pin2[i];
+        LAIK_REDUCE_CALL(int64, prod, pout, pin1, pin2, count);
         break;
 
     case LAIK_RO_Or:
-        for(int i = 0; i < count; i++)
-            pout[i] = pin1[i] | pin2[i];
+        LAIK_REDUCE_CALL(int64, or, pout, pin1, pin2, count);
         break;
 
     case LAIK_RO_And:
-        for(int i = 0; i < count; i++)
-            pout[i] = pin1[i] & pin2[i];
+        LAIK_REDUCE_CALL(int64, and, pout, pin1, pin2, count);
         break;
 
     case LAIK_RO_Min:
-        for(int i = 0; i < count; i++)
-            pout[i] = (pin1[i] < pin2[i]) ? pin1[i] : pin2[i];
+        LAIK_REDUCE_CALL(int64, min, pout, pin1, pin2, count);
         break;
 
     case LAIK_RO_Max:
-        for(int i = 0; i < count; i++)
-            pout[i] = (pin1[i] > pin2[i]) ? pin1[i] : pin2[i];
+        LAIK_REDUCE_CALL(int64, max, pout, pin1, pin2, count);
         break;
 
     default:
@@ -444,8 +506,7 @@ void laik_uint64_init(void* base, int count, Laik_ReductionOperation o)
     default:
         assert(0);
     }
-    for(int i = 0; i < count; i++)
-        p[i] = v;
+    uint64_fill(p, count, v);
 }
 
 void laik_uint64_reduce(void* out, const void* in1, const void* in2,
@@ -459,7 +520,7 @@ void laik_uint64_reduce(void* out, const void* in1, const void* in2,
         else if (in2)
             memcpy(out, in2, count * sizeof(uint64_t));
         else
-            laik_char_init(out, count, o);
+            laik_uint64_init(out, count, o);
         return;
     }
 
@@ -468,33 +529,27 @@ void laik_uint64_reduce(void* out, const void* in1, const void* in2,
     uint64_t* pout = out;
     switch(o) {
     case LAIK_RO_Sum:
-        for(int i = 0; i < count; i++)
-            pout[i] = pin1[i] + pin2[i];
+        LAIK_REDUCE_CALL(uint64, sum, pout, pin1, pin2, count);
         break;
 
     case LAIK_RO_Prod:
-        for(int i = 0; i < count; i++)
-            pout[i] = pin1[i] * pin2[i];
+        LAIK_REDUCE_CALL(uint64, prod, pout, pin1, pin2, count);
         break;
 
     case LAIK_RO_Or:
-        for(int i = 0; i < count; i++)
-            pout[i] = pin1[i] | pin2[i];
+        LAIK_REDUCE_CALL(uint64, or, pout, pin1, pin2, count);
         break;
 
     case LAIK_RO_And:
-        for(int i = 0; i < count; i++)
-            pout[i] = pin1[i] & pin2[i];
+        LAIK_REDUCE_CALL(uint64, and, pout, pin1, pin2, count);
         break;
 
     case LAIK_RO_Min:
-        for(int i = 0; i < count; i++)
-            pout[i] = (pin1[i] < pin2[i]) ? pin1[i] : pin2[i];
+        LAIK_REDUCE_CALL(uint64, min, pout, pin1, pin2, count);
         break;
 
     case LAIK_RO_Max:
-        for(int i = 0; i < count; i++)
-            pout[i] = (pin1[i] > pin2[i]) ? pin1[i] : pin2[i];
+        LAIK_REDUCE_CALL(uint64, max, pout, pin1, pin2, count);
         break;
 
     default:
@@ -517,8 +572,7 @@ void laik_double_init(void* base, int count, Laik_ReductionOperation o)
     default:
         assert(0);
     }
-    for(int i = 0; i < count; i++)
-        p[i] = v;
+    double_fill(p, count, v);
 }
 
 void laik_double_reduce(void* out, const void* in1, const void* in2,
@@ -541,23 +595,19 @@ void laik_double_reduce(void* out, const void* in1, const void* in2,
     double* pout = out;
     switch(o) {
     case LAIK_RO_Sum:
-        for(int i = 0; i < count; i++)
-            pout[i] = pin1[i] + pin2[i];
+        LAIK_REDUCE_CALL(double, sum, pout, pin1, pin2, count);
         break;
 
     case LAIK_RO_Prod:
-        for(int i = 0; i < count; i++)
-            pout[i] = pin1[i] * pin2[i];
+        LAIK_REDUCE_CALL(double, prod, pout, pin1, pin2, count);
         break;
 
     case LAIK_RO_Min:
-        for(int i = 0; i < count; i++)
-            pout[i] = (pin1[i] < pin2[i]) ? pin1[i] : pin2[i];
+        LAIK_REDUCE_CALL(double, min, pout, pin1, pin2, count);
         break;
 
     case LAIK_RO_Max:
-        for(int i = 0; i < count; i++)
-            pout[i] = (pin1[i] > pin2[i]) ? pin1[i] : pin2[i];
+        LAIK_REDUCE_CALL(double, max, pout, pin1, pin2, count);
         break;
 
     default:
@@ -580,8 +630,7 @@ void laik_float_init(void* base, int count, Laik_ReductionOperation o)
     default:
         assert(0);
     }
-    for(int i = 0; i < count; i++)
-        p[i] = v;
+    float_fill(p, count, v);
 }
 
 void laik_float_reduce(void* out, const void* in1, const void* in2,
@@ -604,23 +653,19 @@ void laik_float_reduce(void* out, const void* in1, const void* in2,
     float* pout = out;
     switch(o) {
     case LAIK_RO_Sum:
-        for(int i = 0; i < count; i++)
-            pout[i] = pin1[i] + pin2[i];
+        LAIK_REDUCE_CALL(float, sum, pout, pin1, pin2, count);
         break;
 
     case LAIK_RO_Prod:
-        for(int i = 0; i < count; i++)
-            pout[i] = pin1[i] * pin2[i];
+        LAIK_REDUCE_CALL(float, prod, pout, pin1, pin2, count);
         break;
 
     case LAIK_RO_Min:
-        for(int i = 0; i < count; i++)
-            pout[i] = (pin1[i] < pin2[i]) ? pin1[i] : pin2[i];
+        LAIK_REDUCE_CALL(float, min, pout, pin1, pin2, count);
         break;
 
     case LAIK_RO_Max:
-        for(int i = 0; i < count; i++)
-            pout[i] = (pin1[i] > pin2[i]) ? pin1[i] : pin2[i];
+        LAIK_REDUCE_CALL(float, max, pout, pin1, pin2, count);
         break;
 
     default:
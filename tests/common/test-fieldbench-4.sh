@@ -0,0 +1,3 @@
+#!/bin/sh
+${LAUNCHER-./launcher} -n 4 ../src/fieldbench -c 100 8 5 > test-fieldbench-4.out
+cmp test-fieldbench-4.out "$(dirname -- "${0}")/test-fieldbench-4.expected"
@@ -0,0 +1,4 @@
+#!/bin/sh
+# test with overlap of halo exchange and computation (split-phase switch)
+${LAUNCHER-./launcher} -n 4 ../../examples/jac2d -s -o 100 > test-jac2d-ovl-4.out
+cmp test-jac2d-ovl-4.out "$(dirname -- "${0}")/test-jac2d-4.expected"
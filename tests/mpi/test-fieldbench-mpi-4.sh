@@ -0,0 +1,3 @@
+#!/bin/sh
+LAIK_BACKEND=mpi ${MPIEXEC-mpiexec} -n 4 ../src/fieldbench -c 100 8 5 > test-fieldbench-mpi-4.out
+cmp test-fieldbench-mpi-4.out "$(dirname -- "${0}")/test-fieldbench-mpi-4.expected"
@@ -0,0 +1,3 @@
+#!/bin/sh
+LAIK_BACKEND=mpi ${MPIEXEC-mpiexec} -n 4 ../../examples/jac1d 1000 50 10 0.05 > test-jac1d-1000-repart-inc-mpi-4.out
+cmp test-jac1d-1000-repart-inc-mpi-4.out "$(dirname -- "${0}")/test-jac1d-1000-repart.expected"
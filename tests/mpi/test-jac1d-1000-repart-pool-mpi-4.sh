@@ -0,0 +1,3 @@
+#!/bin/sh
+LAIK_POOL=1 LAIK_BACKEND=mpi ${MPIEXEC-mpiexec} -n 4 ../../examples/jac1d 1000 50 10 > test-jac1d-1000-repart-pool-mpi-4.out
+cmp test-jac1d-1000-repart-pool-mpi-4.out "$(dirname -- "${0}")/test-jac1d-1000-repart.expected"
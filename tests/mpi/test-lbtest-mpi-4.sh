@@ -0,0 +1,3 @@
+#!/bin/sh
+LAIK_BACKEND=mpi ${MPIEXEC-mpiexec} -n 4 ../src/lbtest > test-lbtest-mpi-4.out
+cmp test-lbtest-mpi-4.out "$(dirname -- "${0}")/test-lbtest-mpi-4.expected"
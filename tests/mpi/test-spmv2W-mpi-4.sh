@@ -0,0 +1,3 @@
+#!/bin/sh
+LAIK_BACKEND=mpi ${MPIEXEC-mpiexec} -n 4 ../../examples/spmv2 -W 10 3000 | LC_ALL='C' sort > test-spmv2W-mpi-4.out
+cmp test-spmv2W-mpi-4.out "$(dirname -- "${0}")/test-spmv2.expected"
@@ -0,0 +1,3 @@
+#!/bin/sh
+LAIK_BACKEND=mpi LAIK_THREADS=4 ${MPIEXEC-mpiexec} -n 4 ../src/transtest > test-transtest-mpi-4.out
+cmp test-transtest-mpi-4.out "$(dirname -- "${0}")/test-transtest-mpi-4.expected"
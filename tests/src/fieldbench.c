@@ -0,0 +1,202 @@
+// Benchmark for halo exchanges of multiple fields over a 2d space. For a
+// number of double containers with same partitionings, the switch from a
+// bisection partitioning to the partitioning extended by halos (depth 1,
+// with corners) is done separately for each container, together for
+// all containers with one call to laik_switchto_partitionings(), where
+// messages to the same neighbor are combined, and by executing action
+// sequences for all containers pre-calculated with laik_calc_actions_multi()
+// (using reservations). Reported are time and sent messages of this process
+// per exchange. Each process checks the values received. With -c (check
+// mode, used as test), only the correctness of the modes is reported.
+//
+// Usage: fieldbench [-c] [<side width> [<fields> [<iterations>]]]
+
+#include "laik-internal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static int fields;
+static Laik_Data** data;
+static Laik_Partitioning *pWrite, *pRead;
+
+static double value(int f, int64_t x, int64_t y, int it)
+{
+    return (double) (f * 1000 + (x + 2 * y) % 997 + it);
+}
+
+// set own values of all fields for iteration <it>, switching fields
+// to <pWrite> if <doSwitch> is set (otherwise they must be in <pWrite>)
+static void writeFields(int it, bool doSwitch)
+{
+    int64_t x1, x2, y1, y2;
+    double* base;
+    uint64_t ysize, ystride, xsize;
+
+    laik_my_range_2d(pWrite, 0, &x1, &x2, &y1, &y2);
+    for(int f = 0; f < fields; f++) {
+        if (doSwitch)
+            laik_switchto_partitioning(data[f], pWrite, LAIK_DF_None, LAIK_RO_None);
+        laik_get_map_2d(data[f], 0, (void**) &base, &ysize, &ystride, &xsize);
+        for(uint64_t y = 0; y < ysize; y++)
+            for(uint64_t x = 0; x < xsize; x++)
+                base[y * ystride + x] = value(f, x1 + x, y1 + y, it);
+    }
+}
+
+// check own values and halos of all fields after exchange
+static void checkFields(int it, int myid)
+{
+    int64_t x1, x2, y1, y2;
+    double* base;
+    uint64_t ysize, ystride, xsize;
+
+    laik_my_range_2d(pRead, 0, &x1, &x2, &y1, &y2);
+    for(int f = 0; f < fields; f++) {
+        laik_get_map_2d(data[f], 0, (void**) &base, &ysize, &ystride, &xsize);
+        for(uint64_t y = 0; y < ysize; y++)
+            for(uint64_t x = 0; x < xsize; x++) {
+                double v = value(f, x1 + x, y1 + y, it);
+                if (base[y * ystride + x] == v) continue;
+                printf("T%d: ERROR: field %d at (%lld/%lld) is %f, expected %f\n",
+                       myid, f, (long long) (x1 + x), (long long) (y1 + y),
+                       base[y * ystride + x], v);
+                exit(1);
+            }
+    }
+}
+
+// messages sent for all fields, accounted by switch statistics
+static uint64_t sentMessages(void)
+{
+    uint64_t sum = 0;
+    for(int f = 0; f < fields; f++)
+        sum += data[f]->stat->msgSendCount + data[f]->stat->msgAsyncSendCount;
+    return sum;
+}
+
+int main(int argc, char* argv[])
+{
+    Laik_Instance* inst = laik_init(&argc, &argv);
+    Laik_Group* world = laik_world(inst);
+    int myid = laik_myid(world);
+
+    int size = 1000, iter = 20;
+    bool check = false;
+    fields = 8;
+    int arg = 1;
+    if ((argc > arg) && (argv[arg][0] == '-') && (argv[arg][1] == 'c')) {
+        check = true;
+        arg++;
+    }
+    if (argc > arg) size = atoi(argv[arg]);
+    if (argc > arg + 1) fields = atoi(argv[arg + 1]);
+    if (argc > arg + 2) iter = atoi(argv[arg + 2]);
+    if (fields < 1) fields = 1;
+
+    Laik_Space* space = laik_new_space_2d(inst, size, size);
+    pWrite = laik_new_partitioning(laik_new_bisection_partitioner(),
+                                   world, space, 0);
+    pRead = laik_new_partitioning(laik_new_cornerhalo_partitioner(1),
+                                  world, space, pWrite);
+    data = malloc(fields * sizeof(Laik_Data*));
+    Laik_Partitioning** toP = malloc(fields * sizeof(Laik_Partitioning*));
+    Laik_Partitioning** exclP = malloc(fields * sizeof(Laik_Partitioning*));
+    Laik_Reservation** res = malloc(fields * sizeof(Laik_Reservation*));
+    Laik_Transition** toHalo = malloc(fields * sizeof(Laik_Transition*));
+    Laik_Transition** toExcl = malloc(fields * sizeof(Laik_Transition*));
+    if (!data || !toP || !exclP || !res || !toHalo || !toExcl) {
+        printf("ERROR: out of memory\n");
+        exit(1);
+    }
+    for(int f = 0; f < fields; f++) {
+        data[f] = laik_new_data(space, laik_Double);
+        toP[f] = pRead;
+        exclP[f] = pWrite;
+    }
+
+    if (myid == 0) {
+        printf("Halo exchange of %d fields with %d x %d doubles, %d processes\n",
+               fields, size, size, laik_size(world));
+        if (!check)
+            printf("  mode        ms/exchange  msgs/exchange (T0)\n");
+    }
+
+    // modes: 0 separate, 1 together, 2 pre-calculated action sequences
+    const char* modeName[3] = { "separate", "together", "sequence" };
+    Laik_ActionSeq *toHaloSeq = 0, *toExclSeq = 0;
+    uint64_t modeMsgs[3];
+    for(int mode = 0; mode < 3; mode++) {
+        if (mode == 2) {
+            // reservations keep mappings fixed, as required for sequences
+            for(int f = 0; f < fields; f++) {
+                res[f] = laik_reservation_new(data[f]);
+                laik_reservation_add(res[f], pRead);
+                laik_reservation_add(res[f], pWrite);
+                laik_reservation_alloc(res[f]);
+                laik_data_use_reservation(data[f], res[f]);
+                toHalo[f] = laik_calc_transition(space, pWrite, pRead,
+                                                 LAIK_DF_Preserve, LAIK_RO_None);
+                toExcl[f] = laik_calc_transition(space, pRead, pWrite,
+                                                 LAIK_DF_None, LAIK_RO_None);
+            }
+            toHaloSeq = laik_calc_actions_multi(fields, data, toHalo, res, res);
+            toExclSeq = laik_calc_actions_multi(fields, data, toExcl, res, res);
+            // switch into mappings of reservations
+            laik_switchto_partitionings(fields, data, exclP,
+                                        LAIK_DF_None, LAIK_RO_None);
+        }
+
+        double t = 0.0;
+        uint64_t msgs = sentMessages();
+        for(int it = 0; it < iter; it++) {
+            writeFields(it, mode < 2);
+            double tt = laik_wtime();
+            if (mode == 0)
+                for(int f = 0; f < fields; f++)
+                    laik_switchto_partitioning(data[f], pRead,
+                                               LAIK_DF_Preserve, LAIK_RO_None);
+            else if (mode == 1)
+                laik_switchto_partitionings(fields, data, toP,
+                                            LAIK_DF_Preserve, LAIK_RO_None);
+            else
+                laik_exec_actions(toHaloSeq);
+            t += laik_wtime() - tt;
+            checkFields(it, myid);
+            if (mode == 2)
+                laik_exec_actions(toExclSeq);
+        }
+        msgs = sentMessages() - msgs;
+        modeMsgs[mode] = msgs;
+        if (myid != 0) continue;
+        if (check)
+            printf("  %s: values ok\n", modeName[mode]);
+        else
+            printf("  %-10s  %11.3f  %13.1f\n", modeName[mode],
+                   (iter > 0) ? t * 1000.0 / iter : 0.0,
+                   (iter > 0) ? (double) msgs / iter : 0.0);
+    }
+
+    // combining messages must not result in more messages
+    if ((modeMsgs[1] > modeMsgs[0]) || (modeMsgs[2] > modeMsgs[1])) {
+        printf("T%d: ERROR: more messages with combined exchanges "
+               "(%llu/%llu/%llu)\n", myid, (unsigned long long) modeMsgs[0],
+               (unsigned long long) modeMsgs[1], (unsigned long long) modeMsgs[2]);
+        exit(1);
+    }
+
+    laik_aseq_free(toHaloSeq);
+    laik_aseq_free(toExclSeq);
+    for(int f = 0; f < fields; f++) {
+        laik_free_transition(toHalo[f]);
+        laik_free_transition(toExcl[f]);
+    }
+    free(toExcl);
+    free(toHalo);
+    free(res);
+    free(exclP);
+    free(toP);
+    free(data);
+    laik_finalize(inst);
+    return 0;
+}
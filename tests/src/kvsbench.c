@@ -0,0 +1,80 @@
+// Scaling benchmark for KV store synchronization, based on kvstest.
+// For increasing numbers of entries per process, each process sets own
+// entries plus entries with the same values on all processes (as for
+// configuration data) and the store is synchronized. This is repeated
+// with changed values. Run with different process counts, e.g. with the
+// MPI backend comparing LAIK_MPI_KVSTREE=0/1. Not run as test, but each
+// process checks that it sees all entries with correct values.
+//
+// Usage: kvsbench [<max entries per process> [<iterations>]]
+
+#include "laik.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int main(int argc, char* argv[])
+{
+    Laik_Instance* inst = laik_init(&argc, &argv);
+    Laik_Group* world = laik_world(inst);
+    int myid = laik_myid(world);
+    int size = laik_size(world);
+
+    int maxEntries = 1000;
+    int iter = 10;
+    if (argc > 1) maxEntries = atoi(argv[1]);
+    if (argc > 2) iter = atoi(argv[2]);
+
+    if (myid == 0) {
+        printf("KVS sync with %d processes (ms per sync)\n", size);
+        printf("  entries/proc  total entries  first sync  updates\n");
+    }
+
+    char key[50], data[50];
+    for(int n = 1; n <= maxEntries; n *= 10) {
+        Laik_KVStore* kvs = laik_kvs_new("bench", inst);
+        double tFirst = 0.0, tUpdate = 0.0;
+        for(int it = 0; it <= iter; it++) {
+            for(int i = 0; i < n; i++) {
+                sprintf(key, "T%d-%d", myid, i);
+                sprintf(data, "value %d/%d", i, it);
+                laik_kvs_sets(kvs, key, data);
+                sprintf(key, "common-%d", i);
+                laik_kvs_sets(kvs, key, data);
+            }
+            double t = laik_wtime();
+            laik_kvs_sync(kvs);
+            t = laik_wtime() - t;
+            if (it == 0) tFirst = t;
+            else tUpdate += t;
+
+            // check that all entries of all processes are visible
+            for(int task = 0; task < size; task++) {
+                for(int i = 0; i < n; i++) {
+                    sprintf(key, "T%d-%d", task, i);
+                    sprintf(data, "value %d/%d", i, it);
+                    char* v = laik_kvs_get(kvs, key, 0);
+                    if (!v || strcmp(v, data) != 0) {
+                        printf("T%d: ERROR: key '%s' has value '%s', expected '%s'\n",
+                               myid, key, v ? v : "(none)", data);
+                        exit(1);
+                    }
+                }
+            }
+        }
+        unsigned int count = laik_kvs_count(kvs);
+        if (count != (unsigned int) ((size + 1) * n)) {
+            printf("T%d: ERROR: %d entries, expected %d\n",
+                   myid, count, (size + 1) * n);
+            exit(1);
+        }
+        if (myid == 0)
+            printf("  %12d  %13d  %10.3f  %7.3f\n", n, count,
+                   tFirst * 1000.0, (iter > 0) ? tUpdate * 1000.0 / iter : 0.0);
+        laik_kvs_free(kvs);
+    }
+
+    laik_finalize(inst);
+    return 0;
+}
@@ -0,0 +1,80 @@
+// Test for the load balancer: after rebalancing, the group shrinks and the
+// block partitioner is run for the new group before the next rebalancing.
+// The weights of the old group must not be used any more, i.e. the new
+// partitioning must be the same as without weights. Compute times are set
+// directly to get deterministic results. Needs at least 2 processes.
+//
+// Usage: lbtest
+
+#include "laik-internal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <assert.h>
+
+// print ranges of <p> (from task 0 of its group only)
+static
+void printRanges(const char* name, Laik_Partitioning* p)
+{
+    if (laik_myid(p->group) != 0) return;
+
+    printf("%s:", name);
+    Laik_TaskRange* tr;
+    for(int n = 0; (tr = laik_partitioning_get_taskrange(p, n)) != 0; n++) {
+        const Laik_Range* r = laik_taskrange_get_range(tr);
+        printf(" T%d [%" PRId64 ";%" PRId64 "[", laik_taskrange_get_task(tr),
+               r->from.i[0], r->to.i[0]);
+    }
+    printf("\n");
+}
+
+int main(int argc, char* argv[])
+{
+    Laik_Instance* inst = laik_init(&argc, &argv);
+    Laik_Group* world = laik_world(inst);
+    int myid = laik_myid(world);
+    int size = laik_size(world);
+    assert(size > 1);
+
+    Laik_Space* space = laik_new_space_1d(inst, 1200);
+    Laik_Partitioner* pr = laik_new_block_partitioner1();
+    Laik_LoadBalancer* lb = laik_new_load_balancer(pr, 0.1, 1);
+
+    // task i is (i+1) times slower than task 0: repartitioning
+    Laik_Partitioning* p1 = laik_new_partitioning(pr, world, space, 0);
+    lb->myTime = (double) (myid + 1);
+    Laik_Partitioning* p2 = laik_lb_balance(lb, p1);
+    assert(p2 != 0);
+    printRanges("balanced", p2);
+
+    // remove last task. In the shrinked group, no times are measured, so
+    // no repartitioning, but weights are reset
+    int removeList[1] = { size - 1 };
+    Laik_Group* g2 = laik_new_shrinked_group(world, 1, removeList);
+    if (laik_myid(g2) >= 0) {
+        Laik_Partitioning* p3 = laik_new_partitioning(pr, g2, space, 0);
+        lb->myTime = 0.0;
+        assert(laik_lb_balance(lb, p3) == 0);
+
+        Laik_Partitioning* p4 = laik_new_partitioning(pr, g2, space, 0);
+        printRanges("shrinked", p4);
+
+        // must be same as without weights
+        Laik_Partitioning* p5;
+        p5 = laik_new_partitioning(laik_new_block_partitioner1(), g2, space, 0);
+        assert(laik_partitioning_rangecount(p4) == laik_partitioning_rangecount(p5));
+        for(int n = 0; n < laik_partitioning_rangecount(p4); n++) {
+            Laik_TaskRange* tr = laik_partitioning_get_taskrange(p4, n);
+            Laik_Range r = *laik_taskrange_get_range(tr);
+            int task = laik_taskrange_get_task(tr);
+            tr = laik_partitioning_get_taskrange(p5, n);
+            assert(laik_range_isEqual(&r, (Laik_Range*) laik_taskrange_get_range(tr)));
+            assert(task == laik_taskrange_get_task(tr));
+        }
+    }
+
+    laik_free_load_balancer(lb);
+    laik_finalize(inst);
+    return 0;
+}
@@ -0,0 +1,109 @@
+// Micro benchmark for pack/unpack of faces of a 3d lexicographical layout,
+// comparing the generic offset-based variant with the lex layout one.
+// Not run as test, but results of both variants are checked to be equal.
+//
+// Usage: packbench [<side length> [<iterations>]]
+
+#include "laik-internal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+// pack buffer size (bytes), same as used in the MPI backend
+#define PACKBUF_SIZE (10*1024*1024)
+
+typedef unsigned int (*packunpack_t)(Laik_Mapping*, Laik_Range*,
+                                     Laik_Index*, char*, unsigned int);
+
+// pack/unpack range <r> via <f> in pieces fitting into <buf>, return seconds
+double run(packunpack_t f, Laik_Mapping* m, Laik_Range* r,
+           char* buf, unsigned int size, int iter)
+{
+    double t = laik_wtime();
+    for(int i = 0; i < iter; i++) {
+        Laik_Index idx = r->from;
+        char* b = buf;
+        unsigned int left = size;
+        while(!laik_index_isEqual(r->space->dims, &idx, &(r->to))) {
+            unsigned int n = (*f)(m, r, &idx, b, left);
+            assert(n > 0);
+            b += n * m->data->elemsize;
+            left -= n * m->data->elemsize;
+        }
+    }
+    return laik_wtime() - t;
+}
+
+int main(int argc, char* argv[])
+{
+    Laik_Instance* inst = laik_init(&argc, &argv);
+    Laik_Group* world = laik_world(inst);
+
+    int side = 200, iter = 20;
+    if (argc > 1) side = atoi(argv[1]);
+    if (argc > 2) iter = atoi(argv[2]);
+    if (side < 4) side = 4;
+    if (iter < 1) iter = 1;
+
+    Laik_Space* space = laik_new_space_3d(inst, side, side, side);
+    Laik_Data* data = laik_new_data(space, laik_Double);
+    Laik_Partitioning* p = laik_new_partitioning(laik_All, world, space, 0);
+    laik_switchto_partitioning(data, p, LAIK_DF_None, LAIK_RO_None);
+
+    double* base;
+    uint64_t ysize, ystride, zsize, zstride, xsize;
+    Laik_Mapping* m = laik_get_map_3d(data, 0, (void**) &base,
+                                      &zsize, &zstride, &ysize, &ystride, &xsize);
+    for(uint64_t z = 0; z < zsize; z++)
+        for(uint64_t y = 0; y < ysize; y++)
+            for(uint64_t x = 0; x < xsize; x++)
+                base[x + y * ystride + z * zstride] = x + 1000.0 * y + 1000000.0 * z;
+
+    unsigned int size = PACKBUF_SIZE;
+    uint64_t faceBytes = (uint64_t) side * side * sizeof(double);
+    if (faceBytes > size) size = faceBytes;
+    char* buf1 = malloc(size);
+    char* buf2 = malloc(size);
+    assert(buf1 && buf2);
+
+    const char* name[3] = { "x", "y", "z" };
+    printf("Pack/unpack of faces with %d x %d doubles, %d iterations\n",
+           side, side, iter);
+    printf(" face     generic pack/unpack (GB/s)    lex pack/unpack (GB/s)\n");
+    for(int d = 0; d < 3; d++) {
+        // face in the middle of dimension d, with thickness 1
+        Laik_Range r;
+        laik_range_init(&r, space, &(space->range.from), &(space->range.to));
+        r.from.i[d] = side / 2;
+        r.to.i[d] = side / 2 + 1;
+
+        double tgp = run(laik_layout_pack_gen, m, &r, buf1, size, iter);
+        double tlp = run(m->layout->pack, m, &r, buf2, size, iter);
+        if (memcmp(buf1, buf2, faceBytes) != 0) {
+            printf("ERROR: pack results differ for %s face\n", name[d]);
+            return 1;
+        }
+
+        // unpack modified values, check by packing again
+        for(uint64_t i = 0; i < faceBytes / sizeof(double); i++)
+            ((double*)buf1)[i] += 1.0;
+        double tgu = run(laik_layout_unpack_gen, m, &r, buf1, size, iter);
+        double tlu = run(m->layout->unpack, m, &r, buf1, size, iter);
+        run(m->layout->pack, m, &r, buf2, size, 1);
+        if (memcmp(buf1, buf2, faceBytes) != 0) {
+            printf("ERROR: unpack results differ for %s face\n", name[d]);
+            return 1;
+        }
+
+        double gb = (double) faceBytes * iter / 1e9;
+        printf("   %s     %10.3f %10.3f            %10.3f %10.3f\n",
+               name[d], gb / tgp, gb / tgu, gb / tlp, gb / tlu);
+    }
+
+    free(buf1);
+    free(buf2);
+    laik_finalize(inst);
+    return 0;
+}
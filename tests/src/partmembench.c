@@ -0,0 +1,90 @@
+// Scaling benchmark for the memory used by range lists of partitionings
+// in one process. For increasing task counts, a partitioning and a halo
+// partitioning derived from it are created and the transition between
+// them is calculated, storing either all ranges (default) or only own
+// ranges and ranges intersecting them (owner-only mode, see
+// laik_set_owner_ranges). Uses a fake group, i.e. no communication.
+// Not run as test, but the number of send/receive operations of the
+// transitions is checked to be equal for both modes.
+//
+// Usage: partmembench [<max task count>]
+
+#include "laik-internal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+// bytes of range lists stored for transition pWrite => pRead
+// in group <g> for given mode, returns send/recv op count in <ops>
+uint64_t run(Laik_Space* s, Laik_Group* g, Laik_Partitioner* prWrite,
+             Laik_Partitioner* prRead, bool ownerRanges, int* ops, double* t)
+{
+    laik_set_owner_ranges(laik_inst(g), ownerRanges);
+
+    uint64_t before, after;
+    laik_get_partitioning_memory(&before, 0);
+    double tt = laik_wtime();
+
+    Laik_Partitioning* pWrite = laik_new_partitioning(prWrite, g, s, 0);
+    Laik_Partitioning* pRead = laik_new_partitioning(prRead, g, s, pWrite);
+    Laik_Transition* tr = laik_calc_transition(s, pWrite, pRead,
+                                               LAIK_DF_Preserve, LAIK_RO_None);
+    Laik_Transition* tr2 = laik_calc_transition(s, pRead, pWrite,
+                                                LAIK_DF_None, LAIK_RO_None);
+    *t = laik_wtime() - tt;
+    *ops = tr->sendCount + tr->recvCount + tr2->sendCount + tr2->recvCount;
+
+    laik_get_partitioning_memory(&after, 0);
+    laik_free_transition(tr);
+    laik_free_transition(tr2);
+    laik_free_partitioning(pRead);
+    laik_free_partitioning(pWrite);
+    return after - before;
+}
+
+int main(int argc, char* argv[])
+{
+    Laik_Instance* inst = laik_init(&argc, &argv);
+
+    int maxTasks = 4096;
+    if (argc > 1) maxTasks = atoi(argv[1]);
+
+    printf("Range list memory per process for block/grid partitioning with halos\n");
+    printf(" dims  tasks   all ranges (B)   own ranges (B)   time all/own (ms)\n");
+    for(int dims = 1; dims <= 3; dims += 2) {
+        int64_t size = (dims == 1) ? (1 << 20) : 1024;
+        Laik_Space* s = (dims == 1) ? laik_new_space_1d(inst, size)
+                                    : laik_new_space_3d(inst, size, size, size);
+        for(int k = 4; ; k *= 2) {
+            int tasks = (dims == 1) ? 16 * k : k * k * k;
+            if (tasks > maxTasks) break;
+
+            // fake group, this process in the middle
+            Laik_Group* g = laik_create_group(inst, tasks);
+            g->size = tasks;
+            g->myid = tasks / 2;
+
+            Laik_Partitioner *prWrite, *prRead;
+            prWrite = (dims == 1) ? laik_new_block_partitioner1()
+                                  : laik_new_grid_partitioner(k, k, k);
+            prRead = laik_new_cornerhalo_partitioner(1);
+
+            int opsAll, opsOwn;
+            double tAll, tOwn;
+            uint64_t all = run(s, g, prWrite, prRead, false, &opsAll, &tAll);
+            uint64_t own = run(s, g, prWrite, prRead, true, &opsOwn, &tOwn);
+            if (opsAll != opsOwn) {
+                printf("ERROR: %d send/recv ops with own ranges, expected %d\n",
+                       opsOwn, opsAll);
+                return 1;
+            }
+            printf("   %d  %6d  %15llu  %15llu  %8.3f /%8.3f\n", dims, tasks,
+                   (unsigned long long) all, (unsigned long long) own,
+                   tAll * 1000.0, tOwn * 1000.0);
+        }
+    }
+
+    laik_finalize(inst);
+    return 0;
+}
@@ -0,0 +1,158 @@
+// Scaling benchmark for freezing range lists with large numbers of ranges.
+// For increasing range counts, range lists are built from ranges appended
+// in order and in random order, and frozen (sorting by task, tag and start
+// index). Shuffled lists are compared with sorting via qsort, as done
+// before radix sorting was used. Same for single indexes (appended via
+// laik_rangelist_append_single1d), where consecutive indexes of a task
+// appended in order get merged already when appending.
+// Not run as test, but the frozen lists are checked to be correct.
+//
+// Usage: rangebench [<max range count>]   (default 10000000)
+
+#include "laik-internal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#define TASKS 64
+
+static uint64_t seed;
+
+static uint64_t rnd(void)
+{
+    seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+    return seed >> 33;
+}
+
+// random permutation of [0;n[
+static int64_t* permutation(int64_t n, bool shuffle)
+{
+    int64_t* p = malloc(sizeof(int64_t) * n);
+    assert(p);
+    for(int64_t i = 0; i < n; i++) p[i] = i;
+    if (!shuffle) return p;
+    seed = 42;
+    for(int64_t i = n - 1; i > 0; i--) {
+        int64_t j = (int64_t) ((rnd() << 31 | rnd()) % (uint64_t) (i + 1));
+        int64_t t = p[i]; p[i] = p[j]; p[j] = t;
+    }
+    return p;
+}
+
+// range <i> of <n> ranges: [2i;2i+2[, tasks get consecutive blocks
+static int taskOf(int64_t i, int64_t n)
+{
+    return (int) (i * TASKS / n);
+}
+
+// same order as used by laik_rangelist_freeze
+static int cmp(const void *p1, const void *p2)
+{
+    const Laik_TaskRange_Gen* r1 = (const Laik_TaskRange_Gen*) p1;
+    const Laik_TaskRange_Gen* r2 = (const Laik_TaskRange_Gen*) p2;
+    if (r1->task != r2->task) return r1->task - r2->task;
+    if (r1->tag != r2->tag) return r1->tag - r2->tag;
+    if (r1->range.from.i[0] == r2->range.from.i[0]) return 0;
+    return (r1->range.from.i[0] < r2->range.from.i[0]) ? -1 : 1;
+}
+
+// generic ranges, returns time for freezing, and for qsort in <tq>
+static double runGen(Laik_Space* s, int64_t n, bool shuffle, double* tq)
+{
+    int64_t* p = permutation(n, shuffle);
+    Laik_RangeList* list = laik_rangelist_new(s, TASKS);
+    Laik_Range r;
+    for(int64_t i = 0; i < n; i++) {
+        laik_range_init_1d(&r, s, 2 * p[i], 2 * p[i] + 2);
+        laik_rangelist_append(list, taskOf(p[i], n), &r, 0, 0);
+    }
+    free(p);
+
+    *tq = 0.0;
+    if (shuffle) {
+        Laik_TaskRange_Gen* copy = malloc(sizeof(Laik_TaskRange_Gen) * n);
+        assert(copy);
+        memcpy(copy, list->trange, sizeof(Laik_TaskRange_Gen) * n);
+        double t = laik_wtime();
+        qsort(copy, n, sizeof(Laik_TaskRange_Gen), cmp);
+        *tq = laik_wtime() - t;
+        free(copy);
+    }
+
+    double t = laik_wtime();
+    laik_rangelist_freeze(list, false);
+    t = laik_wtime() - t;
+
+    assert(list->count == (unsigned int) n);
+    for(int64_t i = 0; i < n; i++) {
+        if ((list->trange[i].range.from.i[0] != 2 * i) ||
+            (list->trange[i].task != taskOf(i, n))) {
+            printf("ERROR: range %lld wrong after freezing\n", (long long) i);
+            exit(1);
+        }
+    }
+    laik_rangelist_free(list);
+    free(list);
+    return t;
+}
+
+// single indexes, returns time for appending and freezing
+static double runSingle(Laik_Space* s, int64_t n, bool shuffle)
+{
+    int64_t* p = permutation(n, shuffle);
+    double t = laik_wtime();
+    Laik_RangeList* list = laik_rangelist_new(s, TASKS);
+    for(int64_t i = 0; i < n; i++)
+        laik_rangelist_append_single1d(list, taskOf(p[i], n), p[i]);
+    laik_rangelist_freeze(list, false);
+    t = laik_wtime() - t;
+    free(p);
+
+    // each task owns one block of consecutive indexes
+    int64_t next = 0;
+    for(unsigned int o = 0; o < list->count; o++) {
+        Laik_TaskRange_Gen* tr = &(list->trange[o]);
+        if ((tr->range.from.i[0] != next) || (tr->task != taskOf(next, n))) {
+            printf("ERROR: single index range %u wrong after freezing\n", o);
+            exit(1);
+        }
+        next = tr->range.to.i[0];
+    }
+    if ((next != n) || (list->count != TASKS)) {
+        printf("ERROR: %u ranges after freezing, expected %d\n",
+               list->count, TASKS);
+        exit(1);
+    }
+    laik_rangelist_free(list);
+    free(list);
+    return t;
+}
+
+int main(int argc, char* argv[])
+{
+    Laik_Instance* inst = laik_init(&argc, &argv);
+
+    int64_t maxCount = 10000000;
+    if (argc > 1) maxCount = atoll(argv[1]);
+
+    printf("Freezing range lists with %d tasks (ms)\n", TASKS);
+    printf("               generic ranges                 single indexes\n");
+    printf("     count   ordered  shuffled  (qsort)    ordered  shuffled\n");
+    for(int64_t n = 1000000; n <= maxCount; n *= 10) {
+        Laik_Space* s = laik_new_space_1d(inst, 2 * n);
+        double tq;
+        double tOrd = runGen(s, n, false, &tq);
+        double tShuf = runGen(s, n, true, &tq);
+        double tSOrd = runSingle(s, n, false);
+        double tSShuf = runSingle(s, n, true);
+        printf(" %9lld  %8.1f  %8.1f  %8.1f   %8.1f  %8.1f\n", (long long) n,
+               tOrd * 1000.0, tShuf * 1000.0, tq * 1000.0,
+               tSOrd * 1000.0, tSShuf * 1000.0);
+        laik_free_space(s);
+    }
+
+    laik_finalize(inst);
+    return 0;
+}
@@ -0,0 +1,108 @@
+// Micro benchmark for the reduction and initialization functions of the
+// built-in LAIK types. For each type and reduction operation, the bandwidth
+// of the 3-operand variant and of in-place accumulation into the output
+// is reported. Not run as test, but results of both variants are checked
+// to be equal.
+//
+// Usage: reducebench [<elements> [<iterations>]]
+
+#include "laik-internal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+// fill <buf> with values valid for all types (no NaNs for floats)
+void fill(Laik_Type* t, char* buf, int count, int seed)
+{
+    for(int i = 0; i < count; i++) {
+        int v = (i * 7 + seed) % 13 + 1;
+        char* p = buf + (uint64_t) i * t->size;
+        if (t == laik_Double)      *(double*)p = v * 0.5;
+        else if (t == laik_Float)  *(float*)p = v * 0.5f;
+        else if (t->size == 1)     *(char*)p = (char) v;
+        else if (t->size == 4)     *(int32_t*)p = v;
+        else                       *(int64_t*)p = v;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Laik_Instance* inst = laik_init(&argc, &argv);
+
+    int count = 1000000, iter = 50;
+    if (argc > 1) count = atoi(argv[1]);
+    if (argc > 2) iter = atoi(argv[2]);
+    if (count < 1) count = 1;
+    if (iter < 1) iter = 1;
+
+    Laik_Type* type[8] = { laik_Char, laik_UChar, laik_Int32, laik_UInt32,
+                           laik_Int64, laik_UInt64, laik_Float, laik_Double };
+    Laik_ReductionOperation op[6] = { LAIK_RO_Sum, LAIK_RO_Prod, LAIK_RO_Min,
+                                      LAIK_RO_Max, LAIK_RO_Or, LAIK_RO_And };
+    const char* opName[6] = { "sum", "prod", "min", "max", "or", "and" };
+
+    char* in1 = malloc((uint64_t) count * 8);
+    char* in2 = malloc((uint64_t) count * 8);
+    char* out = malloc((uint64_t) count * 8);
+    char* acc = malloc((uint64_t) count * 8);
+    assert(in1 && in2 && out && acc);
+
+    printf("Reduction of %d elements, %d iterations (GB/s)\n", count, iter);
+    printf(" type    op        init     reduce   in-place\n");
+    for(int ti = 0; ti < 8; ti++) {
+        Laik_Type* t = type[ti];
+        uint64_t bytes = (uint64_t) count * t->size;
+        for(int oi = 0; oi < 6; oi++) {
+            // bitwise operations only supported for integer types
+            if ((oi >= 4) && ((t == laik_Float) || (t == laik_Double)))
+                continue;
+
+            fill(t, in1, count, 1);
+            fill(t, in2, count, 2);
+
+            double tt = laik_wtime();
+            for(int i = 0; i < iter; i++)
+                (t->init)(acc, count, op[oi]);
+            double ti_ = laik_wtime() - tt;
+
+            tt = laik_wtime();
+            for(int i = 0; i < iter; i++)
+                (t->reduce)(out, in1, in2, count, op[oi]);
+            double tr = laik_wtime() - tt;
+
+            // fused in-place variants must give the same result
+            memcpy(acc, in1, bytes);
+            (t->reduce)(acc, acc, in2, count, op[oi]);
+            if (memcmp(acc, out, bytes) != 0) {
+                printf("ERROR: in-place result differs for %s %s\n",
+                       t->name, opName[oi]);
+                return 1;
+            }
+            memcpy(acc, in2, bytes);
+            (t->reduce)(acc, in1, acc, count, op[oi]);
+            if (memcmp(acc, out, bytes) != 0) {
+                printf("ERROR: in-place result differs for %s %s\n",
+                       t->name, opName[oi]);
+                return 1;
+            }
+            tt = laik_wtime();
+            for(int i = 0; i < iter; i++)
+                (t->reduce)(acc, acc, in2, count, op[oi]);
+            double tp = laik_wtime() - tt;
+
+            // init writes 1 array, reductions read 2 and write 1
+            double gb = (double) bytes * iter / 1e9;
+            printf(" %-7s %-5s %10.3f %10.3f %10.3f\n", t->name, opName[oi],
+                   gb / ti_, 3 * gb / tr, 3 * gb / tp);
+        }
+    }
+
+    free(in1);
+    free(in2);
+    free(out);
+    free(acc);
+    laik_finalize(inst);
+    return 0;
+}
@@ -0,0 +1,183 @@
+// Comparison of partitioners for 2d/3d spaces: for increasing task counts,
+// a partitioning is calculated with the grid (3d only), bisection and
+// space-filling curve (Morton/Hilbert) partitioners, and the halo volume
+// (indexes of other tasks directly neighbored to own indexes, i.e. depth 1
+// without corners) is counted. This is the amount of data to receive for a
+// stencil code. Also reported are load imbalance (maximum weight of a task
+// relative to the average) and the maximum number of mappings of a task.
+// Done with uniform weights and with weights 10x higher in one corner
+// (only the curve partitioners take index weights into account).
+// Uses a fake group, i.e. no communication.
+//
+// Usage: sfcbench [<max task count>]
+
+#include "laik-internal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+static int64_t size;
+static int dims;
+
+// weight of an index: 10 in corner (quarter of each side), else 1
+double getW(Laik_Index* idx, const void* userData)
+{
+    (void) userData;
+    for(int d = 0; d < dims; d++)
+        if (idx->i[d] >= size / 4) return 1.0;
+    return 10.0;
+}
+
+// split <tasks> into 3 factors as equal as possible, for grid partitioner
+void factorize(int tasks, int* f)
+{
+    f[0] = tasks; f[1] = 1; f[2] = 1;
+    for(int z = 1; z * z * z <= tasks; z++) {
+        if (tasks % z) continue;
+        for(int y = z; y * y <= tasks / z; y++) {
+            if ((tasks / z) % y) continue;
+            int x = tasks / z / y;
+            if (x - z < f[0] - f[2]) {
+                f[0] = x; f[1] = y; f[2] = z;
+            }
+        }
+    }
+}
+
+// statistics for partitioning of <p>, with <owner> array of size^dims
+void stats(Laik_Partitioning* p, int tasks, bool weighted, int* owner,
+           double* imbalance, uint64_t* haloSum, uint64_t* haloMax, int* mapsMax)
+{
+    Laik_RangeList* list = laik_partitioning_allranges(p);
+    int64_t n[3] = { size, (dims > 1) ? size : 1, (dims > 2) ? size : 1 };
+    double* w = calloc(tasks, sizeof(double));
+    uint64_t* halo = calloc(tasks, sizeof(uint64_t));
+    assert(w && halo);
+
+    double totalW = 0.0;
+    Laik_Index idx;
+    laik_index_init(&idx, 0, 0, 0);
+    for(unsigned int o = 0; o < list->count; o++) {
+        Laik_Range* r = &(list->trange[o].range);
+        int64_t from[3] = { 0, 0, 0 }, to[3] = { 1, 1, 1 };
+        for(int d = 0; d < dims; d++) {
+            from[d] = r->from.i[d];
+            to[d] = r->to.i[d];
+        }
+        int64_t* x = idx.i;
+        for(x[2] = from[2]; x[2] < to[2]; x[2]++)
+            for(x[1] = from[1]; x[1] < to[1]; x[1]++)
+                for(x[0] = from[0]; x[0] < to[0]; x[0]++) {
+                    owner[x[0] + n[0] * (x[1] + n[1] * x[2])] = list->trange[o].task;
+                    double v = weighted ? getW(&idx, 0) : 1.0;
+                    w[list->trange[o].task] += v;
+                    totalW += v;
+                }
+    }
+
+    // an index is in the halo of each different task owning a neighbor
+    int64_t stride[3] = { 1, n[0], n[0] * n[1] };
+    for(int64_t z = 0; z < n[2]; z++)
+        for(int64_t y = 0; y < n[1]; y++)
+            for(int64_t x = 0; x < n[0]; x++) {
+                int64_t c[3] = { x, y, z };
+                int64_t off = x + n[0] * (y + n[1] * z);
+                int seen[6], seenCount = 0;
+                for(int d = 0; d < dims; d++) {
+                    for(int dir = -1; dir <= 1; dir += 2) {
+                        if ((c[d] + dir < 0) || (c[d] + dir >= n[d])) continue;
+                        int o = owner[off + dir * stride[d]];
+                        if (o == owner[off]) continue;
+                        bool found = false;
+                        for(int i = 0; i < seenCount; i++)
+                            if (seen[i] == o) found = true;
+                        if (found) continue;
+                        seen[seenCount++] = o;
+                        halo[o]++;
+                    }
+                }
+            }
+
+    double maxW = 0.0;
+    *haloSum = 0;
+    *haloMax = 0;
+    *mapsMax = 0;
+    for(int t = 0; t < tasks; t++) {
+        if (w[t] > maxW) maxW = w[t];
+        *haloSum += halo[t];
+        if (halo[t] > *haloMax) *haloMax = halo[t];
+        int maps = laik_rangelist_tidmapcount(list, t);
+        if (maps > *mapsMax) *mapsMax = maps;
+    }
+    *imbalance = maxW / (totalW / tasks);
+    free(w);
+    free(halo);
+}
+
+int main(int argc, char* argv[])
+{
+    Laik_Instance* inst = laik_init(&argc, &argv);
+
+    int maxTasks = 128;
+    if (argc > 1) maxTasks = atoi(argv[1]);
+
+    int taskCounts[] = { 6, 8, 12, 24, 27, 48, 64, 96, 125, 0 };
+    const char* names[4] = { "grid", "bisection", "sfc-morton", "sfc-hilbert" };
+
+    printf("Halo volume (depth 1) for partitionings of 2d/3d spaces\n");
+    for(int weighted = 0; weighted < 2; weighted++) {
+        printf("\n%s weights\n", weighted ? "Corner-heavy" : "Uniform");
+        printf(" dims  tasks  partitioner   imbalance  halo total  halo max  maps max\n");
+        for(dims = 2; dims <= 3; dims++) {
+            size = (dims == 2) ? 512 : 64;
+            Laik_Space* s = (dims == 2) ? laik_new_space_2d(inst, size, size)
+                                        : laik_new_space_3d(inst, size, size, size);
+            int* owner = malloc(sizeof(int) * (dims == 2 ? size * size : size * size * size));
+            assert(owner);
+
+            for(int i = 0; taskCounts[i] > 0; i++) {
+                int tasks = taskCounts[i];
+                if (tasks > maxTasks) break;
+
+                // fake group
+                Laik_Group* g = laik_create_group(inst, tasks);
+                g->size = tasks;
+                g->myid = 0;
+
+                for(int pi = 0; pi < 4; pi++) {
+                    Laik_Partitioner* pr;
+                    Laik_GetIdxWeight_t f = weighted ? getW : 0;
+                    if (pi == 0) {
+                        if (dims < 3) continue;
+                        int fac[3];
+                        factorize(tasks, fac);
+                        pr = laik_new_grid_partitioner(fac[0], fac[1], fac[2]);
+                    }
+                    else if (pi == 1)
+                        pr = laik_new_bisection_partitioner();
+                    else
+                        pr = laik_new_sfc_partitioner((pi == 2) ? LAIK_SFC_Morton
+                                                                : LAIK_SFC_Hilbert,
+                                                      0, f, 0, 0);
+
+                    Laik_Partitioning* p = laik_new_partitioning(pr, g, s, 0);
+                    double imbalance;
+                    uint64_t haloSum, haloMax;
+                    int mapsMax;
+                    stats(p, tasks, weighted, owner,
+                          &imbalance, &haloSum, &haloMax, &mapsMax);
+                    printf("   %d  %5d  %-12s %10.3f  %10llu  %8llu  %8d\n",
+                           dims, tasks, names[pi], imbalance,
+                           (unsigned long long) haloSum,
+                           (unsigned long long) haloMax, mapsMax);
+                    laik_free_partitioning(p);
+                }
+            }
+            free(owner);
+        }
+    }
+
+    laik_finalize(inst);
+    return 0;
+}
@@ -0,0 +1,131 @@
+// Test for the space-filling curve partitioner: for small 2d/3d spaces,
+// partitionings along Morton and Hilbert curves must cover the space
+// without overlap. The ranges of each task are printed for comparison
+// with expected output. Uses fake groups, i.e. no communication.
+//
+// Usage: sfctest
+
+#include "laik-internal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <assert.h>
+
+// index weight: 4 in the lower corner (first half of each side), else 1
+static
+double getW(Laik_Index* idx, const void* userData)
+{
+    const int64_t* half = (const int64_t*) userData;
+    for(int d = 0; d < 3; d++)
+        if (idx->i[d] >= half[d]) return 1.0;
+    return 4.0;
+}
+
+static
+void printRange(Laik_Range* r, int dims)
+{
+    for(int d = 0; d < dims; d++)
+        printf("%s[%" PRId64 ";%" PRId64 "[", (d > 0) ? " x " : "",
+               r->from.i[d], r->to.i[d]);
+}
+
+// partition space <s> with <tasks> tasks, check coverage without overlap,
+// and print ranges with tags and own weight sums
+static
+void check(Laik_Instance* inst, Laik_Space* s, int tasks,
+           Laik_SFCType type, int64_t blocksize, bool weighted)
+{
+    int dims = s->dims;
+    int64_t n[3] = { 1, 1, 1 }, half[3] = { 1, 1, 1 };
+    for(int d = 0; d < dims; d++) {
+        n[d] = s->range.to.i[d] - s->range.from.i[d];
+        half[d] = n[d] / 2;
+    }
+
+    // fake group
+    Laik_Group* g = laik_create_group(inst, tasks);
+    g->size = tasks;
+    g->myid = 0;
+
+    Laik_Partitioner* pr;
+    pr = laik_new_sfc_partitioner(type, blocksize, weighted ? getW : 0, 0,
+                                  weighted ? half : 0);
+    Laik_Partitioning* p = laik_new_partitioning(pr, g, s, 0);
+    Laik_RangeList* list = laik_partitioning_allranges(p);
+    assert(list != 0);
+
+    printf("%dd %" PRId64 "x%" PRId64 "x%" PRId64 ", %d tasks, %s, block %d%s:\n",
+           dims, n[0], n[1], n[2], tasks,
+           (type == LAIK_SFC_Morton) ? "Morton" : "Hilbert",
+           (int) blocksize, weighted ? ", weighted" : "");
+
+    int* owner = malloc(n[0] * n[1] * n[2] * sizeof(int));
+    double* w = calloc(tasks, sizeof(double));
+    assert(owner && w);
+    for(int64_t i = 0; i < n[0] * n[1] * n[2]; i++)
+        owner[i] = -1;
+
+    Laik_Index idx;
+    laik_index_init(&idx, 0, 0, 0);
+    for(unsigned int o = 0; o < list->count; o++) {
+        Laik_TaskRange_Gen* tr = &(list->trange[o]);
+        Laik_Range* r = &(tr->range);
+        assert(laik_range_within_space(r, s));
+        assert(!laik_range_isEmpty(r));
+
+        int64_t from[3] = { 0, 0, 0 }, to[3] = { 1, 1, 1 };
+        for(int d = 0; d < dims; d++) {
+            from[d] = r->from.i[d] - s->range.from.i[d];
+            to[d] = r->to.i[d] - s->range.from.i[d];
+        }
+        int64_t* x = idx.i;
+        for(x[2] = from[2]; x[2] < to[2]; x[2]++)
+            for(x[1] = from[1]; x[1] < to[1]; x[1]++)
+                for(x[0] = from[0]; x[0] < to[0]; x[0]++) {
+                    int64_t off = x[0] + n[0] * (x[1] + n[1] * x[2]);
+                    // no overlap
+                    assert(owner[off] < 0);
+                    owner[off] = tr->task;
+                    w[tr->task] += weighted ? getW(&idx, half) : 1.0;
+                }
+
+        printf("  T%d: ", tr->task);
+        printRange(r, dims);
+        printf(" (tag %d)\n", tr->tag);
+    }
+
+    // full coverage
+    for(int64_t i = 0; i < n[0] * n[1] * n[2]; i++)
+        assert(owner[i] >= 0);
+
+    printf("  weights:");
+    for(int t = 0; t < tasks; t++)
+        printf(" %.0f", w[t]);
+    printf("\n");
+
+    free(owner);
+    free(w);
+    laik_free_partitioning(p);
+}
+
+int main(int argc, char* argv[])
+{
+    Laik_Instance* inst = laik_init(&argc, &argv);
+
+    Laik_Space* s2 = laik_new_space_2d(inst, 8, 8);
+    Laik_Space* s2odd = laik_new_space_2d(inst, 10, 6);
+    Laik_Space* s3 = laik_new_space_3d(inst, 4, 4, 4);
+
+    for(int t = 0; t < 2; t++) {
+        Laik_SFCType type = (t == 0) ? LAIK_SFC_Morton : LAIK_SFC_Hilbert;
+        check(inst, s2, 4, type, 2, false);
+        check(inst, s2, 3, type, 2, true);
+        check(inst, s2odd, 4, type, 4, false);
+        check(inst, s3, 3, type, 2, false);
+        check(inst, s3, 2, type, 0, true);
+    }
+
+    laik_finalize(inst);
+    return 0;
+}
@@ -0,0 +1,121 @@
+// Scaling benchmark for the intersection search done in transition
+// calculation for 2d/3d spaces. For grid partitionings with increasing
+// task counts, all tasks' searches for ranges of other tasks intersecting
+// their own ranges are done (as in a switch on each process), comparing
+// checking all ranges with queries to the range index.
+// Not run as test, but the number of intersections found is checked to
+// be equal for both variants.
+//
+// Usage: transbench [<max task count>]
+
+#include "laik-internal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+// grid with <n[d]> blocks in dimension d over space of size <size>,
+// block borders shifted by <shift> (task ids in lexicographical order)
+Laik_RangeList* grid(Laik_Space* s, int dims, int* n, int64_t size, int64_t shift)
+{
+    int tasks = n[0] * n[1] * n[2];
+    Laik_RangeList* list = laik_rangelist_new(s, tasks);
+    for(int t = 0; t < tasks; t++) {
+        int c[3] = { t % n[0], (t / n[0]) % n[1], t / n[0] / n[1] };
+        Laik_Range r;
+        r.space = s;
+        for(int d = 0; d < 3; d++) {
+            if (d >= dims) {
+                r.from.i[d] = 0;
+                r.to.i[d] = 1;
+                continue;
+            }
+            int64_t from = (c[d] == 0) ? 0 : size * c[d] / n[d] + shift;
+            int64_t to = (c[d] == n[d] - 1) ? size : size * (c[d] + 1) / n[d] + shift;
+            r.from.i[d] = from;
+            r.to.i[d] = to;
+        }
+        laik_rangelist_append(list, t, &r, 0, 0);
+    }
+    laik_rangelist_freeze(list, false);
+    return list;
+}
+
+static uint64_t hits;
+static Laik_RangeList* qlist;
+static const Laik_Range* qrange;
+
+void countHit(void* ctx, unsigned int o)
+{
+    (void) ctx;
+    if (laik_range_intersect(&(qlist->trange[o].range), qrange)) hits++;
+}
+
+int main(int argc, char* argv[])
+{
+    Laik_Instance* inst = laik_init(&argc, &argv);
+
+    int maxTasks = 4096;
+    if (argc > 1) maxTasks = atoi(argv[1]);
+
+    int64_t size = 1 << 20;
+    printf("Intersection search of all tasks for grid partitionings (ms)\n");
+    printf(" dims  tasks    all ranges     index (incl. build)\n");
+    for(int dims = 2; dims <= 3; dims++) {
+        Laik_Space* s = (dims == 2) ? laik_new_space_2d(inst, size, size)
+                                    : laik_new_space_3d(inst, size, size, size);
+        for(int k = (dims == 2) ? 8 : 4; ; k *= 2) {
+            // from/to: grids with different shapes
+            int n1[3] = { k, k, 1 }, n2[3] = { k / 2, 2 * k, 1 };
+            if (dims == 3) {
+                n1[2] = k;
+                n2[2] = k;
+            }
+            int tasks = n1[0] * n1[1] * n1[2];
+            if (tasks > maxTasks) break;
+
+            Laik_RangeList* from = grid(s, dims, n1, size, 0);
+            Laik_RangeList* to = grid(s, dims, n2, size, 7);
+
+            double t = laik_wtime();
+            uint64_t allHits = 0;
+            for(int task = 0; task < tasks; task++) {
+                unsigned int last = laik_rangelist_tidoff(from, task + 1);
+                for(unsigned int o1 = laik_rangelist_tidoff(from, task); o1 < last; o1++)
+                    for(unsigned int o2 = 0; o2 < to->count; o2++)
+                        if (laik_range_intersect(&(from->trange[o1].range),
+                                                 &(to->trange[o2].range)))
+                            allHits++;
+            }
+            double tAll = laik_wtime() - t;
+
+            t = laik_wtime();
+            hits = 0;
+            qlist = to;
+            for(int task = 0; task < tasks; task++) {
+                unsigned int last = laik_rangelist_tidoff(from, task + 1);
+                for(unsigned int o1 = laik_rangelist_tidoff(from, task); o1 < last; o1++) {
+                    qrange = &(from->trange[o1].range);
+                    laik_rangelist_query(to, qrange, countHit, 0);
+                }
+            }
+            double tIdx = laik_wtime() - t;
+
+            if (hits != allHits) {
+                printf("ERROR: %llu intersections found via index, expected %llu\n",
+                       (unsigned long long) hits, (unsigned long long) allHits);
+                return 1;
+            }
+            printf("   %d  %6d  %12.3f  %12.3f\n",
+                   dims, tasks, tAll * 1000.0, tIdx * 1000.0);
+
+            laik_rangelist_free(from);
+            laik_rangelist_free(to);
+            free(from);
+            free(to);
+        }
+    }
+
+    laik_finalize(inst);
+    return 0;
+}
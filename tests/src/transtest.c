@@ -0,0 +1,173 @@
+// Test for laik_calc_transitions: transitions calculated for multiple
+// containers at once (in parallel if LAIK_THREADS > 1) must be the same
+// as transitions calculated one after the other with laik_calc_transition
+//
+// Usage: transtest
+
+#include "laik-internal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#define CONTAINERS 6
+
+static
+double taskWeight(int rank, const void* userData)
+{
+    (void) userData;
+    return (double) (rank + 1);
+}
+
+static
+void checkRange(Laik_Range* r1, Laik_Range* r2)
+{
+    assert(laik_range_isEqual(r1, r2));
+}
+
+// check that <t1> and <t2> describe the same transition
+static
+void checkTransition(Laik_Transition* t1, Laik_Transition* t2)
+{
+    assert(t1 && t2);
+    assert(t1->space == t2->space);
+    assert(t1->fromPartitioning == t2->fromPartitioning);
+    assert(t1->toPartitioning == t2->toPartitioning);
+    assert(t1->flow == t2->flow);
+    assert(t1->redOp == t2->redOp);
+    assert(t1->actionCount == t2->actionCount);
+
+    assert(t1->localCount == t2->localCount);
+    for(int i = 0; i < t1->localCount; i++) {
+        struct localTOp *o1 = &(t1->local[i]), *o2 = &(t2->local[i]);
+        checkRange(&(o1->range), &(o2->range));
+        assert(o1->fromRangeNo == o2->fromRangeNo);
+        assert(o1->toRangeNo == o2->toRangeNo);
+        assert(o1->fromMapNo == o2->fromMapNo);
+        assert(o1->toMapNo == o2->toMapNo);
+    }
+
+    assert(t1->initCount == t2->initCount);
+    for(int i = 0; i < t1->initCount; i++) {
+        struct initTOp *o1 = &(t1->init[i]), *o2 = &(t2->init[i]);
+        checkRange(&(o1->range), &(o2->range));
+        assert(o1->rangeNo == o2->rangeNo);
+        assert(o1->mapNo == o2->mapNo);
+        assert(o1->redOp == o2->redOp);
+    }
+
+    assert(t1->sendCount == t2->sendCount);
+    for(int i = 0; i < t1->sendCount; i++) {
+        struct sendTOp *o1 = &(t1->send[i]), *o2 = &(t2->send[i]);
+        checkRange(&(o1->range), &(o2->range));
+        assert(o1->rangeNo == o2->rangeNo);
+        assert(o1->mapNo == o2->mapNo);
+        assert(o1->toTask == o2->toTask);
+    }
+
+    assert(t1->recvCount == t2->recvCount);
+    for(int i = 0; i < t1->recvCount; i++) {
+        struct recvTOp *o1 = &(t1->recv[i]), *o2 = &(t2->recv[i]);
+        checkRange(&(o1->range), &(o2->range));
+        assert(o1->rangeNo == o2->rangeNo);
+        assert(o1->mapNo == o2->mapNo);
+        assert(o1->fromTask == o2->fromTask);
+    }
+
+    assert(t1->redCount == t2->redCount);
+    for(int i = 0; i < t1->redCount; i++) {
+        struct redTOp *o1 = &(t1->red[i]), *o2 = &(t2->red[i]);
+        checkRange(&(o1->range), &(o2->range));
+        assert(o1->redOp == o2->redOp);
+        assert(o1->inputGroup == o2->inputGroup);
+        assert(o1->outputGroup == o2->outputGroup);
+        assert(o1->myInputRangeNo == o2->myInputRangeNo);
+        assert(o1->myOutputRangeNo == o2->myOutputRangeNo);
+        assert(o1->myInputMapNo == o2->myInputMapNo);
+        assert(o1->myOutputMapNo == o2->myOutputMapNo);
+    }
+
+    assert(t1->subgroupCount == t2->subgroupCount);
+    for(int i = 0; i < t1->subgroupCount; i++) {
+        TaskGroup *g1 = &(t1->subgroup[i]), *g2 = &(t2->subgroup[i]);
+        assert(g1->count == g2->count);
+        for(int j = 0; j < g1->count; j++)
+            assert(g1->task[j] == g2->task[j]);
+    }
+}
+
+// calculate transitions for <n> containers in <d> to <toP> at once and
+// one by one, and compare. Returns the sum of action counts
+static
+int checkTransitions(int n, Laik_Data** d, Laik_Partitioning** toP,
+                     Laik_DataFlow flow, Laik_ReductionOperation redOp)
+{
+    Laik_Transition* t[CONTAINERS];
+    int actions = 0;
+
+    laik_calc_transitions(n, d, toP, flow, redOp, t);
+    for(int i = 0; i < n; i++) {
+        Laik_Transition* st;
+        st = laik_calc_transition(d[i]->space, d[i]->activePartitioning,
+                                  toP[i], flow, redOp);
+        checkTransition(t[i], st);
+        actions += st->actionCount;
+        laik_free_transition(st);
+        laik_free_transition(t[i]);
+    }
+    return actions;
+}
+
+int main(int argc, char* argv[])
+{
+    Laik_Instance* inst = laik_init(&argc, &argv);
+    Laik_Group* world = laik_world(inst);
+    int myid = laik_myid(world);
+
+    Laik_Space* s1 = laik_new_space_1d(inst, 1000);
+    Laik_Space* s2 = laik_new_space_2d(inst, 40, 50);
+
+    Laik_Partitioning *pBlock, *pBlock2, *pBlockW, *pHalo;
+    Laik_Partitioning *pAll, *pMaster, *pBis, *pBisHalo;
+    pBlock = laik_new_partitioning(laik_new_block_partitioner1(),
+                                   world, s1, 0);
+    pBlock2 = laik_new_partitioning(laik_new_block_partitioner(0, 2, 0, 0, 0),
+                                    world, s1, 0);
+    pBlockW = laik_new_partitioning(laik_new_block_partitioner_tw1(taskWeight, 0),
+                                    world, s1, 0);
+    pHalo = laik_new_partitioning(laik_new_cornerhalo_partitioner(1),
+                                  world, s1, pBlock);
+    pAll = laik_new_partitioning(laik_All, world, s1, 0);
+    pMaster = laik_new_partitioning(laik_Master, world, s1, 0);
+    pBis = laik_new_partitioning(laik_new_bisection_partitioner(),
+                                 world, s2, 0);
+    pBisHalo = laik_new_partitioning(laik_new_cornerhalo_partitioner(1),
+                                     world, s2, pBis);
+
+    // containers with their active partitioning, and the ones to switch to.
+    // Reductions are only supported for 1d spaces (apart from full space),
+    // and the switch from <pAll> needs a reduction: the first container
+    // is only used without, the last one only with reduction
+    Laik_Partitioning* fromP[CONTAINERS] = {
+        pBis, pBlock, pBlock, pBlockW, pMaster, pAll };
+    Laik_Partitioning* toP[CONTAINERS] = {
+        pBisHalo, pBlock2, pHalo, pAll, pBlockW, pMaster };
+
+    Laik_Data* d[CONTAINERS];
+    for(int i = 0; i < CONTAINERS; i++) {
+        d[i] = laik_new_data(fromP[i]->space, laik_Double);
+        laik_switchto_partitioning(d[i], fromP[i], LAIK_DF_None, LAIK_RO_None);
+    }
+
+    int n = CONTAINERS - 1;
+    int a1 = checkTransitions(n, d, toP, LAIK_DF_Preserve, LAIK_RO_None);
+    int a2 = checkTransitions(n, d + 1, toP + 1, LAIK_DF_Preserve, LAIK_RO_Sum);
+    int a3 = checkTransitions(n, d + 1, toP + 1, LAIK_DF_Init, LAIK_RO_Max);
+
+    if (myid == 0)
+        printf("Threads: %d, actions (preserve/sum/init): %d/%d/%d\n",
+               laik_threads_count(), a1, a2, a3);
+
+    laik_finalize(inst);
+    return 0;
+}
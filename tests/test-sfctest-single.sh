@@ -0,0 +1,3 @@
+#!/bin/sh
+LAIK_BACKEND=single src/sfctest > test-sfctest-single.out
+cmp test-sfctest-single.out "$(dirname -- "${0}")/test-sfctest.expected"
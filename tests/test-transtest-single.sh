@@ -0,0 +1,3 @@
+#!/bin/sh
+LAIK_BACKEND=single LAIK_THREADS=4 src/transtest > test-transtest-single.out
+cmp test-transtest-single.out "$(dirname -- "${0}")/test-transtest.expected"